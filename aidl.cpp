@@ -24,9 +24,11 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <thread>
 
 #ifdef _WIN32
 #include <io.h>
@@ -36,8 +38,11 @@
 
 #include <android-base/strings.h>
 
+#include "aidl_apicheck.h"
 #include "aidl_language.h"
 #include "aidl_typenames.h"
+#include "call_profile.h"
+#include "flight_recorder.h"
 #include "generate_aidl_mappings.h"
 #include "generate_cpp.h"
 #include "generate_java.h"
@@ -46,6 +51,8 @@
 #include "logging.h"
 #include "options.h"
 #include "os.h"
+#include "parse_cache.h"
+#include "time_trace.h"
 #include "type_cpp.h"
 #include "type_java.h"
 #include "type_namespace.h"
@@ -169,6 +176,12 @@ bool register_types(const AidlStructuredParcelable* parcel, TypeNamespace* types
 
 bool register_types(const AidlInterface* c, TypeNamespace* types) {
   for (const auto& m : c->GetMethods()) {
+    // The meta methods are added after the types are registered the first
+    // time, see load_and_validate_aidl. They are skipped when the types are
+    // registered in the namespace of another language too.
+    if (!m->IsUserDefined()) {
+      continue;
+    }
     if (!types->MaybeAddContainerType(m->GetType())) {
       return false;
     }
@@ -208,6 +221,33 @@ bool register_types(const AidlInterface* c, TypeNamespace* types) {
   return true;
 }
 
+// Links |defined_types|, and the typespecs in them, to the types of the
+// language of |types|. Fails if one of them can't be used in that language.
+bool link_language_types(const vector<AidlDefinedType*>& defined_types, TypeNamespace* types) {
+  TimeTrace::Scope trace("LinkTypes");
+  trace.Count("types", defined_types.size());
+  for (const auto defined_type : defined_types) {
+    AidlInterface* interface = defined_type->AsInterface();
+    AidlStructuredParcelable* parcelable = defined_type->AsStructuredParcelable();
+
+    // Link the AIDL type with the type of the target language. This will
+    // be removed when the migration to AidlTypenames is done.
+    defined_type->SetLanguageType(types->GetDefinedType(*defined_type));
+
+    if (interface != nullptr) {
+      if (!register_types(interface, types)) {
+        return false;
+      }
+    }
+    if (parcelable != nullptr) {
+      if (!register_types(parcelable, types)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 bool write_dep_file(const Options& options, const AidlDefinedType& defined_type,
                     const vector<string>& imports, const IoDelegate& io_delegate,
                     const string& input_file, const string& output_file) {
@@ -230,6 +270,10 @@ bool write_dep_file(const Options& options, const AidlDefinedType& defined_type,
   for (const auto& import : imports) {
     source_aidl.push_back(import);
   }
+  // The stubs are generated according to the profile too.
+  if (!options.ProfileFile().empty()) {
+    source_aidl.push_back(options.ProfileFile());
+  }
 
   // Encode that the output file depends on aidl input files.
   writer->Write("%s : \\\n", output_file.c_str());
@@ -399,20 +443,31 @@ bool ParsePreprocessedLine(const string& line, string* decl,
   return true;
 }
 
-}  // namespace
-
-namespace internals {
-
-bool parse_preprocessed_file(const IoDelegate& io_delegate, const string& filename,
-                             TypeNamespace* types, AidlTypenames& typenames) {
+// Reads the declarations in the preprocessed |filename| into |file|. Returns
+// false on error, in which case the declarations of a text file that precede
+// the malformed line are still returned.
+bool read_preprocessed_file(const IoDelegate& io_delegate, const string& filename,
+                            internals::PreprocessedFile* file) {
+  TimeTrace::Scope trace("LoadPreprocessed", filename);
   bool success = true;
-  unique_ptr<LineReader> line_reader = io_delegate.GetLineReader(filename);
-  if (!line_reader) {
+  unique_ptr<FileBuffer> contents = io_delegate.GetFileBuffer(filename);
+  if (!contents) {
     LOG(ERROR) << "cannot open preprocessed file: " << filename;
     success = false;
     return success;
   }
+  trace.Count("bytes", contents->size());
+  if (PreprocessedTable::IsBinaryFormat(contents->data(), contents->size())) {
+    file->table = PreprocessedTable::Read(filename, std::move(contents));
+    if (file->table != nullptr) {
+      trace.Count("types", file->table->Size());
+    }
+    return file->table != nullptr;
+  }
 
+  vector<unique_ptr<AidlPreprocessedType>>* decls = &file->decls;
+  unique_ptr<LineReader> line_reader =
+      LineReader::ReadFromBuffer(contents->data(), contents->size());
   string line;
   int lineno = 1;
   for ( ; line_reader->ReadLine(&line); ++lineno) {
@@ -429,9 +484,7 @@ bool parse_preprocessed_file(const IoDelegate& io_delegate, const string& filena
       break;
     }
 
-    AidlLocation::Point point = {.line = lineno, .column = 0 /*column*/};
-    AidlLocation location = AidlLocation(filename, point, point);
-
+    AidlPreprocessedType::Kind kind;
     if (decl == "parcelable") {
       // ParcelFileDescriptor is treated as a built-in type, but it's also in the framework.aidl.
       // So aidl should ignore built-in types in framework.aidl to prevent duplication.
@@ -439,27 +492,18 @@ bool parse_preprocessed_file(const IoDelegate& io_delegate, const string& filena
       if (AidlTypenames::IsBuiltinTypename(class_name)) {
         continue;
       }
-      AidlParcelable* doc = new AidlParcelable(
-          location, new AidlQualifiedName(location, class_name, ""), package, "" /* comments */);
-      types->AddParcelableType(*doc, filename);
-      typenames.AddPreprocessedType(unique_ptr<AidlParcelable>(doc));
+      kind = AidlPreprocessedType::Kind::PARCELABLE;
     } else if (decl == "structured_parcelable") {
-      auto temp = new std::vector<std::unique_ptr<AidlVariableDeclaration>>();
-      AidlStructuredParcelable* doc =
-          new AidlStructuredParcelable(location, new AidlQualifiedName(location, class_name, ""),
-                                       package, "" /* comments */, temp);
-      types->AddParcelableType(*doc, filename);
-      typenames.AddPreprocessedType(unique_ptr<AidlStructuredParcelable>(doc));
+      kind = AidlPreprocessedType::Kind::STRUCTURED_PARCELABLE;
     } else if (decl == "interface") {
-      auto temp = new std::vector<std::unique_ptr<AidlMember>>();
-      AidlInterface* doc = new AidlInterface(location, class_name, "", false, temp, package);
-      types->AddBinderType(*doc, filename);
-      typenames.AddPreprocessedType(unique_ptr<AidlInterface>(doc));
+      kind = AidlPreprocessedType::Kind::INTERFACE;
     } else {
       success = false;
       break;
     }
+    decls->emplace_back(new AidlPreprocessedType(kind, package, class_name, filename, lineno));
   }
+  trace.Count("types", decls->size());
   if (!success) {
     LOG(ERROR) << filename << ':' << lineno
                << " malformed preprocessed file line: '" << line << "'";
@@ -468,12 +512,146 @@ bool parse_preprocessed_file(const IoDelegate& io_delegate, const string& filena
   return success;
 }
 
+// Parses the imported |filename| and adds the types it defines to the
+// AidlTypenames of |types|. Returns false if the file can't be parsed.
+bool parse_import(const string& filename, const Options& options, const IoDelegate& io_delegate,
+                  TypeNamespace* types, internals::ImportCache* import_cache,
+                  vector<AidlDefinedType*>* defined_types) {
+  if (import_cache == nullptr) {
+    return ParseCache::Parse(options.CacheDir(), filename, io_delegate, types->typenames_,
+                             defined_types);
+  }
+
+  const vector<AidlDefinedType*>* shared_types =
+      import_cache->GetImport(filename, options.CacheDir());
+  if (shared_types == nullptr) {
+    return false;
+  }
+  bool success = true;
+  for (const auto type : *shared_types) {
+    success &= types->typenames_.AddSharedDefinedType(*type);
+  }
+  *defined_types = *shared_types;
+  return success;
+}
+
+}  // namespace
+
+namespace internals {
+
+const vector<AidlDefinedType*>* ImportCache::GetImport(const string& filename,
+                                                      const string& cache_dir) {
+  Import* import;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unique_ptr<Import>& entry = imports_[filename];
+    if (entry == nullptr) {
+      entry.reset(new Import);
+    }
+    import = entry.get();
+  }
+  std::call_once(import->parsed, [&] {
+    AidlErrorCapture capture(&import->diagnostics);
+    import->stamped = io_delegate_.GetFileStamp(filename, &import->stamp);
+    import->ok = ParseCache::Parse(cache_dir, filename, io_delegate_, import->typenames,
+                                   &import->defined_types);
+    if (!import->ok) {
+      import->defined_types.clear();
+    }
+  });
+  import->diagnostics.Report();
+  return import->ok ? &import->defined_types : nullptr;
+}
+
+const PreprocessedFile* ImportCache::GetPreprocessed(const string& filename) {
+  Preprocessed* preprocessed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unique_ptr<Preprocessed>& entry = preprocessed_[filename];
+    if (entry == nullptr) {
+      entry.reset(new Preprocessed);
+    }
+    preprocessed = entry.get();
+  }
+  std::call_once(preprocessed->parsed, [&] {
+    AidlErrorCapture capture(&preprocessed->diagnostics);
+    preprocessed->stamped = io_delegate_.GetFileStamp(filename, &preprocessed->stamp);
+    preprocessed->ok = read_preprocessed_file(io_delegate_, filename, &preprocessed->file);
+    if (!preprocessed->ok) {
+      preprocessed->file = {};
+    }
+  });
+  preprocessed->diagnostics.Report();
+  return preprocessed->ok ? &preprocessed->file : nullptr;
+}
+
+string ImportCache::FindImportFile(const ImportResolver& resolver, const string& canonical_name) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = import_paths_.find(canonical_name);
+    if (it != import_paths_.end()) {
+      return it->second;
+    }
+  }
+  // The resolver reports its errors itself, so it is called without the lock.
+  string path = resolver.FindImportFile(canonical_name);
+  if (!path.empty()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    import_paths_.emplace(canonical_name, path);
+  }
+  return path;
+}
+
+void ImportCache::Revalidate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = imports_.begin(); it != imports_.end();) {
+    it = Changed(it->first, *it->second) ? imports_.erase(it) : std::next(it);
+  }
+  for (auto it = preprocessed_.begin(); it != preprocessed_.end();) {
+    it = Changed(it->first, *it->second) ? preprocessed_.erase(it) : std::next(it);
+  }
+  import_paths_.clear();
+  directory_listings_.Clear();
+}
+
+bool ImportCache::Changed(const string& filename, const CachedFile& file) const {
+  FileStamp stamp;
+  return !file.stamped || !io_delegate_.GetFileStamp(filename, &stamp) || stamp != file.stamp;
+}
+
+bool parse_preprocessed_file(const IoDelegate& io_delegate, const string& filename,
+                             TypeNamespace* types, AidlTypenames& typenames) {
+  PreprocessedFile file;
+  bool success = read_preprocessed_file(io_delegate, filename, &file);
+  for (auto& decl : file.decls) {
+    types->AddPreprocessedType(*decl);
+    typenames.AddPreprocessedType(std::move(decl));
+  }
+  if (file.table != nullptr) {
+    types->AddPreprocessedTable(*file.table);
+    typenames.AddPreprocessedTable(std::move(file.table));
+  }
+  return success;
+}
+
 AidlError load_and_validate_aidl(const std::string& input_file_name, const Options& options,
                                  const IoDelegate& io_delegate, TypeNamespace* types,
                                  vector<AidlDefinedType*>* defined_types,
-                                 vector<string>* imported_files) {
+                                 vector<string>* imported_files,
+                                 ImportCache* import_cache,
+                                 TypeRegistrations* registrations) {
   AidlError err = AidlError::OK;
 
+  // Registers loaded types in |types|, and records how it was done, so that
+  // the namespaces of other languages can be set up the same way.
+  auto add_to_namespace = [&](std::function<bool(TypeNamespace*)> step) {
+    const bool success = step(types);
+    if (registrations != nullptr) {
+      registrations->push_back(std::move(step));
+    }
+    return success;
+  };
+
   //////////////////////////////////////////////////////////////////////////
   // Loading phase
   //////////////////////////////////////////////////////////////////////////
@@ -484,14 +662,60 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
   if (main_parser == nullptr) {
     return AidlError::PARSE_ERROR;
   }
-  if (!types->AddDefinedTypes(main_parser->GetDefinedTypes(), input_file_name)) {
+  const vector<AidlDefinedType*>& main_types = main_parser->GetDefinedTypes();
+  if (!add_to_namespace([main_types, input_file_name](TypeNamespace* t) {
+        return t->AddDefinedTypes(main_types, input_file_name);
+      })) {
     return AidlError::BAD_TYPE;
   }
 
   // Import the preprocessed file
   for (const string& s : options.PreprocessedFiles()) {
-    if (!parse_preprocessed_file(io_delegate, s, types, types->typenames_)) {
-      err = AidlError::BAD_PRE_PROCESSED_FILE;
+    PreprocessedFile own_file;
+    const PreprocessedFile* file = &own_file;
+    if (import_cache == nullptr) {
+      // What could be read is used even if the file is malformed.
+      if (!read_preprocessed_file(io_delegate, s, &own_file)) {
+        err = AidlError::BAD_PRE_PROCESSED_FILE;
+      }
+    } else {
+      file = import_cache->GetPreprocessed(s);
+      if (file == nullptr) {
+        err = AidlError::BAD_PRE_PROCESSED_FILE;
+        continue;
+      }
+    }
+    TimeTrace::Scope trace("RegisterTypes", s);
+    trace.Count("types", file->decls.size() + (file->table != nullptr ? file->table->Size() : 0));
+    // Whether these are added successfully has never mattered.
+    for (const auto& decl : file->decls) {
+      const AidlPreprocessedType* type = decl.get();
+      add_to_namespace([type](TypeNamespace* t) {
+        t->AddPreprocessedType(*type);
+        return true;
+      });
+    }
+    if (file->table != nullptr) {
+      const PreprocessedTable* table = file->table.get();
+      add_to_namespace([table](TypeNamespace* t) {
+        t->AddPreprocessedTable(*table);
+        return true;
+      });
+    }
+    if (file == &own_file) {
+      for (auto& decl : own_file.decls) {
+        types->typenames_.AddPreprocessedType(std::move(decl));
+      }
+      if (own_file.table != nullptr) {
+        types->typenames_.AddPreprocessedTable(std::move(own_file.table));
+      }
+    } else {
+      for (const auto& decl : file->decls) {
+        types->typenames_.AddSharedPreprocessedType(*decl);
+      }
+      if (file->table != nullptr) {
+        types->typenames_.AddSharedPreprocessedTable(*file->table);
+      }
     }
   }
   if (err != AidlError::OK) {
@@ -500,8 +724,9 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
 
   // Find files to import and parse them
   vector<string> import_paths;
-  ImportResolver import_resolver{io_delegate, input_file_name, options.ImportDirs(),
-                                 options.InputFiles()};
+  ImportResolver import_resolver{
+      io_delegate, input_file_name, options.ImportDirs(), options.InputFiles(),
+      import_cache != nullptr ? import_cache->GetDirectoryListings() : nullptr};
 
   set<string> type_from_import_statements;
   for (const auto& import : main_parser->GetImports()) {
@@ -530,7 +755,9 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
       // This seems like an error, but legacy support demands we support it...
       continue;
     }
-    string import_path = import_resolver.FindImportFile(import);
+    string import_path = import_cache != nullptr
+                             ? import_cache->FindImportFile(import_resolver, import)
+                             : import_resolver.FindImportFile(import);
     if (import_path.empty()) {
       if (type_from_import_statements.find(import) != type_from_import_statements.end()) {
         // Complain only when the import from the import statement has failed.
@@ -542,14 +769,15 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
 
     import_paths.emplace_back(import_path);
 
-    std::unique_ptr<Parser> import_parser =
-        Parser::Parse(import_path, io_delegate, types->typenames_);
-    if (import_parser == nullptr) {
-      cerr << "error while importing " << import_path << " for " << import << endl;
+    vector<AidlDefinedType*> import_types;
+    if (!parse_import(import_path, options, io_delegate, types, import_cache, &import_types)) {
+      AidlErrorStream() << "error while importing " << import_path << " for " << import << endl;
       err = AidlError::BAD_IMPORT;
       continue;
     }
-    if (!types->AddDefinedTypes(import_parser->GetDefinedTypes(), import_path)) {
+    if (!add_to_namespace([import_types, import_path](TypeNamespace* t) {
+          return t->AddDefinedTypes(import_types, import_path);
+        })) {
       return AidlError::BAD_TYPE;
     }
   }
@@ -560,14 +788,15 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
   for (const auto& imported_file : options.ImportFiles()) {
     import_paths.emplace_back(imported_file);
 
-    std::unique_ptr<Parser> import_parser =
-        Parser::Parse(imported_file, io_delegate, types->typenames_);
-    if (import_parser == nullptr) {
+    vector<AidlDefinedType*> import_types;
+    if (!parse_import(imported_file, options, io_delegate, types, import_cache, &import_types)) {
       AIDL_ERROR(imported_file) << "error while importing " << imported_file;
       err = AidlError::BAD_IMPORT;
       continue;
     }
-    if (!types->AddDefinedTypes(import_parser->GetDefinedTypes(), imported_file)) {
+    if (!add_to_namespace([import_types, imported_file](TypeNamespace* t) {
+          return t->AddDefinedTypes(import_types, imported_file);
+        })) {
       return AidlError::BAD_TYPE;
     }
   }
@@ -582,32 +811,16 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
     // using fully qualified names.
     return AidlError::BAD_TYPE;
   }
-  if (!is_check_api) {
-    for (const auto defined_type : main_parser->GetDefinedTypes()) {
-      AidlInterface* interface = defined_type->AsInterface();
-      AidlStructuredParcelable* parcelable = defined_type->AsStructuredParcelable();
-
-      // Link the AIDL type with the type of the target language. This will
-      // be removed when the migration to AidlTypenames is done.
-      defined_type->SetLanguageType(types->GetDefinedType(*defined_type));
-
-      if (interface != nullptr) {
-        if (!register_types(interface, types)) {
-          return AidlError::BAD_TYPE;
-        }
-      }
-      if (parcelable != nullptr) {
-        if (!register_types(parcelable, types)) {
-          return AidlError::BAD_TYPE;
-        }
-      }
-    }
+  if (!is_check_api && !link_language_types(main_parser->GetDefinedTypes(), types)) {
+    return AidlError::BAD_TYPE;
   }
 
   //////////////////////////////////////////////////////////////////////////
   // Validation phase
   //////////////////////////////////////////////////////////////////////////
 
+  TimeTrace::Scope validate_trace("Validate", input_file_name);
+  validate_trace.Count("types", main_parser->GetDefinedTypes().size());
   AidlTypenames& typenames = types->typenames_;
 
   // For legacy reasons, by default, compiling an unstructured parcelable (which contains no output)
@@ -664,6 +877,7 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
     if (interface != nullptr) {
       // add the meta-method 'int getInterfaceVersion()' if version is specified.
       if (options.Version() > 0) {
+        AidlArena::Scope arena_scope(typenames.GetArena());
         AidlTypeSpecifier* ret =
             new AidlTypeSpecifier(AIDL_LOCATION_HERE, "int", false, nullptr, "");
         ret->Resolve(typenames);
@@ -709,68 +923,106 @@ AidlError load_and_validate_aidl(const std::string& input_file_name, const Optio
   return AidlError::OK;
 }
 
+AidlError register_language_types(const TypeRegistrations& registrations,
+                                  const vector<AidlDefinedType*>& defined_types,
+                                  TypeNamespace* types) {
+  TimeTrace::Scope trace("RegisterTypes");
+  for (const auto& step : registrations) {
+    if (!step(types)) {
+      return AidlError::BAD_TYPE;
+    }
+  }
+  if (!link_language_types(defined_types, types)) {
+    return AidlError::BAD_TYPE;
+  }
+  return AidlError::OK;
+}
+
 } // namespace internals
 
-int compile_aidl(const Options& options, const IoDelegate& io_delegate) {
-  const Options::Language lang = options.TargetLanguage();
-  for (const string& input_file : options.InputFiles()) {
-    // Create type namespace that will hold the types identified by the parser.
-    // This two namespaces that are specific to the target language will be
-    // unified to AidlTypenames which is agnostic to the target language.
-    cpp::TypeNamespace cpp_types;
-    cpp_types.Init();
+namespace {
 
-    java::JavaTypeNamespace java_types;
-    java_types.Init();
+int compile_aidl_file(const string& input_file, const Options& options,
+                      const IoDelegate& io_delegate, internals::ImportCache* import_cache) {
+  TimeTrace::Scope trace("Compile", input_file);
+  // The file is loaded and validated once, with the namespace of the first
+  // target language. The namespaces of the other languages share the types
+  // loaded into it, which is why it is kept until the end.
+  unique_ptr<cpp::TypeNamespace> loaded_cpp_types;
+  unique_ptr<java::JavaTypeNamespace> loaded_java_types;
+  AidlTypenames* loaded_typenames = nullptr;
+  internals::TypeRegistrations registrations;
+
+  vector<AidlDefinedType*> defined_types;
+  vector<string> imported_files;
+
+  for (const Options::Language lang : options.TargetLanguages()) {
+    const Options lang_options = options.ForLanguage(lang);
+    // Create type namespace that will hold the types identified by the parser.
+    // Only the namespaces of the target languages are created. The namespaces
+    // will be unified to AidlTypenames which is agnostic to the target language.
+    unique_ptr<cpp::TypeNamespace> cpp_types;
+    unique_ptr<java::JavaTypeNamespace> java_types;
 
     TypeNamespace* types;
-    if (options.IsCppOutput()) {
-      types = &cpp_types;
+    if (lang_options.IsCppOutput()) {
+      cpp_types.reset(loaded_typenames != nullptr ? new cpp::TypeNamespace(*loaded_typenames)
+                                                  : new cpp::TypeNamespace);
+      types = cpp_types.get();
     } else if (lang == Options::Language::JAVA) {
-      types = &java_types;
+      java_types.reset(loaded_typenames != nullptr
+                           ? new java::JavaTypeNamespace(*loaded_typenames)
+                           : new java::JavaTypeNamespace);
+      types = java_types.get();
     } else {
       LOG(FATAL) << "Unsupported target language." << endl;
       return 1;
     }
-
-    vector<AidlDefinedType*> defined_types;
-    vector<string> imported_files;
-
-    AidlError aidl_err = internals::load_and_validate_aidl(input_file, options, io_delegate, types,
-                                                           &defined_types, &imported_files);
-    bool allowError = aidl_err == AidlError::FOUND_PARCELABLE && !options.FailOnParcelable();
-    if (aidl_err != AidlError::OK && !allowError) {
+    types->Init();
+
+    if (loaded_typenames == nullptr) {
+      AidlError aidl_err = internals::load_and_validate_aidl(
+          input_file, lang_options, io_delegate, types, &defined_types, &imported_files,
+          import_cache, &registrations);
+      bool allowError = aidl_err == AidlError::FOUND_PARCELABLE && !options.FailOnParcelable();
+      if (aidl_err != AidlError::OK && !allowError) {
+        return 1;
+      }
+      loaded_typenames = &types->typenames_;
+    } else if (internals::register_language_types(registrations, defined_types, types) !=
+               AidlError::OK) {
       return 1;
     }
 
     for (const auto defined_type : defined_types) {
       CHECK(defined_type != nullptr);
 
-      string output_file_name = options.OutputFile();
+      string output_file_name = lang_options.OutputFile();
       // if needed, generate the output file name from the base folder
-      if (output_file_name.empty() && !options.OutputDir().empty()) {
-        output_file_name = generate_outputFileName(options, *defined_type);
+      if (output_file_name.empty() && !lang_options.OutputDir().empty()) {
+        output_file_name = generate_outputFileName(lang_options, *defined_type);
         if (output_file_name.empty()) {
           return 1;
         }
       }
 
-      if (!write_dep_file(options, *defined_type, imported_files, io_delegate, input_file,
+      if (!write_dep_file(lang_options, *defined_type, imported_files, io_delegate, input_file,
                           output_file_name)) {
         return 1;
       }
 
+      TimeTrace::Scope generate_trace("Generate", output_file_name);
       bool success = false;
       if (lang == Options::Language::CPP) {
-        success =
-            cpp::GenerateCpp(output_file_name, options, cpp_types, *defined_type, io_delegate);
+        success = cpp::GenerateCpp(output_file_name, lang_options, *cpp_types, *defined_type,
+                                   io_delegate);
       } else if (lang == Options::Language::NDK) {
-        ndk::GenerateNdk(output_file_name, options, cpp_types.typenames_, *defined_type,
+        ndk::GenerateNdk(output_file_name, lang_options, cpp_types->typenames_, *defined_type,
                          io_delegate);
         success = true;
       } else if (lang == Options::Language::JAVA) {
-        success =
-            java::generate_java(output_file_name, defined_type, &java_types, io_delegate, options);
+        success = java::generate_java(output_file_name, defined_type, java_types.get(),
+                                      io_delegate, lang_options);
       } else {
         LOG(FATAL) << "Should not reach here" << endl;
         return 1;
@@ -779,20 +1031,100 @@ int compile_aidl(const Options& options, const IoDelegate& io_delegate) {
         return 1;
       }
     }
+
+    if (loaded_cpp_types == nullptr && loaded_java_types == nullptr) {
+      loaded_cpp_types = std::move(cpp_types);
+      loaded_java_types = std::move(java_types);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+int compile_aidl(const Options& original_options, const IoDelegate& io_delegate,
+                 internals::ImportCache* import_cache) {
+  // The profile is loaded once for all the inputs.
+  std::shared_ptr<const CallProfile> profile;
+  if (!original_options.ProfileFile().empty()) {
+    profile = CallProfile::Load(original_options.ProfileFile(), io_delegate);
+    if (profile == nullptr) {
+      return 1;
+    }
+  }
+  const Options options = original_options.WithCallProfile(std::move(profile));
+  const vector<string>& input_files = options.InputFiles();
+  // Imports and preprocessed files are parsed once for all the inputs.
+  unique_ptr<internals::ImportCache> own_import_cache;
+  if (import_cache == nullptr) {
+    own_import_cache.reset(new internals::ImportCache(io_delegate));
+    import_cache = own_import_cache.get();
+  }
+  const size_t jobs = std::min<size_t>(options.Jobs(), input_files.size());
+  if (jobs <= 1) {
+    for (const string& input_file : input_files) {
+      if (compile_aidl_file(input_file, options, io_delegate, import_cache) != 0) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  // The inputs are handed out in order. Each worker records the errors of an
+  // input instead of printing them, so that they can be printed in input order
+  // afterwards. Like the serial compilation, nothing after the first failing
+  // input is reported; inputs after it are not started anymore.
+  vector<AidlDiagnostics> diagnostics(input_files.size());
+  vector<int> results(input_files.size(), 0);
+  std::atomic<size_t> next_input(0);
+  std::atomic<size_t> first_failure(input_files.size());
+  auto worker = [&]() {
+    for (size_t i = next_input++; i < input_files.size() && i < first_failure; i = next_input++) {
+      {
+        AidlErrorCapture capture(&diagnostics[i]);
+        results[i] = compile_aidl_file(input_files[i], options, io_delegate, import_cache);
+      }
+      if (results[i] != 0) {
+        size_t failure = first_failure;
+        while (i < failure && !first_failure.compare_exchange_weak(failure, i)) {
+        }
+      }
+    }
+  };
+  vector<std::thread> workers;
+  for (size_t i = 0; i < jobs; i++) {
+    workers.emplace_back(worker);
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  for (size_t i = 0; i < input_files.size(); i++) {
+    diagnostics[i].Report();
+    if (results[i] != 0) {
+      return 1;
+    }
   }
   return 0;
 }
 
-bool dump_mappings(const Options& options, const IoDelegate& io_delegate) {
+bool dump_mappings(const Options& options, const IoDelegate& io_delegate,
+                   internals::ImportCache* import_cache) {
   android::aidl::mappings::SignatureMap all_mappings;
+  unique_ptr<internals::ImportCache> own_import_cache;
+  if (import_cache == nullptr) {
+    own_import_cache.reset(new internals::ImportCache(io_delegate));
+    import_cache = own_import_cache.get();
+  }
   for (const string& input_file : options.InputFiles()) {
     java::JavaTypeNamespace java_types;
     java_types.Init();
     vector<AidlDefinedType*> defined_types;
     vector<string> imported_files;
 
-    AidlError aidl_err = internals::load_and_validate_aidl(
-        input_file, options, io_delegate, &java_types, &defined_types, &imported_files);
+    AidlError aidl_err =
+        internals::load_and_validate_aidl(input_file, options, io_delegate, &java_types,
+                                          &defined_types, &imported_files, import_cache);
     if (aidl_err != AidlError::OK) {
       LOG(WARNING) << "AIDL file is invalid.\n";
       continue;
@@ -814,19 +1146,37 @@ bool dump_mappings(const Options& options, const IoDelegate& io_delegate) {
 bool preprocess_aidl(const Options& options, const IoDelegate& io_delegate) {
   unique_ptr<CodeWriter> writer = io_delegate.GetCodeWriter(options.OutputFile());
 
+  // The binary format is written at once, as its entries are sorted. The
+  // parsed types are kept until then.
+  const bool binary = options.GetPreprocessFormat() == Options::PreprocessFormat::BINARY;
+  vector<unique_ptr<AidlTypenames>> all_typenames;
+  vector<unique_ptr<Parser>> parsers;
+  vector<const AidlDefinedType*> types;
+
   for (const auto& file : options.InputFiles()) {
-    AidlTypenames typenames;
+    all_typenames.emplace_back(new AidlTypenames);
+    AidlTypenames& typenames = *all_typenames.back();
     std::unique_ptr<Parser> p = Parser::Parse(file, io_delegate, typenames);
     if (p == nullptr) return false;
 
     for (const auto& defined_type : p->GetDefinedTypes()) {
+      if (binary) {
+        types.push_back(defined_type);
+        continue;
+      }
       if (!writer->Write("%s %s;\n", defined_type->GetPreprocessDeclarationName().c_str(),
                          defined_type->GetCanonicalName().c_str())) {
         return false;
       }
     }
+    if (binary) {
+      parsers.push_back(std::move(p));
+    }
   }
 
+  if (binary && !PreprocessedTable::Write(types, writer.get())) {
+    return false;
+  }
   return writer->Close();
 }
 
@@ -837,13 +1187,19 @@ static string GetApiDumpPathFor(const AidlDefinedType& defined_type, const Optio
          ".aidl";
 }
 
-bool dump_api(const Options& options, const IoDelegate& io_delegate) {
+bool dump_api(const Options& options, const IoDelegate& io_delegate,
+              internals::ImportCache* import_cache) {
+  unique_ptr<internals::ImportCache> own_import_cache;
+  if (import_cache == nullptr) {
+    own_import_cache.reset(new internals::ImportCache(io_delegate));
+    import_cache = own_import_cache.get();
+  }
   for (const auto& file : options.InputFiles()) {
     java::JavaTypeNamespace ns;
     ns.Init();
     vector<AidlDefinedType*> defined_types;
     if (internals::load_and_validate_aidl(file, options, io_delegate, &ns, &defined_types,
-                                          nullptr) == AidlError::OK) {
+                                          nullptr, import_cache) == AidlError::OK) {
       for (const auto type : defined_types) {
         unique_ptr<CodeWriter> writer =
             io_delegate.GetCodeWriter(GetApiDumpPathFor(*type, options));
@@ -859,5 +1215,56 @@ bool dump_api(const Options& options, const IoDelegate& io_delegate) {
   return true;
 }
 
+namespace {
+
+int run_task_with(const Options& options, const IoDelegate& io_delegate,
+                  internals::ImportCache* import_cache) {
+  switch (options.GetTask()) {
+    case Options::Task::COMPILE:
+      return compile_aidl(options, io_delegate, import_cache);
+    case Options::Task::PREPROCESS:
+      return preprocess_aidl(options, io_delegate) ? 0 : 1;
+    case Options::Task::DUMP_API:
+      return dump_api(options, io_delegate, import_cache) ? 0 : 1;
+    case Options::Task::CHECK_API:
+      return check_api(options, io_delegate) ? 0 : 1;
+    case Options::Task::DUMP_MAPPINGS:
+      return dump_mappings(options, io_delegate, import_cache) ? 0 : 1;
+    case Options::Task::DECODE_FLIGHT_RECORDER:
+      return decode_flight_recorder(options, io_delegate) ? 0 : 1;
+    default:
+      LOG(FATAL) << "aidl: internal error" << std::endl;
+      return 1;
+  }
+}
+
+}  // namespace
+
+int run_task(const Options& options, const IoDelegate& io_delegate,
+             internals::ImportCache* import_cache) {
+  unique_ptr<WriteIfChangedIoDelegate> write_if_changed;
+  const IoDelegate* delegate = &io_delegate;
+  if (options.WriteIfChanged()) {
+    write_if_changed.reset(new WriteIfChangedIoDelegate(io_delegate));
+    delegate = write_if_changed.get();
+  }
+  if (options.TimeTraceFile().empty()) {
+    return run_task_with(options, *delegate, import_cache);
+  }
+
+  TimeTrace time_trace;
+  int status;
+  {
+    TimeTrace::Scope trace("RunTask");
+    status = run_task_with(options, *delegate, import_cache);
+  }
+  // The trace is written even if the task failed, as it may tell why it is
+  // slow to fail.
+  if (!time_trace.Write(options.TimeTraceFile(), io_delegate) && status == 0) {
+    status = 1;
+  }
+  return status;
+}
+
 }  // namespace android
 }  // namespace aidl
@@ -16,15 +16,21 @@
 
 #pragma once
 
+#include <functional>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include <android-base/macros.h>
+
 #include "aidl_language.h"
 #include "import_resolver.h"
 #include "io_delegate.h"
 #include "options.h"
+#include "preprocessed_table.h"
 #include "type_namespace.h"
 
 namespace android {
@@ -46,19 +52,132 @@ enum class AidlError {
   OK = 0,
 };
 
-int compile_aidl(const Options& options, const IoDelegate& io_delegate);
+namespace internals {
+class ImportCache;
+}  // namespace internals
+
+// When |import_cache| is given, imports and preprocessed files are taken from
+// it, so that they can be shared with other invocations.
+int compile_aidl(const Options& options, const IoDelegate& io_delegate,
+                 internals::ImportCache* import_cache = nullptr);
 bool preprocess_aidl(const Options& options, const IoDelegate& io_delegate);
-bool dump_api(const Options& options, const IoDelegate& io_delegate);
-bool dump_mappings(const Options& options, const IoDelegate& io_delegate);
+bool dump_api(const Options& options, const IoDelegate& io_delegate,
+              internals::ImportCache* import_cache = nullptr);
+bool dump_mappings(const Options& options, const IoDelegate& io_delegate,
+                   internals::ImportCache* import_cache = nullptr);
+
+// Runs the task of |options|, and returns the exit status of the command line.
+// With --write_if_changed, the files are written through a
+// WriteIfChangedIoDelegate. With --time_trace, the phases of the task are
+// recorded into a TimeTrace, which is written afterwards.
+int run_task(const Options& options, const IoDelegate& io_delegate,
+             internals::ImportCache* import_cache = nullptr);
 
 const string kGetInterfaceVersion("getInterfaceVersion");
 
 namespace internals {
 
+// The types declared in a preprocessed file. A file in the text format is read
+// into |decls|, while a file in the binary format is kept as |table|.
+struct PreprocessedFile {
+  vector<std::unique_ptr<AidlPreprocessedType>> decls;
+  std::unique_ptr<PreprocessedTable> table;
+};
+
+// Imports and preprocessed files shared by all the inputs of one invocation.
+// Each of them is read and parsed at most once. The parsed types are then
+// added to the TypeNamespace of every input that refers to them, without
+// being copied. The methods can be called from multiple threads. The errors
+// found while parsing a file are reported every time it is requested, as if
+// it had been parsed again.
+//
+// A cache can be kept for several invocations with the same working
+// directory, as long as Revalidate() is called before each of them.
+class ImportCache {
+ public:
+  explicit ImportCache(const IoDelegate& io_delegate)
+      : io_delegate_(io_delegate), directory_listings_(io_delegate) {}
+  ~ImportCache() = default;
+
+  // Returns the types defined in the imported |filename|, or nullptr if it
+  // can't be parsed. A file that isn't parsed yet is looked up in |cache_dir|
+  // first, if any (see ParseCache).
+  const vector<AidlDefinedType*>* GetImport(const std::string& filename,
+                                            const std::string& cache_dir = "");
+
+  // Returns the types declared in the preprocessed |filename|, or nullptr if
+  // it is malformed.
+  const PreprocessedFile* GetPreprocessed(const std::string& filename);
+
+  // Same as ImportResolver::FindImportFile, but remembers the imports that
+  // were found. Misses are not cached so that errors are reported every time.
+  std::string FindImportFile(const ImportResolver& resolver, const std::string& canonical_name);
+
+  // The listings of the import directories, to be shared by the resolvers of
+  // the invocation.
+  DirectoryListings* GetDirectoryListings() { return &directory_listings_; }
+
+  // Forgets the files whose modification time or size changed since they
+  // were parsed, and where the imports were found, as the next invocation may
+  // search other directories, or the directories may have changed. Must not be
+  // called concurrently with the other methods, nor while the types of a
+  // forgotten file are still in use.
+  void Revalidate();
+
+ private:
+  struct CachedFile {
+    std::once_flag parsed;
+    AidlDiagnostics diagnostics;
+    bool ok = false;
+    // Taken before the file is read. False if the file couldn't be examined.
+    bool stamped = false;
+    FileStamp stamp;
+  };
+  struct Import : CachedFile {
+    AidlTypenames typenames;
+    vector<AidlDefinedType*> defined_types;
+  };
+  struct Preprocessed : CachedFile {
+    PreprocessedFile file;
+  };
+
+  // Returns true if |file| may not hold the contents of |filename| anymore.
+  bool Changed(const std::string& filename, const CachedFile& file) const;
+
+  const IoDelegate& io_delegate_;
+  // Guards the maps, but not the entries. Each entry is filled exactly once.
+  std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Import>> imports_;
+  std::map<std::string, std::unique_ptr<Preprocessed>> preprocessed_;
+  std::map<std::string, std::string> import_paths_;
+  DirectoryListings directory_listings_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImportCache);
+};
+
+// How the loaded types were registered in a TypeNamespace, step by step.
+using TypeRegistrations = vector<std::function<bool(TypeNamespace*)>>;
+
+// When |import_cache| is given, imports and preprocessed files are taken from
+// it instead of being parsed again. When |registrations| is given, the way the
+// types were registered in |types| is stored to it, see
+// register_language_types.
 AidlError load_and_validate_aidl(const std::string& input_file_name, const Options& options,
                                  const IoDelegate& io_delegate, TypeNamespace* types,
                                  vector<AidlDefinedType*>* defined_types,
-                                 vector<string>* imported_files);
+                                 vector<string>* imported_files,
+                                 ImportCache* import_cache = nullptr,
+                                 TypeRegistrations* registrations = nullptr);
+
+// Sets up |types| for generating |defined_types| in another language than the
+// one they were loaded with. |types| must share the AidlTypenames of the
+// namespace given to load_and_validate_aidl, and |registrations| must come
+// from it. The files are neither parsed nor validated again; only what depends
+// on the language is checked. The types are linked to those of the language of
+// |types| from then on.
+AidlError register_language_types(const TypeRegistrations& registrations,
+                                  const vector<AidlDefinedType*>& defined_types,
+                                  TypeNamespace* types);
 
 bool parse_preprocessed_file(const IoDelegate& io_delegate, const std::string& filename,
                              TypeNamespace* types, AidlTypenames& typenames);
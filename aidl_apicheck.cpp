@@ -13,24 +13,88 @@
  * limitations under the License.
  */
 
+#include "aidl_apicheck.h"
+
 #include "aidl.h"
 #include "aidl_language.h"
 #include "import_resolver.h"
 #include "options.h"
+#include "os.h"
 #include "type_java.h"
 
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <android-base/strings.h>
+
 namespace android {
 namespace aidl {
 
+using android::base::Split;
+using android::base::StartsWith;
+using android::base::Trim;
 using std::map;
 using std::set;
 using std::string;
+using std::unordered_map;
 using std::vector;
 
+// The lines of an API dump file that matter for the check: blank lines and
+// lines that are only a // comment are left out. aidl_interface compares the
+// dumps that way too, and the frozen dumps start with such a preamble.
+static string api_lines(const string& contents) {
+  string lines;
+  for (const string& line : Split(contents, "\n")) {
+    const string trimmed = Trim(line);
+    if (!trimmed.empty() && !StartsWith(trimmed, "//")) {
+      lines += line;
+      lines += '\n';
+    }
+  }
+  return lines;
+}
+
+// Reads the API dump in |dir|, keyed by the paths of its files relative to
+// |dir|, without the lines left out by api_lines. Returns false if a file
+// can't be read.
+static bool read_api_dump(const string& dir, const IoDelegate& io_delegate,
+                          map<string, string>* dump) {
+  for (const string& file : io_delegate.ListFiles(dir)) {
+    std::unique_ptr<string> contents = io_delegate.GetFileContents(file);
+    if (contents == nullptr) {
+      return false;
+    }
+    const size_t start = file.find_first_not_of(OS_PATH_SEPARATOR, dir.size());
+    (*dump)[file.substr(std::min(start, file.size()))] = api_lines(*contents);
+  }
+  return true;
+}
+
+// Loads the types of the API dump in |dir| into |ns|.
+static bool load_api_dump(const string& dir, const Options& options,
+                          const IoDelegate& io_delegate, java::JavaTypeNamespace* ns,
+                          vector<AidlDefinedType*>* defined_types) {
+  vector<string> files = io_delegate.ListFiles(dir);
+  if (files.size() == 0) {
+    AIDL_ERROR(dir) << "No API file exist";
+    return false;
+  }
+  for (const auto& file : files) {
+    vector<AidlDefinedType*> types;
+    if (internals::load_and_validate_aidl(file, options, io_delegate, ns, &types,
+                                          nullptr /* imported_files */) != AidlError::OK) {
+      AIDL_ERROR(file) << "Failed to read.";
+      return false;
+    }
+    defined_types->insert(defined_types->end(), types.begin(), types.end());
+  }
+  return true;
+}
+
 static bool have_compatible_annotations(const AidlAnnotatable& older,
                                         const AidlAnnotatable& newer) {
   set<AidlAnnotation> olderAnnotations(older.GetAnnotations().begin(),
@@ -60,8 +124,9 @@ static bool are_compatible_interfaces(const AidlInterface& older, const AidlInte
   bool compatible = true;
   compatible &= have_compatible_annotations(older, newer);
 
-  map<string, AidlMethod*> new_methods;
-  for (const auto& m : newer.AsInterface()->GetMethods()) {
+  const auto& newer_methods = newer.AsInterface()->GetMethods();
+  unordered_map<string, AidlMethod*> new_methods(newer_methods.size());
+  for (const auto& m : newer_methods) {
     new_methods.emplace(m->Signature(), m.get());
   }
 
@@ -111,8 +176,9 @@ static bool are_compatible_interfaces(const AidlInterface& older, const AidlInte
     }
   }
 
-  map<string, AidlConstantDeclaration*> new_constdecls;
-  for (const auto& c : newer.AsInterface()->GetConstantDeclarations()) {
+  const auto& newer_constdecls = newer.AsInterface()->GetConstantDeclarations();
+  unordered_map<string, AidlConstantDeclaration*> new_constdecls(newer_constdecls.size());
+  for (const auto& c : newer_constdecls) {
     new_constdecls.emplace(c->GetName(), c.get());
   }
 
@@ -180,45 +246,35 @@ bool check_api(const Options& options, const IoDelegate& io_delegate) {
   CHECK(options.InputFiles().size() == 2) << "--checkapi requires two inputs "
                                           << "but got " << options.InputFiles().size();
 
+  const string old_dir = options.InputFiles().at(0);
+  const string new_dir = options.InputFiles().at(1);
+  // Dumps that only differ by comments and blank lines are compatible if they
+  // are valid, so only one of them is parsed then. Reading them is much
+  // cheaper than parsing them.
+  map<string, string> old_dump;
+  map<string, string> new_dump;
+  const bool same_dumps = read_api_dump(old_dir, io_delegate, &old_dump) &&
+                          read_api_dump(new_dir, io_delegate, &new_dump) &&
+                          !old_dump.empty() && old_dump == new_dump;
+
   java::JavaTypeNamespace old_ns;
   old_ns.Init();
-  const string old_dir = options.InputFiles().at(0);
   vector<AidlDefinedType*> old_types;
-  vector<string> old_files = io_delegate.ListFiles(old_dir);
-  if (old_files.size() == 0) {
-    AIDL_ERROR(old_dir) << "No API file exist";
+  if (!load_api_dump(old_dir, options, io_delegate, &old_ns, &old_types)) {
     return false;
   }
-  for (const auto& file : old_files) {
-    vector<AidlDefinedType*> types;
-    if (internals::load_and_validate_aidl(file, options, io_delegate, &old_ns, &types,
-                                          nullptr /* imported_files */) != AidlError::OK) {
-      AIDL_ERROR(file) << "Failed to read.";
-      return false;
-    }
-    old_types.insert(old_types.end(), types.begin(), types.end());
+  if (same_dumps) {
+    return true;
   }
 
   java::JavaTypeNamespace new_ns;
   new_ns.Init();
-  const string new_dir = options.InputFiles().at(1);
   vector<AidlDefinedType*> new_types;
-  vector<string> new_files = io_delegate.ListFiles(new_dir);
-  if (new_files.size() == 0) {
-    AIDL_ERROR(new_dir) << "No API file exist";
+  if (!load_api_dump(new_dir, options, io_delegate, &new_ns, &new_types)) {
     return false;
   }
-  for (const auto& file : new_files) {
-    vector<AidlDefinedType*> types;
-    if (internals::load_and_validate_aidl(file, options, io_delegate, &new_ns, &types,
-                                          nullptr /* imported_files */) != AidlError::OK) {
-      AIDL_ERROR(file) << "Failed to read.";
-      return false;
-    }
-    new_types.insert(new_types.end(), types.begin(), types.end());
-  }
 
-  map<string, AidlDefinedType*> new_map;
+  unordered_map<string, AidlDefinedType*> new_map(new_types.size());
   for (const auto t : new_types) {
     new_map.emplace(t->GetCanonicalName(), t);
   }
@@ -21,7 +21,10 @@ namespace android {
 namespace aidl {
 
 // Compare the two API dumps, which are given as input files, and test whether
-// the second API dump is backwards compatible with the first API dump.
+// the second API dump is backwards compatible with the first API dump. Dumps
+// whose files only differ by blank lines and // comments, like a frozen dump
+// and the dump it was made from, are compatible if the first one is valid,
+// and the second one isn't parsed.
 bool check_api(const Options& options, const IoDelegate& io_delegate);
 
 }  // namespace aidl
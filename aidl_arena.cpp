@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "aidl_arena.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <string>
+
+namespace {
+
+thread_local AidlArena* current_arena = nullptr;
+
+constexpr size_t kAlignment = alignof(std::max_align_t);
+constexpr size_t kFirstBlockSize = 1024;
+constexpr size_t kBlockSize = 64 * 1024;
+// Allocations bigger than this get a block of their own, so that the rest of
+// the current block isn't wasted.
+constexpr size_t kMaxSharedAllocation = kBlockSize / 4;
+
+// Every AidlArenaAllocated object is preceded by a header telling where its
+// memory comes from. The header keeps the object aligned.
+constexpr size_t kHeaderSize = kAlignment;
+constexpr uintptr_t kFromHeap = 0;
+constexpr uintptr_t kFromArena = 1;
+
+std::mutex& SharedMutex() {
+  static std::mutex* shared_mutex = new std::mutex;
+  return *shared_mutex;
+}
+
+AidlArena& SharedArena() {
+  static AidlArena* shared_arena = new AidlArena;
+  return *shared_arena;
+}
+
+}  // namespace
+
+AidlArena::AidlArena() : block_size_(kFirstBlockSize) {}
+
+AidlArena::~AidlArena() {
+  for (void* block : blocks_) {
+    ::operator delete(block);
+  }
+}
+
+void* AidlArena::Allocate(size_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  allocated_size_ += size;
+  if (size > kMaxSharedAllocation) {
+    void* block = ::operator new(size);
+    blocks_.push_back(block);
+    return block;
+  }
+  if (size > remaining_) {
+    while (block_size_ < size) {
+      block_size_ *= 2;
+    }
+    next_ = static_cast<char*>(::operator new(block_size_));
+    blocks_.push_back(next_);
+    remaining_ = block_size_;
+    block_size_ = std::min(block_size_ * 2, kBlockSize);
+  }
+  void* ptr = next_;
+  next_ += size;
+  remaining_ -= size;
+  return ptr;
+}
+
+const std::string& AidlArena::Intern(const std::string& str) {
+  return *strings_.insert(str).first;
+}
+
+const std::string& AidlArena::InternString(const std::string& str) {
+  if (current_arena != nullptr) {
+    return current_arena->Intern(str);
+  }
+  std::lock_guard<std::mutex> lock(SharedMutex());
+  return SharedArena().Intern(str);
+}
+
+size_t AidlArena::SharedStringCount() {
+  std::lock_guard<std::mutex> lock(SharedMutex());
+  return SharedArena().strings_.size();
+}
+
+AidlArena::Scope::Scope(AidlArena* arena) : previous_(current_arena) {
+  current_arena = arena;
+}
+
+AidlArena::Scope::~Scope() {
+  current_arena = previous_;
+}
+
+void* AidlArenaAllocated::operator new(size_t size) {
+  char* memory;
+  uintptr_t origin;
+  if (current_arena != nullptr) {
+    memory = static_cast<char*>(current_arena->Allocate(kHeaderSize + size));
+    origin = kFromArena;
+  } else {
+    memory = static_cast<char*>(::operator new(kHeaderSize + size));
+    origin = kFromHeap;
+  }
+  *reinterpret_cast<uintptr_t*>(memory) = origin;
+  return memory + kHeaderSize;
+}
+
+void AidlArenaAllocated::operator delete(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  char* memory = static_cast<char*>(ptr) - kHeaderSize;
+  if (*reinterpret_cast<uintptr_t*>(memory) == kFromHeap) {
+    ::operator delete(memory);
+  }
+}
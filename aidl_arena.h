@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <android-base/macros.h>
+
+// Memory for the nodes of the parse trees that are owned by one
+// AidlTypenames. Allocations are carved out of large blocks, and are only
+// given back when the arena is destroyed, all at once. The arena also keeps
+// one copy of each file name, identifier and type name used by the nodes.
+//
+// The nodes keep their usual owners, which still destroy them. Only their
+// memory and their interned strings come from the arena, so the arena must
+// outlive all of them.
+class AidlArena final {
+ public:
+  AidlArena();
+  ~AidlArena();
+
+  // Returns |size| bytes aligned like max_align_t.
+  void* Allocate(size_t size);
+
+  // Bytes handed out so far.
+  size_t AllocatedSize() const { return allocated_size_; }
+
+  // Returns the copy of |str| kept by this arena. Equal strings share one
+  // copy, so two strings interned in the same arena are equal if and only if
+  // they have the same address.
+  const std::string& Intern(const std::string& str);
+
+  // Interns |str| in the arena of the calling thread. If there is none,
+  // |str| is interned in a pool that is shared by the process and never
+  // freed. Compilations never use that pool, as the nodes they create outside
+  // of a parse are created in the scope of the arena of their owner; it is
+  // only there for nodes created on their own, e.g. by tests.
+  static const std::string& InternString(const std::string& str);
+  // Number of strings in the pool shared by the process.
+  static size_t SharedStringCount();
+
+  // Makes |arena| the arena of the calling thread while it is in scope.
+  // AidlArenaAllocated objects created meanwhile take their memory from it.
+  // |arena| can be nullptr, in which case they come from the heap.
+  class Scope final {
+   public:
+    explicit Scope(AidlArena* arena);
+    ~Scope();
+
+   private:
+    AidlArena* const previous_;
+
+    DISALLOW_COPY_AND_ASSIGN(Scope);
+  };
+
+ private:
+  std::vector<void*> blocks_;
+  // Arenas that hold only a few nodes, like those of preprocessed types,
+  // start with small blocks.
+  size_t block_size_;
+  char* next_ = nullptr;
+  size_t remaining_ = 0;
+  size_t allocated_size_ = 0;
+  std::unordered_set<std::string> strings_;
+
+  DISALLOW_COPY_AND_ASSIGN(AidlArena);
+};
+
+// Base of the classes whose objects are allocated from the arena of the
+// current AidlArena::Scope, if any, and from the heap otherwise. Deleting an
+// object from an arena only runs its destructor.
+class AidlArenaAllocated {
+ public:
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+};
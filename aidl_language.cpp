@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -14,10 +15,12 @@
 
 #include <android-base/parsedouble.h>
 #include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
 #include "aidl_language_y-module.h"
 #include "logging.h"
+#include "time_trace.h"
 #include "type_java.h"
 #include "type_namespace.h"
 
@@ -29,6 +32,7 @@ int isatty(int  fd)
 #endif
 
 using android::aidl::IoDelegate;
+using android::aidl::TimeTrace;
 using android::base::Join;
 using android::base::Split;
 using std::cerr;
@@ -46,15 +50,34 @@ int yyparse(Parser*);
 YY_BUFFER_STATE yy_scan_buffer(char *, size_t, void *);
 void yy_delete_buffer(YY_BUFFER_STATE, void *);
 
-AidlToken::AidlToken(const std::string& text, const std::string& comments)
-    : text_(text),
-      comments_(comments) {}
+AidlComments::AidlComments(const std::string& comments) {
+  if (!comments.empty()) {
+    const string& interned = AidlArena::InternString(comments);
+    data_ = interned.data();
+    size_ = interned.size();
+  }
+}
+
+AidlComments AidlComments::InFile(const char* data, size_t size) {
+  AidlComments comments;
+  if (size > 0) {
+    comments.data_ = data;
+    comments.size_ = size;
+  }
+  return comments;
+}
+
+AidlToken::AidlToken(const std::string& text, const AidlComments& comments)
+    : text_(&AidlArena::InternString(text)), comments_(comments) {}
 
 AidlLocation::AidlLocation(const std::string& file, Point begin, Point end)
+    : AidlLocation(&AidlArena::InternString(file), begin, end) {}
+
+AidlLocation::AidlLocation(const std::string* file, Point begin, Point end)
     : file_(file), begin_(begin), end_(end) {}
 
 std::ostream& operator<<(std::ostream& os, const AidlLocation& l) {
-  os << l.file_ << ":" << l.begin_.line << "." << l.begin_.column << "-";
+  os << *l.file_ << ":" << l.begin_.line << "." << l.begin_.column << "-";
   if (l.begin_.line != l.end_.line) {
     os << l.end_.line << ".";
   }
@@ -66,14 +89,100 @@ AidlNode::AidlNode(const AidlLocation& location) : location_(location) {}
 
 std::string AidlNode::PrintLocation() const {
   std::stringstream ss;
-  ss << location_.file_ << ":" << location_.begin_.line;
+  ss << *location_.file_ << ":" << location_.begin_.line;
   return ss.str();
 }
 
-AidlError::AidlError(bool fatal) : os_(std::cerr), fatal_(fatal) {
+AidlError::AidlError(bool fatal) : os_(fatal ? std::cerr : AidlErrorStream()), fatal_(fatal) {
   os_ << "ERROR: ";
 }
 
+static thread_local AidlErrorCapture* current_error_capture = nullptr;
+
+std::ostream& AidlErrorStream() {
+  if (current_error_capture != nullptr) {
+    return current_error_capture->stream_;
+  }
+  return std::cerr;
+}
+
+void AidlDiagnostics::Report() const {
+  for (const auto& entry : entries_) {
+    if (current_error_capture != nullptr) {
+      current_error_capture->Record(entry);
+    } else if (entry.is_log) {
+      android::base::StderrLogger(entry.id, entry.severity, entry.tag.c_str(), entry.file.c_str(),
+                                  entry.line, entry.message.c_str());
+    } else {
+      std::cerr << entry.message;
+    }
+  }
+}
+
+string AidlDiagnostics::ToString() const {
+  string text;
+  for (const auto& entry : entries_) {
+    if (entry.is_log) {
+      text += android::base::StringPrintf(
+          "%s %c %s:%u] %s\n", entry.tag.empty() ? "aidl" : entry.tag.c_str(),
+          "VDIWEFF"[entry.severity], entry.file.c_str(), entry.line, entry.message.c_str());
+    } else {
+      text += entry.message;
+    }
+  }
+  return text;
+}
+
+AidlErrorCapture::AidlErrorCapture(AidlDiagnostics* diagnostics)
+    : diagnostics_(diagnostics), enclosing_(current_error_capture) {
+  // The logger is process wide. Outside of captures it behaves like the
+  // default one, so it is installed once and then left in place.
+  static std::once_flag logger_installed;
+  std::call_once(logger_installed, [] { android::base::SetLogger(AidlErrorCapture::Log); });
+  current_error_capture = this;
+}
+
+AidlErrorCapture::~AidlErrorCapture() {
+  Flush();
+  current_error_capture = enclosing_;
+}
+
+void AidlErrorCapture::Flush() {
+  const string text = stream_.str();
+  if (!text.empty()) {
+    diagnostics_->entries_.push_back({.is_log = false,
+                                      .id = android::base::DEFAULT,
+                                      .severity = android::base::ERROR,
+                                      .tag = "",
+                                      .file = "",
+                                      .line = 0,
+                                      .message = text});
+    stream_.str("");
+  }
+}
+
+void AidlErrorCapture::Record(AidlDiagnostics::Entry entry) {
+  // Keep the order between the errors and the log messages.
+  Flush();
+  diagnostics_->entries_.push_back(std::move(entry));
+}
+
+void AidlErrorCapture::Log(android::base::LogId id, android::base::LogSeverity severity,
+                           const char* tag, const char* file, unsigned int line,
+                           const char* message) {
+  if (current_error_capture == nullptr || severity >= android::base::FATAL) {
+    android::base::StderrLogger(id, severity, tag, file, line, message);
+    return;
+  }
+  current_error_capture->Record({.is_log = true,
+                                 .id = id,
+                                 .severity = severity,
+                                 .tag = tag != nullptr ? tag : "",
+                                 .file = file != nullptr ? file : "",
+                                 .line = line,
+                                 .message = message});
+}
+
 static const string kNullable("nullable");
 static const string kUtf8InCpp("utf8InCpp");
 static const string kUnsupportedAppUsage("UnsupportedAppUsage");
@@ -99,7 +208,8 @@ AidlAnnotation* AidlAnnotation::Parse(const AidlLocation& location, const string
 }
 
 AidlAnnotation::AidlAnnotation(const AidlLocation& location, const string& name)
-    : AidlNode(location), name_(name) {}
+    : AidlNode(location),
+      name_(&AidlArena::InternString(name)) {}
 
 static bool HasAnnotation(const vector<AidlAnnotation>& annotations, const string& name) {
   for (const auto& a : annotations) {
@@ -144,9 +254,9 @@ string AidlAnnotatable::ToString() const {
 AidlTypeSpecifier::AidlTypeSpecifier(const AidlLocation& location, const string& unresolved_name,
                                      bool is_array,
                                      vector<unique_ptr<AidlTypeSpecifier>>* type_params,
-                                     const string& comments)
+                                     const AidlComments& comments)
     : AidlAnnotatable(location),
-      unresolved_name_(unresolved_name),
+      unresolved_name_(&AidlArena::InternString(unresolved_name)),
       is_array_(is_array),
       type_params_(type_params),
       comments_(comments) {}
@@ -185,9 +295,9 @@ string AidlTypeSpecifier::Signature() const {
 
 bool AidlTypeSpecifier::Resolve(android::aidl::AidlTypenames& typenames) {
   assert(!IsResolved());
-  pair<string, bool> result = typenames.ResolveTypename(unresolved_name_);
+  pair<string, bool> result = typenames.ResolveTypename(*unresolved_name_);
   if (result.second) {
-    fully_qualified_name_ = result.first;
+    fully_qualified_name_ = &typenames.GetArena()->Intern(result.first);
   }
   return result.second;
 }
@@ -247,7 +357,10 @@ AidlVariableDeclaration::AidlVariableDeclaration(const AidlLocation& location,
 AidlVariableDeclaration::AidlVariableDeclaration(const AidlLocation& location,
                                                  AidlTypeSpecifier* type, const std::string& name,
                                                  AidlConstantValue* default_value)
-    : AidlNode(location), type_(type), name_(name), default_value_(default_value) {}
+    : AidlNode(location),
+      type_(type),
+      name_(&AidlArena::InternString(name)),
+      default_value_(default_value) {}
 
 bool AidlVariableDeclaration::CheckValid(const AidlTypenames& typenames) const {
   bool valid = true;
@@ -262,7 +375,7 @@ bool AidlVariableDeclaration::CheckValid(const AidlTypenames& typenames) const {
 }
 
 string AidlVariableDeclaration::ToString() const {
-  string ret = type_->Signature() + " " + name_;
+  string ret = type_->Signature() + " " + *name_;
   if (default_value_ != nullptr) {
     ret += " = " + ValueString(AidlConstantValueDecorator);
   }
@@ -270,7 +383,7 @@ string AidlVariableDeclaration::ToString() const {
 }
 
 string AidlVariableDeclaration::Signature() const {
-  return type_->Signature() + " " + name_;
+  return type_->Signature() + " " + *name_;
 }
 
 std::string AidlVariableDeclaration::ValueString(const ConstantValueDecorator& decorator) const {
@@ -531,7 +644,7 @@ string AidlConstantValue::ToString(Type type) {
 AidlConstantDeclaration::AidlConstantDeclaration(const AidlLocation& location,
                                                  AidlTypeSpecifier* type, const std::string& name,
                                                  AidlConstantValue* value)
-    : AidlMember(location), type_(type), name_(name), value_(value) {}
+    : AidlMember(location), type_(type), name_(&AidlArena::InternString(name)), value_(value) {}
 
 bool AidlConstantDeclaration::CheckValid(const AidlTypenames& typenames) const {
   bool valid = true;
@@ -549,29 +662,29 @@ bool AidlConstantDeclaration::CheckValid(const AidlTypenames& typenames) const {
 }
 
 string AidlConstantDeclaration::ToString() const {
-  return "const " + type_->ToString() + " " + name_ + " = " +
+  return "const " + type_->ToString() + " " + *name_ + " = " +
          ValueString(AidlConstantValueDecorator);
 }
 
 string AidlConstantDeclaration::Signature() const {
-  return type_->Signature() + " " + name_;
+  return type_->Signature() + " " + *name_;
 }
 
 AidlMethod::AidlMethod(const AidlLocation& location, bool oneway, AidlTypeSpecifier* type,
                        const std::string& name, std::vector<std::unique_ptr<AidlArgument>>* args,
-                       const std::string& comments)
+                       const AidlComments& comments)
     : AidlMethod(location, oneway, type, name, args, comments, 0, true) {
   has_id_ = false;
 }
 
 AidlMethod::AidlMethod(const AidlLocation& location, bool oneway, AidlTypeSpecifier* type,
                        const std::string& name, std::vector<std::unique_ptr<AidlArgument>>* args,
-                       const std::string& comments, int id, bool is_user_defined)
+                       const AidlComments& comments, int id, bool is_user_defined)
     : AidlMember(location),
       oneway_(oneway),
       comments_(comments),
       type_(type),
-      name_(name),
+      name_(&AidlArena::InternString(name)),
       arguments_(std::move(*args)),
       id_(id),
       is_user_defined_(is_user_defined) {
@@ -606,9 +719,12 @@ string AidlMethod::ToString() const {
 }
 
 AidlDefinedType::AidlDefinedType(const AidlLocation& location, const std::string& name,
-                                 const std::string& comments,
+                                 const AidlComments& comments,
                                  const std::vector<std::string>& package)
-    : AidlAnnotatable(location), name_(name), comments_(comments), package_(package) {}
+    : AidlAnnotatable(location),
+      name_(&AidlArena::InternString(name)),
+      comments_(comments),
+      package_(package) {}
 
 std::string AidlDefinedType::GetPackage() const {
   return Join(package_, '.');
@@ -622,8 +738,8 @@ std::string AidlDefinedType::GetCanonicalName() const {
 }
 
 AidlParcelable::AidlParcelable(const AidlLocation& location, AidlQualifiedName* name,
-                               const std::vector<std::string>& package, const std::string& comments,
-                               const std::string& cpp_header)
+                               const std::vector<std::string>& package,
+                               const AidlComments& comments, const std::string& cpp_header)
     : AidlDefinedType(location, name->GetDotName(), comments, package),
       name_(name),
       cpp_header_(cpp_header) {
@@ -657,7 +773,7 @@ void AidlParcelable::Write(CodeWriter* writer) const {
 
 AidlStructuredParcelable::AidlStructuredParcelable(
     const AidlLocation& location, AidlQualifiedName* name, const std::vector<std::string>& package,
-    const std::string& comments, std::vector<std::unique_ptr<AidlVariableDeclaration>>* variables)
+    const AidlComments& comments, std::vector<std::unique_ptr<AidlVariableDeclaration>>* variables)
     : AidlParcelable(location, name, package, comments, "" /*cpp_header*/),
       variables_(std::move(*variables)) {}
 
@@ -682,7 +798,7 @@ bool AidlStructuredParcelable::CheckValid(const AidlTypenames& typenames) const
 }
 
 AidlInterface::AidlInterface(const AidlLocation& location, const std::string& name,
-                             const std::string& comments, bool oneway,
+                             const AidlComments& comments, bool oneway,
                              std::vector<std::unique_ptr<AidlMember>>* members,
                              const std::vector<std::string>& package)
     : AidlDefinedType(location, name, comments, package) {
@@ -786,20 +902,42 @@ bool AidlInterface::CheckValid(const AidlTypenames& typenames) const {
 }
 
 AidlQualifiedName::AidlQualifiedName(const AidlLocation& location, const std::string& term,
-                                     const std::string& comments)
-    : AidlNode(location), terms_({term}), comments_(comments) {
+                                     const AidlComments& comments)
+    : AidlNode(location), comments_(comments) {
   if (term.find('.') != string::npos) {
-    terms_ = Split(term, ".");
-    for (const auto& subterm : terms_) {
+    for (const auto& subterm : Split(term, ".")) {
       if (subterm.empty()) {
         AIDL_FATAL(this) << "Malformed qualified identifier: '" << term << "'";
       }
+      AddTerm(subterm);
+    }
+  } else {
+    AddTerm(term);
+  }
+}
+
+vector<string> AidlQualifiedName::GetTerms() const {
+  vector<string> terms;
+  terms.reserve(terms_.size());
+  for (const string* term : terms_) {
+    terms.push_back(*term);
+  }
+  return terms;
+}
+
+string AidlQualifiedName::JoinTerms(const char* separator) const {
+  string joined;
+  for (size_t i = 0; i < terms_.size(); i++) {
+    if (i > 0) {
+      joined += separator;
     }
+    joined += *terms_[i];
   }
+  return joined;
 }
 
 void AidlQualifiedName::AddTerm(const std::string& term) {
-  terms_.push_back(term);
+  terms_.push_back(&AidlArena::InternString(term));
 }
 
 AidlImport::AidlImport(const AidlLocation& location, const std::string& needed_class)
@@ -809,19 +947,37 @@ std::unique_ptr<Parser> Parser::Parse(const std::string& filename,
                                       const android::aidl::IoDelegate& io_delegate,
                                       AidlTypenames& typenames) {
   // Make sure we can read the file first, before trashing previous state.
-  unique_ptr<string> raw_buffer = io_delegate.GetFileContents(filename);
-  if (raw_buffer == nullptr) {
-    AIDL_ERROR(filename) << "Error while opening file for parsing";
-    return nullptr;
+  // The buffer ends with the two nulls that yacc demands, so it is scanned
+  // in place.
+  unique_ptr<android::aidl::FileBuffer> raw_buffer;
+  {
+    TimeTrace::Scope trace("ReadFile", filename);
+    raw_buffer = io_delegate.GetFileBuffer(filename);
+    if (raw_buffer == nullptr) {
+      AIDL_ERROR(filename) << "Error while opening file for parsing";
+      return nullptr;
+    }
+    trace.Count("bytes", raw_buffer->size());
   }
+  return Parse(filename, std::move(raw_buffer), typenames);
+}
 
-  // We're going to scan this buffer in place, and yacc demands we put two
-  // nulls at the end.
-  raw_buffer->append(2u, '\0');
-
+std::unique_ptr<Parser> Parser::Parse(const std::string& filename,
+                                      unique_ptr<android::aidl::FileBuffer> raw_buffer,
+                                      AidlTypenames& typenames) {
+  // The nodes of the parse tree, and the tokens they are made from, are owned
+  // by |typenames| in the end. They are allocated from its arena, and the
+  // scanner of |parser| refers to the buffer, which |typenames| keeps as well.
+  TimeTrace::Scope trace("Parse", filename);
+  trace.Count("bytes", raw_buffer->size());
+  AidlArena::Scope arena_scope(typenames.GetArena());
   std::unique_ptr<Parser> parser(new Parser(filename, *raw_buffer, typenames));
+  typenames.AddParsedFile(std::move(raw_buffer));
 
-  if (yy::parser(parser.get()).parse() != 0 || parser->HasError()) return nullptr;
+  const bool failed = yy::parser(parser.get()).parse() != 0 || parser->HasError();
+  trace.Count("tokens", parser->tokens_);
+  trace.Count("types", parser->GetDefinedTypes().size());
+  if (failed) return nullptr;
 
   return parser;
 }
@@ -849,11 +1005,13 @@ bool Parser::Resolve() {
   return success;
 }
 
-Parser::Parser(const std::string& filename, std::string& raw_buffer,
+Parser::Parser(const std::string& filename, android::aidl::FileBuffer& raw_buffer,
                android::aidl::AidlTypenames& typenames)
-    : filename_(filename), typenames_(typenames) {
+    : filename_(&typenames.GetArena()->Intern(filename)), typenames_(typenames) {
+  static_assert(android::aidl::FileBuffer::kPadding == 2, "yacc needs two nulls at the end");
   yylex_init(&scanner_);
-  buffer_ = yy_scan_buffer(&raw_buffer[0], raw_buffer.length(), scanner_);
+  buffer_ = yy_scan_buffer(raw_buffer.data(), raw_buffer.size() + android::aidl::FileBuffer::kPadding,
+                           scanner_);
 }
 
 Parser::~Parser() {
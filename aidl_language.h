@@ -1,14 +1,17 @@
 #pragma once
 
+#include "aidl_arena.h"
 #include "aidl_typenames.h"
 #include "code_writer.h"
 #include "io_delegate.h"
 
 #include <cassert>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android-base/strings.h>
 
@@ -29,19 +32,47 @@ namespace aidl {
 namespace mappings {
 std::string dump_location(const AidlNode& method);
 }  // namespace mappings
+class ParseCache;
 }  // namespace aidl
 }  // namespace android
 
-class AidlToken {
+// The comments before a token or a node, e.g. the javadoc of a method.
+// Comments read from the parse cache refer to its entry, which is kept as long
+// as the parse tree (see AidlTypenames::AddParsedFile), and are only copied
+// into a string when a generator asks for them. Other comments, including
+// those found by the lexer, are interned in the arena of the current
+// AidlArena::Scope.
+class AidlComments final {
  public:
-  AidlToken(const std::string& text, const std::string& comments);
+  AidlComments() = default;
+  AidlComments(const std::string& comments);
+  AidlComments(const char* comments) : AidlComments(std::string(comments)) {}
 
-  const std::string& GetText() const { return text_; }
-  const std::string& GetComments() const { return comments_; }
+  // Comments that are the |size| bytes at |data| of a file kept by
+  // AidlTypenames::AddParsedFile.
+  static AidlComments InFile(const char* data, size_t size);
+
+  bool Empty() const { return size_ == 0; }
+  std::string ToString() const { return std::string(data_, size_); }
+
+ private:
+  const char* data_ = "";
+  size_t size_ = 0;
+};
+
+// The strings held by the nodes and tokens, like file names, identifiers and
+// type names, are interned in the arena of the current AidlArena::Scope. See
+// AidlArena::InternString.
+class AidlToken : public AidlArenaAllocated {
+ public:
+  AidlToken(const std::string& text, const AidlComments& comments);
+
+  const std::string& GetText() const { return *text_; }
+  const AidlComments& GetComments() const { return comments_; }
 
  private:
-  std::string text_;
-  std::string comments_;
+  const std::string* text_;
+  const AidlComments comments_;
 
   DISALLOW_COPY_AND_ASSIGN(AidlToken);
 };
@@ -54,12 +85,15 @@ class AidlLocation {
   };
 
   AidlLocation(const std::string& file, Point begin, Point end);
+  // Same as above, for a |file| that is already interned.
+  AidlLocation(const std::string* file, Point begin, Point end);
 
   friend std::ostream& operator<<(std::ostream& os, const AidlLocation& l);
   friend class AidlNode;
+  friend class android::aidl::ParseCache;
 
  private:
-  const std::string file_;
+  const std::string* file_;
   Point begin_;
   Point end_;
 };
@@ -71,8 +105,9 @@ class AidlLocation {
 
 std::ostream& operator<<(std::ostream& os, const AidlLocation& l);
 
-// Anything that is locatable in a .aidl file.
-class AidlNode {
+// Anything that is locatable in a .aidl file. The nodes created by a Parser
+// are allocated from the arena of its AidlTypenames.
+class AidlNode : public AidlArenaAllocated {
  public:
   AidlNode(const AidlLocation& location);
 
@@ -87,6 +122,8 @@ class AidlNode {
   // To be able to print AidlLocation (nothing else should use this information)
   friend class AidlError;
   friend std::string android::aidl::mappings::dump_location(const AidlNode&);
+  // To store the locations of cached parse trees (nothing else should use this either)
+  friend class android::aidl::ParseCache;
 
  private:
   std::string PrintLocation() const;
@@ -125,6 +162,70 @@ class AidlError {
 #define AIDL_FATAL_IF(CONDITION, CONTEXT) \
   if (CONDITION) AIDL_FATAL(CONTEXT) << "Bad internal state: " << #CONDITION << ": "
 
+// Stream that the errors found by the current thread are printed to. This is
+// std::cerr unless an AidlErrorCapture is active on the thread.
+std::ostream& AidlErrorStream();
+
+// Errors and log messages recorded by an AidlErrorCapture, in the order they
+// were reported.
+class AidlDiagnostics {
+ public:
+  AidlDiagnostics() = default;
+  AidlDiagnostics(AidlDiagnostics&&) = default;
+  AidlDiagnostics& operator=(AidlDiagnostics&&) = default;
+
+  bool Empty() const { return entries_.empty(); }
+
+  // Reports the recorded diagnostics again from the current thread, i.e. to
+  // the active AidlErrorCapture or, if there is none, to stderr.
+  void Report() const;
+
+  // Returns the recorded diagnostics as they would have been printed, with
+  // the log messages in a short format.
+  std::string ToString() const;
+
+ private:
+  struct Entry {
+    // False for the text written to AidlErrorStream().
+    bool is_log;
+    android::base::LogId id;
+    android::base::LogSeverity severity;
+    std::string tag;
+    std::string file;
+    unsigned int line;
+    std::string message;
+  };
+
+  std::vector<Entry> entries_;
+
+  friend class AidlErrorCapture;
+  DISALLOW_COPY_AND_ASSIGN(AidlDiagnostics);
+};
+
+// While alive, AIDL_ERROR and LOG() output of the thread that created it is
+// recorded into |diagnostics| instead of being printed. Captures can be
+// nested; the innermost one records. Fatal errors are never captured.
+class AidlErrorCapture {
+ public:
+  explicit AidlErrorCapture(AidlDiagnostics* diagnostics);
+  ~AidlErrorCapture();
+
+ private:
+  // Moves the text written to |stream_| so far into |diagnostics_|.
+  void Flush();
+  void Record(AidlDiagnostics::Entry entry);
+  static void Log(android::base::LogId id, android::base::LogSeverity severity, const char* tag,
+                  const char* file, unsigned int line, const char* message);
+
+  AidlDiagnostics* const diagnostics_;
+  AidlErrorCapture* const enclosing_;
+  std::ostringstream stream_;
+
+  friend std::ostream& AidlErrorStream();
+  friend class AidlDiagnostics;
+  DISALLOW_COPY_AND_ASSIGN(AidlErrorCapture);
+};
+
 namespace android {
 namespace aidl {
 
@@ -142,22 +243,23 @@ class AidlAnnotation : public AidlNode {
   AidlAnnotation(AidlAnnotation&&) = default;
   virtual ~AidlAnnotation() = default;
 
-  const string& GetName() const { return name_; }
-  string ToString() const { return "@" + name_; }
-  const string& GetComments() const { return comments_; }
-  void SetComments(const string& comments) { comments_ = comments; }
+  const string& GetName() const { return *name_; }
+  string ToString() const { return "@" + *name_; }
+  const AidlComments& GetComments() const { return comments_; }
+  void SetComments(const AidlComments& comments) { comments_ = comments; }
 
  private:
   AidlAnnotation(const AidlLocation& location, const string& name);
-  const string name_;
-  string comments_;
+  const string* name_;
+  AidlComments comments_;
 };
 
 static inline bool operator<(const AidlAnnotation& lhs, const AidlAnnotation& rhs) {
   return lhs.GetName() < rhs.GetName();
 }
 static inline bool operator==(const AidlAnnotation& lhs, const AidlAnnotation& rhs) {
-  return lhs.GetName() == rhs.GetName();
+  // The names are interned, usually in the same arena.
+  return &lhs.GetName() == &rhs.GetName() || lhs.GetName() == rhs.GetName();
 }
 
 class AidlAnnotatable : public AidlNode {
@@ -189,7 +291,8 @@ class AidlQualifiedName;
 class AidlTypeSpecifier final : public AidlAnnotatable {
  public:
   AidlTypeSpecifier(const AidlLocation& location, const string& unresolved_name, bool is_array,
-                    vector<unique_ptr<AidlTypeSpecifier>>* type_params, const string& comments);
+                    vector<unique_ptr<AidlTypeSpecifier>>* type_params,
+                    const AidlComments& comments);
   virtual ~AidlTypeSpecifier() = default;
 
   // Copy of this type which is not an array.
@@ -202,7 +305,7 @@ class AidlTypeSpecifier final : public AidlAnnotatable {
   // IFoo -> foo.bar.IFoo (if IFoo is in package foo.bar)
   const string& GetName() const {
     if (IsResolved()) {
-      return fully_qualified_name_;
+      return *fully_qualified_name_;
     } else {
       return GetUnresolvedName();
     }
@@ -214,13 +317,13 @@ class AidlTypeSpecifier final : public AidlAnnotatable {
 
   std::string Signature() const;
 
-  const string& GetUnresolvedName() const { return unresolved_name_; }
+  const string& GetUnresolvedName() const { return *unresolved_name_; }
 
-  const string& GetComments() const { return comments_; }
+  string GetComments() const { return comments_.ToString(); }
 
-  void SetComments(const string& comment) { comments_ = comment; }
+  void SetComments(const AidlComments& comments) { comments_ = comments; }
 
-  bool IsResolved() const { return fully_qualified_name_ != ""; }
+  bool IsResolved() const { return fully_qualified_name_ != nullptr; }
 
   bool IsArray() const { return is_array_; }
 
@@ -245,11 +348,12 @@ class AidlTypeSpecifier final : public AidlAnnotatable {
  private:
   AidlTypeSpecifier(const AidlTypeSpecifier&) = default;
 
-  const string unresolved_name_;
-  string fully_qualified_name_;
+  const string* const unresolved_name_;
+  // Interned in the arena of the AidlTypenames that resolved this type.
+  const string* fully_qualified_name_ = nullptr;
   bool is_array_;
   const shared_ptr<vector<unique_ptr<AidlTypeSpecifier>>> type_params_;
-  string comments_;
+  AidlComments comments_;
   const android::aidl::ValidatableType* language_type_ = nullptr;
 };
 
@@ -270,7 +374,7 @@ class AidlVariableDeclaration : public AidlNode {
                           const std::string& name, AidlConstantValue* default_value);
   virtual ~AidlVariableDeclaration() = default;
 
-  std::string GetName() const { return name_; }
+  std::string GetName() const { return *name_; }
   const AidlTypeSpecifier& GetType() const { return *type_; }
   const AidlConstantValue* GetDefaultValue() const { return default_value_.get(); }
 
@@ -284,7 +388,7 @@ class AidlVariableDeclaration : public AidlNode {
 
  private:
   std::unique_ptr<AidlTypeSpecifier> type_;
-  std::string name_;
+  const std::string* name_;
   std::unique_ptr<AidlConstantValue> default_value_;
 
   DISALLOW_COPY_AND_ASSIGN(AidlVariableDeclaration);
@@ -360,6 +464,8 @@ class AidlConstantValue : public AidlNode {
                     std::vector<std::unique_ptr<AidlConstantValue>>* values);
   static string ToString(Type type);
 
+  friend class android::aidl::ParseCache;
+
   const Type type_ = Type::ERROR;
   const std::vector<std::unique_ptr<AidlConstantValue>> values_;  // if type_ == ARRAY
   const std::string value_;                                       // otherwise
@@ -375,7 +481,7 @@ class AidlConstantDeclaration : public AidlMember {
 
   const AidlTypeSpecifier& GetType() const { return *type_; }
   AidlTypeSpecifier* GetMutableType() { return type_.get(); }
-  const std::string& GetName() const { return name_; }
+  const std::string& GetName() const { return *name_; }
   const AidlConstantValue& GetValue() const { return *value_; }
   bool CheckValid(const AidlTypenames& typenames) const;
 
@@ -389,7 +495,7 @@ class AidlConstantDeclaration : public AidlMember {
 
  private:
   const unique_ptr<AidlTypeSpecifier> type_;
-  const std::string name_;
+  const std::string* const name_;
   const unique_ptr<AidlConstantValue> value_;
 
   DISALLOW_COPY_AND_ASSIGN(AidlConstantDeclaration);
@@ -399,15 +505,15 @@ class AidlMethod : public AidlMember {
  public:
   AidlMethod(const AidlLocation& location, bool oneway, AidlTypeSpecifier* type,
              const std::string& name, std::vector<std::unique_ptr<AidlArgument>>* args,
-             const std::string& comments);
+             const AidlComments& comments);
   AidlMethod(const AidlLocation& location, bool oneway, AidlTypeSpecifier* type,
              const std::string& name, std::vector<std::unique_ptr<AidlArgument>>* args,
-             const std::string& comments, int id, bool is_user_defined = true);
+             const AidlComments& comments, int id, bool is_user_defined = true);
   virtual ~AidlMethod() = default;
 
   AidlMethod* AsMethod() override { return this; }
 
-  const std::string& GetComments() const { return comments_; }
+  std::string GetComments() const { return comments_.ToString(); }
   const AidlTypeSpecifier& GetType() const { return *type_; }
   AidlTypeSpecifier* GetMutableType() { return type_.get(); }
 
@@ -415,7 +521,7 @@ class AidlMethod : public AidlMember {
   void ApplyInterfaceOneway(bool oneway) { oneway_ = oneway_ || oneway; }
   bool IsOneway() const { return oneway_; }
 
-  const std::string& GetName() const { return name_; }
+  const std::string& GetName() const { return *name_; }
   bool HasId() const { return has_id_; }
   int GetId() const { return id_; }
   void SetId(unsigned id) { id_ = id; }
@@ -445,9 +551,9 @@ class AidlMethod : public AidlMember {
 
  private:
   bool oneway_;
-  std::string comments_;
+  AidlComments comments_;
   std::unique_ptr<AidlTypeSpecifier> type_;
-  std::string name_;
+  const std::string* name_;
   const std::vector<std::unique_ptr<AidlArgument>> arguments_;
   std::vector<const AidlArgument*> in_arguments_;
   std::vector<const AidlArgument*> out_arguments_;
@@ -466,19 +572,21 @@ class AidlStructuredParcelable;
 class AidlQualifiedName : public AidlNode {
  public:
   AidlQualifiedName(const AidlLocation& location, const std::string& term,
-                    const std::string& comments);
+                    const AidlComments& comments);
   virtual ~AidlQualifiedName() = default;
 
-  const std::vector<std::string>& GetTerms() const { return terms_; }
-  const std::string& GetComments() const { return comments_; }
-  std::string GetDotName() const { return android::base::Join(terms_, '.'); }
-  std::string GetColonName() const { return android::base::Join(terms_, "::"); }
+  std::vector<std::string> GetTerms() const;
+  const AidlComments& GetComments() const { return comments_; }
+  std::string GetDotName() const { return JoinTerms("."); }
+  std::string GetColonName() const { return JoinTerms("::"); }
 
   void AddTerm(const std::string& term);
 
  private:
-  std::vector<std::string> terms_;
-  std::string comments_;
+  std::string JoinTerms(const char* separator) const;
+
+  std::vector<const std::string*> terms_;
+  AidlComments comments_;
 
   DISALLOW_COPY_AND_ASSIGN(AidlQualifiedName);
 };
@@ -491,12 +599,12 @@ class AidlStructuredParcelable;
 class AidlDefinedType : public AidlAnnotatable {
  public:
   AidlDefinedType(const AidlLocation& location, const std::string& name,
-                  const std::string& comments, const std::vector<std::string>& package);
+                  const AidlComments& comments, const std::vector<std::string>& package);
   virtual ~AidlDefinedType() = default;
 
-  const std::string& GetName() const { return name_; };
-  const std::string& GetComments() const { return comments_; }
-  void SetComments(const std::string comments) { comments_ = comments; }
+  const std::string& GetName() const { return *name_; };
+  std::string GetComments() const { return comments_.ToString(); }
+  void SetComments(const AidlComments& comments) { comments_ = comments; }
 
   /* dot joined package, example: "android.package.foo" */
   std::string GetPackage() const;
@@ -543,8 +651,8 @@ class AidlDefinedType : public AidlAnnotatable {
   virtual void Write(CodeWriter* writer) const = 0;
 
  private:
-  std::string name_;
-  std::string comments_;
+  const std::string* name_;
+  AidlComments comments_;
   const android::aidl::ValidatableType* language_type_ = nullptr;
   const std::vector<std::string> package_;
 
@@ -554,7 +662,7 @@ class AidlDefinedType : public AidlAnnotatable {
 class AidlParcelable : public AidlDefinedType {
  public:
   AidlParcelable(const AidlLocation& location, AidlQualifiedName* name,
-                 const std::vector<std::string>& package, const std::string& comments,
+                 const std::vector<std::string>& package, const AidlComments& comments,
                  const std::string& cpp_header = "");
   virtual ~AidlParcelable() = default;
 
@@ -579,7 +687,7 @@ class AidlParcelable : public AidlDefinedType {
 class AidlStructuredParcelable : public AidlParcelable {
  public:
   AidlStructuredParcelable(const AidlLocation& location, AidlQualifiedName* name,
-                           const std::vector<std::string>& package, const std::string& comments,
+                           const std::vector<std::string>& package, const AidlComments& comments,
                            std::vector<std::unique_ptr<AidlVariableDeclaration>>* variables);
 
   const std::vector<std::unique_ptr<AidlVariableDeclaration>>& GetFields() const {
@@ -601,7 +709,7 @@ class AidlStructuredParcelable : public AidlParcelable {
 
 class AidlInterface final : public AidlDefinedType {
  public:
-  AidlInterface(const AidlLocation& location, const std::string& name, const std::string& comments,
+  AidlInterface(const AidlLocation& location, const std::string& name, const AidlComments& comments,
                 bool oneway_, std::vector<std::unique_ptr<AidlMember>>* members,
                 const std::vector<std::string>& package);
   virtual ~AidlInterface() = default;
@@ -650,12 +758,20 @@ class Parser {
   static std::unique_ptr<Parser> Parse(const std::string& filename,
                                        const android::aidl::IoDelegate& io_delegate,
                                        AidlTypenames& typenames);
+  // Same as above, for the |contents| of |filename| that were already read.
+  static std::unique_ptr<Parser> Parse(const std::string& filename,
+                                       std::unique_ptr<android::aidl::FileBuffer> contents,
+                                       AidlTypenames& typenames);
 
   void AddError() { error_++; }
   bool HasError() { return error_ != 0; }
 
-  const std::string& FileName() const { return filename_; }
+  // Interned in the arena of the AidlTypenames, like the file names of the
+  // locations of the nodes.
+  const std::string& FileName() const { return *filename_; }
   void* Scanner() const { return scanner_; }
+  // Called for every token that is read, see TimeTrace.
+  void CountToken() { tokens_++; }
 
   void AddImport(AidlImport* import);
   const std::vector<std::unique_ptr<AidlImport>>& GetImports() {
@@ -691,16 +807,17 @@ class Parser {
   vector<AidlDefinedType*>& GetDefinedTypes() { return defined_types_; }
 
  private:
-  explicit Parser(const std::string& filename, std::string& raw_buffer,
+  explicit Parser(const std::string& filename, android::aidl::FileBuffer& raw_buffer,
                   android::aidl::AidlTypenames& typenames);
 
-  std::string filename_;
+  const std::string* const filename_;
   std::unique_ptr<AidlQualifiedName> package_;
   AidlTypenames& typenames_;
 
   void* scanner_ = nullptr;
   YY_BUFFER_STATE buffer_;
   int error_ = 0;
+  size_t tokens_ = 0;
 
   std::vector<std::unique_ptr<AidlImport>> imports_;
   vector<AidlDefinedType*> defined_types_;
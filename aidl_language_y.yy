@@ -9,6 +9,12 @@
 
 int yylex(yy::parser::semantic_type *, yy::parser::location_type *, void *);
 
+// Reads the next token with the scanner of |ps|, counting it.
+static int yylex(yy::parser::semantic_type *lvalp, yy::parser::location_type *llocp, Parser *ps) {
+  ps->CountToken();
+  return yylex(lvalp, llocp, ps->Scanner());
+}
+
 AidlLocation loc(const yy::parser::location_type& l) {
   CHECK(l.begin.filename == l.end.filename);
   AidlLocation::Point begin {
@@ -19,11 +25,10 @@ AidlLocation loc(const yy::parser::location_type& l) {
     .line = l.end.line,
     .column = l.end.column,
   };
-  return AidlLocation(*l.begin.filename, begin, end);
+  // The file name is Parser::FileName(), which is interned already.
+  return AidlLocation(l.begin.filename, begin, end);
 }
 
-#define lex_scanner ps->Scanner()
-
 %}
 
 %initial-action {
@@ -32,7 +37,7 @@ AidlLocation loc(const yy::parser::location_type& l) {
 }
 
 %parse-param { Parser* ps }
-%lex-param { void *lex_scanner }
+%lex-param { Parser* ps }
 
 %glr-parser
 %skeleton "glr.cc"
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "aidl_server.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/macros.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+
+#include "aidl_language.h"
+#include "logging.h"
+#include "options.h"
+
+using android::base::StringPrintf;
+using android::base::unique_fd;
+using android::base::WriteFully;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace aidl {
+
+namespace {
+
+// Reads the NUL-terminated strings of a request or a response.
+class StringReader {
+ public:
+  explicit StringReader(int fd) : fd_(fd) {}
+
+  // Stores the next string to |*str|. Returns false at the end of the input,
+  // which is an error if it cuts a string, or on error.
+  bool Next(string* str) {
+    str->clear();
+    while (true) {
+      if (pos_ == size_) {
+        const ssize_t n = TEMP_FAILURE_RETRY(read(fd_, buffer_, sizeof(buffer_)));
+        if (n <= 0) {
+          failed_ = n < 0 || !str->empty();
+          return false;
+        }
+        pos_ = 0;
+        size_ = n;
+      }
+      const char* begin = buffer_ + pos_;
+      const char* end = static_cast<const char*>(memchr(begin, '\0', size_ - pos_));
+      if (end == nullptr) {
+        str->append(begin, size_ - pos_);
+        pos_ = size_;
+        continue;
+      }
+      str->append(begin, end);
+      pos_ = end - buffer_ + 1;
+      return true;
+    }
+  }
+
+  bool Failed() const { return failed_; }
+
+ private:
+  const int fd_;
+  char buffer_[4096];
+  size_t pos_ = 0;
+  size_t size_ = 0;
+  bool failed_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(StringReader);
+};
+
+void AppendString(const string& str, string* out) {
+  out->append(str);
+  out->push_back('\0');
+}
+
+// Returns a socket connected to |addr|, or an invalid one.
+unique_fd Connect(const sockaddr_un& addr) {
+  unique_fd fd(socket(AF_UNIX, SOCK_STREAM, 0));
+  if (fd.get() < 0 ||
+      TEMP_FAILURE_RETRY(connect(fd.get(), reinterpret_cast<const sockaddr*>(&addr),
+                                 sizeof(addr))) != 0) {
+    return unique_fd();
+  }
+  return fd;
+}
+
+// Stores the address of |socket_path| to |*addr|. Returns false if the path
+// is too long.
+bool GetSocketAddress(const string& socket_path, sockaddr_un* addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr->sun_path)) {
+    return false;
+  }
+  memcpy(addr->sun_path, socket_path.c_str(), socket_path.size() + 1);
+  return true;
+}
+
+}  // namespace
+
+AidlServer::AidlServer(const IoDelegate& io_delegate) : io_delegate_(io_delegate) {}
+
+AidlServer::~AidlServer() = default;
+
+int AidlServer::HandleRequest(const string& working_dir, const vector<string>& args,
+                              string* diagnostics) {
+  diagnostics->clear();
+  if (args.empty()) {
+    *diagnostics = "aidl: empty command line\n";
+    return 1;
+  }
+  if (chdir(working_dir.c_str()) != 0) {
+    *diagnostics = StringPrintf("aidl: can't change to directory %s: %s\n", working_dir.c_str(),
+                                strerror(errno));
+    return 1;
+  }
+
+  Options options = Options::From(args);
+  if (options.HelpRequested()) {
+    *diagnostics = options.GetUsage();
+    return 0;
+  }
+  if (!options.Ok()) {
+    *diagnostics = options.GetErrorMessage() + options.GetUsage();
+    return 1;
+  }
+  if (options.GetTask() == Options::Task::SERVE) {
+    *diagnostics = "aidl: --server can't be run by a server\n";
+    return 1;
+  }
+  if (options.WritesToStandardOutput()) {
+    *diagnostics = "aidl: a server can't write to the standard output of its client (\"-\")\n";
+    return 1;
+  }
+
+  unique_ptr<internals::ImportCache>& import_cache = import_caches_[working_dir];
+  if (import_cache == nullptr) {
+    import_cache.reset(new internals::ImportCache(io_delegate_));
+  } else {
+    import_cache->Revalidate();
+  }
+  AidlDiagnostics captured;
+  int status;
+  {
+    AidlErrorCapture capture(&captured);
+    status = run_task(options, io_delegate_, import_cache.get());
+  }
+  *diagnostics = captured.ToString();
+  return status;
+}
+
+bool AidlServer::Serve(int in_fd, int out_fd) {
+  StringReader reader(in_fd);
+  string working_dir;
+  while (reader.Next(&working_dir)) {
+    string count;
+    size_t num_args;
+    if (!reader.Next(&count)) {
+      LOG(ERROR) << "truncated request";
+      return false;
+    }
+    if (!android::base::ParseUint(count, &num_args)) {
+      LOG(ERROR) << "invalid number of arguments: " << count;
+      return false;
+    }
+    vector<string> args;
+    string arg;
+    for (size_t i = 0; i < num_args; i++) {
+      if (!reader.Next(&arg)) {
+        LOG(ERROR) << "truncated request";
+        return false;
+      }
+      args.push_back(std::move(arg));
+    }
+
+    string diagnostics;
+    const int status = HandleRequest(working_dir, args, &diagnostics);
+    string response;
+    AppendString(std::to_string(status), &response);
+    AppendString(diagnostics, &response);
+    if (!WriteFully(out_fd, response.data(), response.size())) {
+      PLOG(ERROR) << "can't write response";
+      return false;
+    }
+  }
+  if (reader.Failed()) {
+    PLOG(ERROR) << "can't read request";
+    return false;
+  }
+  return true;
+}
+
+bool AidlServer::ServeStdio() {
+  unique_fd out(dup(STDOUT_FILENO));
+  if (out.get() < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+    PLOG(ERROR) << "can't redirect the standard output";
+    return false;
+  }
+  return Serve(STDIN_FILENO, out.get());
+}
+
+void AidlServer::Listen(const string& socket_path) {
+  sockaddr_un addr;
+  if (!GetSocketAddress(socket_path, &addr)) {
+    LOG(ERROR) << socket_path << ": socket path is too long";
+    return;
+  }
+  if (Connect(addr).get() >= 0) {
+    LOG(ERROR) << socket_path << ": another server is listening";
+    return;
+  }
+  unlink(socket_path.c_str());
+  unique_fd fd(socket(AF_UNIX, SOCK_STREAM, 0));
+  if (fd.get() < 0 || bind(fd.get(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(fd.get(), SOMAXCONN) != 0) {
+    PLOG(ERROR) << socket_path << ": can't listen";
+    return;
+  }
+
+  // A client that goes away must not take the server down with it.
+  signal(SIGPIPE, SIG_IGN);
+  while (true) {
+    unique_fd client(TEMP_FAILURE_RETRY(accept(fd.get(), nullptr, nullptr)));
+    if (client.get() < 0) {
+      PLOG(ERROR) << socket_path << ": can't accept";
+      return;
+    }
+    Serve(client.get(), client.get());
+  }
+}
+
+bool AidlServer::SendRequest(const string& socket_path, const string& working_dir,
+                             const vector<string>& args, int* status, string* diagnostics) {
+  sockaddr_un addr;
+  if (!GetSocketAddress(socket_path, &addr)) {
+    return false;
+  }
+  unique_fd fd = Connect(addr);
+  if (fd.get() < 0) {
+    return false;
+  }
+  string request;
+  AppendString(working_dir, &request);
+  AppendString(std::to_string(args.size()), &request);
+  for (const string& arg : args) {
+    AppendString(arg, &request);
+  }
+  if (!WriteFully(fd.get(), request.data(), request.size())) {
+    return false;
+  }
+  StringReader reader(fd.get());
+  string status_str;
+  return reader.Next(&status_str) && reader.Next(diagnostics) &&
+         android::base::ParseInt(status_str, status);
+}
+
+}  // namespace aidl
+}  // namespace android
+
+#endif  // _WIN32
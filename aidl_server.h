@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "aidl.h"
+#include "io_delegate.h"
+
+namespace android {
+namespace aidl {
+
+// Runs aidl command lines in a single long-lived process, so that the imports
+// and preprocessed files they share are parsed only once. A parsed file is
+// used again as long as its modification time and size don't change.
+//
+// A request is a sequence of NUL-terminated strings: the working directory of
+// the command line, the number of its arguments in decimal, and the arguments
+// starting with argv[0]. The response is the exit status of the command line,
+// in decimal, followed by what it would have printed to stderr, both
+// NUL-terminated.
+//
+// The requests are run one at a time, in the order they are received. The
+// output files are written by the server itself, so a request that writes to
+// the standard output ("-") is rejected: aidl-client runs it by itself instead.
+//
+// All the requests share the process, so a CHECK that fails while one of them
+// is run aborts the server, and with it the requests of every client that are
+// still queued. Clients that have no response then run their command line by
+// themselves, see SendRequest().
+class AidlServer final {
+ public:
+  explicit AidlServer(const IoDelegate& io_delegate);
+  ~AidlServer();
+
+  // Runs the command line |args| in |working_dir|. Returns its exit status,
+  // and stores what it would have printed to stderr to |*diagnostics|.
+  int HandleRequest(const std::string& working_dir, const std::vector<std::string>& args,
+                    std::string* diagnostics);
+
+  // Runs the requests read from |in_fd| and writes the responses to |out_fd|,
+  // until the input ends. Returns false on error or if a request is truncated.
+  bool Serve(int in_fd, int out_fd);
+
+  // Serve() on the standard input and output. Anything else written to the
+  // standard output goes to the standard error instead.
+  bool ServeStdio();
+
+  // Serves the clients of the Unix socket |socket_path| one after the other.
+  // A socket left behind by a server that is gone is replaced. Returns only if
+  // the socket can't be set up, after logging why.
+  void Listen(const std::string& socket_path);
+
+  // Has |args| run in |working_dir| by the server listening on |socket_path|,
+  // and stores the response to |*status| and |*diagnostics|. Returns false if
+  // there is no such server or it fails before responding, in which case the
+  // caller has to run the command line itself.
+  static bool SendRequest(const std::string& socket_path, const std::string& working_dir,
+                          const std::vector<std::string>& args, int* status,
+                          std::string* diagnostics);
+
+ private:
+  const IoDelegate& io_delegate_;
+  // Relative paths depend on the working directory, so each one has its own
+  // cache.
+  std::map<std::string, std::unique_ptr<internals::ImportCache>> import_caches_;
+
+  DISALLOW_COPY_AND_ASSIGN(AidlServer);
+};
+
+}  // namespace aidl
+}  // namespace android
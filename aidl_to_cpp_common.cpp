@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <unordered_map>
 
 #include "aidl_to_cpp_common.h"
+#include "call_profile.h"
+#include "flight_recorder.h"
 #include "logging.h"
 #include "os.h"
 
@@ -86,6 +89,60 @@ string BuildVarName(const AidlArgument& a) {
   return prefix + a.GetName();
 }
 
+std::set<const AidlMethod*> TableTransactions(const AidlInterface& interface,
+                                              const Options& options) {
+  const CallProfile* profile = options.GetCallProfile();
+  const bool profiled = profile != nullptr && profile->Covers(interface);
+  if (!options.GenTransactionTable() && !profiled) {
+    return {};
+  }
+
+  std::vector<const AidlMethod*> methods;
+  for (const AidlMethod* method : MethodsByCalls(interface, profile)) {
+    if (method->IsUserDefined()) {
+      methods.push_back(method);
+    }
+  }
+  std::set<const AidlMethod*> candidates;
+  if (options.GenTransactionTable()) {
+    if (!profiled) {
+      std::stable_sort(methods.begin(), methods.end(),
+                       [](const AidlMethod* m1, const AidlMethod* m2) {
+                         return m1->GetArguments().size() < m2->GetArguments().size();
+                       });
+    }
+    const size_t inline_count = std::min(options.TransactionTableInlineCount(), methods.size());
+    candidates.insert(methods.begin() + inline_count, methods.end());
+  } else {
+    candidates = profile->ColdMethods(interface);
+  }
+
+  std::set<const AidlMethod*> table_methods;
+  const int max_id = 2 * methods.size();
+  for (const AidlMethod* method : candidates) {
+    if (method->GetId() <= max_id) {
+      table_methods.insert(method);
+    }
+  }
+  return table_methods;
+}
+
+string TransactionHandlerName(const AidlMethod& method) {
+  return "_aidl_handle_" + method.GetName();
+}
+
+std::vector<string> TransactionTableEntries(const std::set<const AidlMethod*>& methods) {
+  std::vector<string> entries;
+  for (const AidlMethod* method : methods) {
+    const size_t id = method->GetId();
+    if (entries.size() <= id) {
+      entries.resize(id + 1, "nullptr");
+    }
+    entries[id] = TransactionHandlerName(*method);
+  }
+  return entries;
+}
+
 struct TypeInfo {
   // name of the type in C++ output
   std::string cpp_name;
@@ -224,36 +281,175 @@ void WriteLogForArguments(CodeWriterPtr& writer, const AidlArgument& a, bool isS
   (*writer).Dedent();
 }
 
+string GenLogDeclarations(const Options& options, bool isNdk) {
+  if (options.GetLogFormat() == Options::LogFormat::JSON) {
+    return "static std::function<void(const Json::Value&)> logFunc;\n";
+  }
+  string code;
+  CodeWriterPtr writer = CodeWriter::ForString(&code);
+  (*writer) << "// What logFunc gets for each transaction. The pointers are only valid\n"
+            << "// during the call.\n"
+            << "struct TransactionLog {\n";
+  (*writer).Indent();
+  (*writer) << "// An argument, or the return value. |value| points at its C++ value,\n"
+            << "// which has the type of |type| in this backend.\n"
+            << "struct Value {\n"
+            << "  const char* name;\n"
+            << "  // The AIDL type, e.g. \"int\" or \"String[]\".\n"
+            << "  const char* type;\n"
+            << "  const void* value;\n"
+            << "};\n"
+            << "double duration_ms;\n"
+            << "const char* interface_name;\n"
+            << "const char* method_name;\n"
+            << "// The proxy or the stub.\n"
+            << "const void* address;\n"
+            << "// The inout arguments have their value after the call in both lists.\n"
+            << "const Value* input_args;\n"
+            << "size_t input_arg_count;\n"
+            << "const Value* output_args;\n"
+            << "size_t output_arg_count;\n"
+            << "// nullptr if the method returns nothing.\n"
+            << "const Value* return_value;\n"
+            << (isNdk ? "const AStatus* status;\n" : "const ::android::binder::Status* status;\n");
+  (*writer).Dedent();
+  (*writer) << "};\n"
+            << "static std::function<void(const TransactionLog&)> logFunc;\n";
+  writer->Close();
+  return code;
+}
+
+string GenLogFuncDefinition(const string& className, const Options& options) {
+  const string argument = options.GetLogFormat() == Options::LogFormat::JSON
+                              ? "const Json::Value&"
+                              : "const " + className + "::TransactionLog&";
+  return "std::function<void(" + argument + ")> " + className + "::logFunc;\n";
+}
+
 const string GenLogBeforeExecute(const string className, const AidlMethod& method, bool isServer,
-                                 bool isNdk) {
+                                 bool isNdk, const Options& options) {
   string code;
   CodeWriterPtr writer = CodeWriter::ForString(&code);
-  (*writer) << "Json::Value _log_input_args(Json::arrayValue);\n";
+  // Nothing is done but this check while no logFunc is installed. Installing
+  // one during the transaction doesn't make it log half of it.
+  (*writer) << "const bool _log_enabled = " << className << "::logFunc != nullptr;\n";
+  const bool json = options.GetLogFormat() == Options::LogFormat::JSON;
+  if (json) {
+    (*writer) << "std::optional<Json::Value> _log_input_args;\n";
+  }
+  (*writer) << "std::chrono::steady_clock::time_point _log_start;\n";
 
-  (*writer) << "if (" << className << "::logFunc != nullptr) {\n";
+  (*writer) << "if (_log_enabled) {\n";
   (*writer).Indent();
 
-  for (const auto& a : method.GetArguments()) {
-    if (a->IsIn()) {
-      WriteLogForArguments(writer, *a, isServer, "_log_input_args", isNdk);
+  // The typed log points at the arguments after the transaction instead.
+  if (json) {
+    (*writer) << "_log_input_args.emplace(Json::arrayValue);\n";
+    for (const auto& a : method.GetArguments()) {
+      if (a->IsIn()) {
+        WriteLogForArguments(writer, *a, isServer, "(*_log_input_args)", isNdk);
+      }
     }
   }
+  (*writer) << "_log_start = std::chrono::steady_clock::now();\n";
 
   (*writer).Dedent();
   (*writer) << "}\n";
+  writer->Close();
+  return code;
+}
+
+namespace {
 
-  (*writer) << "auto _log_start = std::chrono::steady_clock::now();\n";
+// Declares |var_name|, the TransactionLog::Value array of |arguments|, and
+// returns the expression that TransactionLog points at them with.
+string WriteTypedLogValues(CodeWriter& writer, const string& className,
+                           const std::vector<const AidlArgument*>& arguments, bool isServer,
+                           bool isNdk, const string& var_name) {
+  if (arguments.empty()) {
+    return "nullptr";
+  }
+  writer << "const " << className << "::TransactionLog::Value " << var_name << "[] = {\n";
+  writer.Indent();
+  for (const AidlArgument* a : arguments) {
+    const string name = isServer || isNdk ? BuildVarName(*a) : a->GetName();
+    // The proxy gets the out arguments through pointers.
+    const bool isPointer = a->IsOut() && !isServer;
+    writer << "{\"" << name << "\", \"" << a->GetType().ToString() << "\", "
+           << (isPointer ? "" : "&") << name << "},\n";
+  }
+  writer.Dedent();
+  writer << "};\n";
+  return var_name;
+}
+
+string GenTypedLogAfterExecute(const string& className, const AidlInterface& interface,
+                               const AidlMethod& method, const string& statusVarName,
+                               const string& returnVarName, bool isServer, bool isNdk,
+                               const string& address) {
+  string code;
+  CodeWriterPtr writer = CodeWriter::ForString(&code);
+  (*writer) << "if (_log_enabled) {\n";
+  (*writer).Indent();
+  std::vector<const AidlArgument*> input_args;
+  for (const auto& a : method.GetArguments()) {
+    if (a->IsIn()) {
+      input_args.push_back(a.get());
+    }
+  }
+  const string input_values =
+      WriteTypedLogValues(*writer, className, input_args, isServer, isNdk, "_log_input_args");
+  const string output_values = WriteTypedLogValues(*writer, className, method.GetOutArguments(),
+                                                   isServer, isNdk, "_log_output_args");
+  string return_value = "nullptr";
+  if (method.GetType().GetName() != "void") {
+    (*writer) << "const " << className << "::TransactionLog::Value _log_return_value = {\""
+              << returnVarName << "\", \"" << method.GetType().ToString() << "\", "
+              << (isServer ? "&" : "") << returnVarName << "};\n";
+    return_value = "&_log_return_value";
+  }
+  (*writer) << className << "::TransactionLog _log_transaction;\n";
+  (*writer) << "_log_transaction.duration_ms = std::chrono::duration<double, std::milli>("
+               "std::chrono::steady_clock::now() - _log_start).count();\n";
+  (*writer) << "_log_transaction.interface_name = \"" << interface.GetCanonicalName() << "\";\n";
+  (*writer) << "_log_transaction.method_name = \"" << method.GetName() << "\";\n";
+  (*writer) << "_log_transaction.address = " << address << ";\n";
+  (*writer) << "_log_transaction.input_args = " << input_values << ";\n";
+  (*writer) << "_log_transaction.input_arg_count = " << std::to_string(input_args.size())
+            << ";\n";
+  (*writer) << "_log_transaction.output_args = " << output_values << ";\n";
+  (*writer) << "_log_transaction.output_arg_count = "
+            << std::to_string(method.GetOutArguments().size()) << ";\n";
+  (*writer) << "_log_transaction.return_value = " << return_value << ";\n";
+  (*writer) << "_log_transaction.status = "
+            << (isNdk ? statusVarName + ".get()" : "&" + statusVarName) << ";\n";
+  (*writer) << className << "::logFunc(_log_transaction);\n";
+  (*writer).Dedent();
+  (*writer) << "}\n";
   writer->Close();
   return code;
 }
 
+}  // namespace
+
 const string GenLogAfterExecute(const string className, const AidlInterface& interface,
                                 const AidlMethod& method, const string& statusVarName,
-                                const string& returnVarName, bool isServer, bool isNdk) {
+                                const string& returnVarName, bool isServer, bool isNdk,
+                                const Options& options, bool inTable) {
+  // The stub is _aidl_impl in the handlers of the transaction table, and in
+  // the NDK, whose switch isn't in a member function either.
+  const bool impl = isServer && (isNdk || inTable);
+  if (options.GetLogFormat() == Options::LogFormat::TYPED) {
+    return GenTypedLogAfterExecute(className, interface, method, statusVarName, returnVarName,
+                                   isServer, isNdk,
+                                   impl ? (isNdk ? "_aidl_impl.get()" : "_aidl_impl")
+                                        : "static_cast<const void*>(this)");
+  }
+
   string code;
   CodeWriterPtr writer = CodeWriter::ForString(&code);
 
-  (*writer) << "if (" << className << "::logFunc != nullptr) {\n";
+  (*writer) << "if (_log_enabled) {\n";
   (*writer).Indent();
 
   // Write the log as a Json object. For example,
@@ -301,9 +497,9 @@ const string GenLogAfterExecute(const string className, const AidlInterface& int
   (*writer) << "_log_transaction[\"" << (isServer ? "stub_address" : "proxy_address") << "\"] = ";
   (*writer) << "Json::Value("
             << "(std::ostringstream() << "
-            << (isNdk && isServer ? "_aidl_impl" : "static_cast<const void*>(this)") << ").str()"
+            << (impl ? "_aidl_impl" : "static_cast<const void*>(this)") << ").str()"
             << ");\n";
-  (*writer) << "_log_transaction[\"input_args\"] = _log_input_args;\n";
+  (*writer) << "_log_transaction[\"input_args\"] = std::move(*_log_input_args);\n";
   (*writer) << "Json::Value _log_output_args(Json::arrayValue);\n";
 
   (*writer) << "Json::Value _log_status(Json::objectValue);\n";
@@ -352,6 +548,355 @@ const string GenLogAfterExecute(const string className, const AidlInterface& int
   return code;
 }
 
+namespace {
+
+// The user-defined methods of |interface|, whose transactions are counted by
+// --transaction_stats.
+std::vector<const AidlMethod*> StatsMethods(const AidlInterface& interface) {
+  std::vector<const AidlMethod*> methods;
+  for (const auto& method : interface.GetMethods()) {
+    if (method->IsUserDefined()) {
+      methods.push_back(method.get());
+    }
+  }
+  return methods;
+}
+
+}  // namespace
+
+string GenTransactionStatsDeclarations() {
+  return "// Statistics of the transactions of each method, see --transaction_stats.\n"
+         "struct TransactionStats {\n"
+         "  // Bucket 0 counts the zeros, bucket i the values in [2^(i-1), 2^i), and the\n"
+         "  // last bucket also the values beyond.\n"
+         "  static constexpr size_t kBuckets = 32;\n"
+         "  struct Histogram {\n"
+         "    uint64_t counts[kBuckets];\n"
+         "    uint64_t sum;\n"
+         "    // The upper bound of the bucket of the |percent|th percentile, e.g. 99.\n"
+         "    uint64_t percentile(double percent) const {\n"
+         "      uint64_t total = 0;\n"
+         "      for (uint64_t count : counts) {\n"
+         "        total += count;\n"
+         "      }\n"
+         "      uint64_t below = 0;\n"
+         "      for (size_t i = 0; i < kBuckets; i++) {\n"
+         "        below += counts[i];\n"
+         "        if (below > 0 && below * 100.0 >= total * percent) {\n"
+         "          return i + 1 < kBuckets ? (uint64_t(1) << i) - 1 : UINT64_MAX;\n"
+         "        }\n"
+         "      }\n"
+         "      return 0;\n"
+         "    }\n"
+         "  };\n"
+         "  struct Method {\n"
+         "    const char* name;\n"
+         "    uint64_t calls;\n"
+         "    // The transactions that failed, e.g. because a parcel was too large.\n"
+         "    uint64_t errors;\n"
+         "    // The transactions whose status has an exception.\n"
+         "    uint64_t exceptions;\n"
+         "    // How long the transactions take, in microseconds: the round trip in the\n"
+         "    // proxy, and the handling of the transaction in the stub.\n"
+         "    Histogram time_us;\n"
+         "    Histogram data_bytes;\n"
+         "    Histogram reply_bytes;\n"
+         "  };\n"
+         "  // The user-defined methods, in the order of their declaration.\n"
+         "  std::vector<Method> methods;\n"
+         "};\n";
+}
+
+string GenTransactionStatsAccessorDeclaration() {
+  return "// The statistics of the transactions so far, see --transaction_stats.\n"
+         "static TransactionStats getTransactionStats();\n";
+}
+
+string GenTransactionStatsDefinitions(const AidlInterface& interface, bool isNdk) {
+  const string i_name = ClassName(interface, ClassNames::INTERFACE);
+  const std::vector<const AidlMethod*> methods = StatsMethods(interface);
+  // There is at least one counter, as arrays can't be empty.
+  const string count = std::to_string(std::max<size_t>(methods.size(), 1));
+  string code;
+  CodeWriterPtr writer = CodeWriter::ForString(&code);
+  CodeWriter& out = *writer;
+
+  out << "namespace {\n\n";
+  out << "// The counters of the transactions of a method, which are updated without\n"
+      << "// locking.\n";
+  out << "struct _aidl_histogram {\n";
+  out << "  std::atomic<uint64_t> counts[" << i_name << "::TransactionStats::kBuckets];\n";
+  out << "  std::atomic<uint64_t> sum;\n";
+  out << "};\n";
+  out << "struct _aidl_method_stats {\n";
+  out << "  std::atomic<uint64_t> calls;\n";
+  out << "  std::atomic<uint64_t> errors;\n";
+  out << "  std::atomic<uint64_t> exceptions;\n";
+  out << "  _aidl_histogram time_us;\n";
+  out << "  _aidl_histogram data_bytes;\n";
+  out << "  _aidl_histogram reply_bytes;\n";
+  out << "};\n";
+  out << "// By the index of the method in " << i_name << "::TransactionStats.\n";
+  out << "_aidl_method_stats _aidl_client_stats[" << count << "];\n";
+  out << "_aidl_method_stats _aidl_server_stats[" << count << "];\n\n";
+
+  out << "uint64_t _aidl_stats_now() {\n";
+  out << "  return std::chrono::duration_cast<std::chrono::nanoseconds>(\n"
+      << "      std::chrono::steady_clock::now().time_since_epoch()).count();\n";
+  out << "}\n\n";
+
+  out << "void _aidl_stats_add(_aidl_histogram* histogram, uint64_t value) {\n";
+  out.Indent();
+  out << "const size_t bucket =\n"
+      << "    value == 0 ? 0\n"
+      << "               : std::min<size_t>(64 - __builtin_clzll(value),\n"
+      << "                                  " << i_name
+      << "::TransactionStats::kBuckets - 1);\n";
+  out << "histogram->counts[bucket].fetch_add(1, std::memory_order_relaxed);\n";
+  out << "histogram->sum.fetch_add(value, std::memory_order_relaxed);\n";
+  out.Dedent();
+  out << "}\n\n";
+
+  out << "void _aidl_stats_record(_aidl_method_stats* stats, uint64_t time_ns, size_t data_size,\n"
+      << "                        size_t reply_size, bool failed) {\n";
+  out.Indent();
+  out << "stats->calls.fetch_add(1, std::memory_order_relaxed);\n";
+  out << "if (failed) {\n";
+  out << "  stats->errors.fetch_add(1, std::memory_order_relaxed);\n";
+  out << "}\n";
+  out << "_aidl_stats_add(&stats->time_us, time_ns / 1000);\n";
+  out << "_aidl_stats_add(&stats->data_bytes, data_size);\n";
+  out << "_aidl_stats_add(&stats->reply_bytes, reply_size);\n";
+  out.Dedent();
+  out << "}\n\n";
+
+  // The stub finds the counters of a transaction by its code.
+  out << "void _aidl_stats_record_server(uint32_t code, uint64_t time_ns, size_t data_size,\n"
+      << "                               size_t reply_size, bool failed) {\n";
+  out.Indent();
+  out << "size_t index;\n";
+  out << "switch (code) {\n";
+  const string first_call =
+      isNdk ? "FIRST_CALL_TRANSACTION" : "::android::IBinder::FIRST_CALL_TRANSACTION";
+  for (size_t i = 0; i < methods.size(); i++) {
+    out << "  case " << first_call << " + " << std::to_string(methods[i]->GetId()) << ": index = "
+        << std::to_string(i) << "; break;\n";
+  }
+  out << "  default: return;\n";
+  out << "}\n";
+  out << "_aidl_stats_record(&_aidl_server_stats[index], time_ns, data_size, reply_size, "
+         "failed);\n";
+  out.Dedent();
+  out << "}\n\n";
+
+  out << "void _aidl_stats_copy(const _aidl_histogram& histogram,\n"
+      << "                      " << i_name << "::TransactionStats::Histogram* snapshot) {\n";
+  out.Indent();
+  out << "for (size_t i = 0; i < " << i_name << "::TransactionStats::kBuckets; i++) {\n";
+  out << "  snapshot->counts[i] = histogram.counts[i].load(std::memory_order_relaxed);\n";
+  out << "}\n";
+  out << "snapshot->sum = histogram.sum.load(std::memory_order_relaxed);\n";
+  out.Dedent();
+  out << "}\n\n";
+
+  out << i_name << "::TransactionStats _aidl_stats_snapshot(const _aidl_method_stats* stats) {\n";
+  out.Indent();
+  out << "static const char* const names[] = {";
+  for (const AidlMethod* method : methods) {
+    out << "\"" << method->GetName() << "\", ";
+  }
+  out << "nullptr};\n";
+  out << i_name << "::TransactionStats snapshot;\n";
+  out << "snapshot.methods.resize(" << std::to_string(methods.size()) << ");\n";
+  out << "for (size_t i = 0; i < snapshot.methods.size(); i++) {\n";
+  out.Indent();
+  out << i_name << "::TransactionStats::Method& method = snapshot.methods[i];\n";
+  out << "method.name = names[i];\n";
+  out << "method.calls = stats[i].calls.load(std::memory_order_relaxed);\n";
+  out << "method.errors = stats[i].errors.load(std::memory_order_relaxed);\n";
+  out << "method.exceptions = stats[i].exceptions.load(std::memory_order_relaxed);\n";
+  out << "_aidl_stats_copy(stats[i].time_us, &method.time_us);\n";
+  out << "_aidl_stats_copy(stats[i].data_bytes, &method.data_bytes);\n";
+  out << "_aidl_stats_copy(stats[i].reply_bytes, &method.reply_bytes);\n";
+  out.Dedent();
+  out << "}\n";
+  out << "return snapshot;\n";
+  out.Dedent();
+  out << "}\n\n";
+  out << "}  // namespace\n\n";
+  writer->Close();
+  return code;
+}
+
+string GenTransactionStatsAccessorDefinition(const AidlInterface& interface,
+                                             const string& className, bool isServer) {
+  return ClassName(interface, ClassNames::INTERFACE) + "::TransactionStats " + className +
+         "::getTransactionStats() {\n"
+         "  return _aidl_stats_snapshot(" +
+         (isServer ? "_aidl_server_stats" : "_aidl_client_stats") + ");\n}\n";
+}
+
+string TransactionStatsOf(const AidlInterface& interface, const AidlMethod& method,
+                          bool isServer) {
+  const std::vector<const AidlMethod*> methods = StatsMethods(interface);
+  const size_t index = std::find(methods.begin(), methods.end(), &method) - methods.begin();
+  return string(isServer ? "_aidl_server_stats" : "_aidl_client_stats") + "[" +
+         std::to_string(index) + "]";
+}
+
+string GenTransactionStatsException(const AidlInterface& interface, const AidlMethod& method,
+                                    const string& statusVarName, bool isServer, bool isNdk) {
+  const string has_exception = isNdk ? "!AStatus_isOk(" + statusVarName + ".get())"
+                                     : "!" + statusVarName + ".isOk()";
+  return "if (" + has_exception + ") {\n  " + TransactionStatsOf(interface, method, isServer) +
+         ".exceptions.fetch_add(1, std::memory_order_relaxed);\n}\n";
+}
+
+string GenFlightRecorderDeclaration() {
+  return "// Writes the records of the last transactions to |fd|, see --flight_recorder.\n"
+         "static bool dumpFlightRecorder(int fd);\n";
+}
+
+string GenFlightRecorderDefinitions(const AidlInterface& interface, const string& className,
+                                    const Options& options, bool isNdk) {
+  const string size = std::to_string(options.FlightRecorderSize());
+  const size_t arg_bytes = options.FlightRecorderArgBytes();
+  const string words = std::to_string(FlightRecordWords(arg_bytes));
+  string code;
+  CodeWriterPtr writer = CodeWriter::ForString(&code);
+  CodeWriter& out = *writer;
+
+  out << "namespace {\n\n";
+  out << "// The records of the last " << size << " transactions. _aidl_flight_next counts\n"
+      << "// them, and the one whose index is i is in _aidl_flight_records[i % " << size << "].\n"
+      << "// Its sequence is 2 * i + 1 while it is written, and 2 * i + 2 once it is, so\n"
+      << "// that dumpFlightRecorder skips the records that are being written without\n"
+      << "// locking. A record can only be torn if the ring wraps around while it is\n"
+      << "// written.\n";
+  out << "struct _aidl_flight_entry {\n";
+  out << "  std::atomic<uint64_t> sequence;\n";
+  out << "  std::atomic<uint64_t> words[" << words << "];\n";
+  out << "};\n";
+  out << "_aidl_flight_entry _aidl_flight_records[" << size << "];\n";
+  out << "std::atomic<uint64_t> _aidl_flight_next;\n\n";
+
+  out << "uint64_t _aidl_flight_now() {\n";
+  out << "  return std::chrono::duration_cast<std::chrono::nanoseconds>(\n"
+      << "      std::chrono::steady_clock::now().time_since_epoch()).count();\n";
+  out << "}\n\n";
+
+  out << "void _aidl_flight_record(uint32_t code, int32_t status, uint64_t start_ns, "
+      << "size_t data_size,\n"
+      << "                         size_t reply_size"
+      << (arg_bytes > 0 ? ", const uint8_t* args, size_t args_size" : "") << ") {\n";
+  out.Indent();
+  out << "uint64_t words[" << words << "] = {\n";
+  out << "    code | uint64_t(uint32_t(status)) << 32,\n";
+  out << "    start_ns,\n";
+  out << "    _aidl_flight_now() - start_ns,\n";
+  out << "    uint32_t(data_size) | uint64_t(uint32_t(reply_size)) << 32,\n";
+  out << "};\n";
+  if (arg_bytes > 0) {
+    out << "words[4] = std::min<size_t>(args_size, " << std::to_string(arg_bytes) << ");\n";
+    out << "memcpy(&words[5], args, words[4]);\n";
+  }
+  out << "const uint64_t index = _aidl_flight_next.fetch_add(1, std::memory_order_relaxed);\n";
+  out << "_aidl_flight_entry& record = _aidl_flight_records[index % " << size << "];\n";
+  out << "record.sequence.store(2 * index + 1, std::memory_order_relaxed);\n";
+  out << "std::atomic_thread_fence(std::memory_order_release);\n";
+  out << "for (size_t i = 0; i < " << words << "; i++) {\n";
+  out << "  record.words[i].store(words[i], std::memory_order_relaxed);\n";
+  out << "}\n";
+  out << "record.sequence.store(2 * index + 2, std::memory_order_release);\n";
+  out.Dedent();
+  out << "}\n\n";
+
+  out << "void _aidl_flight_put(std::string* dump, uint64_t value, size_t size) {\n";
+  out << "  for (size_t i = 0; i < size; i++) {\n";
+  out << "    dump->push_back(static_cast<char>(value >> (8 * i)));\n";
+  out << "  }\n";
+  out << "}\n\n";
+  out << "void _aidl_flight_put_string(std::string* dump, const char* value) {\n";
+  out << "  _aidl_flight_put(dump, strlen(value), 4);\n";
+  out << "  dump->append(value);\n";
+  out << "}\n\n";
+  out << "}  // namespace\n\n";
+
+  out << "bool " << className << "::dumpFlightRecorder(int fd) {\n";
+  out.Indent();
+  out << "static const struct {\n";
+  out << "  uint32_t code;\n";
+  out << "  const char* name;\n";
+  out << "} _aidl_methods[] = {\n";
+  out.Indent();
+  const string first_call =
+      isNdk ? "FIRST_CALL_TRANSACTION" : "::android::IBinder::FIRST_CALL_TRANSACTION";
+  for (const auto& method : interface.GetMethods()) {
+    out << "{" << first_call << " + " << std::to_string(method->GetId()) << ", \""
+        << method->GetName() << "\"},\n";
+  }
+  out.Dedent();
+  out << "};\n";
+  out << "std::string _aidl_dump(\"" << kFlightRecorderMagic << "\");\n";
+  out << "_aidl_flight_put(&_aidl_dump, " << std::to_string(arg_bytes) << ", 4);\n";
+  out << "_aidl_flight_put_string(&_aidl_dump, \"" << interface.GetCanonicalName() << "\");\n";
+  out << "_aidl_flight_put(&_aidl_dump, " << std::to_string(interface.GetMethods().size())
+      << ", 4);\n";
+  out << "for (const auto& _aidl_method : _aidl_methods) {\n";
+  out << "  _aidl_flight_put(&_aidl_dump, _aidl_method.code, 4);\n";
+  out << "  _aidl_flight_put_string(&_aidl_dump, _aidl_method.name);\n";
+  out << "}\n";
+
+  out << "std::string _aidl_records;\n";
+  out << "uint32_t _aidl_count = 0;\n";
+  out << "const uint64_t _aidl_next = _aidl_flight_next.load(std::memory_order_acquire);\n";
+  out << "for (uint64_t _aidl_index = _aidl_next > " << size << " ? _aidl_next - " << size
+      << " : 0; _aidl_index < _aidl_next;\n"
+      << "     _aidl_index++) {\n";
+  out.Indent();
+  out << "const _aidl_flight_entry& _aidl_record = _aidl_flight_records[_aidl_index % " << size
+      << "];\n";
+  out << "const uint64_t _aidl_sequence = 2 * _aidl_index + 2;\n";
+  out << "if (_aidl_record.sequence.load(std::memory_order_acquire) != _aidl_sequence) {\n";
+  out << "  continue;\n";
+  out << "}\n";
+  out << "uint64_t _aidl_words[" << words << "];\n";
+  out << "for (size_t i = 0; i < " << words << "; i++) {\n";
+  out << "  _aidl_words[i] = _aidl_record.words[i].load(std::memory_order_relaxed);\n";
+  out << "}\n";
+  out << "std::atomic_thread_fence(std::memory_order_acquire);\n";
+  out << "if (_aidl_record.sequence.load(std::memory_order_relaxed) != _aidl_sequence) {\n";
+  out << "  continue;\n";
+  out << "}\n";
+  out << "_aidl_flight_put(&_aidl_records, _aidl_index, 8);\n";
+  out << "for (uint64_t _aidl_word : _aidl_words) {\n";
+  out << "  _aidl_flight_put(&_aidl_records, _aidl_word, 8);\n";
+  out << "}\n";
+  out << "_aidl_count++;\n";
+  out.Dedent();
+  out << "}\n";
+  out << "_aidl_flight_put(&_aidl_dump, _aidl_count, 4);\n";
+  out << "_aidl_dump += _aidl_records;\n";
+
+  out << "const char* _aidl_bytes = _aidl_dump.data();\n";
+  out << "size_t _aidl_left = _aidl_dump.size();\n";
+  out << "while (_aidl_left > 0) {\n";
+  out.Indent();
+  out << "const ssize_t _aidl_written = TEMP_FAILURE_RETRY(write(fd, _aidl_bytes, _aidl_left));\n";
+  out << "if (_aidl_written <= 0) {\n";
+  out << "  return false;\n";
+  out << "}\n";
+  out << "_aidl_bytes += _aidl_written;\n";
+  out << "_aidl_left -= _aidl_written;\n";
+  out.Dedent();
+  out << "}\n";
+  out << "return true;\n";
+  out.Dedent();
+  out << "}\n";
+  writer->Close();
+  return code;
+}
+
 }  // namespace cpp
 }  // namespace aidl
 }  // namespace android
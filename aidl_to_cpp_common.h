@@ -16,9 +16,12 @@
 
 #pragma once
 
+#include <set>
 #include <string>
+#include <vector>
 
 #include "aidl_language.h"
+#include "options.h"
 
 // This is used to help generate code targetting C++ (the language) whether using the libbinder or
 // libbinder_ndk backend.
@@ -49,11 +52,68 @@ void EnterNamespace(CodeWriter& out, const AidlDefinedType& defined_type);
 void LeaveNamespace(CodeWriter& out, const AidlDefinedType& defined_type);
 
 string BuildVarName(const AidlArgument& a);
+
+// The user-defined methods of |interface| whose transactions are handled by
+// their own function, found through a table. With --transaction_table, like
+// in the outlining of Java, the TransactionTableInlineCount() methods with the
+// fewest arguments are left inline, or those called most if the call profile
+// covers |interface|. With the profile alone, its cold methods are in the
+// table. The methods with an ID beyond twice the number of methods are always
+// left inline, to keep the table dense.
+std::set<const AidlMethod*> TableTransactions(const AidlInterface& interface,
+                                              const Options& options);
+
+// Name of the function that handles the transactions of |method|.
+string TransactionHandlerName(const AidlMethod& method);
+
+// The entries of the table of the handlers of |methods|: the handler of the
+// method whose ID is i is the entry i, and the other entries are nullptr.
+std::vector<string> TransactionTableEntries(const std::set<const AidlMethod*>& methods);
+
+// The declarations that --log adds to the proxy and the stub classes: logFunc,
+// and with --log=typed, the TransactionLog that it gets.
+string GenLogDeclarations(const Options& options, bool isNdk);
+// The definition of the logFunc of |className|.
+string GenLogFuncDefinition(const string& className, const Options& options);
+
 const string GenLogBeforeExecute(const string className, const AidlMethod& method, bool isServer,
-                                 bool isNdk);
+                                 bool isNdk, const Options& options);
+// |inTable| is true in the handlers of the transaction table of a stub.
 const string GenLogAfterExecute(const string className, const AidlInterface& interface,
                                 const AidlMethod& method, const string& statusVarName,
-                                const string& returnVarName, bool isServer, bool isNdk);
+                                const string& returnVarName, bool isServer, bool isNdk,
+                                const Options& options, bool inTable = false);
+
+// The TransactionStats that --transaction_stats adds to the interface class.
+string GenTransactionStatsDeclarations();
+// The declaration of getTransactionStats, which --transaction_stats adds to
+// the proxy and the stub classes.
+string GenTransactionStatsAccessorDeclaration();
+// The counters of the transactions of the proxy and of the stub of
+// |interface|, and the functions that update them. They are defined once in
+// the source file, before the proxy and the stub.
+string GenTransactionStatsDefinitions(const AidlInterface& interface, bool isNdk);
+// The definition of getTransactionStats of the proxy or, |isServer|, of the
+// stub |className| of |interface|.
+string GenTransactionStatsAccessorDefinition(const AidlInterface& interface,
+                                             const string& className, bool isServer);
+// The counters of |method| in the proxy or, |isServer|, in the stub.
+string TransactionStatsOf(const AidlInterface& interface, const AidlMethod& method,
+                          bool isServer);
+// Counts an exception of |method| if the status |statusVarName|, a
+// binder::Status or, |isNdk|, a ScopedAStatus, has one.
+string GenTransactionStatsException(const AidlInterface& interface, const AidlMethod& method,
+                                    const string& statusVarName, bool isServer, bool isNdk);
+
+// The declaration of dumpFlightRecorder, which --flight_recorder adds to the
+// stub classes.
+string GenFlightRecorderDeclaration();
+// The ring buffer that --flight_recorder keeps the transactions of the stub
+// |className| of |interface| in, _aidl_flight_record, which records one of
+// them, and the definition of dumpFlightRecorder. See flight_recorder.h for
+// the format of the records and of the dumps.
+string GenFlightRecorderDefinitions(const AidlInterface& interface, const string& className,
+                                    const Options& options, bool isNdk);
 }  // namespace cpp
 }  // namespace aidl
 }  // namespace android
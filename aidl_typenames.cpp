@@ -16,10 +16,13 @@
 
 #include "aidl_typenames.h"
 #include "aidl_language.h"
+#include "io_delegate.h"
 #include "logging.h"
+#include "preprocessed_table.h"
 
 #include <android-base/strings.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <set>
@@ -27,6 +30,7 @@
 #include <utility>
 #include <vector>
 
+using android::base::Join;
 using android::base::Split;
 
 using std::make_pair;
@@ -81,30 +85,128 @@ static bool IsValidName(const string& name) {
   return true;
 }
 
-bool AidlTypenames::AddDefinedType(unique_ptr<AidlDefinedType> type) {
-  const string name = type->GetCanonicalName();
-  if (defined_types_.find(name) != defined_types_.end()) {
+AidlPreprocessedType::AidlPreprocessedType(Kind kind, const vector<string>& package,
+                                           const string& name, const string& filename, int line)
+    : kind_(kind),
+      package_(package),
+      dotted_package_(Join(package, '.')),
+      name_(name),
+      canonical_name_(package.empty() ? name : dotted_package_ + "." + name),
+      filename_(filename),
+      line_(line) {}
+
+AidlPreprocessedType::~AidlPreprocessedType() = default;
+
+const AidlDefinedType& AidlPreprocessedType::GetDefinedType() const {
+  std::call_once(defined_type_created_, [this] {
+    // The type may be shared by many AidlTypenames, so it doesn't belong in
+    // the arena of whichever is being parsed, and it may outlive them.
+    AidlArena::Scope arena_scope(&arena_);
+    AidlLocation::Point point = {.line = line_, .column = 0 /*column*/};
+    AidlLocation location = AidlLocation(filename_, point, point);
+    switch (kind_) {
+      case Kind::PARCELABLE:
+        defined_type_.reset(new AidlParcelable(
+            location, new AidlQualifiedName(location, name_, ""), package_, "" /* comments */));
+        break;
+      case Kind::STRUCTURED_PARCELABLE: {
+        auto temp = new std::vector<std::unique_ptr<AidlVariableDeclaration>>();
+        defined_type_.reset(new AidlStructuredParcelable(
+            location, new AidlQualifiedName(location, name_, ""), package_, "" /* comments */,
+            temp));
+        break;
+      }
+      case Kind::INTERFACE: {
+        auto temp = new std::vector<std::unique_ptr<AidlMember>>();
+        defined_type_.reset(new AidlInterface(location, name_, "", false, temp, package_));
+        break;
+      }
+    }
+  });
+  return *defined_type_;
+}
+
+AidlTypenames::AidlTypenames() = default;
+
+AidlTypenames::~AidlTypenames() = default;
+
+template <typename T>
+bool AidlTypenames::TypeTable<T>::Add(const string& package, const string& name,
+                                      const string& canonical_name, const T* type) {
+  if (types.find(canonical_name) != types.end()) {
     return false;
   }
-  if (!IsValidName(type->GetPackage()) || !IsValidName(type->GetName())) {
+  if (!IsValidName(package) || !IsValidName(name)) {
     return false;
   }
-  defined_types_.emplace(name, std::move(type));
+  types.emplace(canonical_name, type);
+  auto it = canonical_names.find(name);
+  if (it == canonical_names.end()) {
+    canonical_names.emplace(name, canonical_name);
+  } else if (canonical_name < it->second) {
+    it->second = canonical_name;
+  }
   return true;
 }
 
-bool AidlTypenames::AddPreprocessedType(unique_ptr<AidlDefinedType> type) {
-  const string name = type->GetCanonicalName();
-  if (preprocessed_types_.find(name) != preprocessed_types_.end()) {
+template <typename T>
+const T* AidlTypenames::TypeTable<T>::FindByCanonicalName(const string& canonical_name) const {
+  auto it = types.find(canonical_name);
+  return it != types.end() ? it->second : nullptr;
+}
+
+template <typename T>
+const T* AidlTypenames::TypeTable<T>::FindByName(const string& name) const {
+  auto it = canonical_names.find(name);
+  return it != canonical_names.end() ? FindByCanonicalName(it->second) : nullptr;
+}
+
+template <typename T>
+vector<const T*> AidlTypenames::TypeTable<T>::SortedTypes() const {
+  vector<pair<string, const T*>> sorted(types.begin(), types.end());
+  std::sort(sorted.begin(), sorted.end());
+  vector<const T*> ret;
+  ret.reserve(sorted.size());
+  for (const auto& kv : sorted) {
+    ret.push_back(kv.second);
+  }
+  return ret;
+}
+
+bool AidlTypenames::AddDefinedType(unique_ptr<AidlDefinedType> type) {
+  if (!AddSharedDefinedType(*type)) {
     return false;
   }
-  if (!IsValidName(type->GetPackage()) || !IsValidName(type->GetName())) {
+  owned_types_.push_back(std::move(type));
+  return true;
+}
+
+bool AidlTypenames::AddPreprocessedType(unique_ptr<AidlPreprocessedType> type) {
+  if (!AddSharedPreprocessedType(*type)) {
     return false;
   }
-  preprocessed_types_.insert(make_pair(name, std::move(type)));
+  owned_preprocessed_types_.push_back(std::move(type));
   return true;
 }
 
+bool AidlTypenames::AddSharedDefinedType(const AidlDefinedType& type) {
+  return defined_types_.Add(type.GetPackage(), type.GetName(), type.GetCanonicalName(), &type);
+}
+
+bool AidlTypenames::AddSharedPreprocessedType(const AidlPreprocessedType& type) {
+  return preprocessed_types_.Add(type.GetPackage(), type.GetName(), type.GetCanonicalName(),
+                                 &type);
+}
+
+void AidlTypenames::AddPreprocessedTable(unique_ptr<PreprocessedTable> table) {
+  AddSharedPreprocessedTable(*table);
+  owned_preprocessed_tables_.push_back(std::move(table));
+}
+
+void AidlTypenames::AddSharedPreprocessedTable(const PreprocessedTable& table) {
+  preprocessed_tables_.push_back(&table);
+}
+
 bool AidlTypenames::IsBuiltinTypename(const string& type_name) {
   return kBuiltinTypes.find(type_name) != kBuiltinTypes.end() ||
       kJavaLikeTypeToAidlType.find(type_name) != kJavaLikeTypeToAidlType.end();
@@ -116,33 +218,48 @@ bool AidlTypenames::IsPrimitiveTypename(const string& type_name) {
 
 const AidlDefinedType* AidlTypenames::TryGetDefinedType(const string& type_name) const {
   // Do the exact match first.
-  auto found_def = defined_types_.find(type_name);
-  if (found_def != defined_types_.end()) {
-    return found_def->second.get();
+  const AidlDefinedType* defined_type = defined_types_.FindByCanonicalName(type_name);
+  if (defined_type != nullptr) {
+    return defined_type;
   }
 
-  auto found_prep = preprocessed_types_.find(type_name);
-  if (found_prep != preprocessed_types_.end()) {
-    return found_prep->second.get();
+  const AidlPreprocessedType* preprocessed_type = FindPreprocessedType(type_name);
+  if (preprocessed_type != nullptr) {
+    return &preprocessed_type->GetDefinedType();
   }
 
   // Then match with the class name. Defined types has higher priority than
   // types from the preprocessed file.
-  for (auto it = defined_types_.begin(); it != defined_types_.end(); it++) {
-    if (it->second->GetName() == type_name) {
-      return it->second.get();
-    }
+  defined_type = defined_types_.FindByName(type_name);
+  if (defined_type != nullptr) {
+    return defined_type;
   }
 
-  for (auto it = preprocessed_types_.begin(); it != preprocessed_types_.end(); it++) {
-    if (it->second->GetName() == type_name) {
-      return it->second.get();
+  preprocessed_type = preprocessed_types_.FindByName(type_name);
+  for (const auto table : preprocessed_tables_) {
+    const AidlPreprocessedType* candidate = table->FindByName(type_name);
+    if (candidate != nullptr &&
+        (preprocessed_type == nullptr ||
+         candidate->GetCanonicalName() < preprocessed_type->GetCanonicalName())) {
+      preprocessed_type = FindPreprocessedType(candidate->GetCanonicalName());
     }
   }
+  if (preprocessed_type != nullptr) {
+    return &preprocessed_type->GetDefinedType();
+  }
 
   return nullptr;
 }
 
+const AidlPreprocessedType* AidlTypenames::FindPreprocessedType(const string& type_name) const {
+  const AidlPreprocessedType* type = preprocessed_types_.FindByCanonicalName(type_name);
+  for (auto it = preprocessed_tables_.begin(); type == nullptr && it != preprocessed_tables_.end();
+       ++it) {
+    type = (*it)->FindByCanonicalName(type_name);
+  }
+  return type;
+}
+
 pair<string, bool> AidlTypenames::ResolveTypename(const string& type_name) const {
   if (IsBuiltinTypename(type_name)) {
     auto found = kJavaLikeTypeToAidlType.find(type_name);
@@ -172,17 +289,38 @@ bool AidlTypenames::CanBeOutParameter(const AidlTypeSpecifier& type) const {
 }
 
 void AidlTypenames::IterateTypes(const std::function<void(const AidlDefinedType&)>& body) const {
-  for (const auto& kv : defined_types_) {
-    body(*kv.second);
+  for (const auto type : defined_types_.SortedTypes()) {
+    body(*type);
   }
-  for (const auto& kv : preprocessed_types_) {
-    body(*kv.second);
+  vector<const AidlPreprocessedType*> preprocessed = preprocessed_types_.SortedTypes();
+  for (const auto table : preprocessed_tables_) {
+    for (size_t i = 0; i < table->Size(); i++) {
+      const AidlPreprocessedType& type = table->GetType(i);
+      if (FindPreprocessedType(type.GetCanonicalName()) == &type) {
+        preprocessed.push_back(&type);
+      }
+    }
+  }
+  std::sort(preprocessed.begin(), preprocessed.end(),
+            [](const AidlPreprocessedType* a, const AidlPreprocessedType* b) {
+              return a->GetCanonicalName() < b->GetCanonicalName();
+            });
+  for (const auto type : preprocessed) {
+    body(type->GetDefinedType());
   }
 }
 
+void AidlTypenames::AddParsedFile(unique_ptr<FileBuffer> file) {
+  parsed_files_.push_back(std::move(file));
+}
+
 void AidlTypenames::Reset() {
-  defined_types_.clear();
-  preprocessed_types_.clear();
+  defined_types_ = {};
+  preprocessed_types_ = {};
+  owned_types_.clear();
+  owned_preprocessed_types_.clear();
+  preprocessed_tables_.clear();
+  owned_preprocessed_tables_.clear();
 }
 
 }  // namespace aidl
@@ -18,11 +18,17 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <android-base/macros.h>
+
+#include "aidl_arena.h"
+
 using std::map;
 using std::pair;
 using std::set;
@@ -36,6 +42,51 @@ class AidlTypeSpecifier;
 namespace android {
 namespace aidl {
 
+class FileBuffer;
+class PreprocessedTable;
+
+// A type declared in a preprocessed file, e.g. "parcelable foo.Bar;". Only the
+// declaration is kept. The AidlDefinedType for it is created the first time it
+// is asked for, as most types of a large preprocessed file are never used by
+// a compilation. Can be used from multiple threads.
+class AidlPreprocessedType final {
+ public:
+  enum class Kind {
+    PARCELABLE,
+    STRUCTURED_PARCELABLE,
+    INTERFACE,
+  };
+
+  AidlPreprocessedType(Kind kind, const vector<string>& package, const string& name,
+                       const string& filename, int line);
+  ~AidlPreprocessedType();
+
+  Kind GetKind() const { return kind_; }
+  const vector<string>& GetSplitPackage() const { return package_; }
+  const string& GetPackage() const { return dotted_package_; }
+  const string& GetName() const { return name_; }
+  const string& GetCanonicalName() const { return canonical_name_; }
+  const string& GetFilename() const { return filename_; }
+
+  const AidlDefinedType& GetDefinedType() const;
+
+ private:
+  const Kind kind_;
+  const vector<string> package_;
+  const string dotted_package_;
+  const string name_;
+  const string canonical_name_;
+  const string filename_;
+  const int line_;
+
+  mutable std::once_flag defined_type_created_;
+  // Holds the nodes of |defined_type_|, so it must be destroyed after it.
+  mutable AidlArena arena_;
+  mutable unique_ptr<AidlDefinedType> defined_type_;
+
+  DISALLOW_COPY_AND_ASSIGN(AidlPreprocessedType);
+};
+
 // AidlTypenames is a collection of AIDL types available to a compilation unit.
 //
 // Basic types (such as int, String, etc.) are added by default, while defined
@@ -49,22 +100,63 @@ namespace aidl {
 // Note that nothing here is specific to either Java or C++.
 class AidlTypenames final {
  public:
-  AidlTypenames() = default;
+  AidlTypenames();
+  ~AidlTypenames();
   void Reset();
   bool AddDefinedType(unique_ptr<AidlDefinedType> type);
-  bool AddPreprocessedType(unique_ptr<AidlDefinedType> type);
+  bool AddPreprocessedType(unique_ptr<AidlPreprocessedType> type);
+  // Same as above, but |type| is not owned and must outlive this object. This
+  // is used to share the parse trees of imports across compilation units.
+  bool AddSharedDefinedType(const AidlDefinedType& type);
+  bool AddSharedPreprocessedType(const AidlPreprocessedType& type);
+  // Adds the types of a preprocessed file in the binary format. They are
+  // looked up in |table| directly. When a type is declared both there and
+  // by AddPreprocessedType, the latter is used.
+  void AddPreprocessedTable(unique_ptr<PreprocessedTable> table);
+  void AddSharedPreprocessedTable(const PreprocessedTable& table);
   static bool IsBuiltinTypename(const string& type_name);
   static bool IsPrimitiveTypename(const string& type_name);
   const AidlDefinedType* TryGetDefinedType(const string& type_name) const;
   pair<string, bool> ResolveTypename(const string& type_name) const;
   bool CanBeOutParameter(const AidlTypeSpecifier& type) const;
 
-  // Iterates over all defined and then preprocessed types
+  // Iterates over all defined and then preprocessed types, each group in the
+  // order of their canonical names
   void IterateTypes(const std::function<void(const AidlDefinedType&)>& body) const;
 
+  // Memory for the parse trees of the defined types, see Parser::Parse.
+  AidlArena* GetArena() { return &arena_; }
+  // Keeps the text of a parsed file, or of a parse cache entry, as long as the
+  // parse trees, as the scanner or the comments refer to it. See AidlComments.
+  void AddParsedFile(unique_ptr<FileBuffer> file);
+
  private:
-  map<string, unique_ptr<AidlDefinedType>> defined_types_;
-  map<string, unique_ptr<AidlDefinedType>> preprocessed_types_;
+  template <typename T>
+  struct TypeTable {
+    // Types by canonical name.
+    std::unordered_map<string, const T*> types;
+    // Canonical names by the type name without package. When types share a
+    // name, the smallest canonical name is kept.
+    std::unordered_map<string, string> canonical_names;
+
+    bool Add(const string& package, const string& name, const string& canonical_name,
+             const T* type);
+    const T* FindByCanonicalName(const string& canonical_name) const;
+    const T* FindByName(const string& name) const;
+    vector<const T*> SortedTypes() const;
+  };
+
+  const AidlPreprocessedType* FindPreprocessedType(const string& type_name) const;
+
+  // Declared first, so that they outlive the nodes allocated from them.
+  AidlArena arena_;
+  vector<unique_ptr<FileBuffer>> parsed_files_;
+  TypeTable<AidlDefinedType> defined_types_;
+  TypeTable<AidlPreprocessedType> preprocessed_types_;
+  vector<const PreprocessedTable*> preprocessed_tables_;
+  vector<unique_ptr<AidlDefinedType>> owned_types_;
+  vector<unique_ptr<AidlPreprocessedType>> owned_preprocessed_types_;
+  vector<unique_ptr<PreprocessedTable>> owned_preprocessed_tables_;
 };
 
 }  // namespace aidl
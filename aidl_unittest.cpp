@@ -19,24 +19,40 @@
 #include <string>
 #include <vector>
 
+#include <limits.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <gtest/gtest.h>
 
 #include "aidl.h"
 #include "aidl_apicheck.h"
 #include "aidl_language.h"
+#include "aidl_server.h"
 #include "aidl_to_cpp.h"
+#include "flight_recorder.h"
+#include "line_reader.h"
+#include "parse_cache.h"
+#include "preprocessed_table.h"
+#include "tests/corpus_generator.h"
 #include "tests/fake_io_delegate.h"
 #include "type_cpp.h"
 #include "type_java.h"
 #include "type_namespace.h"
 
+using android::aidl::test::Corpus;
+using android::aidl::test::CorpusConfig;
 using android::aidl::test::FakeIoDelegate;
+using android::aidl::test::GenerateCorpus;
 using android::base::StringPrintf;
 using std::set;
 using std::string;
 using std::unique_ptr;
 using std::vector;
+using testing::internal::CaptureStderr;
+using testing::internal::GetCapturedStderr;
 using android::aidl::internals::parse_preprocessed_file;
 
 namespace android {
@@ -283,6 +299,197 @@ TEST_F(AidlTest, ParsesPreprocessedFileWithWhitespace) {
   EXPECT_TRUE(java_types_.HasTypeByCanonicalName("b.IBar"));
 }
 
+TEST_F(AidlTest, BufferLineReaderSplitsLinesLikeMemoryLineReader) {
+  for (const string contents : {"", "\n", "a", "a\n", "a\nb", "a\n\nb\n", "\n\n"}) {
+    vector<string> expected;
+    string line;
+    for (auto reader = LineReader::ReadFromMemory(contents); reader->ReadLine(&line);) {
+      expected.push_back(line);
+    }
+    vector<string> lines;
+    for (auto reader = LineReader::ReadFromBuffer(contents.data(), contents.size());
+         reader->ReadLine(&line);) {
+      lines.push_back(line);
+    }
+    EXPECT_EQ(expected, lines) << "'" << contents << "'";
+  }
+  // Including an empty last line after a trailing newline.
+  vector<string> lines;
+  string line;
+  for (auto reader = LineReader::ReadFromBuffer("a\n", 2); reader->ReadLine(&line);) {
+    lines.push_back(line);
+  }
+  EXPECT_EQ((vector<string>{"a", ""}), lines);
+}
+
+TEST_F(AidlTest, ResolvesPreprocessedTypesByName) {
+  io_delegate_.SetFileContents("path",
+                               "parcelable b.Foo;\nparcelable a.Foo;\n"
+                               "structured_parcelable a.Data;\ninterface b.IBar;");
+  EXPECT_TRUE(parse_preprocessed_file(io_delegate_, "path", &java_types_, java_types_.typenames_));
+  const AidlTypenames& typenames = java_types_.typenames_;
+
+  // When types share a name, the one with the smallest canonical name is used.
+  const AidlDefinedType* foo = typenames.TryGetDefinedType("Foo");
+  ASSERT_NE(nullptr, foo);
+  EXPECT_EQ("a.Foo", foo->GetCanonicalName());
+  EXPECT_EQ(foo, typenames.TryGetDefinedType("a.Foo"));
+  EXPECT_NE(nullptr, foo->AsUnstructuredParcelable());
+
+  const AidlDefinedType* data = typenames.TryGetDefinedType("Data");
+  ASSERT_NE(nullptr, data);
+  EXPECT_NE(nullptr, data->AsStructuredParcelable());
+  const AidlDefinedType* bar = typenames.TryGetDefinedType("b.IBar");
+  ASSERT_NE(nullptr, bar);
+  EXPECT_NE(nullptr, bar->AsInterface());
+  EXPECT_EQ("b.IBar", typenames.ResolveTypename("IBar").first);
+  EXPECT_EQ(nullptr, typenames.TryGetDefinedType("c.Foo"));
+
+  // Defined types take precedence over preprocessed types with the same name.
+  EXPECT_NE(nullptr, Parse("c/Foo.aidl", "package c; parcelable Foo {}", &java_types_));
+  EXPECT_EQ("c.Foo", typenames.ResolveTypename("Foo").first);
+  EXPECT_EQ("a.Foo", typenames.ResolveTypename("a.Foo").first);
+}
+
+TEST_F(AidlTest, AllocatesParseTreesFromArena) {
+  AidlTypenames& typenames = java_types_.typenames_;
+  EXPECT_EQ(0u, typenames.GetArena()->AllocatedSize());
+  EXPECT_NE(nullptr, Parse("p/IFoo.aidl", "package p; interface IFoo { int f(in int[] a); }",
+                           &java_types_));
+  const size_t allocated_size = typenames.GetArena()->AllocatedSize();
+  EXPECT_GT(allocated_size, 0u);
+
+  // Types from preprocessed files can outlive |typenames|, so they don't use
+  // its arena even when they are created during a parse.
+  io_delegate_.SetFileContents("path", "parcelable a.Foo;");
+  EXPECT_TRUE(parse_preprocessed_file(io_delegate_, "path", &java_types_, typenames));
+  ASSERT_NE(nullptr, typenames.TryGetDefinedType("a.Foo"));
+  EXPECT_EQ(allocated_size, typenames.GetArena()->AllocatedSize());
+
+  // Nodes created outside of a parse come from the heap.
+  std::unique_ptr<AidlQualifiedName> name(new AidlQualifiedName(AIDL_LOCATION_HERE, "Foo", ""));
+  EXPECT_EQ(allocated_size, typenames.GetArena()->AllocatedSize());
+}
+
+TEST_F(AidlTest, InternsNamesOfParseTrees) {
+  AidlArena* arena = java_types_.typenames_.GetArena();
+  EXPECT_EQ(&arena->Intern("p.IFoo"), &arena->Intern(string("p.") + "IFoo"));
+
+  const AidlDefinedType* parse_result =
+      Parse("p/IFoo.aidl", "package p; interface IFoo { String f(String a, in String[] b); }",
+            &java_types_);
+  ASSERT_NE(nullptr, parse_result);
+  const AidlInterface* interface = parse_result->AsInterface();
+  ASSERT_NE(nullptr, interface);
+  ASSERT_EQ(1u, interface->GetMethods().size());
+  const AidlMethod& method = *interface->GetMethods()[0];
+  ASSERT_EQ(2u, method.GetArguments().size());
+  const AidlTypeSpecifier& a = method.GetArguments()[0]->GetType();
+  const AidlTypeSpecifier& b = method.GetArguments()[1]->GetType();
+  EXPECT_EQ(&method.GetType().GetUnresolvedName(), &a.GetUnresolvedName());
+  EXPECT_EQ(&a.GetUnresolvedName(), &b.GetUnresolvedName());
+  EXPECT_EQ(&a.GetName(), &b.GetName());
+  EXPECT_EQ(&arena->Intern("String"), &a.GetName());
+  EXPECT_EQ(&arena->Intern("IFoo"), &parse_result->GetName());
+}
+
+TEST_F(AidlTest, CompilationsDontGrowSharedStringPool) {
+  io_delegate_.SetFileContents("preprocessed", "interface q.IBar;\n");
+  io_delegate_.SetFileContents("p/IFoo.aidl",
+                               "package p; import q.IBar; interface IFoo { void f(IBar b); }");
+  const size_t shared_strings = AidlArena::SharedStringCount();
+  for (const string lang : {"cpp", "ndk"}) {
+    Options options = Options::From("aidl --lang=" + lang +
+                                    " --version=2 -p preprocessed -o out -h out/include "
+                                    "p/IFoo.aidl");
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+  }
+  EXPECT_EQ(shared_strings, AidlArena::SharedStringCount());
+}
+
+TEST_F(AidlTest, KeepsCommentsBeforeTokens) {
+  const AidlDefinedType* parse_result = Parse("p/IFoo.aidl",
+                                              "package p;\n"
+                                              "/** Foo. */\n"
+                                              "interface IFoo {\n"
+                                              "  // a\n"
+                                              "  /* b */ void f();\n"
+                                              "%%{\n"
+                                              " c\n"
+                                              "}%%\n"
+                                              "  void g();\n"
+                                              "}\n",
+                                              &java_types_);
+  ASSERT_NE(nullptr, parse_result);
+  EXPECT_EQ("/** Foo. */", parse_result->GetComments());
+  const AidlInterface* interface = parse_result->AsInterface();
+  ASSERT_NE(nullptr, interface);
+  ASSERT_EQ(2u, interface->GetMethods().size());
+  // Comments separated by whitespace are joined without it.
+  EXPECT_EQ("// a\n/* b */", interface->GetMethods()[0]->GetComments());
+  EXPECT_EQ("/**\n c\n**/", interface->GetMethods()[1]->GetComments());
+}
+
+TEST_F(AidlTest, LexesTokensAndCommentsAtBufferBoundaries) {
+  // The first token starts the buffer, tokens touch each other, and a
+  // multi-line comment ends the buffer without a newline.
+  const AidlDefinedType* parse_result =
+      Parse("p/IFoo.aidl",
+            "interface IFoo{/** a\n"
+            " * b\n"
+            " */void f(int x);/* c */\n"
+            "// d\n"
+            "String g(in String[]y);}/* e\n"
+            " */",
+            &java_types_);
+  ASSERT_NE(nullptr, parse_result);
+  EXPECT_EQ("IFoo", parse_result->GetName());
+  EXPECT_EQ("", parse_result->GetComments());
+  const AidlInterface* interface = parse_result->AsInterface();
+  ASSERT_NE(nullptr, interface);
+  ASSERT_EQ(2u, interface->GetMethods().size());
+  const AidlMethod& f = *interface->GetMethods()[0];
+  EXPECT_EQ("f", f.GetName());
+  EXPECT_EQ("/** a\n * b\n */", f.GetComments());
+  ASSERT_EQ(1u, f.GetArguments().size());
+  EXPECT_EQ("x", f.GetArguments()[0]->GetName());
+  const AidlMethod& g = *interface->GetMethods()[1];
+  EXPECT_EQ("g", g.GetName());
+  EXPECT_EQ("/* c */// d\n", g.GetComments());
+  ASSERT_EQ(1u, g.GetArguments().size());
+  EXPECT_EQ("y", g.GetArguments()[0]->GetName());
+  EXPECT_EQ("String[]", g.GetArguments()[0]->GetType().ToString());
+
+  // Lines are counted across the comments.
+  EXPECT_EQ("p/IFoo.aidl:3", mappings::dump_location(f));
+  EXPECT_EQ("p/IFoo.aidl:5", mappings::dump_location(g));
+
+  parse_result = Parse("p/IBar.aidl", "package p;/* a\n\n b */interface IBar{}", &java_types_);
+  ASSERT_NE(nullptr, parse_result);
+  EXPECT_EQ("IBar", parse_result->GetName());
+  EXPECT_EQ("/* a\n\n b */", parse_result->GetComments());
+
+  // A file over the 16KiB buffer of the scanner, whose comments and tokens
+  // span multiples of it.
+  string contents = "interface IBaz {\n";
+  for (int i = 0; contents.size() < 3 * 16384; i++) {
+    contents +=
+        StringPrintf("/** m%d\n * %s\n */void m%d();\n", i, string(1000 + i, '*').c_str(), i);
+  }
+  contents += "}\n";
+  parse_result = Parse("p/IBaz.aidl", contents, &java_types_);
+  ASSERT_NE(nullptr, parse_result);
+  interface = parse_result->AsInterface();
+  ASSERT_NE(nullptr, interface);
+  ASSERT_LT(40u, interface->GetMethods().size());
+  for (size_t i = 0; i < interface->GetMethods().size(); i++) {
+    const AidlMethod& m = *interface->GetMethods()[i];
+    EXPECT_EQ(StringPrintf("m%zu", i), m.GetName());
+    EXPECT_EQ(StringPrintf("/** m%zu\n * %s\n */", i, string(1000 + i, '*').c_str()),
+              m.GetComments());
+  }
+}
+
 TEST_F(AidlTest, PreferImportToPreprocessed) {
   io_delegate_.SetFileContents("preprocessed", "interface another.IBar;");
   io_delegate_.SetFileContents("one/IBar.aidl", "package one; "
@@ -323,6 +530,187 @@ TEST_F(AidlTest, WritePreprocessedFile) {
   EXPECT_EQ("parcelable p.Outer.Inner;\ninterface one.IBar;\n", output);
 }
 
+TEST_F(AidlTest, WriteAndReadBinaryPreprocessedFile) {
+  io_delegate_.SetFileContents("p/Outer.aidl", "package p; parcelable Outer.Inner;");
+  io_delegate_.SetFileContents("one/IBar.aidl", "package one; interface IBar {}");
+  io_delegate_.SetFileContents("two/Foo.aidl", "package two; parcelable Foo { int x; }");
+  io_delegate_.SetFileContents("one/Foo.aidl", "package one; parcelable Foo;");
+  Options options = Options::From(
+      "aidl --preprocess --preprocess_format=binary preprocessed p/Outer.aidl one/IBar.aidl "
+      "two/Foo.aidl one/Foo.aidl");
+  EXPECT_TRUE(::android::aidl::preprocess_aidl(options, io_delegate_));
+
+  string output;
+  EXPECT_TRUE(io_delegate_.GetWrittenContents("preprocessed", &output));
+  EXPECT_TRUE(PreprocessedTable::IsBinaryFormat(output.data(), output.size()));
+  io_delegate_.SetFileContents("preprocessed", output);
+  EXPECT_TRUE(parse_preprocessed_file(io_delegate_, "preprocessed", &java_types_,
+                                      java_types_.typenames_));
+  for (const auto name : {"p.Outer.Inner", "one.IBar", "one.Foo", "two.Foo"}) {
+    EXPECT_TRUE(java_types_.HasTypeByCanonicalName(name)) << name;
+  }
+
+  const AidlTypenames& typenames = java_types_.typenames_;
+  const AidlDefinedType* foo = typenames.TryGetDefinedType("Foo");
+  ASSERT_NE(nullptr, foo);
+  EXPECT_EQ("one.Foo", foo->GetCanonicalName());
+  EXPECT_NE(nullptr, foo->AsUnstructuredParcelable());
+  EXPECT_EQ(foo, typenames.TryGetDefinedType("one.Foo"));
+  const AidlDefinedType* data = typenames.TryGetDefinedType("two.Foo");
+  ASSERT_NE(nullptr, data);
+  EXPECT_NE(nullptr, data->AsStructuredParcelable());
+  const AidlDefinedType* bar = typenames.TryGetDefinedType("IBar");
+  ASSERT_NE(nullptr, bar);
+  EXPECT_NE(nullptr, bar->AsInterface());
+  EXPECT_EQ("p.Outer.Inner", typenames.ResolveTypename("Inner").first);
+  for (const auto name : {"Fo", "Fooo", "one.Fo", "one.Fooo", "three.Foo", "Outer"}) {
+    EXPECT_EQ(nullptr, typenames.TryGetDefinedType(name)) << name;
+  }
+}
+
+TEST_F(AidlTest, BinaryPreprocessedFileWorksLikeTextFile) {
+  io_delegate_.SetFileContents("android/os/Bundle.aidl", "package android.os; parcelable Bundle;");
+  io_delegate_.SetFileContents("android/os/IToken.aidl", "package android.os; interface IToken {}");
+  for (const auto format : {"text", "binary"}) {
+    Options options = Options::From(StringPrintf(
+        "aidl --preprocess --preprocess_format=%s %s android/os/Bundle.aidl "
+        "android/os/IToken.aidl", format, format));
+    EXPECT_TRUE(::android::aidl::preprocess_aidl(options, io_delegate_));
+    string output;
+    EXPECT_TRUE(io_delegate_.GetWrittenContents(format, &output));
+    io_delegate_.SetFileContents(format, output);
+  }
+
+  io_delegate_.SetFileContents("foo/IFoo.aidl",
+                               "package foo;\n"
+                               "interface IFoo { IToken get(in Bundle b, out List<Bundle> l); }\n");
+  string outputs[2];
+  for (int i = 0; i < 2; i++) {
+    Options options = Options::From(StringPrintf(
+        "aidl --lang=java -o out -p %s foo/IFoo.aidl", i == 0 ? "text" : "binary"));
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+    EXPECT_TRUE(io_delegate_.GetWrittenContents("out/foo/IFoo.java", &outputs[i]));
+  }
+  EXPECT_FALSE(outputs[0].empty());
+  EXPECT_EQ(outputs[0], outputs[1]);
+}
+
+TEST_F(AidlTest, RejectsMalformedBinaryPreprocessedFile) {
+  io_delegate_.SetFileContents("a/Foo.aidl", "package a; parcelable Foo;");
+  Options options =
+      Options::From("aidl --preprocess --preprocess_format=binary preprocessed a/Foo.aidl");
+  EXPECT_TRUE(::android::aidl::preprocess_aidl(options, io_delegate_));
+  string output;
+  EXPECT_TRUE(io_delegate_.GetWrittenContents("preprocessed", &output));
+
+  // Truncated
+  io_delegate_.SetFileContents("preprocessed", output.substr(0, output.size() - 8));
+  EXPECT_FALSE(parse_preprocessed_file(io_delegate_, "preprocessed", &java_types_,
+                                       java_types_.typenames_));
+  // Unknown version
+  string other_version = output;
+  other_version[8] = 2;
+  io_delegate_.SetFileContents("preprocessed", other_version);
+  EXPECT_FALSE(parse_preprocessed_file(io_delegate_, "preprocessed", &java_types_,
+                                       java_types_.typenames_));
+  EXPECT_FALSE(java_types_.HasTypeByCanonicalName("a.Foo"));
+}
+
+TEST_F(AidlTest, RejectsInvalidPreprocessFormat) {
+  EXPECT_FALSE(Options::From("aidl --preprocess --preprocess_format=xml out a/Foo.aidl").Ok());
+  EXPECT_FALSE(Options::From("aidl --lang=java --preprocess_format=binary a/IFoo.aidl").Ok());
+}
+
+TEST_F(AidlTest, ImportResolverChecksOnlyListedFiles) {
+  class CountingIoDelegate : public FakeIoDelegate {
+   public:
+    bool FileIsReadable(const string& path) const override {
+      readable_checks_++;
+      return FakeIoDelegate::FileIsReadable(path);
+    }
+    bool ListDirectory(const string& dir, vector<string>* names) const override {
+      listings_++;
+      return FakeIoDelegate::ListDirectory(dir, names);
+    }
+    mutable int readable_checks_ = 0;
+    mutable int listings_ = 0;
+  } io_delegate;
+  io_delegate.SetFileContents("b/p/IFoo.aidl", "package p; interface IFoo {}");
+  io_delegate.SetFileContents("c/p/IBar.aidl", "package p; interface IBar {}");
+  io_delegate.SetFileContents("src/q/IBaz.aidl", "package q; interface IBaz {}");
+  const string input_file = "src/q/IBaz.aidl";
+  ImportResolver resolver{io_delegate, input_file, {"a", "b", "c"}, {input_file}};
+
+  EXPECT_EQ("b/p/IFoo.aidl", resolver.FindImportFile("p.IFoo"));
+  EXPECT_EQ(1, io_delegate.readable_checks_);
+  EXPECT_EQ(3, io_delegate.listings_);
+  // The directories are listed once, and the results are remembered.
+  EXPECT_EQ("c/p/IBar.aidl", resolver.FindImportFile("p.IBar"));
+  EXPECT_EQ("b/p/IFoo.aidl", resolver.FindImportFile("p.IFoo"));
+  EXPECT_EQ("", resolver.FindImportFile("p.IMissing"));
+  EXPECT_EQ("", resolver.FindImportFile("p.IMissing"));
+  EXPECT_EQ(2, io_delegate.readable_checks_);
+  EXPECT_EQ(3, io_delegate.listings_);
+  // Input files are found when the import paths don't have the file.
+  EXPECT_EQ("src/q/IBaz.aidl", resolver.FindImportFile("q.IBaz"));
+}
+
+TEST_F(AidlTest, ImportResolversOfAnInvocationShareDirectoryListings) {
+  class CountingIoDelegate : public FakeIoDelegate {
+   public:
+    bool ListDirectory(const string& dir, vector<string>* names) const override {
+      listings_++;
+      return FakeIoDelegate::ListDirectory(dir, names);
+    }
+    mutable int listings_ = 0;
+  } io_delegate;
+  Options options =
+      Options::From("aidl --lang=java -o out -I a -I b foo/bar/IFoo.aidl foo/bar/IBar.aidl");
+  io_delegate.SetFileContents("b/foo/bar/Data.aidl", "package foo.bar;\nparcelable Data {}\n");
+  io_delegate.SetFileContents(options.InputFiles().at(0),
+                              "package foo.bar;\n"
+                              "import foo.bar.Data;\n"
+                              "interface IFoo { Data getData(); }\n");
+  io_delegate.SetFileContents(options.InputFiles().at(1),
+                              "package foo.bar;\n"
+                              "import foo.bar.Data;\n"
+                              "interface IBar { Data getData(); }\n");
+
+  internals::ImportCache import_cache(io_delegate);
+  int listings[2];
+  for (size_t i = 0; i < 2; i++) {
+    java::JavaTypeNamespace types;
+    types.Init();
+    EXPECT_EQ(AidlError::OK,
+              internals::load_and_validate_aidl(options.InputFiles().at(i), options, io_delegate,
+                                                &types, nullptr, nullptr, &import_cache));
+    listings[i] = io_delegate.listings_;
+  }
+  EXPECT_LT(0, listings[0]);
+  // The second input finds the directories listed for the first one.
+  EXPECT_EQ(listings[0], listings[1]);
+
+  import_cache.Revalidate();
+  java::JavaTypeNamespace types;
+  types.Init();
+  EXPECT_EQ(AidlError::OK,
+            internals::load_and_validate_aidl(options.InputFiles().at(0), options, io_delegate,
+                                              &types, nullptr, nullptr, &import_cache));
+  EXPECT_EQ(2 * listings[0], io_delegate.listings_);
+}
+
+TEST_F(AidlTest, ImportResolverReportsDuplicatesEveryTime) {
+  io_delegate_.SetFileContents("a/p/IFoo.aidl", "package p; interface IFoo {}");
+  io_delegate_.SetFileContents("b/p/IFoo.aidl", "package p; interface IFoo {}");
+  const string input_file = "IBar.aidl";
+  ImportResolver resolver{io_delegate_, input_file, {"a", "b"}, {}};
+  for (int i = 0; i < 2; i++) {
+    CaptureStderr();
+    EXPECT_EQ("", resolver.FindImportFile("p.IFoo"));
+    EXPECT_NE(string::npos, GetCapturedStderr().find("Duplicate files found for p.IFoo"));
+  }
+}
+
 TEST_F(AidlTest, JavaParcelableOutput) {
   io_delegate_.SetFileContents("Rect.aidl",
                                "@SystemApi\n"
@@ -765,6 +1153,405 @@ TEST_F(AidlTest, MultipleTypesInSingleFileCpp) {
   }
 }
 
+TEST_F(AidlTest, DispatchesTransactionsThroughTable) {
+  const string contents =
+      "package foo.bar;\n"
+      "interface IFoo {\n"
+      "  void ping();\n"
+      "  int add(int a, int b);\n"
+      "  oneway void notify(int x);\n"
+      "}\n";
+  for (const string lang : {"cpp", "ndk"}) {
+    Options options = Options::From("aidl --lang=" + lang +
+                                    " --transaction_table=1 -o out -h out/include "
+                                    "foo/bar/IFoo.aidl");
+    io_delegate_.SetFileContents(options.InputFiles().front(), contents);
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+
+    string source;
+    ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &source)) << lang;
+    // ping() has the fewest arguments, so it stays inline.
+    EXPECT_EQ(string::npos, source.find("_aidl_handle_ping")) << lang;
+    EXPECT_NE(string::npos, source.find("_aidl_handle_add")) << lang;
+    EXPECT_NE(string::npos, source.find("_aidl_handle_notify")) << lang;
+    EXPECT_NE(string::npos, source.find("_aidl_transaction_table[_aidl_index]")) << lang;
+    const bool cpp = lang == "cpp";
+    EXPECT_NE(string::npos, source.find(cpp ? "0 /* ping */:" : "0 /*ping*/): {")) << lang;
+    EXPECT_EQ(string::npos, source.find(cpp ? "1 /* add */:" : "1 /*add*/): {")) << lang;
+  }
+}
+
+TEST_F(AidlTest, LogsTransactionsHandledThroughTable) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo { int add(int a, int b); }\n");
+  Options options = Options::From(
+      "aidl --lang=cpp --transaction_table --log -o out -h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+  string source;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &source));
+  // The handler is a static function, where the stub is _aidl_impl.
+  const size_t handler = source.find("_aidl_handle_add(");
+  ASSERT_NE(string::npos, handler);
+  const size_t end = source.find("\n}\n", handler);
+  ASSERT_NE(string::npos, end);
+  const string body = source.substr(handler, end - handler);
+  EXPECT_NE(string::npos, body.find("(std::ostringstream() << _aidl_impl).str()"));
+  EXPECT_EQ(string::npos, body.find("this"));
+}
+
+TEST_F(AidlTest, GeneratesStubsAccordingToCallProfile) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo {\n"
+                               "  void ping();\n"
+                               "  int add(int a, int b);\n"
+                               "  String echo(String s);\n"
+                               "}\n");
+  io_delegate_.SetFileContents("profile",
+                               "# calls\n"
+                               "foo.bar.IFoo echo 600\n"
+                               "foo.bar.IFoo add 300\n"
+                               "foo.bar.IFoo\tadd 99\n"
+                               "foo.bar.IFoo ping 1\n");
+
+  // ping() is cold, and echo() is called more than add().
+  Options cpp_options = Options::From(
+      "aidl --lang=cpp --profile=profile -d out/IFoo.d -o out -h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(cpp_options, io_delegate_));
+  string source;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &source));
+  EXPECT_NE(string::npos, source.find("static __attribute__((cold)) ::android::status_t "
+                                      "_aidl_handle_ping("));
+  EXPECT_EQ(string::npos, source.find("_aidl_handle_add"));
+  EXPECT_LT(source.find("2 /* echo */:"), source.find("1 /* add */:"));
+  string dep;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/IFoo.d", &dep));
+  EXPECT_NE(string::npos, dep.find("  profile"));
+
+  Options ndk_options = Options::From(
+      "aidl --lang=ndk --profile=profile -o out -h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(ndk_options, io_delegate_));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &source));
+  EXPECT_NE(string::npos, source.find("static __attribute__((cold)) binder_status_t "
+                                      "_aidl_handle_ping("));
+  EXPECT_LT(source.find("2 /*echo*/): {"), source.find("1 /*add*/): {"));
+
+  Options java_options =
+      Options::From("aidl --lang=java --profile=profile -o out foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(java_options, io_delegate_));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.java", &source));
+  EXPECT_NE(string::npos, source.find("return this.onTransact$ping$(data, reply);"));
+  EXPECT_EQ(string::npos, source.find("onTransact$add$"));
+  EXPECT_LT(source.find("case TRANSACTION_echo:"), source.find("case TRANSACTION_add:"));
+  EXPECT_LT(source.find("case TRANSACTION_add:"), source.find("case TRANSACTION_ping:"));
+}
+
+TEST_F(AidlTest, RejectsInvalidCallProfile) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl", "package foo.bar; interface IFoo { void f(); }");
+  Options options =
+      Options::From("aidl --lang=java --profile=profile -o out foo/bar/IFoo.aidl");
+  EXPECT_NE(0, ::android::aidl::compile_aidl(options, io_delegate_));
+
+  for (const string contents : {"foo.bar.IFoo f\n", "foo.bar.IFoo f many\n"}) {
+    io_delegate_.SetFileContents("profile", contents);
+    EXPECT_NE(0, ::android::aidl::compile_aidl(options, io_delegate_)) << contents;
+  }
+}
+
+TEST_F(AidlTest, LogsOnlyWhenLogFuncIsInstalled) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo { int add(int a, out int[] b); }\n");
+  for (const string lang : {"cpp", "ndk"}) {
+    Options options = Options::From("aidl --lang=" + lang +
+                                    " --log -o out -h out/include foo/bar/IFoo.aidl");
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+    string source;
+    ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &source)) << lang;
+    // Nothing is allocated or timed before checking for a logFunc.
+    EXPECT_NE(string::npos, source.find("const bool _log_enabled = BpFoo::logFunc != nullptr;\n"
+                                        "  std::optional<Json::Value> _log_input_args;\n"))
+        << lang;
+    EXPECT_NE(string::npos, source.find("if (_log_enabled) {\n"
+                                        "    _log_input_args.emplace(Json::arrayValue);\n"))
+        << lang;
+    EXPECT_EQ(string::npos, source.find("Json::Value _log_input_args")) << lang;
+    EXPECT_EQ(string::npos, source.find("auto _log_start = ")) << lang;
+  }
+}
+
+TEST_F(AidlTest, TypedLogDoesNotDependOnJson) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo { int add(int a, out int[] b); }\n");
+  for (const string lang : {"cpp", "ndk"}) {
+    Options options = Options::From("aidl --lang=" + lang +
+                                    " --log=typed -o out -h out/include foo/bar/IFoo.aidl");
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+    const string header = lang == "cpp" ? "out/include/foo/bar/BpFoo.h"
+                                        : "out/include/aidl/foo/bar/BpFoo.h";
+    const string interface_header = lang == "cpp" ? "out/include/foo/bar/IFoo.h"
+                                                  : "out/include/aidl/foo/bar/IFoo.h";
+    for (const string& file : {string("out/foo/bar/IFoo.cpp"), header, interface_header}) {
+      string contents;
+      ASSERT_TRUE(io_delegate_.GetWrittenContents(file, &contents)) << file;
+      EXPECT_EQ(string::npos, contents.find("Json")) << file;
+      EXPECT_EQ(string::npos, contents.find("json")) << file;
+    }
+    string contents;
+    ASSERT_TRUE(io_delegate_.GetWrittenContents(header, &contents));
+    EXPECT_NE(string::npos,
+              contents.find("static std::function<void(const TransactionLog&)> logFunc;"))
+        << lang;
+    ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &contents));
+    EXPECT_NE(string::npos, contents.find("std::function<void(const BpFoo::TransactionLog&)> "
+                                          "BpFoo::logFunc;"))
+        << lang;
+    EXPECT_NE(string::npos, contents.find("{\"in_a\", \"int\", &in_a},")) << lang;
+    EXPECT_NE(string::npos, contents.find("{\"out_b\", \"int[]\", &out_b},")) << lang;
+  }
+}
+
+TEST_F(AidlTest, CountsTransactionStats) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo { void ping(); int add(int a, int b); }\n");
+  Options cpp_options = Options::From(
+      "aidl --lang=cpp --transaction_stats -o out -h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(cpp_options, io_delegate_));
+  string contents;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/include/foo/bar/IFoo.h", &contents));
+  EXPECT_NE(string::npos, contents.find("struct TransactionStats {"));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/include/foo/bar/BpFoo.h", &contents));
+  EXPECT_NE(string::npos, contents.find("static TransactionStats getTransactionStats();"));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &contents));
+  EXPECT_NE(string::npos, contents.find("_aidl_method_stats _aidl_client_stats[2];"));
+  EXPECT_NE(string::npos, contents.find("static const char* const names[] = "
+                                        "{\"ping\", \"add\", nullptr};"));
+  EXPECT_NE(string::npos, contents.find("_aidl_stats_record(&_aidl_client_stats[1], "
+                                        "_aidl_stats_now() - _aidl_stats_start, "
+                                        "_aidl_data.dataSize(), _aidl_reply.dataSize(), "
+                                        "_aidl_ret_status != ::android::OK);"));
+  // Failing to write the data parcel is counted as an error.
+  EXPECT_NE(string::npos, contents.find("if (_aidl_stats_start == 0) {\n"
+                                        "    _aidl_stats_record(&_aidl_client_stats[1], 0, 0, 0, "
+                                        "true);\n"));
+  EXPECT_NE(string::npos, contents.find("_aidl_stats_record_server(_aidl_code, "
+                                        "_aidl_stats_now() - _aidl_stats_start, "
+                                        "_aidl_data.dataSize(), _aidl_reply->dataSize(), "
+                                        "_aidl_ret_status != ::android::OK);"));
+  EXPECT_NE(string::npos, contents.find("return _aidl_stats_snapshot(_aidl_server_stats);"));
+
+  Options ndk_options = Options::From(
+      "aidl --lang=ndk --transaction_stats -o out -h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(ndk_options, io_delegate_));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &contents));
+  // The transaction consumes the data parcel, whose size is taken before, and
+  // the transaction is recorded once the reply is read, at every return.
+  EXPECT_NE(string::npos,
+            contents.find("_aidl_stats_data_size = AParcel_getDataPosition(_aidl_in.get());"));
+  const string record_add =
+      "_aidl_stats_record(&_aidl_client_stats[1], _aidl_stats_time_ns, _aidl_stats_data_size, "
+      "_aidl_out.get() != nullptr ? AParcel_getDataPosition(_aidl_out.get()) : 0, "
+      "_aidl_stats_failed);\n";
+  EXPECT_NE(string::npos, contents.find("  _aidl_stats_time_ns = _aidl_stats_now() - "
+                                        "_aidl_stats_start;\n"
+                                        "  _aidl_stats_failed = _aidl_ret_status != STATUS_OK;\n"
+                                        "  if (_aidl_ret_status == STATUS_UNKNOWN_TRANSACTION && "
+                                        "IFoo::getDefaultImpl()) {\n"
+                                        "    " +
+                                        record_add));
+  EXPECT_NE(string::npos, contents.find("  if (!AStatus_isOk(_aidl_status.get())) {\n"
+                                        "    _aidl_client_stats[1].exceptions.fetch_add(1, "
+                                        "std::memory_order_relaxed);\n"
+                                        "    " +
+                                        record_add + "    return _aidl_status;\n"));
+  EXPECT_NE(string::npos, contents.find("  _aidl_error:\n  " + record_add));
+  EXPECT_NE(string::npos, contents.find("_aidl_stats_record_server(_aidl_code, "
+                                        "_aidl_stats_now() - _aidl_stats_start, "
+                                        "AParcel_getDataPosition(_aidl_in), "
+                                        "AParcel_getDataPosition(_aidl_out), "));
+  EXPECT_NE(string::npos, contents.find("_aidl_server_stats[0].exceptions.fetch_add(1, "
+                                        "std::memory_order_relaxed);"));
+  EXPECT_NE(string::npos, contents.find("_aidl_handleTransaction(_aidl_binder, _aidl_code, "
+                                        "_aidl_in, _aidl_out);"));
+}
+
+TEST_F(AidlTest, RecordsTransactionsInFlightRecorder) {
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo { int add(int a, int b); }\n");
+  Options cpp_options = Options::From(
+      "aidl --lang=cpp --flight_recorder=16 --flight_recorder_arg_bytes=8 -o out "
+      "-h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(cpp_options, io_delegate_));
+  string contents;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/include/foo/bar/BnFoo.h", &contents));
+  EXPECT_NE(string::npos, contents.find("static bool dumpFlightRecorder(int fd);"));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &contents));
+  // 4 words, the number of argument bytes and 8 argument bytes.
+  EXPECT_NE(string::npos, contents.find("std::atomic<uint64_t> words[6];"));
+  EXPECT_NE(string::npos, contents.find("_aidl_flight_entry _aidl_flight_records[16];"));
+  EXPECT_NE(string::npos, contents.find("_aidl_args_start = _aidl_data.dataPosition();"));
+  EXPECT_NE(string::npos, contents.find("_aidl_flight_record(_aidl_code, _aidl_ret_status, "
+                                        "_aidl_flight_start, _aidl_data.dataSize(), "
+                                        "_aidl_reply->dataSize(), "
+                                        "_aidl_data.data() + _aidl_args_start"));
+  EXPECT_NE(string::npos,
+            contents.find("{::android::IBinder::FIRST_CALL_TRANSACTION + 0, \"add\"},"));
+
+  Options ndk_options = Options::From(
+      "aidl --lang=ndk --flight_recorder -o out -h out/include foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(ndk_options, io_delegate_));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.cpp", &contents));
+  EXPECT_NE(string::npos, contents.find("std::atomic<uint64_t> words[4];"));
+  EXPECT_NE(string::npos,
+            contents.find("static binder_status_t _aidl_onTransact(AIBinder* _aidl_binder, "
+                          "transaction_code_t _aidl_code, const AParcel* _aidl_in, "
+                          "AParcel* _aidl_out) {\n"
+                          "  const uint64_t _aidl_flight_start = _aidl_flight_now();\n"
+                          "  binder_status_t _aidl_ret_status = _aidl_handleTransaction("
+                          "_aidl_binder, _aidl_code, _aidl_in, _aidl_out);\n"
+                          "  _aidl_flight_record(_aidl_code, _aidl_ret_status, "
+                          "_aidl_flight_start, AParcel_getDataPosition(_aidl_in), "
+                          "AParcel_getDataPosition(_aidl_out));\n"
+                          "  return _aidl_ret_status;\n"
+                          "}\n"));
+  EXPECT_NE(string::npos, contents.find("defineClass(IFoo::descriptor, _aidl_onTransact);"));
+
+  Options java_options =
+      Options::From("aidl --lang=java --flight_recorder -o out foo/bar/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(java_options, io_delegate_));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.java", &contents));
+  EXPECT_NE(string::npos, contents.find("private boolean onTransact$recorded$("));
+  EXPECT_NE(string::npos, contents.find("@Override public boolean onTransact("));
+  EXPECT_NE(string::npos, contents.find("new java.util.concurrent.atomic.AtomicLongArray(640);"));
+  EXPECT_NE(string::npos, contents.find("public static byte[] dumpFlightRecorder()"));
+}
+
+// The NDK backend targets the libbinder_ndk of API 29, so the generated code
+// mustn't call what was only added later, such as AParcel_getDataSize.
+TEST_F(AidlTest, NdkBackendOnlyCallsApi29Functions) {
+  static const set<string> kApi29 = {
+      "AIBinder_Class", "AIBinder_Class_define", "AIBinder_Class_setOnDump",
+      "AIBinder_DeathRecipient", "AIBinder_DeathRecipient_delete", "AIBinder_DeathRecipient_new",
+      "AIBinder_Weak", "AIBinder_Weak_delete", "AIBinder_Weak_new", "AIBinder_Weak_promote",
+      "AIBinder_associateClass", "AIBinder_debugGetRefCount", "AIBinder_decStrong",
+      "AIBinder_dump", "AIBinder_getCallingPid", "AIBinder_getCallingUid", "AIBinder_getClass",
+      "AIBinder_getUserData", "AIBinder_incStrong", "AIBinder_isAlive", "AIBinder_isRemote",
+      "AIBinder_linkToDeath", "AIBinder_new", "AIBinder_ping", "AIBinder_prepareTransaction",
+      "AIBinder_transact", "AIBinder_unlinkToDeath", "AParcel_delete", "AParcel_getDataPosition",
+      "AParcel_readBool", "AParcel_readBoolArray", "AParcel_readByte", "AParcel_readByteArray",
+      "AParcel_readChar", "AParcel_readCharArray", "AParcel_readDouble",
+      "AParcel_readDoubleArray", "AParcel_readFloat", "AParcel_readFloatArray",
+      "AParcel_readInt32", "AParcel_readInt32Array", "AParcel_readInt64",
+      "AParcel_readInt64Array", "AParcel_readParcelFileDescriptor",
+      "AParcel_readParcelableArray", "AParcel_readStatusHeader", "AParcel_readString",
+      "AParcel_readStringArray", "AParcel_readStrongBinder", "AParcel_readUint32",
+      "AParcel_readUint32Array", "AParcel_readUint64", "AParcel_readUint64Array",
+      "AParcel_setDataPosition", "AParcel_writeBool", "AParcel_writeBoolArray",
+      "AParcel_writeByte", "AParcel_writeByteArray", "AParcel_writeChar",
+      "AParcel_writeCharArray", "AParcel_writeDouble", "AParcel_writeDoubleArray",
+      "AParcel_writeFloat", "AParcel_writeFloatArray", "AParcel_writeInt32",
+      "AParcel_writeInt32Array", "AParcel_writeInt64", "AParcel_writeInt64Array",
+      "AParcel_writeParcelFileDescriptor", "AParcel_writeParcelableArray",
+      "AParcel_writeStatusHeader", "AParcel_writeString", "AParcel_writeStringArray",
+      "AParcel_writeStrongBinder", "AParcel_writeUint32", "AParcel_writeUint32Array",
+      "AParcel_writeUint64", "AParcel_writeUint64Array", "AStatus_delete",
+      "AStatus_fromExceptionCode", "AStatus_fromExceptionCodeWithMessage",
+      "AStatus_fromServiceSpecificError", "AStatus_fromServiceSpecificErrorWithMessage",
+      "AStatus_fromStatus", "AStatus_getExceptionCode", "AStatus_getMessage",
+      "AStatus_getServiceSpecificError", "AStatus_getStatus", "AStatus_isOk", "AStatus_newOk",
+  };
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "interface IFoo { int add(int a, int b); oneway void ping(); }\n");
+  Options options = Options::From(
+      "aidl --lang=ndk --flight_recorder --transaction_stats --log -o out -h out/include "
+      "foo/bar/IFoo.aidl");
+  ASSERT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+  for (const string& path :
+       {"out/foo/bar/IFoo.cpp", "out/include/aidl/foo/bar/IFoo.h",
+        "out/include/aidl/foo/bar/BpFoo.h", "out/include/aidl/foo/bar/BnFoo.h"}) {
+    string contents;
+    ASSERT_TRUE(io_delegate_.GetWrittenContents(path, &contents)) << path;
+    for (const string prefix : {"AIBinder_", "AParcel_", "AStatus_"}) {
+      for (size_t pos = contents.find(prefix); pos != string::npos;
+           pos = contents.find(prefix, pos + 1)) {
+        // The helpers of libbinder_ndk_helper_headers are in ::ndk.
+        if (pos > 0 && (isalnum(contents[pos - 1]) || contents[pos - 1] == '_' ||
+                        contents[pos - 1] == ':')) {
+          continue;
+        }
+        size_t end = pos + prefix.size();
+        while (end < contents.size() && (isalnum(contents[end]) || contents[end] == '_')) {
+          end++;
+        }
+        const string name = contents.substr(pos, end - pos);
+        EXPECT_EQ(1u, kApi29.count(name)) << name << " in " << path;
+      }
+    }
+  }
+}
+
+TEST_F(AidlTest, DecodesFlightRecorderDump) {
+  string dump = kFlightRecorderMagic;
+  auto put = [&dump](uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      dump.push_back(static_cast<char>(value >> (8 * i)));
+    }
+  };
+  auto put_string = [&dump, &put](const string& value) {
+    put(value.size(), 4);
+    dump += value;
+  };
+  put(3, 4);
+  put_string("foo.bar.IFoo");
+  put(2, 4);
+  put(1, 4);
+  put_string("add");
+  put(2, 4);
+  put_string("ping");
+  put(2, 4);
+  // add() with its first 3 argument bytes, which failed.
+  put(41, 8);
+  put(1 | uint64_t(uint32_t(-74)) << 32, 8);
+  put(1000, 8);
+  put(250, 8);
+  put(120 | uint64_t(4) << 32, 8);
+  put(3, 8);
+  put(0x0a0b0c, 8);
+  // A method that the dump doesn't know.
+  put(42, 8);
+  put(7, 8);
+  put(2000, 8);
+  put(10, 8);
+  put(0, 8);
+  put(0, 8);
+  put(0, 8);
+  io_delegate_.SetFileContents("dump", dump);
+  io_delegate_.SetFileContents("mappings",
+                               "foo.bar.IFoo|add|int,int,|int\n"
+                               "foo/bar/IFoo.aidl:3\n"
+                               "foo.bar.IFoo|ping||void\n"
+                               "foo/bar/IFoo.aidl:2\n");
+
+  Options options =
+      Options::From("aidl --decode_flight_recorder=calls.txt --mappings=mappings dump");
+  EXPECT_EQ(0, ::android::aidl::run_task(options, io_delegate_));
+  string calls;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("calls.txt", &calls));
+  EXPECT_EQ(
+      "#41 foo.bar.IFoo|add|int,int,|int (foo/bar/IFoo.aidl:3) status=-74 start=1000ns "
+      "duration=250ns data=120 reply=4 args=0c0b0a\n"
+      "#42 foo.bar.IFoo code 7 status=0 start=2000ns duration=10ns data=0 reply=0 args=\n",
+      calls);
+
+  io_delegate_.SetFileContents("dump", dump.substr(0, dump.size() - 1));
+  EXPECT_NE(0, ::android::aidl::run_task(options, io_delegate_));
+}
+
 TEST_F(AidlTest, MultipleInputFiles) {
   Options options = Options::From(
       "aidl --lang=java -o out foo/bar/IFoo.aidl foo/bar/Data.aidl");
@@ -818,6 +1605,453 @@ TEST_F(AidlTest, MultipleInputFilesCpp) {
   }
 }
 
+TEST_F(AidlTest, MultipleInputFilesShareImports) {
+  Options options = Options::From(
+      "aidl --lang=java -o out -I . -p preprocessed foo/bar/IFoo.aidl foo/bar/IBar.aidl");
+  io_delegate_.SetFileContents("preprocessed", "parcelable android.os.Bundle;");
+  io_delegate_.SetFileContents("foo/bar/Data.aidl", "package foo.bar;\nparcelable Data {}\n");
+  io_delegate_.SetFileContents(options.InputFiles().at(0),
+                               "package foo.bar;\n"
+                               "import foo.bar.Data;\n"
+                               "interface IFoo { Data getData(in Bundle b); }\n");
+  io_delegate_.SetFileContents(options.InputFiles().at(1),
+                               "package foo.bar;\n"
+                               "import foo.bar.Data;\n"
+                               "interface IBar { void setData(in Data d, in Bundle b); }\n");
+
+  internals::ImportCache import_cache(io_delegate_);
+  java::JavaTypeNamespace types[2];
+  for (size_t i = 0; i < 2; i++) {
+    types[i].Init();
+    vector<string> imported_files;
+    EXPECT_EQ(AidlError::OK, internals::load_and_validate_aidl(
+                                 options.InputFiles().at(i), options, io_delegate_, &types[i],
+                                 nullptr, &imported_files, &import_cache));
+    EXPECT_EQ(vector<string>{"./foo/bar/Data.aidl"}, imported_files);
+  }
+
+  // The import and the preprocessed file are parsed only once.
+  const AidlDefinedType* data = types[0].typenames_.TryGetDefinedType("foo.bar.Data");
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(data, types[1].typenames_.TryGetDefinedType("foo.bar.Data"));
+  const AidlDefinedType* bundle = types[0].typenames_.TryGetDefinedType("android.os.Bundle");
+  ASSERT_NE(nullptr, bundle);
+  EXPECT_EQ(bundle, types[1].typenames_.TryGetDefinedType("android.os.Bundle"));
+
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+  for (const auto file : {"out/foo/bar/IFoo.java", "out/foo/bar/IBar.java"}) {
+    EXPECT_TRUE(io_delegate_.GetWrittenContents(file, nullptr));
+  }
+}
+
+TEST_F(AidlTest, ImportCacheRevalidatesChangedFiles) {
+  Options options = Options::From("aidl --lang=java -o out -I . foo/bar/IFoo.aidl");
+  io_delegate_.SetFileContents("foo/bar/Data.aidl", "package foo.bar;\nparcelable Data {}\n");
+  io_delegate_.SetFileContents(options.InputFiles().at(0),
+                               "package foo.bar;\n"
+                               "import foo.bar.Data;\n"
+                               "interface IFoo { Data getData(); }\n");
+
+  internals::ImportCache import_cache(io_delegate_);
+  auto load_data = [&]() -> std::pair<const AidlDefinedType*, size_t> {
+    java::JavaTypeNamespace types;
+    types.Init();
+    EXPECT_EQ(AidlError::OK,
+              internals::load_and_validate_aidl(options.InputFiles().at(0), options, io_delegate_,
+                                                &types, nullptr, nullptr, &import_cache));
+    const AidlDefinedType* data = types.typenames_.TryGetDefinedType("foo.bar.Data");
+    EXPECT_NE(nullptr, data);
+    if (data == nullptr || data->AsStructuredParcelable() == nullptr) {
+      return {data, 0};
+    }
+    return {data, data->AsStructuredParcelable()->GetFields().size()};
+  };
+
+  const AidlDefinedType* data = load_data().first;
+  import_cache.Revalidate();
+  EXPECT_EQ(data, load_data().first);
+
+  io_delegate_.SetFileContents("foo/bar/Data.aidl",
+                               "package foo.bar;\nparcelable Data { int x; }\n");
+  import_cache.Revalidate();
+  EXPECT_EQ(1u, load_data().second);
+}
+
+TEST_F(AidlTest, ParseCacheStoresImports) {
+  Options options =
+      Options::From("aidl --lang=java -o out -I . --cache_dir=cache foo/bar/IFoo.aidl");
+  const string bar =
+      "package foo.bar;\n"
+      "/** The bar. */\n"
+      "oneway interface IBar {\n"
+      "  /** Does bar. */\n"
+      "  void doBar(in @nullable String[] a, in List<String> b, int c) = 3;\n"
+      "  const int X = 0x10;\n"
+      "  const String Y = \"y\";\n"
+      "}\n"
+      "@JavaOnlyStableParcelable parcelable Baz cpp_header \"baz.h\";\n"
+      "parcelable Qux { int[] a = {1, 2}; boolean b = true; char c = 'c'; }\n";
+  io_delegate_.SetFileContents("foo/bar/IBar.aidl", bar);
+  io_delegate_.SetFileContents(options.InputFiles().at(0),
+                               "package foo.bar;\n"
+                               "import foo.bar.IBar;\n"
+                               "interface IFoo { IBar getBar(); }\n");
+  const string entry_path = ParseCache::EntryPath("cache", bar.data(), bar.size());
+
+  auto load_bar = [&]() {
+    java::JavaTypeNamespace types;
+    types.Init();
+    EXPECT_EQ(AidlError::OK,
+              internals::load_and_validate_aidl(options.InputFiles().at(0), options, io_delegate_,
+                                                &types, nullptr, nullptr));
+    string dump;
+    for (const char* name : {"foo.bar.IBar", "foo.bar.Baz", "foo.bar.Qux"}) {
+      const AidlDefinedType* type = types.typenames_.TryGetDefinedType(name);
+      EXPECT_NE(nullptr, type);
+      if (type == nullptr) {
+        continue;
+      }
+      string text;
+      CodeWriterPtr writer = CodeWriter::ForString(&text);
+      type->Write(writer.get());
+      writer->Close();
+      dump += type->GetComments() + text;
+      if (type->AsInterface() != nullptr) {
+        for (const auto& method : type->AsInterface()->GetMethods()) {
+          dump += method->GetComments() + std::to_string(method->GetId()) +
+                  (method->IsOneway() ? " oneway\n" : "\n");
+        }
+      } else if (type->AsUnstructuredParcelable() != nullptr) {
+        dump += type->AsParcelable()->GetCppHeader() + "\n";
+      }
+    }
+    return dump;
+  };
+
+  const string parsed = load_bar();
+  string entry;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents(entry_path, &entry));
+  io_delegate_.SetFileContents(entry_path, entry);
+  EXPECT_EQ(parsed, load_bar());
+
+  // The types are taken from the entry rather than from the file.
+  size_t pos = entry.rfind("doBar");
+  ASSERT_NE(string::npos, pos);
+  entry.replace(pos, 5, "doBaz");
+  io_delegate_.SetFileContents(entry_path, entry);
+  EXPECT_NE(string::npos, load_bar().find("doBaz"));
+
+  // A malformed entry is ignored.
+  io_delegate_.SetFileContents(entry_path, entry.substr(0, entry.size() - 1));
+  EXPECT_EQ(parsed, load_bar());
+}
+
+TEST_F(AidlTest, ServerRunsCommandLines) {
+  char working_dir[PATH_MAX];
+  ASSERT_NE(nullptr, getcwd(working_dir, sizeof(working_dir)));
+  io_delegate_.SetFileContents("foo/bar/Data.aidl", "package foo.bar;\nparcelable Data {}\n");
+  io_delegate_.SetFileContents("foo/bar/IFoo.aidl",
+                               "package foo.bar;\n"
+                               "import foo.bar.Data;\n"
+                               "interface IFoo { Data getData(); }\n");
+  const vector<string> args = {"aidl", "--lang=java", "-o", "out", "-I", ".",
+                               "foo/bar/IFoo.aidl"};
+
+  AidlServer server(io_delegate_);
+  string diagnostics;
+  EXPECT_EQ(0, server.HandleRequest(working_dir, args, &diagnostics));
+  EXPECT_EQ("", diagnostics);
+  EXPECT_TRUE(io_delegate_.GetWrittenContents("out/foo/bar/IFoo.java", nullptr));
+
+  EXPECT_EQ(1, server.HandleRequest(working_dir, {"aidl", "--lang=klingon", "foo.aidl"},
+                                    &diagnostics));
+  EXPECT_NE(string::npos, diagnostics.find("Unsupported language: 'klingon'"));
+  EXPECT_EQ(1, server.HandleRequest(working_dir, {"aidl", "--bogus"}, &diagnostics));
+  EXPECT_NE(string::npos, diagnostics.find("Invalid option: '--bogus'"));
+  EXPECT_EQ(0, server.HandleRequest(working_dir, {"aidl", "--help"}, &diagnostics));
+  EXPECT_NE(string::npos, diagnostics.find("usage:"));
+  // The standard output of the server isn't that of the client.
+  EXPECT_EQ(1, server.HandleRequest(working_dir, {"aidl", "--preprocess", "-", "foo/bar/IFoo.aidl"},
+                                    &diagnostics));
+  EXPECT_NE(string::npos, diagnostics.find("standard output")) << diagnostics;
+  EXPECT_EQ(1, server.HandleRequest(working_dir,
+                                    {"aidl", "--lang=java", "-d", "-", "-o", "out", "-I", ".",
+                                     "foo/bar/IFoo.aidl"},
+                                    &diagnostics));
+  EXPECT_NE(string::npos, diagnostics.find("standard output")) << diagnostics;
+
+  // A changed import is parsed again.
+  io_delegate_.SetFileContents("foo/bar/Data.aidl", "package foo.bar;\nparcelable Data {\n");
+  EXPECT_EQ(1, server.HandleRequest(working_dir, args, &diagnostics));
+  EXPECT_NE(string::npos, diagnostics.find("foo/bar/Data.aidl"));
+}
+
+TEST_F(AidlTest, ServerReadsRequestsFromFileDescriptors) {
+  char working_dir[PATH_MAX];
+  ASSERT_NE(nullptr, getcwd(working_dir, sizeof(working_dir)));
+  int requests[2];
+  int responses[2];
+  ASSERT_EQ(0, pipe(requests));
+  ASSERT_EQ(0, pipe(responses));
+  string request;
+  for (const string& str : {string(working_dir), string("3"), string("aidl"),
+                            string("--lang=klingon"), string("foo.aidl")}) {
+    request.append(str);
+    request.push_back('\0');
+  }
+  // Arguments can be empty.
+  for (const string& str : {string(working_dir), string("4"), string("aidl"),
+                            string("--lang=klingon"), string(), string("foo.aidl")}) {
+    request.append(str);
+    request.push_back('\0');
+  }
+  ASSERT_TRUE(android::base::WriteFully(requests[1], request.data(), request.size()));
+  close(requests[1]);
+
+  AidlServer server(io_delegate_);
+  EXPECT_TRUE(server.Serve(requests[0], responses[1]));
+  close(requests[0]);
+  close(responses[1]);
+  string response;
+  ASSERT_TRUE(android::base::ReadFdToString(responses[0], &response));
+  close(responses[0]);
+  vector<string> strings = android::base::Split(response, string(1, '\0'));
+  ASSERT_EQ(5u, strings.size());
+  EXPECT_EQ("1", strings[0]);
+  EXPECT_NE(string::npos, strings[1].find("Unsupported language: 'klingon'"));
+  EXPECT_EQ("1", strings[2]);
+  EXPECT_NE(string::npos, strings[3].find("Unsupported language: 'klingon'"));
+  EXPECT_EQ("", strings[4]);
+}
+
+TEST_F(AidlTest, ParallelCompileMatchesSerialCompile) {
+  const int kNumInputs = 8;
+  string input_files;
+  for (int i = 0; i < kNumInputs; i++) {
+    input_files += StringPrintf(" foo/bar/IFoo%d.aidl", i);
+  }
+  FakeIoDelegate io_delegates[2];
+  const string commands[2] = {"aidl --lang=cpp -o out -h out -I . -a" + input_files,
+                              "aidl --lang=cpp -o out -h out -I . -a -j 4" + input_files};
+  for (int j = 0; j < 2; j++) {
+    io_delegates[j].SetFileContents("foo/bar/Data.aidl", "package foo.bar;\nparcelable Data {}\n");
+    for (int i = 0; i < kNumInputs; i++) {
+      io_delegates[j].SetFileContents(
+          StringPrintf("foo/bar/IFoo%d.aidl", i),
+          StringPrintf("package foo.bar;\nimport foo.bar.Data;\n"
+                       "interface IFoo%d { Data get(int x); }\n",
+                       i));
+    }
+    Options options = Options::From(commands[j]);
+    ASSERT_TRUE(options.Ok());
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegates[j]));
+  }
+  for (int i = 0; i < kNumInputs; i++) {
+    for (const auto& file : {StringPrintf("out/foo/bar/IFoo%d.cpp", i),
+                             StringPrintf("out/foo/bar/IFoo%d.h", i),
+                             StringPrintf("out/foo/bar/BpFoo%d.h", i),
+                             StringPrintf("out/foo/bar/IFoo%d.cpp.d", i)}) {
+      string serial, parallel;
+      EXPECT_TRUE(io_delegates[0].GetWrittenContents(file, &serial)) << file;
+      EXPECT_TRUE(io_delegates[1].GetWrittenContents(file, &parallel)) << file;
+      EXPECT_EQ(serial, parallel) << file;
+    }
+  }
+}
+
+TEST_F(AidlTest, ParallelCompileReportsErrorsInInputOrder) {
+  const string input_files = " p/IOk.aidl p/IBad1.aidl p/IBad2.aidl";
+  string errors[2];
+  const string commands[2] = {"aidl --lang=java -o out -I ." + input_files,
+                              "aidl --lang=java -o out -I . -j 3" + input_files};
+  for (int j = 0; j < 2; j++) {
+    FakeIoDelegate io_delegate;
+    io_delegate.SetFileContents("p/IOk.aidl", "package p; interface IOk { void f(); }");
+    io_delegate.SetFileContents("p/IBad1.aidl", "package p; interface IBad1 { Unknown1 f(); }");
+    io_delegate.SetFileContents("p/IBad2.aidl", "package p; interface IBad2 { Unknown2 f(); }");
+    Options options = Options::From(commands[j]);
+    ASSERT_TRUE(options.Ok());
+    CaptureStderr();
+    EXPECT_NE(0, ::android::aidl::compile_aidl(options, io_delegate));
+    errors[j] = GetCapturedStderr();
+    EXPECT_TRUE(io_delegate.GetWrittenContents("out/p/IOk.java", nullptr));
+  }
+  EXPECT_NE(string::npos, errors[0].find("Unknown1"));
+  EXPECT_EQ(string::npos, errors[0].find("Unknown2"));
+  EXPECT_EQ(errors[0], errors[1]);
+}
+
+TEST_F(AidlTest, WritesOutputsOnlyIfChanged) {
+  Options options = Options::From("aidl --lang=java -o out -a --write_if_changed p/IFoo.aidl");
+  ASSERT_TRUE(options.Ok());
+  const string java = "out/p/IFoo.java";
+  const string dep = "out/p/IFoo.java.d";
+  io_delegate_.SetFileContents("p/IFoo.aidl", "package p; interface IFoo { void f(); }");
+  EXPECT_EQ(0, ::android::aidl::run_task(options, io_delegate_));
+  string java_contents, dep_contents;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents(java, &java_contents));
+  ASSERT_TRUE(io_delegate_.GetWrittenContents(dep, &dep_contents));
+
+  // The next build finds the outputs, which don't change.
+  FakeIoDelegate io_delegate;
+  io_delegate.SetFileContents("p/IFoo.aidl", "package p; interface IFoo { void f(); }");
+  io_delegate.SetFileContents(java, java_contents);
+  io_delegate.SetFileContents(dep, dep_contents);
+  EXPECT_EQ(0, ::android::aidl::run_task(options, io_delegate));
+  EXPECT_FALSE(io_delegate.GetWrittenContents(java, nullptr));
+  EXPECT_FALSE(io_delegate.GetWrittenContents(dep, nullptr));
+
+  io_delegate.SetFileContents("p/IFoo.aidl", "package p; interface IFoo { void g(); }");
+  EXPECT_EQ(0, ::android::aidl::run_task(options, io_delegate));
+  EXPECT_TRUE(io_delegate.GetWrittenContents(java, nullptr));
+  EXPECT_FALSE(io_delegate.GetWrittenContents(dep, nullptr));
+}
+
+TEST_F(AidlTest, GeneratesSeveralLanguagesFromOneParse) {
+  const string inputs = " -I . -a p/IFoo.aidl p/Data.aidl";
+  const string commands[4] = {
+      "aidl --java_out=java --cpp_out=cpp --cpp_header_out=cpp_h --ndk_out=ndk "
+      "--ndk_header_out=ndk_h" + inputs,
+      "aidl --lang=java -o java" + inputs,
+      "aidl --lang=cpp -o cpp -h cpp_h" + inputs,
+      "aidl --lang=ndk -o ndk -h ndk_h" + inputs,
+  };
+  FakeIoDelegate io_delegates[4];
+  for (int i = 0; i < 4; i++) {
+    io_delegates[i].SetFileContents("p/Data.aidl", "package p; parcelable Data { int x; }");
+    io_delegates[i].SetFileContents("p/IFoo.aidl",
+                                    "package p; import p.Data;\n"
+                                    "interface IFoo { Data get(in int[] a, out Data d); }");
+    Options options = Options::From(commands[i]);
+    ASSERT_TRUE(options.Ok()) << options.GetErrorMessage();
+    EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegates[i]));
+  }
+  for (const string file :
+       {"java/p/IFoo.java", "java/p/IFoo.java.d", "java/p/Data.java", "cpp/p/IFoo.cpp",
+        "cpp_h/p/IFoo.h", "cpp_h/p/BpFoo.h", "cpp/p/Data.cpp", "ndk/p/IFoo.cpp",
+        "ndk_h/aidl/p/IFoo.h", "ndk/p/Data.cpp.d"}) {
+    const int single = file.find("java") == 0 ? 1 : file.find("cpp") == 0 ? 2 : 3;
+    string all_languages, one_language;
+    EXPECT_TRUE(io_delegates[0].GetWrittenContents(file, &all_languages)) << file;
+    EXPECT_TRUE(io_delegates[single].GetWrittenContents(file, &one_language)) << file;
+    EXPECT_EQ(one_language, all_languages) << file;
+  }
+}
+
+TEST_F(AidlTest, SeveralLanguagesReportErrorsOfEachLanguage) {
+  // The Java namespace has List types of interfaces, but the C++ one doesn't.
+  io_delegate_.SetFileContents("p/IFoo.aidl",
+                               "package p; interface IFoo { void f(in List<IFoo> l); }");
+  Options cpp_only = Options::From("aidl --lang=cpp -o cpp -h cpp p/IFoo.aidl");
+  CaptureStderr();
+  EXPECT_NE(0, ::android::aidl::compile_aidl(cpp_only, io_delegate_));
+  const string cpp_errors = GetCapturedStderr();
+  EXPECT_FALSE(cpp_errors.empty());
+
+  FakeIoDelegate io_delegate;
+  io_delegate.SetFileContents("p/IFoo.aidl",
+                              "package p; interface IFoo { void f(in List<IFoo> l); }");
+  Options options =
+      Options::From("aidl --java_out=java --cpp_out=cpp --cpp_header_out=cpp p/IFoo.aidl");
+  CaptureStderr();
+  EXPECT_NE(0, ::android::aidl::compile_aidl(options, io_delegate));
+  EXPECT_NE(string::npos, GetCapturedStderr().find(cpp_errors));
+  EXPECT_TRUE(io_delegate.GetWrittenContents("java/p/IFoo.java", nullptr));
+  EXPECT_FALSE(io_delegate.GetWrittenContents("cpp/p/IFoo.cpp", nullptr));
+}
+
+TEST_F(AidlTest, WritesTimeTrace) {
+  io_delegate_.SetFileContents("p/IFoo.aidl",
+                               "package p; import p.Data; interface IFoo { Data get(int x); }");
+  io_delegate_.SetFileContents("p/Data.aidl", "package p; parcelable Data { int x; }");
+  Options options =
+      Options::From("aidl --lang=cpp -o out -h out -I . --time_trace=trace.json p/IFoo.aidl");
+  ASSERT_TRUE(options.Ok());
+  EXPECT_EQ(0, ::android::aidl::run_task(options, io_delegate_));
+
+  string trace;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("trace.json", &trace));
+  EXPECT_EQ(0u, trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  for (const string event : {"\"name\":\"RunTask\"", "\"name\":\"Compile\"",
+                             "\"name\":\"FindImport\",", "\"name\":\"LinkTypes\"",
+                             "\"name\":\"Validate\"", "\"name\":\"BuildAst\"",
+                             "\"name\":\"Emit\"", "\"detail\":\"p.Data\"",
+                             "\"detail\":\"out/p/IFoo.cpp\""}) {
+    EXPECT_NE(string::npos, trace.find(event)) << event;
+  }
+  // The counters of the parse of the input.
+  EXPECT_NE(string::npos,
+            trace.find("\"args\":{\"detail\":\"p/IFoo.aidl\",\"bytes\":61,\"tokens\":20,"
+                       "\"types\":1}"));
+
+  // Nothing is recorded without the option.
+  FakeIoDelegate io_delegate;
+  io_delegate.SetFileContents("p/IFoo.aidl", "package p; interface IFoo { void f(); }");
+  Options untraced = Options::From("aidl --lang=cpp -o out -h out p/IFoo.aidl");
+  EXPECT_EQ(0, ::android::aidl::run_task(untraced, io_delegate));
+  EXPECT_FALSE(io_delegate.GetWrittenContents("trace.json", nullptr));
+}
+
+TEST_F(AidlTest, SyntheticCorpusOnlyDependsOnSeedAndConfig) {
+  CorpusConfig config;
+  string error;
+  ASSERT_TRUE(config.Parse("# A chain of parcelables\n"
+                           "seed = 3\n"
+                           "\n"
+                           "parcelables = 5\n"
+                           "import_chain = true\n",
+                           &error))
+      << error;
+  const Corpus corpus = GenerateCorpus(config);
+  EXPECT_EQ(corpus.files, GenerateCorpus(config).files);
+  EXPECT_EQ(vector<string>{"corpus/p0/IService0.aidl"}, corpus.interface_files);
+  EXPECT_NE(string::npos, corpus.files.at("corpus/p0/Data4.aidl").find("Data3 field0;"));
+
+  CorpusConfig other_seed = config;
+  other_seed.seed = 4;
+  EXPECT_NE(corpus.files, GenerateCorpus(other_seed).files);
+
+  EXPECT_FALSE(config.Parse("methods = 3", &error));
+  EXPECT_EQ("line 1: unknown key: methods", error);
+  EXPECT_FALSE(config.Set("import_chain", "yes", &error));
+  config.min_methods = 5;
+  config.max_methods = 4;
+  EXPECT_FALSE(config.Validate(&error));
+  EXPECT_EQ("min_methods must not be greater than max_methods", error);
+}
+
+TEST_F(AidlTest, CompilesSyntheticCorpus) {
+  // More methods than the threshold of the outlining of onTransact in Java.
+  CorpusConfig config;
+  config.min_methods = 300;
+  config.max_methods = 300;
+  config.parcelables = 20;
+  config.import_chain = true;
+  config.packages = 3;
+  config.preprocessed_entries = 100;
+  const Corpus corpus = GenerateCorpus(config);
+  for (const auto& file : corpus.files) {
+    io_delegate_.SetFileContents(file.first, file.second);
+  }
+  Options options = Options::From(
+      "aidl --java_out=java --cpp_out=cpp --cpp_header_out=cpp_h --ndk_out=ndk "
+      "--ndk_header_out=ndk_h -I . -p preprocessed.aidl " +
+      android::base::Join(corpus.interface_files, " "));
+  ASSERT_TRUE(options.Ok()) << options.GetErrorMessage();
+  EXPECT_EQ(0, ::android::aidl::compile_aidl(options, io_delegate_));
+
+  string java;
+  ASSERT_TRUE(io_delegate_.GetWrittenContents("java/corpus/p0/IService0.java", &java));
+  EXPECT_NE(string::npos, java.find("onTransact$method"));
+  EXPECT_TRUE(io_delegate_.GetWrittenContents("cpp/corpus/p0/IService0.cpp", nullptr));
+  EXPECT_TRUE(io_delegate_.GetWrittenContents("ndk/corpus/p0/IService0.cpp", nullptr));
+}
+
+TEST_F(AidlTest, RejectsInvalidNumberOfJobs) {
+  EXPECT_FALSE(Options::From("aidl --lang=java -o out -j 0 IFoo.aidl").Ok());
+  EXPECT_TRUE(Options::From("aidl --lang=java -o out --jobs=2 IFoo.aidl").Ok());
+}
+
 TEST_F(AidlTest, ConflictWithMetaTransactions) {
   Options options = Options::From("aidl --lang=java -o place/for/output p/IFoo.aidl");
   // int getInterfaceVersion() is one of the meta transactions
@@ -864,6 +2098,38 @@ TEST_F(AidlTest, SuccessOnIdenticalApiDumps) {
   EXPECT_TRUE(::android::aidl::check_api(options, io_delegate_));
 }
 
+TEST_F(AidlTest, CheckApiParsesOneOfDumpsThatOnlyDifferByComments) {
+  Options options = Options::From("aidl --checkapi old new");
+  io_delegate_.SetFileContents("old/p/IFoo.aidl",
+                               "// Frozen.\n"
+                               "\n"
+                               "package p; interface IFoo{ void foo();}\n");
+  io_delegate_.SetFileContents("new/p/IFoo.aidl", "package p; interface IFoo{ void foo();}\n");
+  EXPECT_TRUE(::android::aidl::check_api(options, io_delegate_));
+  // Equal dumps are still parsed, but only the first one.
+  io_delegate_.SetFileContents("old/p/IFoo.aidl",
+                               "// Frozen.\n"
+                               "package p; interface IFoo{ void foo(); \n");
+  io_delegate_.SetFileContents("new/p/IFoo.aidl", "package p; interface IFoo{ void foo(); \n");
+  CaptureStderr();
+  EXPECT_FALSE(::android::aidl::check_api(options, io_delegate_));
+  const string errors = GetCapturedStderr();
+  EXPECT_NE(string::npos, errors.find("old/p/IFoo.aidl")) << errors;
+  EXPECT_EQ(string::npos, errors.find("new/p/IFoo.aidl")) << errors;
+
+  // Otherwise, they are parsed and compared.
+  io_delegate_.SetFileContents("old/p/IFoo.aidl",
+                               "// Frozen.\n"
+                               "package p; interface IFoo{ void foo();}\n");
+  io_delegate_.SetFileContents("new/p/IFoo.aidl", "package p; interface IFoo{ void bar();}\n");
+  EXPECT_FALSE(::android::aidl::check_api(options, io_delegate_));
+  io_delegate_.SetFileContents("new/p/IFoo.aidl", "package p;\ninterface IFoo{ void foo();}\n");
+  EXPECT_TRUE(::android::aidl::check_api(options, io_delegate_));
+  // A file of one dump that the other doesn't have isn't skipped either.
+  io_delegate_.SetFileContents("new/p/IBar.aidl", "package p; interface IBar{ void bar( }\n");
+  EXPECT_FALSE(::android::aidl::check_api(options, io_delegate_));
+}
+
 TEST_F(AidlTest, SuccessOnCompatibleChanges) {
   Options options = Options::From("aidl --checkapi old new");
   io_delegate_.SetFileContents("old/p/IFoo.aidl",
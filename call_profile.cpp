@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "call_profile.h"
+
+#include <algorithm>
+
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+
+using android::base::ParseUint;
+using android::base::Split;
+using android::base::Trim;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace aidl {
+
+unique_ptr<CallProfile> CallProfile::Load(const string& filename, const IoDelegate& io_delegate) {
+  unique_ptr<string> contents = io_delegate.GetFileContents(filename);
+  if (contents == nullptr) {
+    AIDL_ERROR(filename) << "Failed to read the profile.";
+    return nullptr;
+  }
+  return Parse(filename, *contents);
+}
+
+unique_ptr<CallProfile> CallProfile::Parse(const string& filename, const string& contents) {
+  unique_ptr<CallProfile> profile(new CallProfile);
+  int line_number = 0;
+  for (const string& raw_line : Split(contents, "\n")) {
+    line_number++;
+    const string line = Trim(raw_line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    vector<string> fields = Split(line, " \t");
+    fields.erase(std::remove(fields.begin(), fields.end(), ""), fields.end());
+    if (fields.size() != 3) {
+      AIDL_ERROR(filename) << "line " << line_number << ": expected <interface> <method> <calls>";
+      return nullptr;
+    }
+    uint64_t calls = 0;
+    if (!ParseUint(fields[2], &calls)) {
+      AIDL_ERROR(filename) << "line " << line_number << ": invalid number of calls: "
+                           << fields[2];
+      return nullptr;
+    }
+    profile->calls_[fields[0]][fields[1]] += calls;
+  }
+  return profile;
+}
+
+bool CallProfile::Covers(const AidlInterface& interface) const {
+  return calls_.count(interface.GetCanonicalName()) != 0;
+}
+
+uint64_t CallProfile::Calls(const AidlInterface& interface, const AidlMethod& method) const {
+  auto methods = calls_.find(interface.GetCanonicalName());
+  if (methods == calls_.end()) {
+    return 0;
+  }
+  auto calls = methods->second.find(method.GetName());
+  return calls != methods->second.end() ? calls->second : 0;
+}
+
+std::set<const AidlMethod*> CallProfile::ColdMethods(const AidlInterface& interface) const {
+  if (!Covers(interface)) {
+    return {};
+  }
+  vector<const AidlMethod*> methods;
+  uint64_t total_calls = 0;
+  for (const AidlMethod* method : MethodsByCalls(interface, this)) {
+    if (method->IsUserDefined()) {
+      methods.push_back(method);
+      total_calls += Calls(interface, *method);
+    }
+  }
+
+  // The hot methods are the fewest that make up kHotCallPercent of the calls.
+  std::set<const AidlMethod*> cold_methods;
+  uint64_t hot_calls = 0;
+  for (const AidlMethod* method : methods) {
+    const uint64_t calls = Calls(interface, *method);
+    if (calls == 0 || hot_calls * 100 >= total_calls * kHotCallPercent) {
+      cold_methods.insert(method);
+    }
+    hot_calls += calls;
+  }
+  return cold_methods;
+}
+
+vector<const AidlMethod*> MethodsByCalls(const AidlInterface& interface,
+                                         const CallProfile* profile) {
+  vector<const AidlMethod*> methods;
+  methods.reserve(interface.GetMethods().size());
+  for (const auto& method : interface.GetMethods()) {
+    methods.push_back(method.get());
+  }
+  if (profile != nullptr && profile->Covers(interface)) {
+    std::stable_sort(methods.begin(), methods.end(),
+                     [&](const AidlMethod* m1, const AidlMethod* m2) {
+                       return profile->Calls(interface, *m1) > profile->Calls(interface, *m2);
+                     });
+  }
+  return methods;
+}
+
+}  // namespace aidl
+}  // namespace android
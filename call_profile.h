@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "aidl_language.h"
+#include "io_delegate.h"
+
+namespace android {
+namespace aidl {
+
+// How often the methods of interfaces are called, as given by --profile. The
+// generators use it to keep the stubs of the methods that are called most
+// compact and first, and to move the others out of line.
+//
+// A profile is a text file with one "<interface> <method> <calls>" per line,
+// e.g. "android.os.IServiceManager getService 12345", where the interface is
+// its canonical name. The calls of the lines that name the same method add
+// up, so that profiles can be concatenated. Empty lines and lines starting
+// with '#' are ignored.
+class CallProfile {
+ public:
+  // Reads the profile in |filename|. Returns nullptr, after reporting the
+  // error, if it can't be read or parsed.
+  static std::unique_ptr<CallProfile> Load(const std::string& filename,
+                                           const IoDelegate& io_delegate);
+  // Parses |contents|, which |filename| is only used to report errors for.
+  static std::unique_ptr<CallProfile> Parse(const std::string& filename,
+                                            const std::string& contents);
+
+  // True if the profile has lines for methods of |interface|. Otherwise
+  // nothing is known about it, and its stubs are generated as without profile.
+  bool Covers(const AidlInterface& interface) const;
+  // Number of calls to |method| of |interface| in the profile.
+  uint64_t Calls(const AidlInterface& interface, const AidlMethod& method) const;
+  // The user-defined methods of |interface| that aren't needed to account for
+  // kHotCallPercent percent of its calls, taking the methods that are called
+  // most first. Those that the profile has no calls to are always in. Empty
+  // if the profile doesn't cover |interface|.
+  std::set<const AidlMethod*> ColdMethods(const AidlInterface& interface) const;
+
+  static constexpr int kHotCallPercent = 99;
+
+ private:
+  CallProfile() = default;
+
+  // Calls of each method, keyed by the canonical name of the interface and
+  // then by the name of the method.
+  std::map<std::string, std::map<std::string, uint64_t>> calls_;
+};
+
+// The methods of |interface|, most called first according to |profile|, and
+// in the order of their declaration otherwise. Without a profile, or if it
+// doesn't cover |interface|, that is the order of their declaration.
+std::vector<const AidlMethod*> MethodsByCalls(const AidlInterface& interface,
+                                              const CallProfile* profile);
+
+}  // namespace aidl
+}  // namespace android
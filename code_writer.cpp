@@ -16,58 +16,103 @@
 #include "code_writer.h"
 
 #include <stdarg.h>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-#include <vector>
+#include <string.h>
+
+#include <utility>
 
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
+#include "time_trace.h"
+
 namespace android {
 namespace aidl {
 
-CodeWriter::CodeWriter(std::unique_ptr<std::ostream> ostream) : ostream_(std::move(ostream)) {}
+namespace {
+
+// Output is written to files in chunks of about this size.
+constexpr size_t kFlushSize = 64 * 1024;
 
-std::string CodeWriter::ApplyIndent(const std::string& str) {
-  std::string output;
-  if (!start_of_line_ || str == "\n") {
-    output = str;
+}  // namespace
+
+CodeWriter::CodeWriter(FILE* file, bool close_file) : file_(file), close_file_(close_file) {
+  if (file_ == nullptr) {
+    failed_ = true;
   } else {
-    output = std::string(indent_level_ * 2, ' ') + str;
+    // The buffering of the FILE is left alone: it may be stdout, which the
+    // rest of the process writes to as well.
+    own_buffer_.reserve(kFlushSize * 2);
   }
-  start_of_line_ = !output.empty() && output.back() == '\n';
-  return output;
 }
 
-bool CodeWriter::Write(const char* format, ...) {
-  va_list ap;
-  va_start(ap, format);
-  std::string formatted;
-  android::base::StringAppendV(&formatted, format, ap);
-  va_end(ap);
+CodeWriter::CodeWriter(std::string* buf) : buffer_(buf), is_string_(true) {
+  buffer_->clear();
+}
 
-  // extract lines. empty line is preserved.
-  std::vector<std::string> lines;
-  size_t pos = 0;
-  while (pos < formatted.size()) {
-    size_t line_end = formatted.find('\n', pos);
-    if (line_end != std::string::npos) {
-      lines.push_back(formatted.substr(pos, (line_end - pos) + 1));
-      pos = line_end + 1;
-    } else {
-      lines.push_back(formatted.substr(pos));
-      break;
+CodeWriter::CodeWriter(std::function<bool(const std::string&)> commit)
+    : is_string_(true), commit_(std::move(commit)) {}
+
+CodeWriter::~CodeWriter() {
+  if (commit_) {
+    Close();
+  }
+  if (file_ != nullptr) {
+    Flush(true);
+    if (close_file_) {
+      fclose(file_);
     }
   }
+}
 
-  std::string indented;
-  for (const auto& line : lines) {
-    indented.append(ApplyIndent(line));
+void CodeWriter::Append(const char* data, size_t size) {
+  const char* const end = data + size;
+  while (data < end) {
+    const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+    const char* line_end = newline != nullptr ? newline + 1 : end;
+    // Empty lines are not indented.
+    if (start_of_line_ && *data != '\n') {
+      buffer_->append(indent_level_ * 2, ' ');
+    }
+    buffer_->append(data, line_end - data);
+    start_of_line_ = newline != nullptr;
+    data = line_end;
   }
+}
 
-  (*ostream_) << indented;
-  return !ostream_->fail();
+bool CodeWriter::Flush(bool all) {
+  if (is_string_ || (!all && buffer_->size() < kFlushSize)) {
+    return !failed_;
+  }
+  if (!buffer_->empty()) {
+    TimeTrace::Scope trace("WriteFile");
+    trace.Count("bytes", buffer_->size());
+    // The file is null if it is closed already, or if there is none.
+    if (file_ == nullptr || fwrite(buffer_->data(), 1, buffer_->size(), file_) != buffer_->size()) {
+      failed_ = true;
+    }
+    buffer_->clear();
+  }
+  return !failed_;
+}
+
+bool CodeWriter::Write(const char* format, ...) {
+  if (strchr(format, '%') == nullptr) {
+    Append(format, strlen(format));
+    return Flush(false);
+  }
+  va_list ap;
+  va_start(ap, format);
+  formatted_.clear();
+  android::base::StringAppendV(&formatted_, format, ap);
+  va_end(ap);
+
+  Append(formatted_.data(), formatted_.size());
+  return Flush(false);
+}
+
+bool CodeWriter::WriteRaw(const std::string& data) {
+  buffer_->append(data);
+  return Flush(false);
 }
 
 void CodeWriter::Indent() {
@@ -80,55 +125,52 @@ void CodeWriter::Dedent() {
 }
 
 bool CodeWriter::Close() {
-  if (ostream_.get()->rdbuf() != std::cout.rdbuf()) {
-    // if the steam is for file (not stdout), do the close.
-    static_cast<std::fstream*>(ostream_.get())->close();
-    return !ostream_->fail();
+  if (commit_) {
+    TimeTrace::Scope trace("WriteFile");
+    trace.Count("bytes", buffer_->size());
+    if (!failed_ && !commit_(*buffer_)) {
+      failed_ = true;
+    }
+    commit_ = nullptr;
+    return !failed_;
+  }
+  if (file_ == nullptr) {
+    return Flush(true);
   }
-  return true;
+  Flush(true);
+  TimeTrace::Scope trace("CloseFile");
+  if ((close_file_ ? fclose(file_) : fflush(file_)) != 0) {
+    failed_ = true;
+  }
+  file_ = nullptr;
+  return !failed_;
 }
 
 CodeWriter& CodeWriter::operator<<(const char* s) {
-  Write(s);
+  Append(s, strlen(s));
+  Flush(false);
   return *this;
 }
 
 CodeWriter& CodeWriter::operator<<(const std::string& str) {
-  Write(str.c_str());
+  Append(str.data(), str.size());
+  Flush(false);
   return *this;
 }
 
 CodeWriterPtr CodeWriter::ForFile(const std::string& filename) {
-  std::unique_ptr<std::ostream> stream;
   if (filename == "-") {
-    stream = std::unique_ptr<std::ostream>(new std::ostream(std::cout.rdbuf()));
-  } else {
-    stream = std::unique_ptr<std::ostream>(
-        new std::fstream(filename, std::fstream::out | std::fstream::binary));
+    return CodeWriterPtr(new CodeWriter(stdout, false /* close_file */));
   }
-  return CodeWriterPtr(new CodeWriter(std::move(stream)));
+  return CodeWriterPtr(new CodeWriter(fopen(filename.c_str(), "wb"), true /* close_file */));
 }
 
 CodeWriterPtr CodeWriter::ForString(std::string* buf) {
-  // This class is defined inside this static function of CodeWriter
-  // in order to have access to private constructor and private member
-  // ostream_.
-  class StringCodeWriter : public CodeWriter {
-   public:
-    StringCodeWriter(std::string* buf)
-        : CodeWriter(std::unique_ptr<std::ostream>(new std::stringstream())), buf_(buf) {}
-    ~StringCodeWriter() override { Close(); }
-    bool Close() override {
-      // extract whats written to the stringstream to the external buffer.
-      // we are sure that ostream_ is indeed stringstream.
-      *buf_ = static_cast<std::stringstream*>(ostream_.get())->str();
-      return true;
-    }
+  return CodeWriterPtr(new CodeWriter(buf));
+}
 
-   private:
-    std::string* buf_;
-  };
-  return CodeWriterPtr(new StringCodeWriter(buf));
+CodeWriterPtr CodeWriter::ForCommit(std::function<bool(const std::string&)> commit) {
+  return CodeWriterPtr(new CodeWriter(std::move(commit)));
 }
 
 }  // namespace aidl
@@ -16,10 +16,11 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
-#include <ostream>
 #include <string>
 
+#include <stddef.h>
 #include <stdio.h>
 
 #include <android-base/macros.h>
@@ -30,33 +31,66 @@ namespace aidl {
 class CodeWriter;
 using CodeWriterPtr = std::unique_ptr<CodeWriter>;
 
+// Writes generated code. The output is indented as it is appended to a
+// single buffer, which is written to the file in large chunks.
 class CodeWriter {
  public:
   // Get a CodeWriter that writes to a file. When filename is "-",
   // it is written to stdout.
   static CodeWriterPtr ForFile(const std::string& filename);
   // Get a CodeWriter that writes to a string buffer.
-  // The buffer gets updated only after Close() is called or the CodeWriter
-  // is deleted -- much like a real file.
+  // The buffer is cleared, and holds everything written so far once Close()
+  // is called or the CodeWriter is deleted -- much like a real file.
   static CodeWriterPtr ForString(std::string* buf);
+  // Get a CodeWriter that keeps everything in memory, and hands it to
+  // |commit| once, when Close() is called or the CodeWriter is deleted.
+  // Close() fails if |commit| returns false.
+  static CodeWriterPtr ForCommit(std::function<bool(const std::string&)> commit);
   // Write a formatted string to this writer in the usual printf sense.
   // Returns false on error.
   virtual bool Write(const char* format, ...);
+  // Write |data| as it is, without formatting or indentation. This is used
+  // for binary output. Returns false on error.
+  virtual bool WriteRaw(const std::string& data);
   void Indent();
   void Dedent();
   virtual bool Close();
-  virtual ~CodeWriter() = default;
+  virtual ~CodeWriter();
+  // What is written to a CodeWriter made this way is thrown away. This is
+  // for subclasses that override the methods above.
   CodeWriter() = default;
 
+  // Write |s| as it is, but indented. Unlike Write(), there is no formatting.
   CodeWriter& operator<<(const char* s);
   CodeWriter& operator<<(const std::string& str);
 
  private:
-  CodeWriter(std::unique_ptr<std::ostream> ostream);
-  std::string ApplyIndent(const std::string& str);
-  const std::unique_ptr<std::ostream> ostream_;
+  CodeWriter(FILE* file, bool close_file);
+  explicit CodeWriter(std::string* buf);
+  explicit CodeWriter(std::function<bool(const std::string&)> commit);
+  // Appends the |size| bytes at |data| to the buffer, indenting each line
+  // that they start.
+  void Append(const char* data, size_t size);
+  // Writes out the buffer to the file if it has grown enough, or if |all|.
+  // Returns false if there was an error so far.
+  bool Flush(bool all);
+
+  FILE* file_ = nullptr;
+  const bool close_file_ = false;
+  // The output that isn't written out yet. This is the string given to
+  // ForString(), which isn't written out at all.
+  std::string own_buffer_;
+  std::string* const buffer_ = &own_buffer_;
+  const bool is_string_ = false;
+  // Set until the output is committed, for a CodeWriter made by ForCommit().
+  std::function<bool(const std::string&)> commit_;
+  // Scratch space for Write() to format into, reused across calls.
+  std::string formatted_;
   int indent_level_ {0};
   bool start_of_line_ {true};
+  bool failed_ {false};
+
+  DISALLOW_COPY_AND_ASSIGN(CodeWriter);
 };
 
 }  // namespace aidl
@@ -16,9 +16,13 @@
 
 #include "code_writer.h"
 
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 #include <string>
 
+#include <android-base/file.h>
+
 using android::aidl::CodeWriter;
 using std::string;
 using std::unique_ptr;
@@ -44,5 +48,76 @@ TEST(CodeWriterTest, AppendOperatorCascade) {
   EXPECT_EQ(str, "Write this and that");
 }
 
+TEST(CodeWriterTest, IndentsLines) {
+  string str;
+  CodeWriterPtr ptr = CodeWriter::ForString(&str);
+  CodeWriter& writer = *ptr;
+  writer << "a {\n";
+  writer.Indent();
+  writer << "b" << "c\n\n";
+  writer.Write("d(%d);\ne", 1);
+  writer.Dedent();
+  writer << ";\n}\n";
+  writer.Close();
+  EXPECT_EQ(str, "a {\n  bc\n\n  d(1);\n  e;\n}\n");
+}
+
+TEST(CodeWriterTest, AppendOperatorDoesNotFormat) {
+  string str;
+  CodeWriterPtr ptr = CodeWriter::ForString(&str);
+  CodeWriter& writer = *ptr;
+  writer << "100%" << string("%s%%");
+  writer.Write("%d%%", 5);
+  writer.Close();
+  EXPECT_EQ(str, "100%%s%%5%");
+}
+
+TEST(CodeWriterTest, WritesLargeFiles) {
+  const string path = testing::TempDir() + "/code_writer_large_file";
+  string expected;
+  {
+    CodeWriterPtr writer = CodeWriter::ForFile(path);
+    writer->Indent();
+    for (int i = 0; i < 20000; i++) {
+      writer->Write("line %d\n", i);
+      expected += "  line " + std::to_string(i) + "\n";
+    }
+    EXPECT_TRUE(writer->Close());
+  }
+  string written;
+  EXPECT_TRUE(android::base::ReadFileToString(path, &written));
+  EXPECT_EQ(expected, written);
+  unlink(path.c_str());
+}
+
+TEST(CodeWriterTest, CommitsOnce) {
+  int commits = 0;
+  string committed;
+  auto commit = [&](const string& contents) {
+    commits++;
+    committed = contents;
+    return contents != "fail";
+  };
+  {
+    CodeWriterPtr writer = CodeWriter::ForCommit(commit);
+    writer->Indent();
+    writer->Write("a\n");
+    EXPECT_EQ(0, commits);
+    EXPECT_TRUE(writer->Close());
+    EXPECT_TRUE(writer->Close());
+  }
+  EXPECT_EQ(1, commits);
+  EXPECT_EQ("  a\n", committed);
+
+  // Deleting the writer commits as well.
+  CodeWriter::ForCommit(commit)->Write("b");
+  EXPECT_EQ(2, commits);
+  EXPECT_EQ("b", committed);
+
+  CodeWriterPtr writer = CodeWriter::ForCommit(commit);
+  writer->Write("fail");
+  EXPECT_FALSE(writer->Close());
+}
+
 }  // namespace aidl
 }  // namespace android
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flight_recorder.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include "logging.h"
+
+using android::base::Split;
+using android::base::StringPrintf;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace aidl {
+
+const char kFlightRecorderMagic[] = "AIDLFR01";
+
+size_t FlightRecordWords(size_t arg_bytes) {
+  return arg_bytes == 0 ? 4 : 5 + (arg_bytes + 7) / 8;
+}
+
+namespace {
+
+// Reads the little-endian integers of a dump, as long as it doesn't end.
+class DumpReader {
+ public:
+  explicit DumpReader(const string& contents) : contents_(contents) {}
+
+  bool Read(size_t size, uint64_t* value) {
+    if (contents_.size() - position_ < size) {
+      return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < size; i++) {
+      *value |= uint64_t(uint8_t(contents_[position_ + i])) << (8 * i);
+    }
+    position_ += size;
+    return true;
+  }
+  bool Read32(uint32_t* value) {
+    uint64_t value64;
+    if (!Read(4, &value64)) {
+      return false;
+    }
+    *value = uint32_t(value64);
+    return true;
+  }
+  bool ReadString(size_t size, string* value) {
+    if (contents_.size() - position_ < size) {
+      return false;
+    }
+    *value = contents_.substr(position_, size);
+    position_ += size;
+    return true;
+  }
+  bool AtEnd() const { return position_ == contents_.size(); }
+
+ private:
+  const string& contents_;
+  size_t position_ = 0;
+};
+
+}  // namespace
+
+bool ParseFlightRecorderDump(const string& contents, FlightRecorderDump* dump, string* error) {
+  DumpReader reader(contents);
+  const size_t magic_size = strlen(kFlightRecorderMagic);
+  string magic;
+  if (!reader.ReadString(magic_size, &magic) || magic != kFlightRecorderMagic) {
+    *error = "not a dump of a flight recorder";
+    return false;
+  }
+  uint32_t descriptor_size;
+  uint32_t method_count;
+  if (!reader.Read32(&dump->arg_bytes) || !reader.Read32(&descriptor_size) ||
+      !reader.ReadString(descriptor_size, &dump->descriptor) || !reader.Read32(&method_count)) {
+    *error = "truncated header";
+    return false;
+  }
+  for (uint32_t i = 0; i < method_count; i++) {
+    uint32_t code;
+    uint32_t name_size;
+    string name;
+    if (!reader.Read32(&code) || !reader.Read32(&name_size) ||
+        !reader.ReadString(name_size, &name)) {
+      *error = "truncated methods";
+      return false;
+    }
+    dump->methods[code] = name;
+  }
+
+  uint32_t record_count;
+  if (!reader.Read32(&record_count)) {
+    *error = "truncated header";
+    return false;
+  }
+  const size_t words = FlightRecordWords(dump->arg_bytes);
+  for (uint32_t i = 0; i < record_count; i++) {
+    // The index and the words of the record.
+    vector<uint64_t> values(1 + words);
+    for (uint64_t& value : values) {
+      if (!reader.Read(8, &value)) {
+        *error = StringPrintf("truncated record %u", i);
+        return false;
+      }
+    }
+    FlightRecorderDump::Record record;
+    record.index = values[0];
+    record.code = uint32_t(values[1]);
+    record.status = int32_t(uint32_t(values[1] >> 32));
+    record.start_ns = values[2];
+    record.duration_ns = values[3];
+    record.data_size = uint32_t(values[4]);
+    record.reply_size = uint32_t(values[4] >> 32);
+    if (dump->arg_bytes > 0) {
+      const size_t arg_size = std::min<uint64_t>(values[5], dump->arg_bytes);
+      for (size_t j = 0; j < arg_size; j++) {
+        record.args.push_back(char(values[6 + j / 8] >> (8 * (j % 8))));
+      }
+    }
+    dump->records.push_back(std::move(record));
+  }
+  if (!reader.AtEnd()) {
+    *error = "trailing bytes";
+    return false;
+  }
+  return true;
+}
+
+string FormatFlightRecords(const FlightRecorderDump& dump, const vector<string>& mappings) {
+  // The signature and location of each method, by "<interface>|<method>|",
+  // the start of the signature.
+  std::map<string, std::pair<string, string>> methods;
+  for (const string& contents : mappings) {
+    const vector<string> lines = Split(contents, "\n");
+    for (size_t i = 0; i + 1 < lines.size(); i += 2) {
+      const vector<string> fields = Split(lines[i], "|");
+      if (fields.size() >= 2) {
+        methods[fields[0] + "|" + fields[1] + "|"] = {lines[i], lines[i + 1]};
+      }
+    }
+  }
+
+  string result;
+  for (const auto& record : dump.records) {
+    string method;
+    auto name = dump.methods.find(record.code);
+    if (name == dump.methods.end()) {
+      method = StringPrintf("%s code %u", dump.descriptor.c_str(), record.code);
+    } else {
+      auto mapping = methods.find(dump.descriptor + "|" + name->second + "|");
+      if (mapping == methods.end()) {
+        method = dump.descriptor + "|" + name->second;
+      } else {
+        method = mapping->second.first + " (" + mapping->second.second + ")";
+      }
+    }
+    result += StringPrintf("#%llu %s status=%d start=%lluns duration=%lluns data=%u reply=%u",
+                           static_cast<unsigned long long>(record.index), method.c_str(),
+                           record.status, static_cast<unsigned long long>(record.start_ns),
+                           static_cast<unsigned long long>(record.duration_ns), record.data_size,
+                           record.reply_size);
+    if (dump.arg_bytes > 0) {
+      result += " args=";
+      for (char c : record.args) {
+        result += StringPrintf("%02x", uint8_t(c));
+      }
+    }
+    result += "\n";
+  }
+  return result;
+}
+
+bool decode_flight_recorder(const Options& options, const IoDelegate& io_delegate) {
+  vector<string> mappings;
+  for (const string& filename : options.MappingFiles()) {
+    unique_ptr<string> contents = io_delegate.GetFileContents(filename);
+    if (contents == nullptr) {
+      LOG(ERROR) << "Failed to read the mappings in " << filename;
+      return false;
+    }
+    mappings.push_back(std::move(*contents));
+  }
+
+  string result;
+  for (const string& filename : options.InputFiles()) {
+    unique_ptr<string> contents = io_delegate.GetFileContents(filename);
+    if (contents == nullptr) {
+      LOG(ERROR) << "Failed to read the dump in " << filename;
+      return false;
+    }
+    FlightRecorderDump dump;
+    string error;
+    if (!ParseFlightRecorderDump(*contents, &dump, &error)) {
+      LOG(ERROR) << filename << ": " << error;
+      return false;
+    }
+    result += FormatFlightRecords(dump, mappings);
+  }
+  CodeWriterPtr writer = io_delegate.GetCodeWriter(options.OutputFile());
+  return writer != nullptr && writer->WriteRaw(result) && writer->Close();
+}
+
+}  // namespace aidl
+}  // namespace android
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "io_delegate.h"
+#include "options.h"
+
+namespace android {
+namespace aidl {
+
+// With --flight_recorder, each stub keeps the records of its last transactions
+// in a ring buffer, which the generated dumpFlightRecorder writes out. A dump
+// is, with all the integers in little endian:
+//
+//   the magic "AIDLFR01"
+//   u32 the number of argument bytes of each record, see
+//       --flight_recorder_arg_bytes
+//   u32 the length of the descriptor of the interface, and the descriptor
+//   u32 the number of methods, and for each of them:
+//       u32 its transaction code
+//       u32 the length of its name, and the name
+//   u32 the number of records, and for each of them, oldest first:
+//       u64 its index, which counts the transactions of the stub
+//       u64 the transaction code, and the status in the upper 32 bits
+//       u64 when the transaction started, in ns of the monotonic clock
+//       u64 how long it took, in ns
+//       u64 the size of the data parcel, and of the reply in the upper 32 bits
+//   and only if there are argument bytes:
+//       u64 the number of argument bytes that were kept
+//       the argument bytes, padded to a multiple of 8
+//
+// The methods are in the dump because the mappings of --apimapping, which
+// tell where they are declared, don't have the transaction codes.
+extern const char kFlightRecorderMagic[];
+
+// Number of u64 words of a record after its index, with |arg_bytes| argument
+// bytes.
+size_t FlightRecordWords(size_t arg_bytes);
+
+// A dump of the flight recorder of a stub.
+struct FlightRecorderDump {
+  struct Record {
+    uint64_t index;
+    uint32_t code;
+    int32_t status;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint32_t data_size;
+    uint32_t reply_size;
+    std::string args;
+  };
+
+  std::string descriptor;
+  uint32_t arg_bytes = 0;
+  // The names of the methods, by transaction code.
+  std::map<uint32_t, std::string> methods;
+  std::vector<Record> records;
+};
+
+// Parses the dump in |contents|. Returns false, with the reason in |error|, if
+// it isn't a valid dump.
+bool ParseFlightRecorderDump(const std::string& contents, FlightRecorderDump* dump,
+                             std::string* error);
+
+// Formats the records of |dump|, one per line. |mappings| are the contents of
+// the files written by --apimapping, which give the signatures and locations
+// of the methods.
+std::string FormatFlightRecords(const FlightRecorderDump& dump,
+                                const std::vector<std::string>& mappings);
+
+// Decodes the dumps in the input files of |options| into its output file.
+bool decode_flight_recorder(const Options& options, const IoDelegate& io_delegate);
+
+}  // namespace aidl
+}  // namespace android
@@ -29,9 +29,11 @@
 #include "aidl_language.h"
 #include "aidl_to_cpp.h"
 #include "ast_cpp.h"
+#include "call_profile.h"
 #include "code_writer.h"
 #include "logging.h"
 #include "os.h"
+#include "time_trace.h"
 
 using android::base::Join;
 using android::base::StringPrintf;
@@ -56,6 +58,7 @@ const char kReplyVarName[] = "_aidl_reply";
 const char kReturnVarName[] = "_aidl_return";
 const char kStatusVarName[] = "_aidl_status";
 const char kTraceVarName[] = "_aidl_trace";
+const char kTransactionTableName[] = "_aidl_transaction_table";
 const char kAndroidParcelLiteral[] = "::android::Parcel";
 const char kAndroidStatusLiteral[] = "::android::status_t";
 const char kAndroidStatusOk[] = "::android::OK";
@@ -246,6 +249,10 @@ unique_ptr<Declaration> DefineClientTransaction(const TypeNamespace& types,
                              kAndroidStatusOk));
   // We unconditionally return a Status object.
   b->AddLiteral(StringPrintf("%s %s", kBinderStatusLiteral, kStatusVarName));
+  // Declared before the first goto, which can't jump over its initialization.
+  if (options.GenTransactionStats()) {
+    b->AddLiteral("uint64_t _aidl_stats_start = 0");
+  }
 
   if (options.GenTraces()) {
     b->AddLiteral(
@@ -254,7 +261,8 @@ unique_ptr<Declaration> DefineClientTransaction(const TypeNamespace& types,
   }
 
   if (options.GenLog()) {
-    b->AddLiteral(GenLogBeforeExecute(bp_name, method, false /* isServer */, false /* isNdk */),
+    b->AddLiteral(GenLogBeforeExecute(bp_name, method, false /* isServer */, false /* isNdk */,
+                                      options),
                   false /* no semicolon */);
   }
 
@@ -303,10 +311,19 @@ unique_ptr<Declaration> DefineClientTransaction(const TypeNamespace& types,
     args.push_back("::android::IBinder::FLAG_ONEWAY");
   }
 
+  if (options.GenTransactionStats()) {
+    b->AddLiteral("_aidl_stats_start = _aidl_stats_now()");
+  }
   b->AddStatement(new Assignment(
       kAndroidStatusVarName,
       new MethodCall("remote()->transact",
                      ArgList(args))));
+  if (options.GenTransactionStats()) {
+    b->AddLiteral(StringPrintf("_aidl_stats_record(&%s, _aidl_stats_now() - _aidl_stats_start, "
+                               "%s.dataSize(), %s.dataSize(), %s != ::android::OK)",
+                               TransactionStatsOf(interface, method, false /* isServer */).c_str(),
+                               kDataVarName, kReplyVarName, kAndroidStatusVarName));
+  }
 
   // If the method is not implemented in the remote side, try to call the
   // default implementation, if provided.
@@ -339,6 +356,11 @@ unique_ptr<Declaration> DefineClientTransaction(const TypeNamespace& types,
     IfStatement* exception_check = new IfStatement(
         new LiteralExpression(StringPrintf("!%s.isOk()", kStatusVarName)));
     b->AddStatement(exception_check);
+    if (options.GenTransactionStats()) {
+      exception_check->OnTrue()->AddLiteral(
+          StringPrintf("%s.exceptions.fetch_add(1, std::memory_order_relaxed)",
+                       TransactionStatsOf(interface, method, false /* isServer */).c_str()));
+    }
     exception_check->OnTrue()->AddLiteral(
         StringPrintf("return %s", kStatusVarName));
   }
@@ -379,13 +401,21 @@ unique_ptr<Declaration> DefineClientTransaction(const TypeNamespace& types,
   //      response.
   // In both cases, we're free to set Status from the status_t and return.
   b->AddLiteral(StringPrintf("%s:\n", kErrorLabel), false /* no semicolon */);
+  if (options.GenTransactionStats()) {
+    // Failing to write the data parcel skips the transaction, but not the count.
+    b->AddLiteral(StringPrintf("if (_aidl_stats_start == 0) {\n"
+                               "  _aidl_stats_record(&%s, 0, 0, 0, true);\n"
+                               "}\n",
+                               TransactionStatsOf(interface, method, false /* isServer */).c_str()),
+                  false /* no semicolon */);
+  }
   b->AddLiteral(
       StringPrintf("%s.setFromStatusT(%s)", kStatusVarName,
                    kAndroidStatusVarName));
 
   if (options.GenLog()) {
     b->AddLiteral(GenLogAfterExecute(bp_name, interface, method, kStatusVarName, kReturnVarName,
-                                     false /* isServer */, false /* isNdk */),
+                                     false /* isServer */, false /* isNdk */, options),
                   false /* no semicolon */);
   }
 
@@ -441,7 +471,10 @@ unique_ptr<Document> BuildClientSource(const TypeNamespace& types, const AidlInt
   if (options.GenLog()) {
     include_list.emplace_back("chrono");
     include_list.emplace_back("functional");
-    include_list.emplace_back("json/value.h");
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      include_list.emplace_back("json/value.h");
+      include_list.emplace_back("optional");
+    }
   }
   vector<unique_ptr<Declaration>> file_decls;
 
@@ -455,12 +488,7 @@ unique_ptr<Document> BuildClientSource(const TypeNamespace& types, const AidlInt
       { "BpInterface<" + i_name + ">(" + kImplVarName + ")" }}});
 
   if (options.GenLog()) {
-    string code;
-    ClassName(interface, ClassNames::CLIENT);
-    CodeWriterPtr writer = CodeWriter::ForString(&code);
-    (*writer) << "std::function<void(const Json::Value&)> "
-              << ClassName(interface, ClassNames::CLIENT) << "::logFunc;\n";
-    writer->Close();
+    const string code = GenLogFuncDefinition(ClassName(interface, ClassNames::CLIENT), options);
     file_decls.push_back(unique_ptr<Declaration>(new LiteralDecl(code)));
   }
 
@@ -475,6 +503,11 @@ unique_ptr<Document> BuildClientSource(const TypeNamespace& types, const AidlInt
     if (!m) { return nullptr; }
     file_decls.push_back(std::move(m));
   }
+
+  if (options.GenTransactionStats()) {
+    file_decls.emplace_back(new LiteralDecl(GenTransactionStatsAccessorDefinition(
+        interface, ClassName(interface, ClassNames::CLIENT), false /* isServer */)));
+  }
   return unique_ptr<Document>{new CppSource{
       include_list,
       NestInNamespaces(std::move(file_decls), interface.GetSplitPackage())}};
@@ -482,8 +515,22 @@ unique_ptr<Document> BuildClientSource(const TypeNamespace& types, const AidlInt
 
 namespace {
 
+// Handles the transactions of |method| in |b|, which is either a case of the
+// switch of onTransact, or the body of the handler of the method when
+// |in_table|. The handler returns where the case breaks, and the interface is
+// checked before it is called.
 bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& interface,
-                             const AidlMethod& method, const Options& options, StatementBlock* b) {
+                             const AidlMethod& method, const Options& options, StatementBlock* b,
+                             bool in_table) {
+  auto exit_on_status_not_ok = in_table ? ReturnOnStatusNotOk : BreakOnStatusNotOk;
+  const string exit = in_table ? StringPrintf("return %s", kAndroidStatusVarName) : "break";
+  if (in_table) {
+    b->AddLiteral(StringPrintf("(void)%s", kDataVarName));
+    b->AddLiteral(StringPrintf("(void)%s", kReplyVarName));
+    b->AddLiteral(StringPrintf("%s %s = %s", kAndroidStatusLiteral, kAndroidStatusVarName,
+                               kAndroidStatusOk));
+  }
+
   // Declare all the parameters now.  In the common case, we expect no errors
   // in serialization.
   for (const unique_ptr<AidlArgument>& a : method.GetArguments()) {
@@ -501,14 +548,19 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
   }
 
   // Check that the client is calling the correct interface.
-  IfStatement* interface_check = new IfStatement(
-      new MethodCall(StringPrintf("%s.checkInterface",
-                                  kDataVarName), "this"),
-      true /* invert the check */);
-  b->AddStatement(interface_check);
-  interface_check->OnTrue()->AddStatement(
-      new Assignment(kAndroidStatusVarName, "::android::BAD_TYPE"));
-  interface_check->OnTrue()->AddLiteral("break");
+  if (!in_table) {
+    IfStatement* interface_check = new IfStatement(
+        new MethodCall(StringPrintf("%s.checkInterface",
+                                    kDataVarName), "this"),
+        true /* invert the check */);
+    b->AddStatement(interface_check);
+    interface_check->OnTrue()->AddStatement(
+        new Assignment(kAndroidStatusVarName, "::android::BAD_TYPE"));
+    interface_check->OnTrue()->AddLiteral("break");
+    if (options.FlightRecorderArgBytes() > 0) {
+      b->AddLiteral(StringPrintf("_aidl_args_start = %s.dataPosition()", kDataVarName));
+    }
+  }
 
   // Deserialize each "in" parameter to the transaction.
   for (const auto& a: method.GetArguments()) {
@@ -523,7 +575,7 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
           kAndroidStatusVarName,
           new MethodCall{string(kDataVarName) + "." + readMethod,
                          "&" + BuildVarName(*a)}});
-      b->AddStatement(BreakOnStatusNotOk());
+      b->AddStatement(exit_on_status_not_ok());
     } else if (a->IsOut() && a->GetType().IsArray()) {
       // Special case, the length of the out array is written into the parcel.
       //     _aidl_ret_status = _aidl_data.resizeOutVector(&out_param_name);
@@ -532,7 +584,7 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
           kAndroidStatusVarName,
           new MethodCall{string(kDataVarName) + ".resizeOutVector",
                          "&" + BuildVarName(*a)}});
-      b->AddStatement(BreakOnStatusNotOk());
+      b->AddStatement(exit_on_status_not_ok());
     }
   }
 
@@ -545,13 +597,14 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
   }
   const string bn_name = ClassName(interface, ClassNames::SERVER);
   if (options.GenLog()) {
-    b->AddLiteral(GenLogBeforeExecute(bn_name, method, true /* isServer */, false /* isNdk */),
+    b->AddLiteral(GenLogBeforeExecute(bn_name, method, true /* isServer */, false /* isNdk */,
+                                      options),
                   false);
   }
   // Call the actual method.  This is implemented by the subclass.
   vector<unique_ptr<AstNode>> status_args;
   status_args.emplace_back(new MethodCall(
-          method.GetName(),
+          (in_table ? string(kImplVarName) + "->" : "") + method.GetName(),
           BuildArgList(types, method, false /* not for method decl */)));
   b->AddStatement(new Statement(new MethodCall(
       StringPrintf("%s %s", kBinderStatusLiteral, kStatusVarName),
@@ -561,10 +614,15 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
     b->AddStatement(new Statement(new MethodCall("atrace_end",
                                                  "ATRACE_TAG_AIDL")));
   }
+  if (options.GenTransactionStats()) {
+    b->AddLiteral(GenTransactionStatsException(interface, method, kStatusVarName,
+                                               true /* isServer */, false /* isNdk */),
+                  false /* no semicolon */);
+  }
 
   if (options.GenLog()) {
     b->AddLiteral(GenLogAfterExecute(bn_name, interface, method, kStatusVarName, kReturnVarName,
-                                     true /* isServer */, false /* isNdk */),
+                                     true /* isServer */, false /* isNdk */, options, in_table),
                   false);
   }
 
@@ -573,11 +631,11 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
     b->AddStatement(new Assignment(
         kAndroidStatusVarName,
         StringPrintf("%s.writeToParcel(%s)", kStatusVarName, kReplyVarName)));
-    b->AddStatement(BreakOnStatusNotOk());
+    b->AddStatement(exit_on_status_not_ok());
     IfStatement* exception_check = new IfStatement(
         new LiteralExpression(StringPrintf("!%s.isOk()", kStatusVarName)));
     b->AddStatement(exception_check);
-    exception_check->OnTrue()->AddLiteral("break");
+    exception_check->OnTrue()->AddLiteral(exit);
   }
 
   // If we have a return value, write it first.
@@ -588,7 +646,7 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
     b->AddStatement(new Assignment{
         kAndroidStatusVarName, new MethodCall{writeMethod,
         ArgList{return_type->WriteCast(kReturnVarName)}}});
-    b->AddStatement(BreakOnStatusNotOk());
+    b->AddStatement(exit_on_status_not_ok());
   }
   // Write each out parameter to the reply parcel.
   for (const AidlArgument* a : method.GetOutArguments()) {
@@ -602,9 +660,12 @@ bool HandleServerTransaction(const TypeNamespace& types, const AidlInterface& in
         kAndroidStatusVarName,
         new MethodCall{string(kReplyVarName) + "->" + writeMethod,
                        type->WriteCast(BuildVarName(*a))}});
-    b->AddStatement(BreakOnStatusNotOk());
+    b->AddStatement(exit_on_status_not_ok());
   }
 
+  if (in_table) {
+    b->AddLiteral(exit);
+  }
   return true;
 }
 
@@ -637,7 +698,22 @@ unique_ptr<Document> BuildServerSource(const TypeNamespace& types, const AidlInt
   if (options.GenLog()) {
     include_list.emplace_back("chrono");
     include_list.emplace_back("functional");
-    include_list.emplace_back("json/value.h");
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      include_list.emplace_back("json/value.h");
+      include_list.emplace_back("optional");
+    }
+  }
+  const bool flight_recorder = options.FlightRecorderSize() > 0;
+  const bool record_args = options.FlightRecorderArgBytes() > 0;
+  if (flight_recorder) {
+    include_list.emplace_back("algorithm");
+    include_list.emplace_back("atomic");
+    if (!options.GenLog()) {
+      include_list.emplace_back("chrono");
+    }
+    include_list.emplace_back("string");
+    include_list.emplace_back("string.h");
+    include_list.emplace_back("unistd.h");
   }
   unique_ptr<MethodImpl> on_transact{new MethodImpl{
       kAndroidStatusLiteral, bn_name, "onTransact",
@@ -653,18 +729,107 @@ unique_ptr<Document> BuildServerSource(const TypeNamespace& types, const AidlInt
       StringPrintf("%s %s = %s", kAndroidStatusLiteral, kAndroidStatusVarName,
                    kAndroidStatusOk));
 
+  // With --transaction_stats, onTransact counts each transaction of a method
+  // once it is handled.
+  if (options.GenTransactionStats()) {
+    on_transact->GetStatementBlock()->AddLiteral(
+        "const uint64_t _aidl_stats_start = _aidl_stats_now()");
+  }
+
+  vector<unique_ptr<Declaration>> decls;
+  // With --flight_recorder, onTransact records each transaction once it is
+  // handled. The arguments start after the interface token, once it is checked.
+  if (flight_recorder) {
+    decls.emplace_back(new LiteralDecl(GenFlightRecorderDefinitions(interface, bn_name, options,
+                                                                    false /* isNdk */)));
+    on_transact->GetStatementBlock()->AddLiteral(
+        "const uint64_t _aidl_flight_start = _aidl_flight_now()");
+    if (record_args) {
+      on_transact->GetStatementBlock()->AddLiteral(
+          StringPrintf("size_t _aidl_args_start = %s.dataSize()", kDataVarName));
+    }
+  }
+
+  // With a table, the transactions that have a handler in it are dispatched
+  // to it, and the switch handles the others.
+  std::set<const AidlMethod*> table_methods;
+  StatementBlock* switch_block = on_transact->GetStatementBlock();
+  table_methods = TableTransactions(interface, options);
+  // The methods called most come first, see CallProfile.
+  const vector<const AidlMethod*> methods = MethodsByCalls(interface, options.GetCallProfile());
+  std::set<const AidlMethod*> cold_methods;
+  if (options.GetCallProfile() != nullptr) {
+    cold_methods = options.GetCallProfile()->ColdMethods(interface);
+  }
+  if (!table_methods.empty()) {
+    const string handler_args =
+        StringPrintf("(%s*, const %s&, %s*)", bn_name.c_str(), kAndroidParcelLiteral,
+                     kAndroidParcelLiteral);
+    for (const AidlMethod* method : methods) {
+      if (table_methods.count(method) == 0) {
+        continue;
+      }
+      // The cold handlers are kept apart from the code that runs often.
+      const char* attributes = cold_methods.count(method) != 0 ? "__attribute__((cold)) " : "";
+      unique_ptr<MethodImpl> handler{new MethodImpl{
+          StringPrintf("static %s%s", attributes, kAndroidStatusLiteral), "",
+          TransactionHandlerName(*method),
+          ArgList{{StringPrintf("%s* %s", bn_name.c_str(), kImplVarName),
+                   StringPrintf("const %s& %s", kAndroidParcelLiteral, kDataVarName),
+                   StringPrintf("%s* %s", kAndroidParcelLiteral, kReplyVarName)}}}};
+      if (!HandleServerTransaction(types, interface, *method, options,
+                                   handler->GetStatementBlock(), true /* in_table */)) {
+        return nullptr;
+      }
+      decls.push_back(std::move(handler));
+    }
+
+    const vector<string> entries = TransactionTableEntries(table_methods);
+    decls.emplace_back(new LiteralDecl(StringPrintf(
+        "static constexpr %s (*%s[])%s = {\n  %s,\n};\n", kAndroidStatusLiteral,
+        kTransactionTableName, handler_args.c_str(), Join(entries, ",\n  ").c_str())));
+
+    // _aidl_index wraps around below FIRST_CALL_TRANSACTION.
+    on_transact->GetStatementBlock()->AddLiteral(StringPrintf(
+        "const uint32_t _aidl_index = %s - ::android::IBinder::FIRST_CALL_TRANSACTION",
+        kCodeVarName));
+    IfStatement* in_table = new IfStatement(new LiteralExpression(
+        StringPrintf("_aidl_index < %zu && %s[_aidl_index] != nullptr", entries.size(),
+                     kTransactionTableName)));
+    on_transact->GetStatementBlock()->AddStatement(in_table);
+    IfStatement* interface_check = new IfStatement(
+        new MethodCall(StringPrintf("%s.checkInterface", kDataVarName), "this"),
+        true /* invert the check */);
+    in_table->OnTrue()->AddStatement(interface_check);
+    interface_check->OnTrue()->AddStatement(
+        new Assignment(kAndroidStatusVarName, "::android::BAD_TYPE"));
+    if (record_args) {
+      interface_check->OnFalse()->AddLiteral(
+          StringPrintf("_aidl_args_start = %s.dataPosition()", kDataVarName));
+    }
+    interface_check->OnFalse()->AddStatement(new Assignment(
+        kAndroidStatusVarName,
+        StringPrintf("%s[_aidl_index](this, %s, %s)", kTransactionTableName, kDataVarName,
+                     kReplyVarName)));
+    switch_block = in_table->OnFalse();
+  }
+
   // Add the all important switch statement, but retain a pointer to it.
   SwitchStatement* s = new SwitchStatement{kCodeVarName};
-  on_transact->GetStatementBlock()->AddStatement(s);
+  switch_block->AddStatement(s);
 
   // The switch statement has a case statement for each transaction code.
-  for (const auto& method : interface.GetMethods()) {
+  for (const AidlMethod* method : methods) {
+    if (table_methods.count(method) != 0) {
+      continue;
+    }
     StatementBlock* b = s->AddCase(GetTransactionIdFor(*method));
     if (!b) { return nullptr; }
 
     bool success = false;
     if (method->IsUserDefined()) {
-      success = HandleServerTransaction(types, interface, *method, options, b);
+      success = HandleServerTransaction(types, interface, *method, options, b,
+                                        false /* in_table */);
     } else {
       success = HandleServerMetaTransaction(types, interface, *method, options, b);
     }
@@ -693,10 +858,26 @@ unique_ptr<Document> BuildServerSource(const TypeNamespace& types, const AidlInt
                    kBinderStatusLiteral, kBinderStatusLiteral,
                    kReplyVarName)));
 
+  if (flight_recorder) {
+    string args = StringPrintf("%s, %s, _aidl_flight_start, %s.dataSize(), %s->dataSize()",
+                               kCodeVarName, kAndroidStatusVarName, kDataVarName, kReplyVarName);
+    if (record_args) {
+      args += StringPrintf(", %s.data() + _aidl_args_start, %s.dataSize() - _aidl_args_start",
+                           kDataVarName, kDataVarName);
+    }
+    on_transact->GetStatementBlock()->AddLiteral("_aidl_flight_record(" + args + ")");
+  }
+  if (options.GenTransactionStats()) {
+    on_transact->GetStatementBlock()->AddLiteral(StringPrintf(
+        "_aidl_stats_record_server(%s, _aidl_stats_now() - _aidl_stats_start, %s.dataSize(), "
+        "%s->dataSize(), "
+        "%s != ::android::OK)",
+        kCodeVarName, kDataVarName, kReplyVarName, kAndroidStatusVarName));
+  }
+
   // Finally, the server's onTransact method just returns a status code.
   on_transact->GetStatementBlock()->AddLiteral(
       StringPrintf("return %s", kAndroidStatusVarName));
-  vector<unique_ptr<Declaration>> decls;
   decls.push_back(std::move(on_transact));
 
   if (options.Version() > 0) {
@@ -708,14 +889,14 @@ unique_ptr<Document> BuildServerSource(const TypeNamespace& types, const AidlInt
   }
 
   if (options.GenLog()) {
-    string code;
-    ClassName(interface, ClassNames::SERVER);
-    CodeWriterPtr writer = CodeWriter::ForString(&code);
-    (*writer) << "std::function<void(const Json::Value&)> "
-              << ClassName(interface, ClassNames::SERVER) << "::logFunc;\n";
-    writer->Close();
+    const string code = GenLogFuncDefinition(ClassName(interface, ClassNames::SERVER), options);
     decls.push_back(unique_ptr<Declaration>(new LiteralDecl(code)));
   }
+
+  if (options.GenTransactionStats()) {
+    decls.emplace_back(new LiteralDecl(
+        GenTransactionStatsAccessorDefinition(interface, bn_name, true /* isServer */)));
+  }
   return unique_ptr<Document>{
       new CppSource{include_list, NestInNamespaces(std::move(decls), interface.GetSplitPackage())}};
 }
@@ -734,6 +915,15 @@ unique_ptr<Document> BuildInterfaceSource(const TypeNamespace& types,
 
   vector<unique_ptr<Declaration>> decls;
 
+  // The proxy and the stub share the counters of --transaction_stats, which
+  // are defined in this source, before theirs.
+  if (options.GenTransactionStats()) {
+    include_list.emplace_back("algorithm");
+    include_list.emplace_back("atomic");
+    include_list.emplace_back("chrono");
+    decls.emplace_back(new LiteralDecl(GenTransactionStatsDefinitions(interface, false /* isNdk */)));
+  }
+
   unique_ptr<MacroDecl> meta_if{new MacroDecl{
       "IMPLEMENT_META_INTERFACE",
       ArgList{vector<string>{ClassName(interface, ClassNames::BASE),
@@ -828,9 +1018,14 @@ unique_ptr<Document> BuildClientHeader(const TypeNamespace& types, const AidlInt
   if (options.GenLog()) {
     includes.emplace_back("chrono");      // for std::chrono::steady_clock
     includes.emplace_back("functional");  // for std::function
-    includes.emplace_back("json/value.h");
-    publics.emplace_back(
-        new LiteralDecl{"static std::function<void(const Json::Value&)> logFunc;\n"});
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      includes.emplace_back("json/value.h");
+    }
+    publics.emplace_back(new LiteralDecl{GenLogDeclarations(options, false /* isNdk */)});
+  }
+
+  if (options.GenTransactionStats()) {
+    publics.emplace_back(new LiteralDecl{GenTransactionStatsAccessorDeclaration()});
   }
 
   vector<unique_ptr<Declaration>> privates;
@@ -879,9 +1074,16 @@ unique_ptr<Document> BuildServerHeader(const TypeNamespace& /* types */,
   if (options.GenLog()) {
     includes.emplace_back("chrono");      // for std::chrono::steady_clock
     includes.emplace_back("functional");  // for std::function
-    includes.emplace_back("json/value.h");
-    publics.emplace_back(
-        new LiteralDecl{"static std::function<void(const Json::Value&)> logFunc;\n"});
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      includes.emplace_back("json/value.h");
+    }
+    publics.emplace_back(new LiteralDecl{GenLogDeclarations(options, false /* isNdk */)});
+  }
+  if (options.GenTransactionStats()) {
+    publics.emplace_back(new LiteralDecl{GenTransactionStatsAccessorDeclaration()});
+  }
+  if (options.FlightRecorderSize() > 0) {
+    publics.emplace_back(new LiteralDecl{GenFlightRecorderDeclaration()});
   }
   unique_ptr<ClassDecl> bn_class{
       new ClassDecl{bn_name,
@@ -963,6 +1165,12 @@ unique_ptr<Document> BuildInterfaceHeader(const TypeNamespace& types,
     includes.insert(kTraceHeader);
   }
 
+  if (options.GenTransactionStats()) {
+    includes.insert("stdint.h");
+    includes.insert("vector");
+    if_class->AddPublic(unique_ptr<Declaration>(new LiteralDecl(GenTransactionStatsDeclarations())));
+  }
+
   if (!interface.GetMethods().empty()) {
     for (const auto& method : interface.GetMethods()) {
       if (method->IsUserDefined()) {
@@ -1114,19 +1322,22 @@ std::unique_ptr<Document> BuildParcelSource(const TypeNamespace& /*types*/,
 bool WriteHeader(const Options& options, const TypeNamespace& types, const AidlInterface& interface,
                  const IoDelegate& io_delegate, ClassNames header_type) {
   unique_ptr<Document> header;
-  switch (header_type) {
-    case ClassNames::INTERFACE:
-      header = BuildInterfaceHeader(types, interface, options);
-      header_type = ClassNames::RAW;
-      break;
-    case ClassNames::CLIENT:
-      header = BuildClientHeader(types, interface, options);
-      break;
-    case ClassNames::SERVER:
-      header = BuildServerHeader(types, interface, options);
-      break;
-    default:
-      LOG(FATAL) << "aidl internal error";
+  {
+    TimeTrace::Scope trace("BuildAst");
+    switch (header_type) {
+      case ClassNames::INTERFACE:
+        header = BuildInterfaceHeader(types, interface, options);
+        header_type = ClassNames::RAW;
+        break;
+      case ClassNames::CLIENT:
+        header = BuildClientHeader(types, interface, options);
+        break;
+      case ClassNames::SERVER:
+        header = BuildServerHeader(types, interface, options);
+        break;
+      default:
+        LOG(FATAL) << "aidl internal error";
+    }
   }
   if (!header) {
     LOG(ERROR) << "aidl internal error: Failed to generate header.";
@@ -1135,7 +1346,10 @@ bool WriteHeader(const Options& options, const TypeNamespace& types, const AidlI
 
   const string header_path = options.OutputHeaderDir() + HeaderFile(interface, header_type);
   unique_ptr<CodeWriter> code_writer(io_delegate.GetCodeWriter(header_path));
-  header->Write(code_writer.get());
+  {
+    TimeTrace::Scope trace("Emit", header_path);
+    header->Write(code_writer.get());
+  }
 
   const bool success = code_writer->Close();
   if (!success) {
@@ -1152,9 +1366,15 @@ using namespace internals;
 bool GenerateCppInterface(const string& output_file, const Options& options,
                           const TypeNamespace& types, const AidlInterface& interface,
                           const IoDelegate& io_delegate) {
-  auto interface_src = BuildInterfaceSource(types, interface, options);
-  auto client_src = BuildClientSource(types, interface, options);
-  auto server_src = BuildServerSource(types, interface, options);
+  unique_ptr<Document> interface_src;
+  unique_ptr<Document> client_src;
+  unique_ptr<Document> server_src;
+  {
+    TimeTrace::Scope trace("BuildAst", output_file);
+    interface_src = BuildInterfaceSource(types, interface, options);
+    client_src = BuildClientSource(types, interface, options);
+    server_src = BuildServerSource(types, interface, options);
+  }
 
   if (!interface_src || !client_src || !server_src) {
     return false;
@@ -1170,9 +1390,12 @@ bool GenerateCppInterface(const string& output_file, const Options& options,
   }
 
   unique_ptr<CodeWriter> writer = io_delegate.GetCodeWriter(output_file);
-  interface_src->Write(writer.get());
-  client_src->Write(writer.get());
-  server_src->Write(writer.get());
+  {
+    TimeTrace::Scope trace("Emit", output_file);
+    interface_src->Write(writer.get());
+    client_src->Write(writer.get());
+    server_src->Write(writer.get());
+  }
 
   const bool success = writer->Close();
   if (!success) {
@@ -1185,8 +1408,13 @@ bool GenerateCppInterface(const string& output_file, const Options& options,
 bool GenerateCppParcel(const string& output_file, const Options& options,
                        const cpp::TypeNamespace& types, const AidlStructuredParcelable& parcelable,
                        const IoDelegate& io_delegate) {
-  auto header = BuildParcelHeader(types, parcelable, options);
-  auto source = BuildParcelSource(types, parcelable, options);
+  unique_ptr<Document> header;
+  unique_ptr<Document> source;
+  {
+    TimeTrace::Scope trace("BuildAst", output_file);
+    header = BuildParcelHeader(types, parcelable, options);
+    source = BuildParcelSource(types, parcelable, options);
+  }
 
   if (!header || !source) {
     return false;
@@ -1194,7 +1422,10 @@ bool GenerateCppParcel(const string& output_file, const Options& options,
 
   const string header_path = options.OutputHeaderDir() + HeaderFile(parcelable, ClassNames::RAW);
   unique_ptr<CodeWriter> header_writer(io_delegate.GetCodeWriter(header_path));
-  header->Write(header_writer.get());
+  {
+    TimeTrace::Scope trace("Emit", header_path);
+    header->Write(header_writer.get());
+  }
   CHECK(header_writer->Close());
 
   // TODO(b/111362593): no unecessary files just to have consistent output with interfaces
@@ -1208,7 +1439,10 @@ bool GenerateCppParcel(const string& output_file, const Options& options,
   CHECK(bn_writer->Close());
 
   unique_ptr<CodeWriter> source_writer = io_delegate.GetCodeWriter(output_file);
-  source->Write(source_writer.get());
+  {
+    TimeTrace::Scope trace("Emit", output_file);
+    source->Write(source_writer.get());
+  }
   CHECK(source_writer->Close());
 
   return true;
@@ -26,6 +26,7 @@
 
 #include "aidl_to_java.h"
 #include "code_writer.h"
+#include "time_trace.h"
 #include "type_java.h"
 
 using std::unique_ptr;
@@ -39,12 +40,17 @@ namespace java {
 bool generate_java_interface(const string& filename, const AidlInterface* iface,
                              JavaTypeNamespace* types, const IoDelegate& io_delegate,
                              const Options& options) {
-  Class* cl = generate_binder_interface_class(iface, types, options);
+  Class* cl;
+  {
+    TimeTrace::Scope trace("BuildAst", filename);
+    cl = generate_binder_interface_class(iface, types, options);
+  }
 
   Document* document =
       new Document("" /* no comment */, iface->GetPackage(), unique_ptr<Class>(cl));
 
   CodeWriterPtr code_writer = io_delegate.GetCodeWriter(filename);
+  TimeTrace::Scope trace("Emit", filename);
   document->Write(code_writer.get());
 
   return true;
@@ -52,12 +58,17 @@ bool generate_java_interface(const string& filename, const AidlInterface* iface,
 
 bool generate_java_parcel(const std::string& filename, const AidlStructuredParcelable* parcel,
                           AidlTypenames& typenames, const IoDelegate& io_delegate) {
-  Class* cl = generate_parcel_class(parcel, typenames);
+  Class* cl;
+  {
+    TimeTrace::Scope trace("BuildAst", filename);
+    cl = generate_parcel_class(parcel, typenames);
+  }
 
   Document* document =
       new Document("" /* no comment */, parcel->GetPackage(), unique_ptr<Class>(cl));
 
   CodeWriterPtr code_writer = io_delegate.GetCodeWriter(filename);
+  TimeTrace::Scope trace("Emit", filename);
   document->Write(code_writer.get());
 
   return true;
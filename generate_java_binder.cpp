@@ -16,6 +16,8 @@
 
 #include "aidl.h"
 #include "aidl_to_java.h"
+#include "call_profile.h"
+#include "flight_recorder.h"
 #include "generate_java.h"
 #include "options.h"
 #include "type_java.h"
@@ -25,6 +27,8 @@
 #include <string.h>
 
 #include <algorithm>
+#include <map>
+#include <set>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -184,10 +188,17 @@ StubClass::StubClass(const Type* type, const InterfaceType* interfaceType, JavaT
   this->transact_data = new Variable(types->ParcelType()->JavaType(), "data");
   this->transact_reply = new Variable(types->ParcelType()->JavaType(), "reply");
   this->transact_flags = new Variable(types->IntType()->JavaType(), "flags");
+  // With --flight_recorder, onTransact records the transactions handled by
+  // the switch, which is moved to onTransact$recorded$.
   Method* onTransact = new Method;
-  onTransact->modifiers = PUBLIC | OVERRIDE;
+  if (options_.FlightRecorderSize() > 0) {
+    onTransact->modifiers = PRIVATE;
+    onTransact->name = "onTransact$recorded$";
+  } else {
+    onTransact->modifiers = PUBLIC | OVERRIDE;
+    onTransact->name = "onTransact";
+  }
   onTransact->returnType = types->BoolType()->JavaType();
-  onTransact->name = "onTransact";
   onTransact->parameters.push_back(this->transact_code);
   onTransact->parameters.push_back(this->transact_data);
   onTransact->parameters.push_back(this->transact_reply);
@@ -876,12 +887,28 @@ static void generate_interface_descriptors(StubClass* stub, ProxyClass* proxy,
 // (so that more "complex" methods come later), and the first non_outline_count
 // number of methods not outlined (are kept in the onTransact() method).
 //
+// With a call profile that covers the interface, the cold methods are
+// outlined whatever the number of methods, and the methods are sorted by
+// decreasing number of calls instead, so that those called most stay inline.
+//
 // Requirements: non_outline_count <= outline_threshold.
 static void compute_outline_methods(const AidlInterface* iface,
                                     StubClass* stub,
                                     size_t outline_threshold,
-                                    size_t non_outline_count) {
+                                    size_t non_outline_count,
+                                    const CallProfile* profile) {
   CHECK_LE(non_outline_count, outline_threshold);
+  if (profile != nullptr && profile->Covers(*iface)) {
+    const std::vector<const AidlMethod*> methods = MethodsByCalls(*iface, profile);
+    const std::set<const AidlMethod*> cold_methods = profile->ColdMethods(*iface);
+    stub->outline_methods.insert(cold_methods.begin(), cold_methods.end());
+    if (methods.size() > outline_threshold) {
+      stub->outline_methods.insert(methods.begin() + non_outline_count, methods.end());
+    }
+    stub->transact_outline = !stub->outline_methods.empty();
+    stub->all_method_count = methods.size();
+    return;
+  }
   // We'll outline (create sub methods) if there are more than min_methods
   // cases.
   stub->transact_outline = iface->GetMethods().size() > outline_threshold;
@@ -905,6 +932,144 @@ static void compute_outline_methods(const AidlInterface* iface,
   }
 }
 
+// Sorts the cases of the methods of |iface| in onTransact by decreasing number
+// of calls in |profile|. The other cases, like INTERFACE_TRANSACTION, stay
+// first.
+static void order_cases_by_calls(const AidlInterface& iface, StubClass* stub,
+                                 const CallProfile* profile) {
+  if (profile == nullptr || !profile->Covers(iface)) {
+    return;
+  }
+  std::map<string, size_t> ranks;
+  const std::vector<const AidlMethod*> methods = MethodsByCalls(iface, profile);
+  for (size_t i = 0; i < methods.size(); i++) {
+    ranks["TRANSACTION_" + methods[i]->GetName()] = i + 1;
+  }
+  auto rank = [&ranks](const Case* c) -> size_t {
+    if (c->cases.size() != 1) {
+      return 0;
+    }
+    auto it = ranks.find(c->cases[0]);
+    return it != ranks.end() ? it->second : 0;
+  };
+  std::vector<Case*>& cases = stub->transact_switch->cases;
+  std::stable_sort(cases.begin(), cases.end(),
+                   [&rank](const Case* c1, const Case* c2) { return rank(c1) < rank(c2); });
+}
+
+// Adds the flight recorder of --flight_recorder to |stub|: the ring buffer of
+// the records of the last transactions, the onTransact that records them, and
+// dumpFlightRecorder. See flight_recorder.h for the format of the records and
+// of the dumps. The argument bytes aren't recorded, as a Parcel doesn't give
+// its raw data cheaply.
+static void generate_flight_recorder(const AidlInterface& iface, StubClass* stub,
+                                     const Options& options) {
+  const size_t size = options.FlightRecorderSize();
+  // Each record is a sequence, as in the C++ stubs, and its words.
+  const size_t words = FlightRecordWords(0);
+  const size_t stride = 1 + words;
+  stub->elements.emplace_back(new LiteralClassElement(StringPrintf(
+      "// The records of the last %zu transactions. sFlightNext counts them, and the one whose\n"
+      "// index is i is in the %zu longs at (i %% %zu) * %zu: its sequence, which is 2 * i + 1\n"
+      "// while it is written, and 2 * i + 2 once it is, and its words.\n"
+      "private static final java.util.concurrent.atomic.AtomicLongArray sFlightRecords =\n"
+      "    new java.util.concurrent.atomic.AtomicLongArray(%zu);\n"
+      "private static final java.util.concurrent.atomic.AtomicLong sFlightNext =\n"
+      "    new java.util.concurrent.atomic.AtomicLong();\n",
+      size, stride, size, stride, size * stride)));
+
+  stub->elements.emplace_back(new LiteralClassElement(
+      "@Override public boolean onTransact(int code, android.os.Parcel data, "
+      "android.os.Parcel reply, int flags) throws android.os.RemoteException\n"
+      "{\n"
+      "  final long start = System.nanoTime();\n"
+      "  // UNKNOWN_ERROR if it throws, and UNKNOWN_TRANSACTION if it isn't handled.\n"
+      "  int status = -2147483648;\n"
+      "  try {\n"
+      "    final boolean handled = onTransact$recorded$(code, data, reply, flags);\n"
+      "    status = handled ? 0 : -74;\n"
+      "    return handled;\n"
+      "  } finally {\n"
+      "    recordFlight(code, status, start, data.dataSize(), "
+      "reply != null ? reply.dataSize() : 0);\n"
+      "  }\n"
+      "}\n"));
+
+  stub->elements.emplace_back(new LiteralClassElement(StringPrintf(
+      "private static void recordFlight(int code, int status, long start, int dataSize, "
+      "int replySize)\n"
+      "{\n"
+      "  final long index = sFlightNext.getAndIncrement();\n"
+      "  final int slot = (int) (index %% %zu) * %zu;\n"
+      "  sFlightRecords.set(slot, 2 * index + 1);\n"
+      "  sFlightRecords.set(slot + 1, (code & 0xffffffffL) | ((long) status << 32));\n"
+      "  sFlightRecords.set(slot + 2, start);\n"
+      "  sFlightRecords.set(slot + 3, System.nanoTime() - start);\n"
+      "  sFlightRecords.set(slot + 4, (dataSize & 0xffffffffL) | ((long) replySize << 32));\n"
+      "  sFlightRecords.set(slot, 2 * index + 2);\n"
+      "}\n",
+      size, stride)));
+
+  // The magic, the number of argument bytes, the descriptor, the methods and
+  // the number of records.
+  size_t header_size = strlen(kFlightRecorderMagic) + 4 + 4 + iface.GetCanonicalName().size() + 4;
+  string methods;
+  for (const auto& method : iface.GetMethods()) {
+    header_size += 8 + method->GetName().size();
+    methods += StringPrintf("  dump.putInt(android.os.IBinder.FIRST_CALL_TRANSACTION + %d);\n",
+                            method->GetId());
+    methods += StringPrintf("  putFlightString(dump, \"%s\");\n", method->GetName().c_str());
+  }
+  header_size += 4;
+
+  stub->elements.emplace_back(new LiteralClassElement(
+      "private static void putFlightString(java.nio.ByteBuffer dump, String value)\n"
+      "{\n"
+      "  final byte[] bytes = value.getBytes(java.nio.charset.StandardCharsets.UTF_8);\n"
+      "  dump.putInt(bytes.length);\n"
+      "  dump.put(bytes);\n"
+      "}\n"));
+  stub->elements.emplace_back(new LiteralClassElement(StringPrintf(
+      "/** Returns the records of the last transactions, see --flight_recorder. */\n"
+      "public static byte[] dumpFlightRecorder()\n"
+      "{\n"
+      "  final java.nio.ByteBuffer dump = java.nio.ByteBuffer.allocate(%zu)\n"
+      "      .order(java.nio.ByteOrder.LITTLE_ENDIAN);\n"
+      "  dump.put(\"%s\".getBytes(java.nio.charset.StandardCharsets.UTF_8));\n"
+      "  dump.putInt(0);\n"
+      "  putFlightString(dump, \"%s\");\n"
+      "  dump.putInt(%zu);\n"
+      "%s"
+      "  final int countPosition = dump.position();\n"
+      "  dump.putInt(0);\n"
+      "  int count = 0;\n"
+      "  final long next = sFlightNext.get();\n"
+      "  for (long index = Math.max(0, next - %zu); index < next; index++) {\n"
+      "    final int slot = (int) (index %% %zu) * %zu;\n"
+      "    final long sequence = 2 * index + 2;\n"
+      "    if (sFlightRecords.get(slot) != sequence) {\n"
+      "      continue;\n"
+      "    }\n"
+      "    final long[] words = new long[%zu];\n"
+      "    for (int i = 0; i < words.length; i++) {\n"
+      "      words[i] = sFlightRecords.get(slot + 1 + i);\n"
+      "    }\n"
+      "    if (sFlightRecords.get(slot) != sequence) {\n"
+      "      continue;\n"
+      "    }\n"
+      "    dump.putLong(index);\n"
+      "    for (long word : words) {\n"
+      "      dump.putLong(word);\n"
+      "    }\n"
+      "    count++;\n"
+      "  }\n"
+      "  dump.putInt(countPosition, count);\n"
+      "  return java.util.Arrays.copyOf(dump.array(), dump.position());\n"
+      "}\n",
+      header_size + size * 8 * stride, kFlightRecorderMagic, iface.GetCanonicalName().c_str(),
+      iface.GetMethods().size(), methods.c_str(), size, size, stride, words)));
+}
+
 static unique_ptr<ClassElement> generate_default_impl_method(const AidlMethod& method) {
   unique_ptr<Method> default_method(new Method);
   default_method->comment = method.GetComments();
@@ -1008,7 +1173,8 @@ Class* generate_binder_interface_class(const AidlInterface* iface, JavaTypeNames
   compute_outline_methods(iface,
                           stub,
                           options.onTransact_outline_threshold_,
-                          options.onTransact_non_outline_count_);
+                          options.onTransact_non_outline_count_,
+                          options.GetCallProfile());
 
   // the proxy inner class
   ProxyClass* proxy = new ProxyClass(types, interfaceType->GetProxy(), interfaceType, options);
@@ -1051,6 +1217,11 @@ Class* generate_binder_interface_class(const AidlInterface* iface, JavaTypeNames
                      types,
                      options);
   }
+  // The methods called most are found first.
+  order_cases_by_calls(*iface, stub, options.GetCallProfile());
+  if (options.FlightRecorderSize() > 0) {
+    generate_flight_recorder(*iface, stub, options);
+  }
 
   // additional static methods for the default impl set/get to the
   // stub class. Can't add them to the interface as the generated java files
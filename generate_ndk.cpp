@@ -20,6 +20,12 @@
 #include "aidl_language.h"
 #include "aidl_to_cpp_common.h"
 #include "aidl_to_ndk.h"
+#include "call_profile.h"
+#include "time_trace.h"
+
+#include <set>
+#include <string>
+#include <vector>
 
 #include <android-base/logging.h>
 
@@ -31,6 +37,7 @@ static constexpr const char* kClazz = "_g_aidl_clazz";
 static constexpr const char* kDescriptor = "descriptor";
 static constexpr const char* kVersion = "version";
 static constexpr const char* kCacheVariable = "_aidl_cached_value";
+static constexpr const char* kTransactionTable = "_aidl_transaction_table";
 
 using namespace internals;
 using cpp::ClassNames;
@@ -40,23 +47,35 @@ void GenerateNdkInterface(const string& output_file, const Options& options,
                           const IoDelegate& io_delegate) {
   const string i_header = options.OutputHeaderDir() + NdkHeaderFile(defined_type, ClassNames::RAW);
   unique_ptr<CodeWriter> i_writer(io_delegate.GetCodeWriter(i_header));
-  GenerateInterfaceHeader(*i_writer, types, defined_type, options);
+  {
+    TimeTrace::Scope trace("Emit", i_header);
+    GenerateInterfaceHeader(*i_writer, types, defined_type, options);
+  }
   CHECK(i_writer->Close());
 
   const string bp_header =
       options.OutputHeaderDir() + NdkHeaderFile(defined_type, ClassNames::CLIENT);
   unique_ptr<CodeWriter> bp_writer(io_delegate.GetCodeWriter(bp_header));
-  GenerateClientHeader(*bp_writer, types, defined_type, options);
+  {
+    TimeTrace::Scope trace("Emit", bp_header);
+    GenerateClientHeader(*bp_writer, types, defined_type, options);
+  }
   CHECK(bp_writer->Close());
 
   const string bn_header =
       options.OutputHeaderDir() + NdkHeaderFile(defined_type, ClassNames::SERVER);
   unique_ptr<CodeWriter> bn_writer(io_delegate.GetCodeWriter(bn_header));
-  GenerateServerHeader(*bn_writer, types, defined_type, options);
+  {
+    TimeTrace::Scope trace("Emit", bn_header);
+    GenerateServerHeader(*bn_writer, types, defined_type, options);
+  }
   CHECK(bn_writer->Close());
 
   unique_ptr<CodeWriter> source_writer = io_delegate.GetCodeWriter(output_file);
-  GenerateSource(*source_writer, types, defined_type, options);
+  {
+    TimeTrace::Scope trace("Emit", output_file);
+    GenerateSource(*source_writer, types, defined_type, options);
+  }
   CHECK(source_writer->Close());
 }
 
@@ -66,7 +85,10 @@ void GenerateNdkParcel(const string& output_file, const Options& options,
   const string header_path =
       options.OutputHeaderDir() + NdkHeaderFile(defined_type, ClassNames::RAW);
   unique_ptr<CodeWriter> header_writer(io_delegate.GetCodeWriter(header_path));
-  GenerateParcelHeader(*header_writer, types, defined_type, options);
+  {
+    TimeTrace::Scope trace("Emit", header_path);
+    GenerateParcelHeader(*header_writer, types, defined_type, options);
+  }
   CHECK(header_writer->Close());
 
   const string bp_header =
@@ -82,7 +104,10 @@ void GenerateNdkParcel(const string& output_file, const Options& options,
   CHECK(bn_writer->Close());
 
   unique_ptr<CodeWriter> source_writer = io_delegate.GetCodeWriter(output_file);
-  GenerateParcelSource(*source_writer, types, defined_type, options);
+  {
+    TimeTrace::Scope trace("Emit", output_file);
+    GenerateParcelSource(*source_writer, types, defined_type, options);
+  }
   CHECK(source_writer->Close());
 }
 
@@ -219,6 +244,16 @@ static void GenerateConstantDefinitions(CodeWriter& out, const AidlInterface& in
 void GenerateSource(CodeWriter& out, const AidlTypenames& types, const AidlInterface& defined_type,
                     const Options& options) {
   GenerateSourceIncludes(out, types, defined_type);
+  if (options.FlightRecorderSize() > 0 || options.GenTransactionStats()) {
+    out << "#include <algorithm>\n";
+    out << "#include <atomic>\n";
+    out << "#include <chrono>\n";
+  }
+  if (options.FlightRecorderSize() > 0) {
+    out << "#include <string>\n";
+    out << "#include <string.h>\n";
+    out << "#include <unistd.h>\n";
+  }
   out << "\n";
 
   EnterNdkNamespace(out, defined_type);
@@ -244,6 +279,25 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
   out.Indent();
   out << "binder_status_t _aidl_ret_status = STATUS_OK;\n";
   out << "::ndk::ScopedAStatus _aidl_status;\n";
+  // The transaction consumes _aidl_in, so its size is taken before. The reply
+  // is at position 0 after the transaction, and AParcel_getDataSize is only in
+  // API 31, so the transaction is recorded once the reply is read, with the
+  // position of _aidl_out then. These are declared before the first goto,
+  // which can't jump over their initialization.
+  const bool stats = options.GenTransactionStats() && method.IsUserDefined();
+  const std::string record_stats =
+      stats ? "_aidl_stats_record(&" +
+                  cpp::TransactionStatsOf(defined_type, method, false /* isServer */) +
+                  ", _aidl_stats_time_ns, _aidl_stats_data_size, "
+                  "_aidl_out.get() != nullptr ? AParcel_getDataPosition(_aidl_out.get()) : 0, "
+                  "_aidl_stats_failed);\n"
+            : "";
+  if (stats) {
+    out << "uint64_t _aidl_stats_start = 0;\n";
+    out << "uint64_t _aidl_stats_time_ns = 0;\n";
+    out << "size_t _aidl_stats_data_size = 0;\n";
+    out << "bool _aidl_stats_failed = true;\n";
+  }
 
   if (return_value_cached_to) {
     out << "if (" << *return_value_cached_to << " != -1) {\n";
@@ -260,7 +314,7 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
 
   if (options.GenLog()) {
     out << cpp::GenLogBeforeExecute(ClassName(defined_type, ClassNames::CLIENT), method,
-                                    false /* isServer */, true /* isNdk */);
+                                    false /* isServer */, true /* isNdk */, options);
   }
 
   out << "_aidl_ret_status = AIBinder_prepareTransaction(asBinder().get(), _aidl_in.getR());\n";
@@ -280,6 +334,10 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
           << ");\n";
     }
   }
+  if (stats) {
+    out << "_aidl_stats_data_size = AParcel_getDataPosition(_aidl_in.get());\n";
+    out << "_aidl_stats_start = _aidl_stats_now();\n";
+  }
   out << "_aidl_ret_status = AIBinder_transact(\n";
   out.Indent();
   out << "asBinder().get(),\n";
@@ -288,6 +346,10 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
   out << "_aidl_out.getR(),\n";
   out << (method.IsOneway() ? "FLAG_ONEWAY" : "0") << ");\n";
   out.Dedent();
+  if (stats) {
+    out << "_aidl_stats_time_ns = _aidl_stats_now() - _aidl_stats_start;\n";
+    out << "_aidl_stats_failed = _aidl_ret_status != STATUS_OK;\n";
+  }
 
   // If the method is not implmented in the server side but the client has
   // provided the default implementation, call it instead of failing hard.
@@ -295,6 +357,7 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
   out << "if (_aidl_ret_status == STATUS_UNKNOWN_TRANSACTION && ";
   out << iface << "::getDefaultImpl()) {\n";
   out.Indent();
+  out << record_stats;
   out << "return " << iface << "::getDefaultImpl()->" << method.GetName() << "(";
   out << NdkArgList(types, method, FormatArgNameOnly) << ");\n";
   out.Dedent();
@@ -306,7 +369,16 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
     out << "_aidl_ret_status = AParcel_readStatusHeader(_aidl_out.get(), _aidl_status.getR());\n";
     StatusCheckGoto(out);
 
-    out << "if (!AStatus_isOk(_aidl_status.get())) return _aidl_status;\n\n";
+    if (stats) {
+      out << "if (!AStatus_isOk(_aidl_status.get())) {\n";
+      out << "  " << cpp::TransactionStatsOf(defined_type, method, false /* isServer */)
+          << ".exceptions.fetch_add(1, std::memory_order_relaxed);\n";
+      out << "  " << record_stats;
+      out << "  return _aidl_status;\n";
+      out << "}\n\n";
+    } else {
+      out << "if (!AStatus_isOk(_aidl_status.get())) return _aidl_status;\n\n";
+    }
   }
 
   if (method.GetType().GetName() != "void") {
@@ -326,22 +398,50 @@ static void GenerateClientMethodDefinition(CodeWriter& out, const AidlTypenames&
   }
 
   out << "_aidl_error:\n";
+  // Failing to write the data parcel skips the transaction, but not the count:
+  // it is recorded as a failure that took no time and sent nothing.
+  out << record_stats;
   out << "_aidl_status.set(AStatus_fromStatus(_aidl_ret_status));\n";
   if (options.GenLog()) {
     out << cpp::GenLogAfterExecute(ClassName(defined_type, ClassNames::CLIENT), defined_type,
                                    method, "_aidl_status", "_aidl_return", false /* isServer */,
-                                   true /* isNdk */);
+                                   true /* isNdk */, options);
   }
   out << "return _aidl_status;\n";
   out.Dedent();
   out << "}\n";
 }
 
+// The declaration of the table of the handlers of the transactions.
+static std::string TransactionTableDecl(const AidlInterface& defined_type) {
+  return std::string("binder_status_t (*") + kTransactionTable + "[])(const std::shared_ptr<" +
+         ClassName(defined_type, ClassNames::SERVER) + ">&, const AParcel*, AParcel*)";
+}
+
+// Handles the transactions of |method|, either in a case of the switch of
+// _aidl_onTransact, or in the handler of the method when |in_table|, which
+// returns where the case breaks. A |cold| handler is kept apart from the code
+// that runs often.
 static void GenerateServerCaseDefinition(CodeWriter& out, const AidlTypenames& types,
                                          const AidlInterface& defined_type,
-                                         const AidlMethod& method, const Options& options) {
-  out << "case " << MethodId(method) << ": {\n";
-  out.Indent();
+                                         const AidlMethod& method, const Options& options,
+                                         bool in_table, bool cold = false) {
+  const auto status_check = in_table ? StatusCheckReturn : StatusCheckBreak;
+  const std::string exit = in_table ? "return _aidl_ret_status;\n" : "break;\n";
+  if (in_table) {
+    const std::string bn_clazz = ClassName(defined_type, ClassNames::SERVER);
+    out << "static " << (cold ? "__attribute__((cold)) " : "") << "binder_status_t "
+        << cpp::TransactionHandlerName(method)
+        << "(const std::shared_ptr<" << bn_clazz
+        << ">& _aidl_impl, const AParcel* _aidl_in, AParcel* _aidl_out) {\n";
+    out.Indent();
+    out << "(void)_aidl_in;\n";
+    out << "(void)_aidl_out;\n";
+    out << "binder_status_t _aidl_ret_status = STATUS_OK;\n";
+  } else {
+    out << "case " << MethodId(method) << ": {\n";
+    out.Indent();
+  }
   for (const auto& arg : method.GetArguments()) {
     out << NdkNameOf(types, arg->GetType(), StorageMode::STACK) << " " << cpp::BuildVarName(*arg)
         << ";\n";
@@ -358,22 +458,26 @@ static void GenerateServerCaseDefinition(CodeWriter& out, const AidlTypenames& t
       out << "_aidl_ret_status = ";
       ReadFromParcelFor({out, types, arg->GetType(), "_aidl_in", "&" + var_name});
       out << ";\n";
-      StatusCheckBreak(out);
+      status_check(out);
     } else if (arg->IsOut() && arg->GetType().IsArray()) {
       out << "_aidl_ret_status = ::ndk::AParcel_resizeVector(_aidl_in, &" << var_name << ");\n";
     }
   }
   if (options.GenLog()) {
     out << cpp::GenLogBeforeExecute(ClassName(defined_type, ClassNames::SERVER), method,
-                                    true /* isServer */, true /* isNdk */);
+                                    true /* isServer */, true /* isNdk */, options);
   }
   out << "::ndk::ScopedAStatus _aidl_status = _aidl_impl->" << method.GetName() << "("
       << NdkArgList(types, method, FormatArgForCall) << ");\n";
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsException(defined_type, method, "_aidl_status",
+                                             true /* isServer */, true /* isNdk */);
+  }
 
   if (options.GenLog()) {
     out << cpp::GenLogAfterExecute(ClassName(defined_type, ClassNames::SERVER), defined_type,
                                    method, "_aidl_status", "_aidl_return", true /* isServer */,
-                                   true /* isNdk */);
+                                   true /* isNdk */, options);
   }
   if (method.IsOneway()) {
     // For a oneway transaction, the kernel will have already returned a result. This is for the
@@ -381,26 +485,29 @@ static void GenerateServerCaseDefinition(CodeWriter& out, const AidlTypenames& t
     out << "_aidl_ret_status = STATUS_OK;\n";
   } else {
     out << "_aidl_ret_status = AParcel_writeStatusHeader(_aidl_out, _aidl_status.get());\n";
-    StatusCheckBreak(out);
+    status_check(out);
 
-    out << "if (!AStatus_isOk(_aidl_status.get())) break;\n\n";
+    out << "if (!AStatus_isOk(_aidl_status.get())) " << exit << "\n";
 
     if (method.GetType().GetName() != "void") {
       out << "_aidl_ret_status = ";
       WriteToParcelFor({out, types, method.GetType(), "_aidl_out", "_aidl_return"});
       out << ";\n";
-      StatusCheckBreak(out);
+      status_check(out);
     }
     for (const AidlArgument* arg : method.GetOutArguments()) {
       out << "_aidl_ret_status = ";
       WriteToParcelFor({out, types, arg->GetType(), "_aidl_out", cpp::BuildVarName(*arg)});
       out << ";\n";
-      StatusCheckBreak(out);
+      status_check(out);
     }
   }
-  out << "break;\n";
+  out << exit;
   out.Dedent();
   out << "}\n";
+  if (in_table) {
+    out << "\n";
+  }
 }
 
 void GenerateClassSource(CodeWriter& out, const AidlTypenames& types,
@@ -408,8 +515,53 @@ void GenerateClassSource(CodeWriter& out, const AidlTypenames& types,
   const std::string clazz = ClassName(defined_type, ClassNames::INTERFACE);
   const std::string bn_clazz = ClassName(defined_type, ClassNames::SERVER);
 
+  // The proxy and the stub share the counters of --transaction_stats.
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsDefinitions(defined_type, true /* isNdk */);
+  }
+
+  // With a table, the transactions that have a handler in it are dispatched
+  // to it, and the switch handles the others.
+  const std::set<const AidlMethod*> table_methods =
+      cpp::TableTransactions(defined_type, options);
+  // The methods called most come first, see CallProfile.
+  const std::vector<const AidlMethod*> methods =
+      MethodsByCalls(defined_type, options.GetCallProfile());
+  std::set<const AidlMethod*> cold_methods;
+  if (options.GetCallProfile() != nullptr) {
+    cold_methods = options.GetCallProfile()->ColdMethods(defined_type);
+  }
+  std::vector<std::string> table_entries;
+  if (!table_methods.empty()) {
+    for (const AidlMethod* method : methods) {
+      if (table_methods.count(method) != 0) {
+        GenerateServerCaseDefinition(out, types, defined_type, *method, options,
+                                     true /* in_table */, cold_methods.count(method) != 0);
+      }
+    }
+    table_entries = cpp::TransactionTableEntries(table_methods);
+    out << "static constexpr " << TransactionTableDecl(defined_type) << " = {\n";
+    out.Indent();
+    for (const std::string& entry : table_entries) {
+      out << entry << ",\n";
+    }
+    out.Dedent();
+    out << "};\n\n";
+  }
+
+  // With --flight_recorder or --transaction_stats, _aidl_onTransact records
+  // each transaction once _aidl_handleTransaction has handled it. The parcel
+  // sizes are their data positions then, i.e. what the handler read and wrote,
+  // which is all of them unless it failed: AParcel_getDataSize is only in
+  // API 31.
+  const bool flight_recorder = options.FlightRecorderSize() > 0;
+  const bool stats = options.GenTransactionStats();
+  if (flight_recorder) {
+    out << cpp::GenFlightRecorderDefinitions(defined_type, bn_clazz, options, true /* isNdk */)
+        << "\n";
+  }
   out << "static binder_status_t "
-      << "_aidl_onTransact"
+      << (flight_recorder || stats ? "_aidl_handleTransaction" : "_aidl_onTransact")
       << "(AIBinder* _aidl_binder, transaction_code_t _aidl_code, const AParcel* _aidl_in, "
          "AParcel* _aidl_out) {\n";
   out.Indent();
@@ -421,10 +573,24 @@ void GenerateClassSource(CodeWriter& out, const AidlTypenames& types,
     // AIBinder_Class object which is associated with this class.
     out << "std::shared_ptr<" << bn_clazz << "> _aidl_impl = std::static_pointer_cast<" << bn_clazz
         << ">(::ndk::ICInterface::asInterface(_aidl_binder));\n";
+    if (!table_entries.empty()) {
+      // _aidl_index wraps around below FIRST_CALL_TRANSACTION.
+      out << "const transaction_code_t _aidl_index = _aidl_code - FIRST_CALL_TRANSACTION;\n";
+      out << "if (_aidl_index < " << std::to_string(table_entries.size()) << " && "
+          << kTransactionTable
+          << "[_aidl_index] != nullptr) {\n";
+      out.Indent();
+      out << "return " << kTransactionTable << "[_aidl_index](_aidl_impl, _aidl_in, _aidl_out);\n";
+      out.Dedent();
+      out << "}\n";
+    }
     out << "switch (_aidl_code) {\n";
     out.Indent();
-    for (const auto& method : defined_type.GetMethods()) {
-      GenerateServerCaseDefinition(out, types, defined_type, *method, options);
+    for (const AidlMethod* method : methods) {
+      if (table_methods.count(method) == 0) {
+        GenerateServerCaseDefinition(out, types, defined_type, *method, options,
+                                     false /* in_table */);
+      }
     }
     out.Dedent();
     out << "}\n";
@@ -436,6 +602,32 @@ void GenerateClassSource(CodeWriter& out, const AidlTypenames& types,
   out.Dedent();
   out << "};\n\n";
 
+  if (flight_recorder || stats) {
+    out << "static binder_status_t _aidl_onTransact(AIBinder* _aidl_binder, "
+           "transaction_code_t _aidl_code, const AParcel* _aidl_in, AParcel* _aidl_out) {\n";
+    out.Indent();
+    if (flight_recorder) {
+      out << "const uint64_t _aidl_flight_start = _aidl_flight_now();\n";
+    }
+    if (stats) {
+      out << "const uint64_t _aidl_stats_start = _aidl_stats_now();\n";
+    }
+    out << "binder_status_t _aidl_ret_status = "
+           "_aidl_handleTransaction(_aidl_binder, _aidl_code, _aidl_in, _aidl_out);\n";
+    if (flight_recorder) {
+      out << "_aidl_flight_record(_aidl_code, _aidl_ret_status, _aidl_flight_start, "
+             "AParcel_getDataPosition(_aidl_in), AParcel_getDataPosition(_aidl_out));\n";
+    }
+    if (stats) {
+      out << "_aidl_stats_record_server(_aidl_code, _aidl_stats_now() - _aidl_stats_start, "
+             "AParcel_getDataPosition(_aidl_in), AParcel_getDataPosition(_aidl_out), "
+             "_aidl_ret_status != STATUS_OK);\n";
+    }
+    out << "return _aidl_ret_status;\n";
+    out.Dedent();
+    out << "}\n\n";
+  }
+
   out << "static AIBinder_Class* " << kClazz << " = ::ndk::ICInterface::defineClass(" << clazz
       << "::" << kDescriptor << ", _aidl_onTransact);\n\n";
 }
@@ -446,7 +638,7 @@ void GenerateClientSource(CodeWriter& out, const AidlTypenames& types,
   out << clazz << "::" << clazz << "(const ::ndk::SpAIBinder& binder) : BpCInterface(binder) {}\n";
   out << clazz << "::~" << clazz << "() {}\n";
   if (options.GenLog()) {
-    out << "std::function<void(const Json::Value&)> " << clazz << "::logFunc;\n";
+    out << cpp::GenLogFuncDefinition(clazz, options);
   }
   out << "\n";
   for (const auto& method : defined_type.GetMethods()) {
@@ -458,6 +650,9 @@ void GenerateClientSource(CodeWriter& out, const AidlTypenames& types,
     GenerateClientMethodDefinition(out, types, defined_type, *method, return_value_cached_to,
                                    options);
   }
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsAccessorDefinition(defined_type, clazz, false /* isServer */);
+  }
 }
 void GenerateServerSource(CodeWriter& out, const AidlTypenames& types,
                           const AidlInterface& defined_type, const Options& options) {
@@ -468,7 +663,7 @@ void GenerateServerSource(CodeWriter& out, const AidlTypenames& types,
   out << clazz << "::" << clazz << "() {}\n";
   out << clazz << "::~" << clazz << "() {}\n";
   if (options.GenLog()) {
-    out << "std::function<void(const Json::Value&)> " << clazz << "::logFunc;\n";
+    out << cpp::GenLogFuncDefinition(clazz, options);
   }
   out << "::ndk::SpAIBinder " << clazz << "::createBinder() {\n";
   out.Indent();
@@ -476,6 +671,9 @@ void GenerateServerSource(CodeWriter& out, const AidlTypenames& types,
   out << "return ::ndk::SpAIBinder(binder);\n";
   out.Dedent();
   out << "}\n";
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsAccessorDefinition(defined_type, clazz, true /* isServer */);
+  }
 
   // Implement the meta methods
   for (const auto& method : defined_type.GetMethods()) {
@@ -611,10 +809,15 @@ void GenerateClientHeader(CodeWriter& out, const AidlTypenames& types,
   out << "\n";
   out << "#include <android/binder_ibinder.h>\n";
   if (options.GenLog()) {
-    out << "#include <json/value.h>\n";
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      out << "#include <json/value.h>\n";
+    }
     out << "#include <functional>\n";
     out << "#include <chrono>\n";
-    out << "#include <sstream>\n";
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      out << "#include <optional>\n";
+      out << "#include <sstream>\n";
+    }
   }
   out << "\n";
   EnterNdkNamespace(out, defined_type);
@@ -633,7 +836,10 @@ void GenerateClientHeader(CodeWriter& out, const AidlTypenames& types,
     out << "int32_t " << kCacheVariable << " = -1;\n";
   }
   if (options.GenLog()) {
-    out << "static std::function<void(const Json::Value&)> logFunc;\n";
+    out << cpp::GenLogDeclarations(options, true /* isNdk */);
+  }
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsAccessorDeclaration();
   }
   out.Dedent();
   out << "};\n";
@@ -669,7 +875,13 @@ void GenerateServerHeader(CodeWriter& out, const AidlTypenames& types,
     }
   }
   if (options.GenLog()) {
-    out << "static std::function<void(const Json::Value&)> logFunc;\n";
+    out << cpp::GenLogDeclarations(options, true /* isNdk */);
+  }
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsAccessorDeclaration();
+  }
+  if (options.FlightRecorderSize() > 0) {
+    out << cpp::GenFlightRecorderDeclaration();
   }
   out.Dedent();
   out << "protected:\n";
@@ -689,10 +901,19 @@ void GenerateInterfaceHeader(CodeWriter& out, const AidlTypenames& types,
   out << "#pragma once\n\n";
   out << "#include <android/binder_interface_utils.h>\n";
   if (options.GenLog()) {
-    out << "#include <json/value.h>\n";
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      out << "#include <json/value.h>\n";
+    }
     out << "#include <functional>\n";
     out << "#include <chrono>\n";
-    out << "#include <sstream>\n";
+    if (options.GetLogFormat() == Options::LogFormat::JSON) {
+      out << "#include <optional>\n";
+      out << "#include <sstream>\n";
+    }
+  }
+  if (options.GenTransactionStats()) {
+    out << "#include <stdint.h>\n";
+    out << "#include <vector>\n";
   }
   out << "\n";
 
@@ -724,6 +945,9 @@ void GenerateInterfaceHeader(CodeWriter& out, const AidlTypenames& types,
   out << "\n";
   out << "static const std::shared_ptr<" << clazz << ">& getDefaultImpl();";
   out << "\n";
+  if (options.GenTransactionStats()) {
+    out << cpp::GenTransactionStatsDeclarations();
+  }
   for (const auto& method : defined_type.GetMethods()) {
     out << "virtual " << NdkMethodDecl(types, *method) << " = 0;\n";
   }
@@ -16,6 +16,7 @@
 
 #include "import_resolver.h"
 #include "aidl_language.h"
+#include "time_trace.h"
 
 #include <android-base/file.h>
 #include <android-base/strings.h>
@@ -27,15 +28,49 @@
 
 #include "os.h"
 
+using std::set;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 namespace android {
 namespace aidl {
 
+const set<string>* DirectoryListings::Get(const string& dir) {
+  Listing* listing;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unique_ptr<Listing>& entry = listings_[dir];
+    if (entry == nullptr) {
+      entry.reset(new Listing);
+    }
+    listing = entry.get();
+  }
+  std::call_once(listing->listed, [&]() {
+    vector<string> names;
+    if (io_delegate_.ListDirectory(dir, &names)) {
+      listing->names.reset(new set<string>(names.begin(), names.end()));
+    }
+  });
+  return listing->names.get();
+}
+
+void DirectoryListings::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  listings_.clear();
+}
+
 ImportResolver::ImportResolver(const IoDelegate& io_delegate, const string& input_file_name,
-                               const set<string>& import_paths, const vector<string>& input_files)
-    : io_delegate_(io_delegate), input_file_name_(input_file_name), input_files_(input_files) {
+                               const set<string>& import_paths, const vector<string>& input_files,
+                               DirectoryListings* listings)
+    : io_delegate_(io_delegate),
+      input_file_name_(input_file_name),
+      input_files_(input_files),
+      listings_(listings) {
+  if (listings_ == nullptr) {
+    own_listings_.reset(new DirectoryListings(io_delegate));
+    listings_ = own_listings_.get();
+  }
   for (string path : import_paths) {
     if (path.empty()) {
       path = ".";
@@ -48,6 +83,12 @@ ImportResolver::ImportResolver(const IoDelegate& io_delegate, const string& inpu
 }
 
 string ImportResolver::FindImportFile(const string& canonical_name) const {
+  TimeTrace::Scope trace("FindImport", canonical_name);
+  auto cached = import_files_.find(canonical_name);
+  if (cached != import_files_.end()) {
+    return cached->second;
+  }
+
   // Convert the canonical name to a relative file path.
   string relative_path = canonical_name;
   for (char& c : relative_path) {
@@ -56,11 +97,19 @@ string ImportResolver::FindImportFile(const string& canonical_name) const {
     }
   }
   relative_path += ".aidl";
+  const size_t name_pos = relative_path.rfind(OS_PATH_SEPARATOR) + 1;
+  const string relative_dir = relative_path.substr(0, name_pos);
+  const string file_name = relative_path.substr(name_pos);
 
-  // Look for that relative path at each of our import roots.
+  // Look for that relative path at each of our import roots. Only the roots
+  // that have the file in their listing are asked whether it is readable.
   vector<string> found_paths;
-  for (string path : import_paths_) {
-    path = path + relative_path;
+  for (const string& import_path : import_paths_) {
+    const set<string>* entries = listings_->Get(import_path + relative_dir);
+    if (entries != nullptr && entries->find(file_name) == entries->end()) {
+      continue;
+    }
+    string path = import_path + relative_path;
     if (io_delegate_.FileIsReadable(path)) {
       found_paths.emplace_back(path);
     }
@@ -70,13 +119,11 @@ string ImportResolver::FindImportFile(const string& canonical_name) const {
   if (num_found == 0) {
     // If not found from the import paths, try to find from the input files
     relative_path.insert(0, 1, OS_PATH_SEPARATOR);
-    for (string input_file : input_files_) {
-      if (android::base::EndsWith(input_file, relative_path)) {
-        return input_file;
-      }
-    }
-    return "";
+    const string& input_file = FindInputFile(relative_path);
+    import_files_.emplace(canonical_name, input_file);
+    return input_file;
   } else if (num_found == 1) {
+    import_files_.emplace(canonical_name, found_paths.front());
     return found_paths.front();
   } else {
     AIDL_ERROR(input_file_name_) << "Duplicate files found for " << canonical_name
@@ -86,5 +133,20 @@ string ImportResolver::FindImportFile(const string& canonical_name) const {
   }
 }
 
+const string& ImportResolver::FindInputFile(const string& suffix) const {
+  static const string kNotFound;
+  if (!input_files_indexed_) {
+    for (const string& input_file : input_files_) {
+      for (size_t pos = input_file.find(OS_PATH_SEPARATOR); pos != string::npos;
+           pos = input_file.find(OS_PATH_SEPARATOR, pos + 1)) {
+        input_files_by_suffix_.emplace(input_file.substr(pos), input_file);
+      }
+    }
+    input_files_indexed_ = true;
+  }
+  auto it = input_files_by_suffix_.find(suffix);
+  return it != input_files_by_suffix_.end() ? it->second : kNotFound;
+}
+
 }  // namespace android
 }  // namespace aidl
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -27,23 +30,72 @@
 namespace android {
 namespace aidl {
 
+// The entries of the directories listed while resolving imports. Can be shared
+// by the ImportResolvers of all the inputs of an invocation, from multiple
+// threads.
+class DirectoryListings {
+ public:
+  explicit DirectoryListings(const IoDelegate& io_delegate) : io_delegate_(io_delegate) {}
+  ~DirectoryListings() = default;
+
+  // Returns the names of the entries of |dir|, or nullptr if it can't be
+  // listed. |dir| is only listed the first time it is asked for.
+  const std::set<std::string>* Get(const std::string& dir);
+
+  // Forgets the listings, as the directories may have changed since. Must not
+  // be called concurrently with Get, nor while its results are still in use.
+  void Clear();
+
+ private:
+  struct Listing {
+    std::once_flag listed;
+    std::unique_ptr<std::set<std::string>> names;
+  };
+
+  const IoDelegate& io_delegate_;
+  // Guards the map, but not the entries. Each entry is filled exactly once.
+  std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Listing>> listings_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryListings);
+};
+
 class ImportResolver {
  public:
+  // The directories are listed into |listings| when it is given, so that they
+  // are listed only once for all the resolvers sharing it.
   ImportResolver(const IoDelegate& io_delegate, const std::string& input_file_name,
                  const std::set<std::string>& import_paths,
-                 const std::vector<std::string>& input_files);
+                 const std::vector<std::string>& input_files,
+                 DirectoryListings* listings = nullptr);
   virtual ~ImportResolver() = default;
 
   // Resolve the canonical name for a class to a file that exists
   // in one of the import paths given to the ImportResolver.
+  //
+  // The directories of the import paths are listed once, when a class of the
+  // package they correspond to is first looked for, and only the files found
+  // that way are checked. Results are remembered, except when the class is
+  // found in more than one import path, so that the error is reported again.
   std::string FindImportFile(const std::string& canonical_name) const;
 
  private:
+  // Returns the first input file whose path ends with |suffix|, or "".
+  const std::string& FindInputFile(const std::string& suffix) const;
+
   const IoDelegate& io_delegate_;
   const std::string& input_file_name_;
   std::vector<std::string> import_paths_;
   std::vector<std::string> input_files_;
 
+  std::unique_ptr<DirectoryListings> own_listings_;
+  DirectoryListings* listings_;
+  // Input files by the suffixes of their paths that start at a separator.
+  // Built when first needed.
+  mutable std::map<std::string, std::string> input_files_by_suffix_;
+  mutable bool input_files_indexed_ = false;
+  mutable std::map<std::string, std::string> import_files_;
+
   DISALLOW_COPY_AND_ASSIGN(ImportResolver);
 };
 
@@ -16,20 +16,31 @@
 
 #include "io_delegate.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <cstring>
 #include <fstream>
+#include <random>
 #include <vector>
 
+#include <stdio.h>
+
 #ifdef _WIN32
 #include <direct.h>
+#include <windows.h>
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #endif
 
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 
 #include "logging.h"
 #include "os.h"
@@ -39,10 +50,109 @@ using std::unique_ptr;
 using std::vector;
 
 using android::base::Split;
+using android::base::StringPrintf;
 
 namespace android {
 namespace aidl {
 
+namespace {
+
+class StringFileBuffer : public FileBuffer {
+ public:
+  // |contents| must already end with the padding.
+  explicit StringFileBuffer(string contents) : contents_(std::move(contents)) {
+    data_ = &contents_[0];
+    size_ = contents_.size() - kPadding;
+  }
+  ~StringFileBuffer() override = default;
+
+ private:
+  string contents_;
+};
+
+#ifndef _WIN32
+// Files smaller than this are read, as that is cheaper than mapping them.
+constexpr off_t kMapThreshold = 64 * 1024;
+
+class MappedFileBuffer : public FileBuffer {
+ public:
+  ~MappedFileBuffer() override { munmap(mapping_, mapping_size_); }
+
+  // Maps the |size| bytes of |fd|. Returns nullptr on error.
+  static unique_ptr<FileBuffer> Map(int fd, size_t size) {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    // One more page than the file needs is reserved, so that there is room
+    // for the padding even when the file ends at a page boundary. The pages
+    // past the end of the file read as zeros.
+    const size_t mapping_size = (size / page_size + 1) * page_size;
+    void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      return nullptr;
+    }
+    if (mmap(mapping, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+        MAP_FAILED) {
+      munmap(mapping, mapping_size);
+      return nullptr;
+    }
+    unique_ptr<MappedFileBuffer> buffer(new MappedFileBuffer);
+    buffer->mapping_ = mapping;
+    buffer->mapping_size_ = mapping_size;
+    buffer->data_ = static_cast<char*>(mapping);
+    buffer->size_ = size;
+    return buffer;
+  }
+
+ private:
+  MappedFileBuffer() = default;
+
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+};
+
+// Reads |fd| until its end, expecting |size_hint| bytes. Returns nullptr on
+// error.
+unique_ptr<FileBuffer> ReadFileBuffer(int fd, size_t size_hint) {
+  // With room for the padding, a file of the expected size is read without
+  // growing the buffer.
+  string contents(size_hint + FileBuffer::kPadding, '\0');
+  size_t size = 0;
+  while (true) {
+    if (size == contents.size()) {
+      contents.resize(std::max<size_t>(contents.size() * 2, 4096));
+    }
+    ssize_t n = read(fd, &contents[size], contents.size() - size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return nullptr;
+    }
+    if (n == 0) {
+      break;
+    }
+    size += n;
+  }
+  contents.resize(size + FileBuffer::kPadding);
+  std::fill(contents.begin() + size, contents.end(), '\0');
+  return unique_ptr<FileBuffer>(new StringFileBuffer(std::move(contents)));
+}
+#endif
+
+}  // namespace
+
+unique_ptr<FileBuffer> FileBuffer::FromString(string contents) {
+  contents.append(kPadding, '\0');
+  return unique_ptr<FileBuffer>(new StringFileBuffer(std::move(contents)));
+}
+
+string IoDelegate::GetTempPath(const string& path) {
+  // The nonce tells processes apart, and the count threads.
+  static const uint32_t nonce = std::random_device()();
+  static std::atomic<uint32_t> count(0);
+  return StringPrintf("%s.%08x.%u.tmp", path.c_str(), nonce, count++);
+}
+
 bool IoDelegate::GetAbsolutePath(const string& path, string* absolute_path) {
 #ifdef _WIN32
 
@@ -104,6 +214,36 @@ unique_ptr<string> IoDelegate::GetFileContents(
   return contents;
 }
 
+unique_ptr<FileBuffer> IoDelegate::GetFileBuffer(const string& filename) const {
+#ifdef _WIN32
+  unique_ptr<string> contents = GetFileContents(filename);
+  if (contents == nullptr) {
+    return nullptr;
+  }
+  return FileBuffer::FromString(std::move(*contents));
+#else
+  android::base::unique_fd fd(open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd.get() < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd.get(), &st) != 0) {
+    return nullptr;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    // Pipes and the like have no size, and are read until they end.
+    return ReadFileBuffer(fd.get(), 0);
+  }
+  if (st.st_size >= kMapThreshold) {
+    unique_ptr<FileBuffer> buffer = MappedFileBuffer::Map(fd.get(), st.st_size);
+    if (buffer != nullptr) {
+      return buffer;
+    }
+  }
+  return ReadFileBuffer(fd.get(), st.st_size);
+#endif
+}
+
 unique_ptr<LineReader> IoDelegate::GetLineReader(
     const string& file_path) const {
   return LineReader::ReadFromFile(file_path);
@@ -119,6 +259,29 @@ bool IoDelegate::FileIsReadable(const string& path) const {
 #endif
 }
 
+bool IoDelegate::GetFileStamp(const string& path, FileStamp* stamp) const {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(path.c_str(), &st) != 0) {
+    return false;
+  }
+  stamp->mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+#ifdef __APPLE__
+  const struct timespec& mtime = st.st_mtimespec;
+#else
+  const struct timespec& mtime = st.st_mtim;
+#endif
+  stamp->mtime_ns = static_cast<int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+#endif
+  stamp->size = st.st_size;
+  return true;
+}
+
 static bool CreateNestedDirs(const string& caller_base_dir, const vector<string>& nested_subdirs) {
   string base_dir = caller_base_dir;
   if (base_dir.empty()) {
@@ -193,12 +356,25 @@ void IoDelegate::RemovePath(const std::string& file_path) const {
 #endif
 }
 
+bool IoDelegate::RenameFile(const string& from, const string& to) const {
+#ifdef _WIN32
+  // rename() fails there when |to| exists.
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
 #ifdef _WIN32
 vector<string> IoDelegate::ListFiles(const string&) const {
   vector<string> result;
   return result;
 }
 
+bool IoDelegate::ListDirectory(const string&, vector<string>*) const {
+  return false;
+}
+
 #else
 static void add_list_files(const string& dirname, vector<string>* result) {
   CHECK(result != nullptr);
@@ -222,7 +398,94 @@ vector<string> IoDelegate::ListFiles(const string& dir) const {
   add_list_files(dir, &result);
   return result;
 }
+
+bool IoDelegate::ListDirectory(const string& dir, vector<string>* names) const {
+  CHECK(names != nullptr);
+  std::unique_ptr<DIR, decltype(&closedir)> d(opendir(dir.c_str()), closedir);
+  if (d == nullptr) {
+    return errno == ENOENT || errno == ENOTDIR;
+  }
+  while (struct dirent* ent = readdir(d.get())) {
+    if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
+      continue;
+    }
+    names->emplace_back(ent->d_name);
+  }
+  return true;
+}
 #endif
 
+unique_ptr<string> WriteIfChangedIoDelegate::GetFileContents(const string& filename,
+                                                             const string& content_suffix) const {
+  return delegate_.GetFileContents(filename, content_suffix);
+}
+
+unique_ptr<LineReader> WriteIfChangedIoDelegate::GetLineReader(const string& file_path) const {
+  return delegate_.GetLineReader(file_path);
+}
+
+unique_ptr<FileBuffer> WriteIfChangedIoDelegate::GetFileBuffer(const string& filename) const {
+  return delegate_.GetFileBuffer(filename);
+}
+
+bool WriteIfChangedIoDelegate::FileIsReadable(const string& path) const {
+  return delegate_.FileIsReadable(path);
+}
+
+bool WriteIfChangedIoDelegate::GetFileStamp(const string& path, FileStamp* stamp) const {
+  return delegate_.GetFileStamp(path, stamp);
+}
+
+unique_ptr<CodeWriter> WriteIfChangedIoDelegate::GetCodeWriter(const string& file_path) const {
+  if (file_path == "-") {
+    return delegate_.GetCodeWriter(file_path);
+  }
+  return CodeWriter::ForCommit([this, file_path](const string& contents) {
+    return WriteIfChanged(file_path, contents);
+  });
+}
+
+void WriteIfChangedIoDelegate::RemovePath(const string& file_path) const {
+  delegate_.RemovePath(file_path);
+}
+
+bool WriteIfChangedIoDelegate::RenameFile(const string& from, const string& to) const {
+  return delegate_.RenameFile(from, to);
+}
+
+vector<string> WriteIfChangedIoDelegate::ListFiles(const string& dir) const {
+  return delegate_.ListFiles(dir);
+}
+
+bool WriteIfChangedIoDelegate::ListDirectory(const string& dir, vector<string>* names) const {
+  return delegate_.ListDirectory(dir, names);
+}
+
+bool WriteIfChangedIoDelegate::WriteIfChanged(const string& file_path,
+                                              const string& contents) const {
+  FileStamp stamp;
+  if (delegate_.GetFileStamp(file_path, &stamp) &&
+      stamp.size == static_cast<int64_t>(contents.size())) {
+    unique_ptr<FileBuffer> old_contents = delegate_.GetFileBuffer(file_path);
+    if (old_contents != nullptr && old_contents->size() == contents.size() &&
+        memcmp(old_contents->data(), contents.data(), contents.size()) == 0) {
+      return true;
+    }
+  }
+
+  const string temp_path = GetTempPath(file_path);
+  unique_ptr<CodeWriter> writer = delegate_.GetCodeWriter(temp_path);
+  if (writer == nullptr) {
+    return false;
+  }
+  const bool written = writer->WriteRaw(contents) && writer->Close();
+  writer.reset();
+  if (written && delegate_.RenameFile(temp_path, file_path)) {
+    return true;
+  }
+  delegate_.RemovePath(temp_path);
+  return false;
+}
+
 }  // namespace android
 }  // namespace aidl
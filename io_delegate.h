@@ -18,6 +18,8 @@
 
 #include <android-base/macros.h>
 
+#include <stdint.h>
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -28,11 +30,54 @@
 namespace android {
 namespace aidl {
 
+// The contents of a file, followed by kPadding NUL bytes that are not part of
+// them, so that they can be scanned in place. The contents are writable as
+// the scanner temporarily modifies them, but the writes never reach the file.
+class FileBuffer {
+ public:
+  static constexpr size_t kPadding = 2;
+
+  // Returns a buffer holding |contents|.
+  static std::unique_ptr<FileBuffer> FromString(std::string contents);
+
+  virtual ~FileBuffer() = default;
+
+  char* data() { return data_; }
+  const char* data() const { return data_; }
+  // Size of the contents, without the padding.
+  size_t size() const { return size_; }
+
+ protected:
+  FileBuffer() = default;
+
+  char* data_ = nullptr;
+  size_t size_ = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileBuffer);
+};
+
+// Identifies a version of a file. A file whose stamp didn't change is assumed
+// to have the same contents.
+struct FileStamp {
+  int64_t mtime_ns = 0;
+  int64_t size = 0;
+
+  bool operator==(const FileStamp& other) const {
+    return mtime_ns == other.mtime_ns && size == other.size;
+  }
+  bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
 class IoDelegate {
  public:
   IoDelegate() = default;
   virtual ~IoDelegate() = default;
 
+  // Returns a path next to |path| that no other thread or process uses, for
+  // a file that is written and then renamed to |path|.
+  static std::string GetTempPath(const std::string& path);
+
   // Stores an absolute version of |path| to |*absolute_path|,
   // possibly prefixing it with the current working directory.
   // Returns false and does not set |*absolute_path| on error.
@@ -48,15 +93,34 @@ class IoDelegate {
   virtual std::unique_ptr<LineReader> GetLineReader(
       const std::string& file_path) const;
 
+  // Returns the contents of |filename| in a buffer that can be scanned in
+  // place, or nullptr if the file can't be read. Large regular files are
+  // mapped instead of being read, so they are never copied.
+  virtual std::unique_ptr<FileBuffer> GetFileBuffer(const std::string& filename) const;
+
   virtual bool FileIsReadable(const std::string& path) const;
 
+  // Stores the modification time and the size of |path| to |*stamp|. Returns
+  // false if the file doesn't exist or can't be examined.
+  virtual bool GetFileStamp(const std::string& path, FileStamp* stamp) const;
+
   virtual std::unique_ptr<CodeWriter> GetCodeWriter(
       const std::string& file_path) const;
 
   virtual void RemovePath(const std::string& file_path) const;
 
+  // Moves the file |from| to |to|, replacing |to| at once if it exists.
+  // Returns false on error.
+  virtual bool RenameFile(const std::string& from, const std::string& to) const;
+
   virtual std::vector<std::string> ListFiles(const std::string& dir) const;
 
+  // Stores the names of the entries of |dir| to |*names|, without the
+  // directory. A directory that doesn't exist has no entries. Returns false
+  // if |dir| can't be listed otherwise, in which case the caller has to check
+  // the paths it is interested in one by one.
+  virtual bool ListDirectory(const std::string& dir, std::vector<std::string>* names) const;
+
  private:
   // Create the directory when path is a dir or the parent directory when
   // path is a file. Path is a dir if it ends with the path separator.
@@ -65,5 +129,39 @@ class IoDelegate {
   DISALLOW_COPY_AND_ASSIGN(IoDelegate);
 };  // class IoDelegate
 
+// Forwards to another IoDelegate, except that the files are only written if
+// their contents change. What depends on a file that was generated again,
+// e.g. the compilation of a generated source, is then not redone.
+//
+// A CodeWriter keeps the new contents in memory until it is closed. They are
+// then compared with the file, by size first. A file that changed is written
+// next to itself, and renamed over itself once complete.
+class WriteIfChangedIoDelegate : public IoDelegate {
+ public:
+  explicit WriteIfChangedIoDelegate(const IoDelegate& delegate) : delegate_(delegate) {}
+  virtual ~WriteIfChangedIoDelegate() = default;
+
+  std::unique_ptr<std::string> GetFileContents(
+      const std::string& filename, const std::string& content_suffix = "") const override;
+  std::unique_ptr<LineReader> GetLineReader(const std::string& file_path) const override;
+  std::unique_ptr<FileBuffer> GetFileBuffer(const std::string& filename) const override;
+  bool FileIsReadable(const std::string& path) const override;
+  bool GetFileStamp(const std::string& path, FileStamp* stamp) const override;
+  std::unique_ptr<CodeWriter> GetCodeWriter(const std::string& file_path) const override;
+  void RemovePath(const std::string& file_path) const override;
+  bool RenameFile(const std::string& from, const std::string& to) const override;
+  std::vector<std::string> ListFiles(const std::string& dir) const override;
+  bool ListDirectory(const std::string& dir, std::vector<std::string>* names) const override;
+
+ private:
+  // Writes |contents| to |file_path| unless it holds them already. Returns
+  // false on error.
+  bool WriteIfChanged(const std::string& file_path, const std::string& contents) const;
+
+  const IoDelegate& delegate_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteIfChangedIoDelegate);
+};
+
 }  // namespace android
 }  // namespace aidl
@@ -16,11 +16,22 @@
 
 #include <string>
 
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
 
 #include "io_delegate.h"
 
+using android::base::ReadFileToString;
+using android::base::StringPrintf;
+using android::base::WriteStringToFile;
 using std::string;
+using std::unique_ptr;
+using std::vector;
 
 namespace android {
 namespace aidl {
@@ -42,5 +53,91 @@ TEST(IoDelegateTest, CurrentlyInfersLinuxAbsolutePath) {
   EXPECT_EQ(absolute_path[0], '/');
 }
 
+TEST(IoDelegateTest, GetsFileBuffersWithPadding) {
+  IoDelegate io_delegate;
+  const string path = testing::TempDir() + "io_delegate_file_buffer";
+  // Small files are read, large ones are mapped. Some of them end at a page
+  // boundary.
+  for (size_t size : {0, 1, 4095, 4096, 65536, 100000}) {
+    string contents(size, 'x');
+    for (size_t i = 0; i < size; i++) {
+      contents[i] = 'a' + i % 26;
+    }
+    ASSERT_TRUE(WriteStringToFile(contents, path));
+    unique_ptr<FileBuffer> buffer = io_delegate.GetFileBuffer(path);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(contents, string(buffer->data(), buffer->size()));
+    for (size_t i = 0; i < FileBuffer::kPadding; i++) {
+      EXPECT_EQ('\0', buffer->data()[size + i]);
+    }
+    // The buffer can be written to without changing the file.
+    if (size > 0) {
+      buffer->data()[0] = '\0';
+      unique_ptr<FileBuffer> again = io_delegate.GetFileBuffer(path);
+      ASSERT_NE(nullptr, again);
+      EXPECT_EQ(contents, string(again->data(), again->size()));
+    }
+  }
+  unlink(path.c_str());
+  EXPECT_EQ(nullptr, io_delegate.GetFileBuffer(path));
+}
+
+TEST(IoDelegateTest, GetsFileBufferFromPipe) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  const string contents = "interface IFoo {}";
+  ASSERT_EQ(static_cast<ssize_t>(contents.size()),
+            write(fds[1], contents.data(), contents.size()));
+  close(fds[1]);
+  IoDelegate io_delegate;
+  unique_ptr<FileBuffer> buffer = io_delegate.GetFileBuffer(StringPrintf("/dev/fd/%d", fds[0]));
+  close(fds[0]);
+  ASSERT_NE(nullptr, buffer);
+  EXPECT_EQ(contents, string(buffer->data(), buffer->size()));
+  EXPECT_EQ('\0', buffer->data()[contents.size()]);
+}
+
+TEST(IoDelegateTest, WritesFilesOnlyIfChanged) {
+  IoDelegate io_delegate;
+  WriteIfChangedIoDelegate write_if_changed(io_delegate);
+  const string dir = testing::TempDir() + "io_delegate_write_if_changed/";
+  const string path = dir + "IFoo.java";
+  auto write = [&](const string& contents) {
+    CodeWriterPtr writer = write_if_changed.GetCodeWriter(path);
+    ASSERT_NE(nullptr, writer);
+    writer->Write("%s", contents.c_str());
+    EXPECT_TRUE(writer->Close());
+  };
+  auto mtime = [&]() {
+    struct stat st;
+    EXPECT_EQ(0, stat(path.c_str(), &st));
+    return st.st_mtime;
+  };
+
+  write("class IFoo {}\n");
+  string contents;
+  EXPECT_TRUE(ReadFileToString(path, &contents));
+  EXPECT_EQ("class IFoo {}\n", contents);
+
+  // Set an old modification time, which must be kept.
+  const struct utimbuf old_times = {1000, 1000};
+  ASSERT_EQ(0, utime(path.c_str(), &old_times));
+  write("class IFoo {}\n");
+  EXPECT_EQ(1000, mtime());
+
+  // Same size, other contents.
+  write("class IBar {}\n");
+  EXPECT_TRUE(ReadFileToString(path, &contents));
+  EXPECT_EQ("class IBar {}\n", contents);
+  EXPECT_NE(1000, mtime());
+
+  // No temporary file is left behind.
+  vector<string> names;
+  ASSERT_TRUE(io_delegate.ListDirectory(dir, &names));
+  EXPECT_EQ(vector<string>{"IFoo.java"}, names);
+  unlink(path.c_str());
+  rmdir(dir.c_str());
+}
+
 }  // namespace android
 }  // namespace aidl
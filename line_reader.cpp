@@ -16,6 +16,8 @@
 
 #include "line_reader.h"
 
+#include <string.h>
+
 #include <fstream>
 #include <sstream>
 
@@ -74,6 +76,41 @@ class MemoryLineReader : public LineReader {
   DISALLOW_COPY_AND_ASSIGN(MemoryLineReader);
 };  // class MemoryLineReader
 
+// Splits the lines the same way as MemoryLineReader, without copying the
+// buffer first. Like MemoryLineReader, and unlike a loop over std::getline, it
+// returns an empty last line after a trailing '\n', and one empty line for an
+// empty buffer.
+class BufferLineReader : public LineReader {
+ public:
+  BufferLineReader(const char* data, size_t size) : data_(data), size_(size) {}
+  ~BufferLineReader() override = default;
+
+  bool ReadLine(string* line) override {
+    if (at_end_) {
+      return false;
+    }
+    const char* begin = data_ + pos_;
+    const char* newline = static_cast<const char*>(memchr(begin, '\n', size_ - pos_));
+    if (newline == nullptr) {
+      line->assign(begin, size_ - pos_);
+      pos_ = size_;
+      at_end_ = true;
+    } else {
+      line->assign(begin, newline - begin);
+      pos_ = newline - data_ + 1;
+    }
+    return true;
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  bool at_end_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferLineReader);
+};  // class BufferLineReader
+
 unique_ptr<LineReader> LineReader::ReadFromFile(const string& file_path) {
   unique_ptr<FileLineReader> file_reader(new FileLineReader());
   unique_ptr<LineReader> ret;
@@ -87,5 +124,9 @@ unique_ptr<LineReader> LineReader::ReadFromMemory(const string& contents) {
   return unique_ptr<LineReader>(new MemoryLineReader(contents));
 }
 
+unique_ptr<LineReader> LineReader::ReadFromBuffer(const char* data, size_t size) {
+  return unique_ptr<LineReader>(new BufferLineReader(data, size));
+}
+
 }  // namespace android
 }  // namespace aidl
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <stddef.h>
+
 #include <memory>
 #include <string>
 
@@ -34,6 +36,9 @@ class LineReader {
       const std::string& file_path);
   static std::unique_ptr<LineReader> ReadFromMemory(
       const std::string& contents);
+  // Same as ReadFromMemory, but reads |size| bytes at |data| where they are.
+  // They must outlive the returned reader.
+  static std::unique_ptr<LineReader> ReadFromBuffer(const char* data, size_t size);
 
  private:
   DISALLOW_COPY_AND_ASSIGN(LineReader);
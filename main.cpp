@@ -15,7 +15,7 @@
  */
 
 #include "aidl.h"
-#include "aidl_apicheck.h"
+#include "aidl_server.h"
 #include "io_delegate.h"
 #include "logging.h"
 #include "options.h"
@@ -34,6 +34,10 @@ int main(int argc, char* argv[]) {
   android::base::InitLogging(argv);
   LOG(DEBUG) << "aidl starting";
   Options options(argc, argv, Options::Language::JAVA);
+  if (options.HelpRequested()) {
+    std::cerr << options.GetUsage();
+    return 0;
+  }
   if (!options.Ok()) {
     std::cerr << options.GetErrorMessage();
     std::cerr << options.GetUsage();
@@ -41,19 +45,15 @@ int main(int argc, char* argv[]) {
   }
 
   android::aidl::IoDelegate io_delegate;
-  switch (options.GetTask()) {
-    case Options::Task::COMPILE:
-      return android::aidl::compile_aidl(options, io_delegate);
-    case Options::Task::PREPROCESS:
-      return android::aidl::preprocess_aidl(options, io_delegate) ? 0 : 1;
-    case Options::Task::DUMP_API:
-      return android::aidl::dump_api(options, io_delegate) ? 0 : 1;
-    case Options::Task::CHECK_API:
-      return android::aidl::check_api(options, io_delegate) ? 0 : 1;
-    case Options::Task::DUMP_MAPPINGS:
-      return android::aidl::dump_mappings(options, io_delegate) ? 0 : 1;
-    default:
-      LOG(FATAL) << "aidl: internal error" << std::endl;
-      return 1;
+#ifndef _WIN32
+  if (options.GetTask() == Options::Task::SERVE) {
+    android::aidl::AidlServer server(io_delegate);
+    if (options.ServerSocket().empty()) {
+      return server.ServeStdio() ? 0 : 1;
+    }
+    server.Listen(options.ServerSocket());
+    return 1;
   }
+#endif
+  return android::aidl::run_task(options, io_delegate);
 }
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "aidl.h"
+#include "aidl_server.h"
+#include "io_delegate.h"
+#include "logging.h"
+#include "options.h"
+
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using android::aidl::Options;
+
+// aidl is leaky. Turn off LeakSanitizer by default. b/37749857
+extern "C" const char* __asan_default_options() {
+  return "detect_leaks=0";
+}
+
+// A drop-in replacement for aidl. When AIDL_SERVER_SOCKET names the socket of
+// an "aidl --server=SOCKET", the command line is run by that server.
+// Otherwise, if the server can't be reached, or if the command line writes to
+// the standard output, it is run by this process.
+int main(int argc, char* argv[]) {
+  android::base::InitLogging(argv);
+  LOG(DEBUG) << "aidl-client starting";
+
+  Options options(argc, argv, Options::Language::JAVA);
+  const char* socket_path = getenv("AIDL_SERVER_SOCKET");
+  char working_dir[PATH_MAX];
+  if (socket_path != nullptr && socket_path[0] != '\0' && !options.WritesToStandardOutput() &&
+      getcwd(working_dir, sizeof(working_dir)) != nullptr) {
+    // The server may go away while the request is being sent.
+    signal(SIGPIPE, SIG_IGN);
+    std::vector<std::string> args{"aidl"};
+    args.insert(args.end(), argv + 1, argv + argc);
+    int status;
+    std::string diagnostics;
+    if (android::aidl::AidlServer::SendRequest(socket_path, working_dir, args, &status,
+                                               &diagnostics)) {
+      std::cerr << diagnostics;
+      return status;
+    }
+  }
+
+  if (options.HelpRequested()) {
+    std::cerr << options.GetUsage();
+    return 0;
+  }
+  if (!options.Ok()) {
+    std::cerr << options.GetErrorMessage();
+    std::cerr << options.GetUsage();
+    return 1;
+  }
+  if (options.GetTask() == Options::Task::SERVE) {
+    std::cerr << "aidl-client can't be a server. Use aidl --server instead." << std::endl;
+    return 1;
+  }
+
+  android::aidl::IoDelegate io_delegate;
+  return android::aidl::run_task(options, io_delegate);
+}
@@ -33,6 +33,10 @@ int main(int argc, char* argv[]) {
   LOG(DEBUG) << "aidl starting";
 
   Options options(argc, argv, Options::Language::CPP);
+  if (options.HelpRequested()) {
+    std::cerr << options.GetUsage();
+    return 0;
+  }
   if (!options.Ok()) {
     std::cerr << options.GetErrorMessage();
     std::cerr << options.GetUsage();
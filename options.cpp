@@ -22,12 +22,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <algorithm>
-#include <iostream>
 #include <sstream>
 #include <string>
 
+#include <android-base/parseint.h>
 #include <android-base/strings.h>
 
+using android::base::ParseUint;
 using android::base::Split;
 using android::base::Trim;
 using std::endl;
@@ -36,14 +37,37 @@ using std::string;
 namespace android {
 namespace aidl {
 
+namespace {
+
+// Number of transactions recorded by --flight_recorder without N.
+constexpr size_t kDefaultFlightRecorderSize = 128;
+
+// Returns |dir| with a path separator at the end.
+string AsOutputDir(const string& dir) {
+  string result = Trim(dir);
+  if (result.empty() || result.back() != OS_PATH_SEPARATOR) {
+    result.push_back(OS_PATH_SEPARATOR);
+  }
+  return result;
+}
+
+}  // namespace
+
 string Options::GetUsage() const {
   std::ostringstream sstr;
   sstr << "usage:" << endl
        << myname_ << " --lang={java|cpp} [OPTION]... INPUT..." << endl
        << "   Generate Java or C++ files for AIDL file(s)." << endl
        << endl
+       << myname_ << " [--java_out=DIR] [--cpp_out=DIR --cpp_header_out=DIR]" << endl
+       << "     [--ndk_out=DIR --ndk_header_out=DIR] [OPTION]... INPUT..." << endl
+       << "   Generate the files of several languages for AIDL file(s), each" << endl
+       << "   language in its own directories. The inputs are parsed only once." << endl
+       << endl
        << myname_ << " --preprocess OUTPUT INPUT..." << endl
        << "   Create an AIDL file having declarations of AIDL file(s)." << endl
+       << "   --preprocess_format={text|binary} selects the format of OUTPUT." << endl
+       << "   The binary format is faster to load with -p. Default is text." << endl
        << endl
 #ifndef _WIN32
        << myname_ << " --dumpapi --out=DIR INPUT..." << endl
@@ -52,6 +76,17 @@ string Options::GetUsage() const {
        << myname_ << " --checkapi OLD_DIR NEW_DIR" << endl
        << "   Checkes whether API dump NEW_DIR is backwards compatible extension " << endl
        << "   of the API dump OLD_DIR." << endl
+       << endl
+       << myname_ << " --decode_flight_recorder=OUTPUT [--mappings=FILE]... DUMP..." << endl
+       << "   Write the transactions recorded in the dumps of --flight_recorder" << endl
+       << "   to OUTPUT, one per line. The methods are found in the FILEs" << endl
+       << "   written by --apimapping, to show their signature and location." << endl
+       << endl
+       << myname_ << " --server[=SOCKET]" << endl
+       << "   Run the command lines above as they are received, keeping the" << endl
+       << "   imports and preprocessed files parsed in between. The requests" << endl
+       << "   are sent by aidl-client to SOCKET, or written to the standard" << endl
+       << "   input if SOCKET is omitted." << endl
 #endif
        << endl;
 
@@ -72,7 +107,8 @@ string Options::GetUsage() const {
        << "  -m FILE, --import=FILE" << endl
        << "          Import FILE directly without searching in the search paths." << endl
        << "  -p FILE, --preprocessed=FILE" << endl
-       << "          Include FILE which is created by --preprocess." << endl
+       << "          Include FILE which is created by --preprocess, in either" << endl
+       << "          the text or the binary format." << endl
        << "  -d FILE, --dep=FILE" << endl
        << "          Generate dependency file as FILE. Don't use this when" << endl
        << "          there are multiple input files. Use -a then." << endl
@@ -107,9 +143,56 @@ string Options::GetUsage() const {
        << "  -v VER, --version=VER" << endl
        << "          Set the version of the interface and parcelable to VER." << endl
        << "          VER must be an interger greater than 0." << endl
-       << "  --log" << endl
+       << "  -j N, --jobs=N" << endl
+       << "          Compile up to N input files in parallel. The generated files" << endl
+       << "          and the reported errors are the same as with a single job." << endl
+       << "          N must be an integer greater than 0. Default is 1." << endl
+       << "  --cache_dir=DIR" << endl
+       << "          Keep the parse trees of the imported files in DIR, to be" << endl
+       << "          reused by later invocations. DIR can be shared by builds." << endl
+       << "  --write_if_changed" << endl
+       << "          Don't write the output files, including the dependency" << endl
+       << "          files, whose contents wouldn't change. They keep their" << endl
+       << "          modification time, so the build system must not expect" << endl
+       << "          it to change, e.g. ninja needs restat." << endl
+       << "  --time_trace=FILE" << endl
+       << "          Write how long each phase of the compilation of each input" << endl
+       << "          takes to FILE, in the Chrome trace-event JSON format that" << endl
+       << "          chrome://tracing and Perfetto can show." << endl
+       << "  --log[={json|typed}]" << endl
        << "          Information about the transaction, e.g., method name, argument" << endl
        << "          values, execution time, etc., is provided via callback." << endl
+       << "          With json, the default, the callback gets a Json::Value. With" << endl
+       << "          typed, it gets a TransactionLog that points at the values," << endl
+       << "          and the generated code doesn't depend on jsoncpp." << endl
+       << "  --transaction_table[=N]" << endl
+       << "          Handle each transaction of a C++ or NDK stub in its own" << endl
+       << "          function, which onTransact finds in a table indexed by the" << endl
+       << "          transaction code. The N methods with the fewest arguments" << endl
+       << "          stay inline in onTransact. Default is 0." << endl
+       << "  --profile=FILE" << endl
+       << "          Generate the stubs according to how often the methods are" << endl
+       << "          called, as given by FILE, which has one line" << endl
+       << "          \"<interface> <method> <calls>\" per method. The methods" << endl
+       << "          called most come first in onTransact. The others are moved" << endl
+       << "          out of it: the C++ and NDK stubs handle them through" << endl
+       << "          --transaction_table, and the Java stub outlines them." << endl
+       << "  --transaction_stats" << endl
+       << "          Count the transactions of each method in the C++ or NDK" << endl
+       << "          proxies and stubs: their number, their errors and" << endl
+       << "          exceptions, and histograms of how long they take and of" << endl
+       << "          the sizes of their parcels. The static getTransactionStats" << endl
+       << "          of the proxy or the stub returns them." << endl
+       << "  --flight_recorder[=N]" << endl
+       << "          Record the last N transactions of each stub in a lock-free" << endl
+       << "          ring buffer: the method, when it started, how long it took," << endl
+       << "          its status and the sizes of its parcels. The static" << endl
+       << "          dumpFlightRecorder of the stub dumps them, to be decoded" << endl
+       << "          with --decode_flight_recorder. Default is " << kDefaultFlightRecorderSize
+       << "." << endl
+       << "  --flight_recorder_arg_bytes=K" << endl
+       << "          Keep the first K bytes of the arguments of each" << endl
+       << "          transaction in its record. Only for --lang=cpp." << endl
        << "  --help" << endl
        << "          Show this help." << endl
        << endl
@@ -152,13 +235,17 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
     : myname_(argv[0]), language_(default_lang) {
   bool lang_option_found = false;
   optind = 0;
+  // Invalid options are reported with the other errors.
+  opterr = 0;
   while (true) {
     static struct option long_options[] = {
         {"lang", required_argument, 0, 'l'},
         {"preprocess", no_argument, 0, 's'},
+        {"preprocess_format", required_argument, 0, 'P'},
 #ifndef _WIN32
         {"dumpapi", no_argument, 0, 'u'},
         {"checkapi", no_argument, 0, 'A'},
+        {"server", optional_argument, 0, 'r'},
 #endif
         {"apimapping", required_argument, 0, 'i'},
         {"include", required_argument, 0, 'I'},
@@ -167,17 +254,33 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
         {"dep", required_argument, 0, 'd'},
         {"out", required_argument, 0, 'o'},
         {"header_out", required_argument, 0, 'h'},
+        {"java_out", required_argument, 0, 'J'},
+        {"cpp_out", required_argument, 0, 'X'},
+        {"cpp_header_out", required_argument, 0, 'H'},
+        {"ndk_out", required_argument, 0, 'N'},
+        {"ndk_header_out", required_argument, 0, 'D'},
         {"ninja", no_argument, 0, 'n'},
         {"structured", no_argument, 0, 'S'},
         {"trace", no_argument, 0, 't'},
         {"transaction_names", no_argument, 0, 'c'},
         {"version", required_argument, 0, 'v'},
-        {"log", no_argument, 0, 'L'},
+        {"log", optional_argument, 0, 'L'},
+        {"transaction_table", optional_argument, 0, 'B'},
+        {"profile", required_argument, 0, 'R'},
+        {"transaction_stats", no_argument, 0, 'Q'},
+        {"flight_recorder", optional_argument, 0, 'F'},
+        {"flight_recorder_arg_bytes", required_argument, 0, 'K'},
+        {"decode_flight_recorder", required_argument, 0, 'G'},
+        {"mappings", required_argument, 0, 'M'},
+        {"jobs", required_argument, 0, 'j'},
+        {"cache_dir", required_argument, 0, 'C'},
+        {"write_if_changed", no_argument, 0, 'W'},
+        {"time_trace", required_argument, 0, 'T'},
         {"help", no_argument, 0, 'e'},
         {0, 0, 0, 0},
     };
     const int c = getopt_long(argc, const_cast<char* const*>(argv),
-                              "I:m:p:d:o:h:abtv:", long_options, nullptr);
+                              "I:m:p:d:o:h:abtv:j:", long_options, nullptr);
     if (c == -1) {
       // no more options
       break;
@@ -225,6 +328,12 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
           structured_ = true;
         }
         break;
+      case 'r':
+        task_ = Options::Task::SERVE;
+        if (optarg != nullptr) {
+          server_socket_ = Trim(optarg);
+        }
+        break;
 #endif
       case 'I': {
         import_dirs_.emplace(Trim(optarg));
@@ -252,6 +361,24 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
           output_header_dir_.push_back(OS_PATH_SEPARATOR);
         }
         break;
+      case 'J':
+        language_output_dirs_[Options::Language::JAVA] = AsOutputDir(optarg);
+        task_ = Options::Task::COMPILE;
+        break;
+      case 'X':
+        language_output_dirs_[Options::Language::CPP] = AsOutputDir(optarg);
+        task_ = Options::Task::COMPILE;
+        break;
+      case 'H':
+        language_header_dirs_[Options::Language::CPP] = AsOutputDir(optarg);
+        break;
+      case 'N':
+        language_output_dirs_[Options::Language::NDK] = AsOutputDir(optarg);
+        task_ = Options::Task::COMPILE;
+        break;
+      case 'D':
+        language_header_dirs_[Options::Language::NDK] = AsOutputDir(optarg);
+        break;
       case 'n':
         dependency_file_ninja_ = true;
         break;
@@ -284,20 +411,144 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
       }
       case 'L':
         gen_log_ = true;
+        if (optarg != nullptr) {
+          const string format = Trim(optarg);
+          if (format == "json") {
+            log_format_ = LogFormat::JSON;
+          } else if (format == "typed") {
+            log_format_ = LogFormat::TYPED;
+          } else {
+            error_message_ << "Unsupported log format: '" << format << "'" << endl;
+            return;
+          }
+        }
+        break;
+      case 'B':
+        gen_transaction_table_ = true;
+        if (optarg != nullptr) {
+          const string count_str = Trim(optarg);
+          if (!ParseUint(count_str, &transaction_table_inline_count_)) {
+            error_message_ << "Invalid number of inline transactions: '" << count_str << "'."
+                           << endl;
+            return;
+          }
+        }
+        break;
+      case 'Q':
+        gen_transaction_stats_ = true;
+        break;
+      case 'F':
+        flight_recorder_size_ = kDefaultFlightRecorderSize;
+        if (optarg != nullptr) {
+          const string size_str = Trim(optarg);
+          if (!ParseUint(size_str, &flight_recorder_size_) || flight_recorder_size_ == 0) {
+            error_message_ << "Invalid number of recorded transactions: '" << size_str << "'. "
+                           << "It must be a positive natural number." << endl;
+            return;
+          }
+        }
+        break;
+      case 'K': {
+        const string bytes_str = Trim(optarg);
+        if (!ParseUint(bytes_str, &flight_recorder_arg_bytes_)) {
+          error_message_ << "Invalid number of recorded argument bytes: '" << bytes_str << "'."
+                         << endl;
+          return;
+        }
+        break;
+      }
+      case 'G':
+        output_file_ = Trim(optarg);
+        task_ = Task::DECODE_FLIGHT_RECORDER;
+        break;
+      case 'M':
+        mapping_files_.emplace_back(Trim(optarg));
+        break;
+      case 'P': {
+        const string format = Trim(optarg);
+        if (format == "text") {
+          preprocess_format_ = PreprocessFormat::TEXT;
+        } else if (format == "binary") {
+          preprocess_format_ = PreprocessFormat::BINARY;
+        } else {
+          error_message_ << "Unsupported preprocess format: '" << format << "'" << endl;
+          return;
+        }
+        preprocess_format_set_ = true;
+        break;
+      }
+      case 'j': {
+        const string jobs_str = Trim(optarg);
+        int jobs = atoi(jobs_str.c_str());
+        if (jobs > 0) {
+          jobs_ = jobs;
+        } else {
+          error_message_ << "Invalid number of jobs: '" << jobs_str << "'. "
+                         << "The number of jobs must be a positive natural number." << endl;
+          return;
+        }
+        break;
+      }
+      case 'C':
+        cache_dir_ = Trim(optarg);
+        break;
+      case 'W':
+        write_if_changed_ = true;
+        break;
+      case 'R':
+        profile_file_ = Trim(optarg);
+        break;
+      case 'T':
+        time_trace_file_ = Trim(optarg);
         break;
       case 'e':
-        std::cerr << GetUsage();
-        exit(0);
+        help_requested_ = true;
+        return;
       case 'i':
         output_file_ = Trim(optarg);
         task_ = Task::DUMP_MAPPINGS;
         break;
       default:
-        std::cerr << GetUsage();
-        exit(1);
+        error_message_ << "Invalid option: '" << argv[optind - 1] << "'" << endl;
+        return;
     }
   }  // while
 
+  if (!language_output_dirs_.empty() || !language_header_dirs_.empty()) {
+    if (default_lang == Options::Language::CPP) {
+      error_message_ << "aidl-cpp does not support --java_out, --cpp_out or --ndk_out." << endl;
+      return;
+    }
+    if (lang_option_found) {
+      error_message_ << "--lang can't be used with --java_out, --cpp_out or --ndk_out." << endl;
+      return;
+    }
+    if (!output_dir_.empty() || !output_header_dir_.empty()) {
+      error_message_ << "--out and --header_out can't be used with --java_out, --cpp_out or "
+                     << "--ndk_out, which set the output directories of each language." << endl;
+      return;
+    }
+    for (const auto& header_dir : language_header_dirs_) {
+      if (language_output_dirs_.count(header_dir.first) == 0) {
+        const char* name = header_dir.first == Options::Language::CPP ? "cpp" : "ndk";
+        error_message_ << "--" << name << "_header_out is set without --" << name << "_out."
+                       << endl;
+        return;
+      }
+    }
+    for (const auto& output_dir : language_output_dirs_) {
+      if (output_dir.first != Options::Language::JAVA &&
+          language_header_dirs_.count(output_dir.first) == 0) {
+        const char* name = output_dir.first == Options::Language::CPP ? "cpp" : "ndk";
+        error_message_ << "Header output directory is not set. Set with --" << name
+                       << "_header_out." << endl;
+        return;
+      }
+    }
+    language_ = language_output_dirs_.begin()->first;
+    lang_option_found = true;
+  }
+
   // Positional arguments
   if (!lang_option_found && task_ == Options::Task::COMPILE) {
     // the legacy arguments format
@@ -340,9 +591,15 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
       }
       error_message_ << endl;
     }
+  } else if (task_ == Options::Task::SERVE) {
+    if (argc - optind > 0) {
+      error_message_ << "--server takes no input file." << endl;
+      return;
+    }
   } else {
     // the new arguments format
-    if (task_ == Options::Task::COMPILE || task_ == Options::Task::DUMP_API) {
+    if (task_ == Options::Task::COMPILE || task_ == Options::Task::DUMP_API ||
+        task_ == Options::Task::DECODE_FLIGHT_RECORDER) {
       if (argc - optind < 1) {
         error_message_ << "No input file." << endl;
         return;
@@ -363,7 +620,7 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
   }
 
   // filter out invalid combinations
-  if (lang_option_found) {
+  if (lang_option_found && language_output_dirs_.empty()) {
     if (IsCppOutput() && task_ == Options::Task::COMPILE) {
       if (output_dir_.empty()) {
         error_message_ << "Output directory is not set. Set with --out." << endl;
@@ -407,16 +664,51 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
                      << "file." << endl;
       return;
     }
-    if (gen_log_ && (language_ != Options::Language::CPP && language_ != Options::Language::NDK)) {
-      error_message_ << "--log is currently supported for either --lang=cpp or --lang=ndk" << endl;
+    if (!dependency_file_.empty() && language_output_dirs_.size() > 1) {
+      error_message_ << "-d or --dep doesn't work when generating several languages. Use '-a' "
+                     << "to generate dependency file next to each output file." << endl;
       return;
     }
+    for (const Language lang : TargetLanguages()) {
+      if (gen_log_ && (lang != Options::Language::CPP && lang != Options::Language::NDK)) {
+        error_message_ << "--log is currently supported for either --lang=cpp or --lang=ndk"
+                       << endl;
+        return;
+      }
+      if (gen_transaction_table_ &&
+          (lang != Options::Language::CPP && lang != Options::Language::NDK)) {
+        error_message_ << "--transaction_table is only supported for --lang=cpp or --lang=ndk"
+                       << endl;
+        return;
+      }
+      if (gen_transaction_stats_ &&
+          (lang != Options::Language::CPP && lang != Options::Language::NDK)) {
+        error_message_ << "--transaction_stats is only supported for --lang=cpp or --lang=ndk"
+                       << endl;
+        return;
+      }
+      if (flight_recorder_arg_bytes_ > 0 && lang != Options::Language::CPP) {
+        error_message_ << "--flight_recorder_arg_bytes is only supported for --lang=cpp" << endl;
+        return;
+      }
+    }
+  }
+  if (flight_recorder_arg_bytes_ > 0 && flight_recorder_size_ == 0) {
+    error_message_ << "--flight_recorder_arg_bytes should be used with --flight_recorder." << endl;
+    return;
+  }
+  if (!mapping_files_.empty() && task_ != Options::Task::DECODE_FLIGHT_RECORDER) {
+    error_message_ << "--mappings should be used with --decode_flight_recorder." << endl;
+    return;
   }
   if (task_ == Options::Task::PREPROCESS) {
     if (version_ > 0) {
       error_message_ << "--version should not be used with '--preprocess'." << endl;
       return;
     }
+  } else if (preprocess_format_set_) {
+    error_message_ << "--preprocess_format should be used with '--preprocess'." << endl;
+    return;
   }
   if (task_ == Options::Task::CHECK_API) {
     if (input_files_.size() != 2) {
@@ -436,5 +728,37 @@ Options::Options(int argc, const char* const argv[], Options::Language default_l
   CHECK(output_header_dir_.empty() || output_header_dir_.back() == OS_PATH_SEPARATOR);
 }
 
+vector<Options::Language> Options::TargetLanguages() const {
+  if (language_output_dirs_.empty()) {
+    return {language_};
+  }
+  vector<Language> languages;
+  for (const auto& output_dir : language_output_dirs_) {
+    languages.push_back(output_dir.first);
+  }
+  return languages;
+}
+
+Options Options::WithCallProfile(std::shared_ptr<const CallProfile> profile) const {
+  Options options = *this;
+  options.call_profile_ = std::move(profile);
+  return options;
+}
+
+Options Options::ForLanguage(Language language) const {
+  Options options = *this;
+  if (language_output_dirs_.empty()) {
+    CHECK(language == language_);
+    return options;
+  }
+  options.language_ = language;
+  options.output_dir_ = language_output_dirs_.at(language);
+  auto header_dir = language_header_dirs_.find(language);
+  options.output_header_dir_ = header_dir != language_header_dirs_.end() ? header_dir->second : "";
+  options.language_output_dirs_.clear();
+  options.language_header_dirs_.clear();
+  return options;
+}
+
 }  // namespace android
 }  // namespace aidl
@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
@@ -27,6 +29,8 @@ using std::set;
 using std::string;
 using std::vector;
 
+class CallProfile;
+
 // A simple wrapper around ostringstream. This is just to make Options class
 // copiable by the implicit copy constructor. If ostingstream is not wrapped,
 // the implcit copy constructor is not generated because ostringstream isn't
@@ -61,7 +65,22 @@ class Options final {
  public:
   enum class Language { UNSPECIFIED, JAVA, CPP, NDK };
 
-  enum class Task { UNSPECIFIED, COMPILE, PREPROCESS, DUMP_API, CHECK_API, DUMP_MAPPINGS };
+  enum class Task {
+    UNSPECIFIED,
+    COMPILE,
+    PREPROCESS,
+    DUMP_API,
+    CHECK_API,
+    DUMP_MAPPINGS,
+    DECODE_FLIGHT_RECORDER,
+    SERVE,
+  };
+
+  enum class PreprocessFormat { TEXT, BINARY };
+
+  // What the callback that --log installs gets: a Json::Value, or a
+  // TransactionLog with the addresses of the values, which doesn't allocate.
+  enum class LogFormat { JSON, TYPED };
 
   Options(int argc, const char* const argv[], Language default_lang = Language::UNSPECIFIED);
 
@@ -77,6 +96,19 @@ class Options final {
   Language TargetLanguage() const { return language_; }
   bool IsCppOutput() const { return language_ == Language::CPP || language_ == Language::NDK; }
 
+  // The languages to generate, in the order they are generated. There are
+  // several of them when --java_out, --cpp_out or --ndk_out are used instead
+  // of --lang, and TargetLanguage() is then the first of them.
+  vector<Language> TargetLanguages() const;
+
+  // The options of this invocation as if it generated |language| alone, with
+  // the output directories given for it.
+  Options ForLanguage(Language language) const;
+
+  // These options with |profile| as the call profile given by --profile,
+  // once it is loaded.
+  Options WithCallProfile(std::shared_ptr<const CallProfile> profile) const;
+
   Task GetTask() const { return task_; }
 
   const set<string>& ImportDirs() const { return import_dirs_; }
@@ -85,6 +117,9 @@ class Options final {
 
   const vector<string>& PreprocessedFiles() const { return preprocessed_files_; }
 
+  // Format of the file written by --preprocess.
+  PreprocessFormat GetPreprocessFormat() const { return preprocess_format_; }
+
   string DependencyFile() const {
     return dependency_file_;
   }
@@ -117,6 +152,65 @@ class Options final {
   int Version() const { return version_; }
 
   bool GenLog() const { return gen_log_; }
+  LogFormat GetLogFormat() const { return log_format_; }
+
+  // With --transaction_table, the C++ and NDK stubs handle each transaction
+  // in its own function, found through a table indexed by the transaction
+  // code, instead of inline in the switch of onTransact.
+  bool GenTransactionTable() const { return gen_transaction_table_; }
+  // Number of methods whose transactions stay inline in the switch, when
+  // GenTransactionTable().
+  size_t TransactionTableInlineCount() const { return transaction_table_inline_count_; }
+
+  // Number of transactions that --flight_recorder keeps the record of, for
+  // each interface. 0 if they aren't recorded.
+  size_t FlightRecorderSize() const { return flight_recorder_size_; }
+  // Number of bytes of the arguments of each transaction that are kept in its
+  // record, with --flight_recorder_arg_bytes. Only the C++ stubs keep them.
+  size_t FlightRecorderArgBytes() const { return flight_recorder_arg_bytes_; }
+  // The files written by --apimapping that --decode_flight_recorder finds the
+  // methods of the records in.
+  const vector<string>& MappingFiles() const { return mapping_files_; }
+
+  // With --transaction_stats, the C++ and NDK proxies and stubs keep
+  // statistics of the transactions of each method, which their static
+  // getTransactionStats returns.
+  bool GenTransactionStats() const { return gen_transaction_stats_; }
+
+  // The call profile given by --profile=FILE, see CallProfile. Empty if there
+  // is none.
+  const string& ProfileFile() const { return profile_file_; }
+  // The profile loaded from ProfileFile(), or nullptr until it is loaded with
+  // WithCallProfile().
+  const CallProfile* GetCallProfile() const { return call_profile_.get(); }
+
+  // Maximum number of input files that are compiled concurrently.
+  int Jobs() const { return jobs_; }
+
+  // Directory where the parse trees of the imports are kept across
+  // invocations. Empty if they aren't.
+  const string& CacheDir() const { return cache_dir_; }
+
+  // Leave the output files that wouldn't change alone, see
+  // WriteIfChangedIoDelegate.
+  bool WriteIfChanged() const { return write_if_changed_; }
+
+  // Where --time_trace writes the time spent in each phase of the
+  // compilation, see TimeTrace. Empty if it isn't traced.
+  const string& TimeTraceFile() const { return time_trace_file_; }
+
+  // Path of the Unix socket that --server listens on. Empty if the requests
+  // are read from the standard input.
+  const string& ServerSocket() const { return server_socket_; }
+
+  // True if an output file is "-", which is the standard output. A server
+  // can't run such a command line, as its standard output isn't the client's.
+  bool WritesToStandardOutput() const {
+    return output_file_ == "-" || dependency_file_ == "-" || time_trace_file_ == "-";
+  }
+
+  // True if --help was given. The usage is then all there is to print.
+  bool HelpRequested() const { return help_requested_; }
 
   bool Ok() const { return error_message_.stream_.str().empty(); }
 
@@ -142,18 +236,38 @@ class Options final {
   set<string> import_dirs_;
   set<string> import_files_;
   vector<string> preprocessed_files_;
+  PreprocessFormat preprocess_format_ = PreprocessFormat::TEXT;
+  bool preprocess_format_set_ = false;
   string dependency_file_;
   bool gen_traces_ = false;
   bool gen_transaction_names_ = false;
   bool dependency_file_ninja_ = false;
   string output_dir_;
   string output_header_dir_;
+  // The output directories of each language, when several are generated.
+  std::map<Language, string> language_output_dirs_;
+  std::map<Language, string> language_header_dirs_;
   bool fail_on_parcelable_ = false;
   bool auto_dep_file_ = false;
   vector<string> input_files_;
   string output_file_;
   int version_ = 0;
   bool gen_log_ = false;
+  LogFormat log_format_ = LogFormat::JSON;
+  bool gen_transaction_table_ = false;
+  size_t transaction_table_inline_count_ = 0;
+  bool gen_transaction_stats_ = false;
+  size_t flight_recorder_size_ = 0;
+  size_t flight_recorder_arg_bytes_ = 0;
+  vector<string> mapping_files_;
+  string profile_file_;
+  std::shared_ptr<const CallProfile> call_profile_;
+  int jobs_ = 1;
+  string cache_dir_;
+  bool write_if_changed_ = false;
+  string time_trace_file_;
+  string server_socket_;
+  bool help_requested_ = false;
   ErrorMessage error_message_;
 };
 
@@ -276,5 +276,191 @@ TEST(OptionsTests, ParsesCompileCppInvalid) {
   EXPECT_EQ(false, GetOptions(arg_with_no_header_dir)->Ok());
 }
 
+TEST(OptionsTests, ParsesCompileSeveralLanguages) {
+  const char* argv[] = {
+      "aidl",
+      "--ndk_out=ndk",
+      "--ndk_header_out=ndk_h",
+      "--java_out=java",
+      "--cpp_out=cpp",
+      "--cpp_header_out=cpp_h",
+      "directory/input.aidl",
+      nullptr,
+  };
+  unique_ptr<Options> options = GetOptions(argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(Options::Task::COMPILE, options->GetTask());
+  const vector<Options::Language> expected_languages{
+      Options::Language::JAVA, Options::Language::CPP, Options::Language::NDK};
+  EXPECT_EQ(expected_languages, options->TargetLanguages());
+  EXPECT_EQ(Options::Language::JAVA, options->TargetLanguage());
+
+  Options java = options->ForLanguage(Options::Language::JAVA);
+  EXPECT_EQ(Options::Language::JAVA, java.TargetLanguage());
+  EXPECT_EQ(string{"java/"}, java.OutputDir());
+  EXPECT_EQ(string{""}, java.OutputHeaderDir());
+  Options ndk = options->ForLanguage(Options::Language::NDK);
+  EXPECT_EQ(Options::Language::NDK, ndk.TargetLanguage());
+  EXPECT_EQ(string{"ndk/"}, ndk.OutputDir());
+  EXPECT_EQ(string{"ndk_h/"}, ndk.OutputHeaderDir());
+  const vector<Options::Language> expected_ndk{Options::Language::NDK};
+  EXPECT_EQ(expected_ndk, ndk.TargetLanguages());
+}
+
+TEST(OptionsTests, ParsesCompileSeveralLanguagesInvalid) {
+  const char* arg_with_no_header_dir[] = {"aidl", "--java_out=java", "--cpp_out=cpp",
+                                          "directory/input.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(arg_with_no_header_dir)->Ok());
+
+  const char* arg_with_lang[] = {"aidl", "--lang=java", "--java_out=java",
+                                 "directory/input.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(arg_with_lang)->Ok());
+
+  const char* arg_with_out[] = {"aidl", "-o out", "--java_out=java", "directory/input.aidl",
+                                nullptr};
+  EXPECT_EQ(false, GetOptions(arg_with_out)->Ok());
+
+  const char* arg_with_dep[] = {
+      "aidl",   "--java_out=java",      "--ndk_out=ndk", "--ndk_header_out=ndk_h",
+      "-d dep", "directory/input.aidl", nullptr,
+  };
+  EXPECT_EQ(false, GetOptions(arg_with_dep)->Ok());
+}
+
+TEST(OptionsTests, ParsesServer) {
+  const char* stdio_argv[] = {"aidl", "--server", nullptr};
+  unique_ptr<Options> options = GetOptions(stdio_argv);
+  EXPECT_EQ(Options::Task::SERVE, options->GetTask());
+  EXPECT_EQ(string{""}, options->ServerSocket());
+
+  const char* socket_argv[] = {"aidl", "--server=/tmp/aidl.sock", nullptr};
+  options = GetOptions(socket_argv);
+  EXPECT_EQ(Options::Task::SERVE, options->GetTask());
+  EXPECT_EQ(string{"/tmp/aidl.sock"}, options->ServerSocket());
+
+  const char* arg_with_input[] = {"aidl", "--server", "directory/input1.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(arg_with_input)->Ok());
+}
+
+TEST(OptionsTests, ParsesTransactionTable) {
+  const char* default_argv[] = {"aidl", "--lang=cpp", "-o", "out", "-h", "out/include",
+                                "--transaction_table", "foo/bar/IFoo.aidl", nullptr};
+  unique_ptr<Options> options = GetOptions(default_argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(true, options->GenTransactionTable());
+  EXPECT_EQ(0u, options->TransactionTableInlineCount());
+
+  const char* count_argv[] = {"aidl", "--lang=ndk", "-o", "out", "-h", "out/include",
+                              "--transaction_table=2", "foo/bar/IFoo.aidl", nullptr};
+  options = GetOptions(count_argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(2u, options->TransactionTableInlineCount());
+
+  const char* invalid_count_argv[] = {"aidl", "--lang=cpp", "-o", "out", "-h", "out/include",
+                                      "--transaction_table=x", "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(invalid_count_argv)->Ok());
+
+  const char* java_argv[] = {"aidl", "--lang=java", "-o", "out", "--transaction_table",
+                             "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(java_argv)->Ok());
+}
+
+TEST(OptionsTests, ParsesLogFormat) {
+  const char* json_argv[] = {"aidl", "--lang=cpp", "--log", "-o", "out", "-h", "out/include",
+                             "foo/bar/IFoo.aidl", nullptr};
+  unique_ptr<Options> options = GetOptions(json_argv);
+  EXPECT_EQ(true, options->GenLog());
+  EXPECT_EQ(Options::LogFormat::JSON, options->GetLogFormat());
+
+  const char* typed_argv[] = {"aidl", "--lang=ndk", "--log=typed", "-o", "out", "-h",
+                              "out/include", "foo/bar/IFoo.aidl", nullptr};
+  options = GetOptions(typed_argv);
+  EXPECT_EQ(true, options->GenLog());
+  EXPECT_EQ(Options::LogFormat::TYPED, options->GetLogFormat());
+
+  const char* invalid_argv[] = {"aidl", "--lang=cpp", "--log=xml", "-o", "out", "-h",
+                                "out/include", "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(invalid_argv)->Ok());
+}
+
+TEST(OptionsTests, ParsesProfile) {
+  const char* argv[] = {"aidl", "--lang=java", "--profile=calls.txt", "-o", "out",
+                        "foo/bar/IFoo.aidl", nullptr};
+  unique_ptr<Options> options = GetOptions(argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(string{"calls.txt"}, options->ProfileFile());
+  // The profile is only loaded when compiling.
+  EXPECT_EQ(nullptr, options->GetCallProfile());
+}
+
+TEST(OptionsTests, ParsesTransactionStats) {
+  const char* argv[] = {"aidl", "--lang=ndk", "--transaction_stats", "-o", "out", "-h",
+                        "out/include", "foo/bar/IFoo.aidl", nullptr};
+  unique_ptr<Options> options = GetOptions(argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(true, options->GenTransactionStats());
+
+  const char* java_argv[] = {"aidl", "--lang=java", "--transaction_stats", "-o", "out",
+                             "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(java_argv)->Ok());
+}
+
+TEST(OptionsTests, ParsesFlightRecorder) {
+  const char* default_argv[] = {"aidl", "--lang=ndk", "--flight_recorder", "-o", "out", "-h",
+                                "out/include", "foo/bar/IFoo.aidl", nullptr};
+  unique_ptr<Options> options = GetOptions(default_argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(128u, options->FlightRecorderSize());
+  EXPECT_EQ(0u, options->FlightRecorderArgBytes());
+
+  const char* args_argv[] = {"aidl", "--lang=cpp", "--flight_recorder=16",
+                             "--flight_recorder_arg_bytes=32", "-o", "out", "-h",
+                             "out/include", "foo/bar/IFoo.aidl", nullptr};
+  options = GetOptions(args_argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(16u, options->FlightRecorderSize());
+  EXPECT_EQ(32u, options->FlightRecorderArgBytes());
+
+  const char* zero_argv[] = {"aidl", "--lang=java", "--flight_recorder=0", "-o", "out",
+                             "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(zero_argv)->Ok());
+
+  // Only the C++ stubs record the arguments, and only with --flight_recorder.
+  const char* java_args_argv[] = {"aidl", "--lang=java", "--flight_recorder",
+                                  "--flight_recorder_arg_bytes=8", "-o", "out",
+                                  "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(java_args_argv)->Ok());
+  const char* no_recorder_argv[] = {"aidl", "--lang=cpp", "--flight_recorder_arg_bytes=8", "-o",
+                                    "out", "-h", "out/include", "foo/bar/IFoo.aidl", nullptr};
+  EXPECT_EQ(false, GetOptions(no_recorder_argv)->Ok());
+}
+
+TEST(OptionsTests, ParsesDecodeFlightRecorder) {
+  const char* argv[] = {"aidl",       "--decode_flight_recorder=calls.txt", "--mappings=a.txt",
+                        "--mappings=b.txt", "dump1",                         "dump2",
+                        nullptr};
+  unique_ptr<Options> options = GetOptions(argv);
+  EXPECT_EQ(true, options->Ok());
+  EXPECT_EQ(Options::Task::DECODE_FLIGHT_RECORDER, options->GetTask());
+  EXPECT_EQ(string{"calls.txt"}, options->OutputFile());
+  EXPECT_EQ((vector<string>{"a.txt", "b.txt"}), options->MappingFiles());
+  EXPECT_EQ((vector<string>{"dump1", "dump2"}), options->InputFiles());
+
+  const char* no_dump_argv[] = {"aidl", "--decode_flight_recorder=calls.txt", nullptr};
+  EXPECT_EQ(false, GetOptions(no_dump_argv)->Ok());
+}
+
+TEST(OptionsTests, ReportsInvalidOptions) {
+  const char* help_argv[] = {"aidl", "--help", nullptr};
+  unique_ptr<Options> options = GetOptions(help_argv);
+  EXPECT_EQ(true, options->HelpRequested());
+  EXPECT_EQ(true, options->Ok());
+
+  const char* bogus_argv[] = {"aidl", "--bogus", "directory/input1.aidl", nullptr};
+  options = GetOptions(bogus_argv);
+  EXPECT_EQ(false, options->Ok());
+  EXPECT_EQ(string{"Invalid option: '--bogus'\n"}, options->GetErrorMessage());
+}
+
 }  // namespace android
 }  // namespace aidl
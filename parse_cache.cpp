@@ -0,0 +1,688 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "parse_cache.h"
+
+#include <string.h>
+
+#include <memory>
+#include <utility>
+
+#include <android-base/stringprintf.h>
+
+#include "aidl_arena.h"
+#include "aidl_language.h"
+#include "os.h"
+
+using android::base::StringPrintf;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace aidl {
+
+namespace {
+
+constexpr char kMagic[8] = {'\x7f', 'A', 'I', 'D', 'L', 'P', 'C', '\0'};
+
+constexpr uint32_t kParcelable = 0;
+constexpr uint32_t kStructuredParcelable = 1;
+constexpr uint32_t kInterface = 2;
+
+// Flags of a type specifier.
+constexpr uint32_t kIsArray = 1;
+constexpr uint32_t kIsGeneric = 2;
+
+// Flags of a method.
+constexpr uint32_t kIsOneway = 1;
+constexpr uint32_t kHasId = 2;
+constexpr uint32_t kIsUserDefined = 4;
+
+void AppendUint32(uint32_t value, string* out) {
+  out->push_back(static_cast<char>(value & 0xff));
+  out->push_back(static_cast<char>((value >> 8) & 0xff));
+  out->push_back(static_cast<char>((value >> 16) & 0xff));
+  out->push_back(static_cast<char>((value >> 24) & 0xff));
+}
+
+// 64-bit FNV-1a.
+uint64_t Hash(const char* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Returns true if |name| can be split into the terms of an AidlQualifiedName.
+bool IsQualifiedName(const string& name) {
+  return !name.empty() && name.front() != '.' && name.back() != '.' &&
+         name.find("..") == string::npos;
+}
+
+}  // namespace
+
+class ParseCache::Writer final {
+ public:
+  explicit Writer(string* out) : out_(out) {}
+
+  // Returns false if |types| can't be stored, e.g. because of an invalid
+  // constant.
+  bool WriteTypes(const vector<AidlDefinedType*>& types) {
+    AppendUint32(types.size(), out_);
+    for (const AidlDefinedType* type : types) {
+      if (!WriteType(*type)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  void WriteString(const string& str) {
+    AppendUint32(str.size(), out_);
+    out_->append(str);
+  }
+
+  void WriteLocation(const AidlNode& node) {
+    const AidlLocation& location = node.location_;
+    AppendUint32(location.begin_.line, out_);
+    AppendUint32(location.begin_.column, out_);
+    AppendUint32(location.end_.line, out_);
+    AppendUint32(location.end_.column, out_);
+  }
+
+  void WriteAnnotations(const AidlAnnotatable& annotatable) {
+    AppendUint32(annotatable.GetAnnotations().size(), out_);
+    for (const AidlAnnotation& annotation : annotatable.GetAnnotations()) {
+      WriteLocation(annotation);
+      WriteString(annotation.GetName());
+      WriteString(annotation.GetComments().ToString());
+    }
+  }
+
+  void WriteTypeSpecifier(const AidlTypeSpecifier& type) {
+    WriteLocation(type);
+    WriteAnnotations(type);
+    WriteString(type.GetUnresolvedName());
+    WriteString(type.GetComments());
+    AppendUint32((type.IsArray() ? kIsArray : 0) | (type.IsGeneric() ? kIsGeneric : 0), out_);
+    if (type.IsGeneric()) {
+      AppendUint32(type.GetTypeParameters().size(), out_);
+      for (const auto& param : type.GetTypeParameters()) {
+        WriteTypeSpecifier(*param);
+      }
+    }
+  }
+
+  bool WriteValue(const AidlConstantValue& value) {
+    if (value.type_ == AidlConstantValue::Type::ERROR) {
+      return false;
+    }
+    WriteLocation(value);
+    AppendUint32(static_cast<uint32_t>(value.type_), out_);
+    if (value.type_ != AidlConstantValue::Type::ARRAY) {
+      WriteString(value.value_);
+      return true;
+    }
+    AppendUint32(value.values_.size(), out_);
+    for (const auto& element : value.values_) {
+      if (!WriteValue(*element)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool WriteVariable(const AidlVariableDeclaration& variable) {
+    WriteLocation(variable);
+    WriteTypeSpecifier(variable.GetType());
+    WriteString(variable.GetName());
+    const AidlConstantValue* default_value = variable.GetDefaultValue();
+    AppendUint32(default_value != nullptr, out_);
+    return default_value == nullptr || WriteValue(*default_value);
+  }
+
+  void WriteMethod(const AidlMethod& method) {
+    WriteLocation(method);
+    AppendUint32((method.IsOneway() ? kIsOneway : 0) | (method.HasId() ? kHasId : 0) |
+                     (method.IsUserDefined() ? kIsUserDefined : 0),
+                 out_);
+    AppendUint32(method.GetId(), out_);
+    WriteTypeSpecifier(method.GetType());
+    WriteString(method.GetName());
+    WriteString(method.GetComments());
+    AppendUint32(method.GetArguments().size(), out_);
+    for (const auto& arg : method.GetArguments()) {
+      WriteLocation(*arg);
+      AppendUint32(arg->DirectionWasSpecified() ? arg->GetDirection() : 0, out_);
+      WriteTypeSpecifier(arg->GetType());
+      WriteString(arg->GetName());
+    }
+  }
+
+  bool WriteType(const AidlDefinedType& type) {
+    uint32_t kind = kParcelable;
+    if (type.AsInterface() != nullptr) {
+      kind = kInterface;
+    } else if (type.AsStructuredParcelable() != nullptr) {
+      kind = kStructuredParcelable;
+    }
+    AppendUint32(kind, out_);
+    WriteLocation(type);
+    WriteAnnotations(type);
+    WriteString(type.GetName());
+    WriteString(type.GetComments());
+    AppendUint32(type.GetSplitPackage().size(), out_);
+    for (const string& term : type.GetSplitPackage()) {
+      WriteString(term);
+    }
+
+    if (kind == kInterface) {
+      const AidlInterface& interface = *type.AsInterface();
+      AppendUint32(interface.GetMethods().size(), out_);
+      for (const auto& method : interface.GetMethods()) {
+        WriteMethod(*method);
+      }
+      AppendUint32(interface.GetConstantDeclarations().size(), out_);
+      for (const auto& constant : interface.GetConstantDeclarations()) {
+        WriteLocation(*constant);
+        WriteTypeSpecifier(constant->GetType());
+        WriteString(constant->GetName());
+        if (!WriteValue(constant->GetValue())) {
+          return false;
+        }
+      }
+    } else if (kind == kStructuredParcelable) {
+      const AidlStructuredParcelable& parcelable = *type.AsStructuredParcelable();
+      AppendUint32(parcelable.GetFields().size(), out_);
+      for (const auto& field : parcelable.GetFields()) {
+        if (!WriteVariable(*field)) {
+          return false;
+        }
+      }
+    } else {
+      WriteString(type.AsParcelable()->GetCppHeader());
+    }
+    return true;
+  }
+
+  string* const out_;
+
+  DISALLOW_COPY_AND_ASSIGN(Writer);
+};
+
+// Each method returns false if the entry is malformed, after which the reader
+// is not to be used anymore. The nodes are created in the current arena.
+class ParseCache::Reader final {
+ public:
+  // |file| is the interned name of the file the types were parsed from.
+  Reader(const FileBuffer& entry, const string* file)
+      : pos_(entry.data()), end_(entry.data() + entry.size()), file_(file) {}
+
+  // Reads the entry of a file holding |contents|.
+  bool ReadEntry(const FileBuffer& contents, vector<unique_ptr<AidlDefinedType>>* types) {
+    uint32_t version;
+    uint32_t size;
+    if (!Skip(kMagic, sizeof(kMagic)) || !ReadUint32(&version) || version != kVersion ||
+        !ReadUint32(&size) || size != contents.size() || !Skip(contents.data(), size)) {
+      return false;
+    }
+    uint32_t count;
+    if (!ReadUint32(&count)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      unique_ptr<AidlDefinedType> type = ReadType();
+      if (type == nullptr) {
+        return false;
+      }
+      types->push_back(std::move(type));
+    }
+    return pos_ == end_;
+  }
+
+ private:
+  bool ReadUint32(uint32_t* value) {
+    if (end_ - pos_ < 4) {
+      return false;
+    }
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(pos_);
+    *value = static_cast<uint32_t>(b[0]) | static_cast<uint32_t>(b[1]) << 8 |
+             static_cast<uint32_t>(b[2]) << 16 | static_cast<uint32_t>(b[3]) << 24;
+    pos_ += 4;
+    return true;
+  }
+
+  // Reads the next |size| bytes, which must be the same as those at |data|.
+  bool Skip(const char* data, size_t size) {
+    if (static_cast<size_t>(end_ - pos_) < size || memcmp(pos_, data, size) != 0) {
+      return false;
+    }
+    pos_ += size;
+    return true;
+  }
+
+  // Stores where the next string is in the entry to |*data| and |*size|.
+  bool ReadPiece(const char** data, size_t* size) {
+    uint32_t piece_size;
+    if (!ReadUint32(&piece_size) || static_cast<size_t>(end_ - pos_) < piece_size) {
+      return false;
+    }
+    *data = pos_;
+    *size = piece_size;
+    pos_ += piece_size;
+    return true;
+  }
+
+  bool ReadString(string* str) {
+    const char* data;
+    size_t size;
+    if (!ReadPiece(&data, &size)) {
+      return false;
+    }
+    str->assign(data, size);
+    return true;
+  }
+
+  // The comments are left in the entry, which AidlTypenames keeps as long as
+  // the parse trees.
+  bool ReadComments(AidlComments* comments) {
+    const char* data;
+    size_t size;
+    if (!ReadPiece(&data, &size)) {
+      return false;
+    }
+    *comments = AidlComments::InFile(data, size);
+    return true;
+  }
+
+  bool ReadLocation(AidlLocation* location) {
+    uint32_t values[4];
+    for (uint32_t& value : values) {
+      if (!ReadUint32(&value)) {
+        return false;
+      }
+    }
+    location->file_ = file_;
+    location->begin_ = {static_cast<int>(values[0]), static_cast<int>(values[1])};
+    location->end_ = {static_cast<int>(values[2]), static_cast<int>(values[3])};
+    return true;
+  }
+
+  bool ReadAnnotations(vector<AidlAnnotation>* annotations) {
+    uint32_t count;
+    if (!ReadUint32(&count)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      AidlLocation location(file_, {}, {});
+      string name;
+      AidlComments comments;
+      if (!ReadLocation(&location) || !ReadString(&name) || !ReadComments(&comments)) {
+        return false;
+      }
+      // An unknown annotation is reported, and makes the entry malformed.
+      unique_ptr<AidlAnnotation> annotation(AidlAnnotation::Parse(location, name));
+      if (annotation == nullptr) {
+        return false;
+      }
+      annotation->SetComments(comments);
+      annotations->push_back(std::move(*annotation));
+    }
+    return true;
+  }
+
+  unique_ptr<AidlTypeSpecifier> ReadTypeSpecifier() {
+    AidlLocation location(file_, {}, {});
+    vector<AidlAnnotation> annotations;
+    string name;
+    AidlComments comments;
+    uint32_t flags;
+    if (!ReadLocation(&location) || !ReadAnnotations(&annotations) || !ReadString(&name) ||
+        !ReadComments(&comments) || !ReadUint32(&flags)) {
+      return nullptr;
+    }
+    unique_ptr<vector<unique_ptr<AidlTypeSpecifier>>> params;
+    if (flags & kIsGeneric) {
+      uint32_t count;
+      if (!ReadUint32(&count)) {
+        return nullptr;
+      }
+      params.reset(new vector<unique_ptr<AidlTypeSpecifier>>);
+      for (uint32_t i = 0; i < count; i++) {
+        unique_ptr<AidlTypeSpecifier> param = ReadTypeSpecifier();
+        if (param == nullptr) {
+          return nullptr;
+        }
+        params->push_back(std::move(param));
+      }
+    }
+    unique_ptr<AidlTypeSpecifier> type(
+        new AidlTypeSpecifier(location, name, flags & kIsArray, params.release(), comments));
+    type->Annotate(std::move(annotations));
+    return type;
+  }
+
+  unique_ptr<AidlConstantValue> ReadValue() {
+    AidlLocation location(file_, {}, {});
+    uint32_t type;
+    if (!ReadLocation(&location) || !ReadUint32(&type) ||
+        type <= static_cast<uint32_t>(AidlConstantValue::Type::ERROR) ||
+        type > static_cast<uint32_t>(AidlConstantValue::Type::STRING)) {
+      return nullptr;
+    }
+    if (type != static_cast<uint32_t>(AidlConstantValue::Type::ARRAY)) {
+      string value;
+      if (!ReadString(&value) || value.empty()) {
+        return nullptr;
+      }
+      return unique_ptr<AidlConstantValue>(
+          new AidlConstantValue(location, static_cast<AidlConstantValue::Type>(type), value));
+    }
+    uint32_t count;
+    if (!ReadUint32(&count)) {
+      return nullptr;
+    }
+    vector<unique_ptr<AidlConstantValue>> values;
+    for (uint32_t i = 0; i < count; i++) {
+      unique_ptr<AidlConstantValue> value = ReadValue();
+      if (value == nullptr) {
+        return nullptr;
+      }
+      values.push_back(std::move(value));
+    }
+    return unique_ptr<AidlConstantValue>(
+        new AidlConstantValue(location, AidlConstantValue::Type::ARRAY, &values));
+  }
+
+  unique_ptr<AidlVariableDeclaration> ReadVariable() {
+    AidlLocation location(file_, {}, {});
+    if (!ReadLocation(&location)) {
+      return nullptr;
+    }
+    unique_ptr<AidlTypeSpecifier> type = ReadTypeSpecifier();
+    string name;
+    uint32_t has_default_value;
+    if (type == nullptr || !ReadString(&name) || !ReadUint32(&has_default_value)) {
+      return nullptr;
+    }
+    if (!has_default_value) {
+      return unique_ptr<AidlVariableDeclaration>(
+          new AidlVariableDeclaration(location, type.release(), name));
+    }
+    unique_ptr<AidlConstantValue> value = ReadValue();
+    if (value == nullptr) {
+      return nullptr;
+    }
+    return unique_ptr<AidlVariableDeclaration>(
+        new AidlVariableDeclaration(location, type.release(), name, value.release()));
+  }
+
+  unique_ptr<AidlArgument> ReadArgument() {
+    AidlLocation location(file_, {}, {});
+    uint32_t direction;
+    if (!ReadLocation(&location) || !ReadUint32(&direction) ||
+        direction > AidlArgument::INOUT_DIR) {
+      return nullptr;
+    }
+    unique_ptr<AidlTypeSpecifier> type = ReadTypeSpecifier();
+    string name;
+    if (type == nullptr || !ReadString(&name)) {
+      return nullptr;
+    }
+    if (direction == 0) {
+      return unique_ptr<AidlArgument>(new AidlArgument(location, type.release(), name));
+    }
+    return unique_ptr<AidlArgument>(new AidlArgument(
+        location, static_cast<AidlArgument::Direction>(direction), type.release(), name));
+  }
+
+  unique_ptr<AidlMethod> ReadMethod() {
+    AidlLocation location(file_, {}, {});
+    uint32_t flags;
+    uint32_t id;
+    if (!ReadLocation(&location) || !ReadUint32(&flags) || !ReadUint32(&id)) {
+      return nullptr;
+    }
+    unique_ptr<AidlTypeSpecifier> type = ReadTypeSpecifier();
+    string name;
+    AidlComments comments;
+    uint32_t count;
+    if (type == nullptr || !ReadString(&name) || !ReadComments(&comments) ||
+        !ReadUint32(&count)) {
+      return nullptr;
+    }
+    unique_ptr<vector<unique_ptr<AidlArgument>>> args(new vector<unique_ptr<AidlArgument>>);
+    for (uint32_t i = 0; i < count; i++) {
+      unique_ptr<AidlArgument> arg = ReadArgument();
+      if (arg == nullptr) {
+        return nullptr;
+      }
+      args->push_back(std::move(arg));
+    }
+    if (!(flags & kHasId)) {
+      return unique_ptr<AidlMethod>(new AidlMethod(location, flags & kIsOneway, type.release(),
+                                                   name, args.release(), comments));
+    }
+    return unique_ptr<AidlMethod>(new AidlMethod(location, flags & kIsOneway, type.release(), name,
+                                                 args.release(), comments, id,
+                                                 flags & kIsUserDefined));
+  }
+
+  unique_ptr<AidlConstantDeclaration> ReadConstant() {
+    AidlLocation location(file_, {}, {});
+    if (!ReadLocation(&location)) {
+      return nullptr;
+    }
+    unique_ptr<AidlTypeSpecifier> type = ReadTypeSpecifier();
+    string name;
+    if (type == nullptr || !ReadString(&name)) {
+      return nullptr;
+    }
+    unique_ptr<AidlConstantValue> value = ReadValue();
+    if (value == nullptr) {
+      return nullptr;
+    }
+    return unique_ptr<AidlConstantDeclaration>(
+        new AidlConstantDeclaration(location, type.release(), name, value.release()));
+  }
+
+  unique_ptr<AidlDefinedType> ReadType() {
+    uint32_t kind;
+    AidlLocation location(file_, {}, {});
+    vector<AidlAnnotation> annotations;
+    string name;
+    AidlComments comments;
+    uint32_t package_size;
+    if (!ReadUint32(&kind) || kind > kInterface || !ReadLocation(&location) ||
+        !ReadAnnotations(&annotations) || !ReadString(&name) || !IsQualifiedName(name) ||
+        !ReadComments(&comments) || !ReadUint32(&package_size)) {
+      return nullptr;
+    }
+    vector<string> package(package_size);
+    for (string& term : package) {
+      if (!ReadString(&term)) {
+        return nullptr;
+      }
+    }
+
+    unique_ptr<AidlDefinedType> type;
+    if (kind == kInterface) {
+      uint32_t count;
+      if (!ReadUint32(&count)) {
+        return nullptr;
+      }
+      unique_ptr<vector<unique_ptr<AidlMember>>> members(new vector<unique_ptr<AidlMember>>);
+      for (uint32_t i = 0; i < count; i++) {
+        unique_ptr<AidlMethod> method = ReadMethod();
+        if (method == nullptr) {
+          return nullptr;
+        }
+        members->push_back(std::move(method));
+      }
+      if (!ReadUint32(&count)) {
+        return nullptr;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        unique_ptr<AidlConstantDeclaration> constant = ReadConstant();
+        if (constant == nullptr) {
+          return nullptr;
+        }
+        members->push_back(std::move(constant));
+      }
+      // The methods of a oneway interface were stored as oneway already.
+      type.reset(new AidlInterface(location, name, comments, false, members.release(), package));
+    } else if (kind == kStructuredParcelable) {
+      uint32_t count;
+      if (!ReadUint32(&count)) {
+        return nullptr;
+      }
+      vector<unique_ptr<AidlVariableDeclaration>> fields;
+      for (uint32_t i = 0; i < count; i++) {
+        unique_ptr<AidlVariableDeclaration> field = ReadVariable();
+        if (field == nullptr) {
+          return nullptr;
+        }
+        fields.push_back(std::move(field));
+      }
+      type.reset(new AidlStructuredParcelable(
+          location, new AidlQualifiedName(location, name, AidlComments()), package, comments,
+          &fields));
+    } else {
+      string cpp_header;
+      if (!ReadString(&cpp_header)) {
+        return nullptr;
+      }
+      // The quotation marks were stripped off by the parser.
+      if (!cpp_header.empty()) {
+        cpp_header = "\"" + cpp_header + "\"";
+      }
+      type.reset(new AidlParcelable(location,
+                                    new AidlQualifiedName(location, name, AidlComments()),
+                                    package, comments, cpp_header));
+    }
+    type->Annotate(std::move(annotations));
+    return type;
+  }
+
+  const char* pos_;
+  const char* const end_;
+  const string* const file_;
+
+  DISALLOW_COPY_AND_ASSIGN(Reader);
+};
+
+bool ParseCache::Parse(const string& cache_dir, const string& filename,
+                       const IoDelegate& io_delegate, AidlTypenames& typenames,
+                       vector<AidlDefinedType*>* defined_types) {
+  if (cache_dir.empty()) {
+    unique_ptr<Parser> parser = Parser::Parse(filename, io_delegate, typenames);
+    if (parser == nullptr) {
+      return false;
+    }
+    *defined_types = parser->GetDefinedTypes();
+    return true;
+  }
+
+  unique_ptr<FileBuffer> contents = io_delegate.GetFileBuffer(filename);
+  if (contents == nullptr) {
+    AIDL_ERROR(filename) << "Error while opening file for parsing";
+    return false;
+  }
+  const string entry_path = EntryPath(cache_dir, contents->data(), contents->size());
+  unique_ptr<FileBuffer> entry = io_delegate.GetFileBuffer(entry_path);
+  if (entry != nullptr) {
+    vector<unique_ptr<AidlDefinedType>> types;
+    AidlDiagnostics diagnostics;
+    bool read;
+    {
+      AidlArena::Scope arena_scope(typenames.GetArena());
+      AidlErrorCapture capture(&diagnostics);
+      Reader reader(*entry, &typenames.GetArena()->Intern(filename));
+      read = reader.ReadEntry(*contents, &types);
+    }
+    if (read && diagnostics.Empty()) {
+      typenames.AddParsedFile(std::move(entry));
+      defined_types->clear();
+      for (auto& type : types) {
+        AidlDefinedType* defined_type = type.get();
+        if (!typenames.AddDefinedType(std::move(type))) {
+          return false;
+        }
+        defined_types->push_back(defined_type);
+      }
+      return true;
+    }
+  }
+
+  // The scanner may modify the contents while they are parsed.
+  const string source(contents->data(), contents->size());
+  AidlDiagnostics diagnostics;
+  unique_ptr<Parser> parser;
+  {
+    AidlErrorCapture capture(&diagnostics);
+    parser = Parser::Parse(filename, std::move(contents), typenames);
+  }
+  diagnostics.Report();
+  if (parser == nullptr) {
+    return false;
+  }
+  *defined_types = parser->GetDefinedTypes();
+  if (!diagnostics.Empty()) {
+    // Reading the entry wouldn't report the diagnostics again.
+    return true;
+  }
+
+  string data(kMagic, sizeof(kMagic));
+  AppendUint32(kVersion, &data);
+  AppendUint32(source.size(), &data);
+  data.append(source);
+  if (!Writer(&data).WriteTypes(*defined_types)) {
+    return true;
+  }
+  const string temp_path = IoDelegate::GetTempPath(entry_path);
+  unique_ptr<CodeWriter> writer = io_delegate.GetCodeWriter(temp_path);
+  if (writer == nullptr) {
+    return true;
+  }
+  const bool written = writer->WriteRaw(data) && writer->Close();
+  writer.reset();
+  // A failure only means that the file will be parsed again next time.
+  if (!written || !io_delegate.RenameFile(temp_path, entry_path)) {
+    io_delegate.RemovePath(temp_path);
+  }
+  return true;
+}
+
+string ParseCache::EntryPath(const string& cache_dir, const char* data, size_t size) {
+  char version[4];
+  for (size_t i = 0; i < sizeof(version); i++) {
+    version[i] = static_cast<char>((kVersion >> (8 * i)) & 0xff);
+  }
+  const uint64_t hash = Hash(data, size, Hash(version, sizeof(version)));
+  const string name = StringPrintf("%016llx", static_cast<unsigned long long>(hash));
+  string path = cache_dir;
+  if (path.back() != OS_PATH_SEPARATOR) {
+    path.push_back(OS_PATH_SEPARATOR);
+  }
+  // Like ccache, the entries are spread over subdirectories.
+  return path + name.substr(0, 2) + OS_PATH_SEPARATOR + name.substr(2);
+}
+
+}  // namespace aidl
+}  // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "aidl_typenames.h"
+#include "io_delegate.h"
+
+class AidlDefinedType;
+
+namespace android {
+namespace aidl {
+
+// The parse trees of imported files, stored in a directory that can be shared
+// by builds, like the one of ccache. An entry is named after a hash of the
+// contents of the file it was parsed from and of kVersion, so the entry of a
+// file is found wherever the file is, and a file that changed has another
+// entry. An entry is only written once the whole file was parsed without a
+// diagnostic.
+//
+// An entry holds a copy of the contents, which are compared with the file
+// before the entry is used, followed by the defined types of the file. Their
+// nodes are stored in the order they are created, without the file name of
+// their locations. All numbers are 32-bit little-endian, and strings are
+// stored with their size first. The comments of the nodes that are read from
+// an entry refer to it, as they would refer to the file after a parse.
+//
+// Entries are written to a temporary file first, and renamed when complete,
+// so that builds can use the same directory concurrently. A malformed entry is
+// treated like a missing one.
+class ParseCache final {
+ public:
+  // Must change whenever the parse trees, or the way they are stored, change.
+  static constexpr uint32_t kVersion = 1;
+
+  // Parses |filename| into |typenames| like Parser::Parse, and stores the
+  // types it defines to |*defined_types|. When |cache_dir| isn't empty, the
+  // types are read from the entry of |filename| in it, or the entry is written
+  // if there is none. Returns false if |filename| can't be parsed.
+  static bool Parse(const std::string& cache_dir, const std::string& filename,
+                    const IoDelegate& io_delegate, AidlTypenames& typenames,
+                    std::vector<AidlDefinedType*>* defined_types);
+
+  // Path of the entry for a file holding the |size| bytes at |data|.
+  static std::string EntryPath(const std::string& cache_dir, const char* data, size_t size);
+
+ private:
+  class Reader;
+  class Writer;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ParseCache);
+};
+
+}  // namespace aidl
+}  // namespace android
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "preprocessed_table.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include <android-base/strings.h>
+
+#include "aidl_language.h"
+#include "logging.h"
+
+using android::base::Split;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace aidl {
+
+namespace {
+
+constexpr char kMagic[8] = {'\x7f', 'A', 'I', 'D', 'L', 'P', 'P', '\0'};
+constexpr size_t kHeaderSize = sizeof(kMagic) + 6 * sizeof(uint32_t);
+constexpr size_t kEntrySize = 5 * sizeof(uint32_t);
+
+constexpr uint32_t kParcelable = 0;
+constexpr uint32_t kStructuredParcelable = 1;
+constexpr uint32_t kInterface = 2;
+
+uint32_t ReadUint32(const char* p) {
+  const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+  return static_cast<uint32_t>(b[0]) | static_cast<uint32_t>(b[1]) << 8 |
+         static_cast<uint32_t>(b[2]) << 16 | static_cast<uint32_t>(b[3]) << 24;
+}
+
+void AppendUint32(uint32_t value, string* out) {
+  out->push_back(static_cast<char>(value & 0xff));
+  out->push_back(static_cast<char>((value >> 8) & 0xff));
+  out->push_back(static_cast<char>((value >> 16) & 0xff));
+  out->push_back(static_cast<char>((value >> 24) & 0xff));
+}
+
+// Compares |data| of |size| bytes with the part of |str| from |*pos| on, and
+// advances |*pos| past the compared bytes. Returns the result as with
+// string::compare, or 0 if |data| is a prefix of the rest of |str|.
+int ComparePiece(const char* data, size_t size, const string& str, size_t* pos) {
+  const size_t n = std::min(size, str.size() - *pos);
+  int result = memcmp(data, str.data() + *pos, n);
+  if (result != 0) {
+    return result;
+  }
+  *pos += n;
+  return n < size ? 1 : 0;
+}
+
+struct Declaration {
+  string package;
+  string name;
+  string canonical_name;
+  uint32_t kind;
+};
+
+}  // namespace
+
+bool PreprocessedTable::IsBinaryFormat(const char* data, size_t size) {
+  return size >= sizeof(kMagic) && memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool PreprocessedTable::Write(const vector<const AidlDefinedType*>& types, CodeWriter* writer) {
+  vector<Declaration> decls;
+  for (const auto type : types) {
+    Declaration decl;
+    decl.canonical_name = type->GetCanonicalName();
+    // Split the same way as the text format does, see b/17415692.
+    size_t dot_pos = decl.canonical_name.rfind('.');
+    if (dot_pos != string::npos) {
+      decl.package = decl.canonical_name.substr(0, dot_pos);
+      decl.name = decl.canonical_name.substr(dot_pos + 1);
+    } else {
+      decl.name = decl.canonical_name;
+    }
+    if (type->AsInterface() != nullptr) {
+      decl.kind = kInterface;
+    } else if (type->AsStructuredParcelable() != nullptr) {
+      decl.kind = kStructuredParcelable;
+    } else {
+      // Built-in types are skipped when the text format is read (b/130899491).
+      if (AidlTypenames::IsBuiltinTypename(decl.name)) {
+        continue;
+      }
+      decl.kind = kParcelable;
+    }
+    decls.push_back(std::move(decl));
+  }
+
+  // Like in the text format, the first declaration of a type wins.
+  std::stable_sort(decls.begin(), decls.end(), [](const Declaration& a, const Declaration& b) {
+    return a.canonical_name < b.canonical_name;
+  });
+  decls.erase(std::unique(decls.begin(), decls.end(),
+                          [](const Declaration& a, const Declaration& b) {
+                            return a.canonical_name == b.canonical_name;
+                          }),
+              decls.end());
+
+  vector<uint32_t> names(decls.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    names[i] = i;
+  }
+  std::stable_sort(names.begin(), names.end(), [&decls](uint32_t a, uint32_t b) {
+    return decls[a].name < decls[b].name;
+  });
+
+  string strings;
+  std::map<string, uint32_t> string_offsets;
+  auto intern = [&strings, &string_offsets](const string& str) {
+    auto it = string_offsets.find(str);
+    if (it != string_offsets.end()) {
+      return it->second;
+    }
+    uint32_t offset = strings.size();
+    strings.append(str);
+    string_offsets.emplace(str, offset);
+    return offset;
+  };
+  string entries;
+  for (const auto& decl : decls) {
+    AppendUint32(intern(decl.package), &entries);
+    AppendUint32(decl.package.size(), &entries);
+    AppendUint32(intern(decl.name), &entries);
+    AppendUint32(decl.name.size(), &entries);
+    AppendUint32(decl.kind, &entries);
+  }
+  strings.resize((strings.size() + 3) & ~3);
+
+  string out(kMagic, sizeof(kMagic));
+  const uint32_t entries_offset = kHeaderSize;
+  const uint32_t names_offset = entries_offset + entries.size();
+  const uint32_t strings_offset = names_offset + names.size() * sizeof(uint32_t);
+  AppendUint32(kVersion, &out);
+  AppendUint32(decls.size(), &out);
+  AppendUint32(entries_offset, &out);
+  AppendUint32(names_offset, &out);
+  AppendUint32(strings_offset, &out);
+  AppendUint32(strings.size(), &out);
+  out.append(entries);
+  for (uint32_t index : names) {
+    AppendUint32(index, &out);
+  }
+  out.append(strings);
+  return writer->WriteRaw(out);
+}
+
+unique_ptr<PreprocessedTable> PreprocessedTable::Read(const string& filename,
+                                                      unique_ptr<FileBuffer> contents) {
+  unique_ptr<PreprocessedTable> table(new PreprocessedTable(filename, std::move(contents)));
+  const FileBuffer& data = *table->contents_;
+  if (!IsBinaryFormat(data.data(), data.size()) || data.size() < kHeaderSize) {
+    LOG(ERROR) << filename << ": malformed preprocessed file header";
+    return nullptr;
+  }
+  const char* header = data.data() + sizeof(kMagic);
+  const uint32_t version = ReadUint32(header);
+  if (version != kVersion) {
+    LOG(ERROR) << filename << ": unsupported preprocessed file version " << version
+               << ", expected " << kVersion;
+    return nullptr;
+  }
+  const uint64_t size = ReadUint32(header + 4);
+  const uint64_t entries_offset = ReadUint32(header + 8);
+  const uint64_t names_offset = ReadUint32(header + 12);
+  const uint64_t strings_offset = ReadUint32(header + 16);
+  const uint64_t strings_size = ReadUint32(header + 20);
+  if (entries_offset + size * kEntrySize > data.size() ||
+      names_offset + size * sizeof(uint32_t) > data.size() ||
+      strings_offset + strings_size > data.size()) {
+    LOG(ERROR) << filename << ": malformed preprocessed file header";
+    return nullptr;
+  }
+  table->size_ = size;
+  table->entries_ = data.data() + entries_offset;
+  table->names_ = data.data() + names_offset;
+  table->strings_ = data.data() + strings_offset;
+
+  // Only the bounds are checked here. The strings are used as they are.
+  for (size_t i = 0; i < size; i++) {
+    const char* entry = table->entries_ + i * kEntrySize;
+    const uint64_t package_end = uint64_t{ReadUint32(entry)} + ReadUint32(entry + 4);
+    const uint64_t name_end = uint64_t{ReadUint32(entry + 8)} + ReadUint32(entry + 12);
+    if (package_end > strings_size || name_end > strings_size || ReadUint32(entry + 12) == 0 ||
+        ReadUint32(entry + 16) > kInterface || ReadUint32(table->names_ + i * 4) >= size) {
+      LOG(ERROR) << filename << ": malformed preprocessed file entry " << i;
+      return nullptr;
+    }
+  }
+  return table;
+}
+
+PreprocessedTable::PreprocessedTable(const string& filename, unique_ptr<FileBuffer> contents)
+    : filename_(filename), contents_(std::move(contents)) {}
+
+PreprocessedTable::~PreprocessedTable() = default;
+
+PreprocessedTable::Entry PreprocessedTable::GetEntry(size_t index) const {
+  const char* entry = entries_ + index * kEntrySize;
+  return Entry{strings_ + ReadUint32(entry), ReadUint32(entry + 4),
+               strings_ + ReadUint32(entry + 8), ReadUint32(entry + 12), ReadUint32(entry + 16)};
+}
+
+AidlPreprocessedType::Kind PreprocessedTable::GetKind(size_t index) const {
+  switch (GetEntry(index).kind) {
+    case kInterface:
+      return AidlPreprocessedType::Kind::INTERFACE;
+    case kStructuredParcelable:
+      return AidlPreprocessedType::Kind::STRUCTURED_PARCELABLE;
+    default:
+      return AidlPreprocessedType::Kind::PARCELABLE;
+  }
+}
+
+string PreprocessedTable::GetPackage(size_t index) const {
+  Entry entry = GetEntry(index);
+  return string(entry.package, entry.package_size);
+}
+
+string PreprocessedTable::GetName(size_t index) const {
+  Entry entry = GetEntry(index);
+  return string(entry.name, entry.name_size);
+}
+
+const AidlPreprocessedType& PreprocessedTable::GetType(size_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  unique_ptr<AidlPreprocessedType>& type = types_[index];
+  if (type == nullptr) {
+    const string package = GetPackage(index);
+    vector<string> split_package;
+    if (!package.empty()) {
+      split_package = Split(package, ".");
+    }
+    // There are no lines in the binary format. The position of the entry is
+    // used instead.
+    type.reset(new AidlPreprocessedType(GetKind(index), split_package, GetName(index), filename_,
+                                        index + 1));
+  }
+  return *type;
+}
+
+int PreprocessedTable::CompareCanonicalName(size_t index, const string& canonical_name) const {
+  Entry entry = GetEntry(index);
+  size_t pos = 0;
+  int result = 0;
+  if (entry.package_size > 0) {
+    result = ComparePiece(entry.package, entry.package_size, canonical_name, &pos);
+    if (result == 0) {
+      result = ComparePiece(".", 1, canonical_name, &pos);
+    }
+  }
+  if (result == 0) {
+    result = ComparePiece(entry.name, entry.name_size, canonical_name, &pos);
+  }
+  if (result == 0 && pos < canonical_name.size()) {
+    result = -1;
+  }
+  return result;
+}
+
+int PreprocessedTable::CompareName(size_t index, const string& name) const {
+  Entry entry = GetEntry(index);
+  size_t pos = 0;
+  int result = ComparePiece(entry.name, entry.name_size, name, &pos);
+  if (result == 0 && pos < name.size()) {
+    result = -1;
+  }
+  return result;
+}
+
+const AidlPreprocessedType* PreprocessedTable::FindByCanonicalName(
+    const string& canonical_name) const {
+  size_t low = 0;
+  size_t high = size_;
+  while (low < high) {
+    const size_t mid = low + (high - low) / 2;
+    const int result = CompareCanonicalName(mid, canonical_name);
+    if (result == 0) {
+      return &GetType(mid);
+    }
+    if (result < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return nullptr;
+}
+
+const AidlPreprocessedType* PreprocessedTable::FindByName(const string& name) const {
+  // Find the first entry of the name index that isn't smaller than |name|.
+  size_t low = 0;
+  size_t high = size_;
+  while (low < high) {
+    const size_t mid = low + (high - low) / 2;
+    if (CompareName(ReadUint32(names_ + mid * 4), name) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == size_) {
+    return nullptr;
+  }
+  const size_t index = ReadUint32(names_ + low * 4);
+  return CompareName(index, name) == 0 ? &GetType(index) : nullptr;
+}
+
+}  // namespace aidl
+}  // namespace android
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "aidl_typenames.h"
+#include "code_writer.h"
+#include "io_delegate.h"
+
+class AidlDefinedType;
+
+namespace android {
+namespace aidl {
+
+// The types of a preprocessed file in the binary format written by
+// "--preprocess --preprocess_format=binary".
+//
+// The file is a header followed by a table of declarations sorted by canonical
+// name, an index of the same declarations sorted by name, and a pool of the
+// package and type names where each distinct string is stored once. All
+// numbers are 32-bit little-endian and every section is 4-byte aligned, so the
+// file can be used right where it is loaded (or mapped) without being parsed:
+//
+//   header:     magic[8] version count entries_offset names_offset
+//               strings_offset strings_size
+//   entries:    count x {package_offset package_size name_offset name_size kind}
+//   names:      count x entry index
+//   strings:    strings_size bytes
+//
+// Types are looked up with a binary search. The AidlPreprocessedType for an
+// entry is only created when it is asked for. Can be used from multiple
+// threads.
+class PreprocessedTable final {
+ public:
+  static constexpr uint32_t kVersion = 1;
+
+  // Returns true if the |size| bytes at |data| start like a file in the
+  // binary format.
+  static bool IsBinaryFormat(const char* data, size_t size);
+
+  // Writes the declarations of |types| to |writer| in the binary format.
+  // Returns false on error.
+  static bool Write(const std::vector<const AidlDefinedType*>& types, CodeWriter* writer);
+
+  // Returns the table stored in |contents|, which was read from |filename|.
+  // Returns nullptr and logs an error if |contents| is malformed.
+  static std::unique_ptr<PreprocessedTable> Read(const std::string& filename,
+                                                 std::unique_ptr<FileBuffer> contents);
+
+  ~PreprocessedTable();
+
+  const std::string& GetFilename() const { return filename_; }
+  // Number of declarations in the table.
+  size_t Size() const { return size_; }
+
+  // Accessors for the declaration at |index|, in the order of canonical names.
+  AidlPreprocessedType::Kind GetKind(size_t index) const;
+  std::string GetPackage(size_t index) const;
+  std::string GetName(size_t index) const;
+  const AidlPreprocessedType& GetType(size_t index) const;
+
+  // Returns the type named |canonical_name|, or nullptr.
+  const AidlPreprocessedType* FindByCanonicalName(const std::string& canonical_name) const;
+  // Returns the type whose name without package is |name|, or nullptr. When
+  // types share a name, the one with the smallest canonical name is returned.
+  const AidlPreprocessedType* FindByName(const std::string& name) const;
+
+ private:
+  struct Entry {
+    const char* package;
+    size_t package_size;
+    const char* name;
+    size_t name_size;
+    uint32_t kind;
+  };
+
+  PreprocessedTable(const std::string& filename, std::unique_ptr<FileBuffer> contents);
+
+  Entry GetEntry(size_t index) const;
+  int CompareCanonicalName(size_t index, const std::string& canonical_name) const;
+  int CompareName(size_t index, const std::string& name) const;
+
+  const std::string filename_;
+  const std::unique_ptr<FileBuffer> contents_;
+  size_t size_ = 0;
+  const char* entries_ = nullptr;
+  const char* names_ = nullptr;
+  const char* strings_ = nullptr;
+
+  // Guards types_, which holds the types created so far by entry index.
+  mutable std::mutex mutex_;
+  mutable std::map<size_t, std::unique_ptr<AidlPreprocessedType>> types_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreprocessedTable);
+};
+
+}  // namespace aidl
+}  // namespace android
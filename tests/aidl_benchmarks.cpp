@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks of the phases of the compiler, and of whole compilations of
+// generated corpora, on synthetic inputs that are kept in a FakeIoDelegate, so
+// that the disk doesn't matter. Besides the time, each benchmark reports the
+// number of allocations, and the bytes they asked for, per iteration.
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+
+#include "aidl.h"
+#include "aidl_language.h"
+#include "code_writer.h"
+#include "generate_cpp.h"
+#include "generate_java.h"
+#include "generate_ndk.h"
+#include "import_resolver.h"
+#include "options.h"
+#include "tests/corpus_generator.h"
+#include "tests/fake_io_delegate.h"
+#include "type_cpp.h"
+#include "type_java.h"
+
+using android::aidl::internals::load_and_validate_aidl;
+using android::aidl::internals::parse_preprocessed_file;
+using android::aidl::test::Corpus;
+using android::aidl::test::CorpusConfig;
+using android::aidl::test::FakeIoDelegate;
+using android::aidl::test::GenerateCorpus;
+using android::base::Join;
+using android::base::StringAppendF;
+using android::base::StringPrintf;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+std::atomic<int64_t> allocations(0);
+std::atomic<int64_t> allocated_bytes(0);
+
+}  // namespace
+
+// Every allocation of the benchmarks goes through here, to be counted.
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    abort();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+namespace android {
+namespace aidl {
+namespace {
+
+// Counts the allocations made from its construction until Report(), which
+// adds them to the counters of |state| as averages per iteration.
+class AllocationCounter {
+ public:
+  AllocationCounter()
+      : allocations_(allocations.load(std::memory_order_relaxed)),
+        bytes_(allocated_bytes.load(std::memory_order_relaxed)) {}
+
+  void Report(benchmark::State& state) const {
+    state.counters["allocs"] =
+        benchmark::Counter(allocations.load(std::memory_order_relaxed) - allocations_,
+                           benchmark::Counter::kAvgIterations);
+    state.counters["alloc_bytes"] =
+        benchmark::Counter(allocated_bytes.load(std::memory_order_relaxed) - bytes_,
+                           benchmark::Counter::kAvgIterations, benchmark::Counter::kIs1024);
+  }
+
+ private:
+  const int64_t allocations_;
+  const int64_t bytes_;
+};
+
+// The shape of a synthetic interface.
+struct Shape {
+  int methods = 1;
+  // Arguments of each method. They cycle through the types below.
+  int args = 0;
+  // Depth of the chain of structured parcelables that the methods take, each
+  // having a field of the next one. 0 means there are none.
+  int nesting = 0;
+  // Number of parcelables the interface imports, each from its own file.
+  int imports = 0;
+};
+
+constexpr char kInterfaceFile[] = "bench/IBench.aidl";
+
+// The files of an interface of |shape| in package "bench", keyed by path.
+// The imported parcelables are spread over |import_roots| directories, named
+// root0/, root1/, etc.
+std::map<string, string> SyntheticFiles(const Shape& shape, int import_roots = 1) {
+  std::map<string, string> files;
+  vector<string> arg_types = {"int", "String", "long", "int[]"};
+  string imports;
+  for (int i = 0; i < shape.imports; i++) {
+    files[StringPrintf("root%d/bench/dep/Dep%d.aidl", i % import_roots, i)] =
+        StringPrintf("package bench.dep;\nparcelable Dep%d {\n  int value;\n  String name;\n}\n", i);
+    StringAppendF(&imports, "import bench.dep.Dep%d;\n", i);
+    arg_types.push_back(StringPrintf("Dep%d", i));
+  }
+  for (int i = 0; i < shape.nesting; i++) {
+    const bool last = i + 1 == shape.nesting;
+    string contents = "package bench;\n";
+    if (!last) {
+      StringAppendF(&contents, "import bench.Nested%d;\n", i + 1);
+    }
+    StringAppendF(&contents, "parcelable Nested%d {\n  int a;\n  String b;\n", i);
+    if (!last) {
+      StringAppendF(&contents, "  Nested%d next;\n", i + 1);
+    }
+    contents += "}\n";
+    files[StringPrintf("bench/Nested%d.aidl", i)] = contents;
+  }
+  if (shape.nesting > 0) {
+    imports += "import bench.Nested0;\n";
+    arg_types.push_back("Nested0");
+  }
+
+  string contents = "package bench;\n" + imports + "\ninterface IBench {\n";
+  for (int m = 0; m < shape.methods; m++) {
+    StringAppendF(&contents, "  // Method number %d.\n  int method%d(", m, m);
+    for (int a = 0; a < shape.args; a++) {
+      const string& type = arg_types[(m + a) % arg_types.size()];
+      StringAppendF(&contents, "%sin %s arg%d", a == 0 ? "" : ", ", type.c_str(), a);
+    }
+    contents += ");\n";
+  }
+  contents += "}\n";
+  files[kInterfaceFile] = contents;
+  return files;
+}
+
+void AddFiles(const std::map<string, string>& files, FakeIoDelegate* io_delegate) {
+  for (const auto& file : files) {
+    io_delegate->SetFileContents(file.first, file.second);
+  }
+}
+
+// An interface with every feature of |shape|, loaded with the type namespace
+// of a language, ready to be generated.
+template <typename Namespace>
+class LoadedInterface {
+ public:
+  LoadedInterface(const Shape& shape, const string& lang)
+      : options_(Options::From("aidl --lang=" + lang + " -I . -I root0 -o out -h out " +
+                               kInterfaceFile)) {
+    AddFiles(SyntheticFiles(shape), &io_delegate_);
+    types_.Init();
+    vector<string> imported_files;
+    CHECK(load_and_validate_aidl(kInterfaceFile, options_, io_delegate_, &types_,
+                                 &defined_types_, &imported_files) == AidlError::OK);
+    CHECK_EQ(1u, defined_types_.size());
+  }
+
+  const Options options_;
+  FakeIoDelegate io_delegate_;
+  Namespace types_;
+  vector<AidlDefinedType*> defined_types_;
+};
+
+void SetBytesProcessed(benchmark::State& state, size_t bytes) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+void BM_Parse(benchmark::State& state) {
+  Shape shape;
+  shape.methods = state.range(0);
+  shape.args = state.range(1);
+  FakeIoDelegate io_delegate;
+  const string contents = SyntheticFiles(shape)[kInterfaceFile];
+  io_delegate.SetFileContents(kInterfaceFile, contents);
+
+  AllocationCounter counter;
+  for (auto _ : state) {
+    AidlTypenames typenames;
+    std::unique_ptr<Parser> parser = Parser::Parse(kInterfaceFile, io_delegate, typenames);
+    CHECK(parser != nullptr && !parser->HasError());
+    benchmark::DoNotOptimize(parser);
+  }
+  counter.Report(state);
+  SetBytesProcessed(state, contents.size());
+}
+BENCHMARK(BM_Parse)
+    ->ArgNames({"methods", "args"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 4}});
+
+void BM_ParsePreprocessed(benchmark::State& state) {
+  FakeIoDelegate io_delegate;
+  string contents;
+  for (int i = 0; i < state.range(0); i++) {
+    StringAppendF(&contents, "parcelable bench.p%d.Parcelable%d;\n", i % 16, i);
+    StringAppendF(&contents, "interface bench.p%d.IInterface%d;\n", i % 16, i);
+  }
+  io_delegate.SetFileContents("preprocessed", contents);
+
+  // The built-in types that a namespace starts with are counted too, as a
+  // file can be loaded only once into a namespace.
+  AllocationCounter counter;
+  for (auto _ : state) {
+    java::JavaTypeNamespace types;
+    types.Init();
+    CHECK(parse_preprocessed_file(io_delegate, "preprocessed", &types, types.typenames_));
+  }
+  counter.Report(state);
+  SetBytesProcessed(state, contents.size());
+}
+BENCHMARK(BM_ParsePreprocessed)->ArgName("entries")->RangeMultiplier(10)->Range(10, 10000);
+
+void BM_FindImportFile(benchmark::State& state) {
+  Shape shape;
+  shape.imports = state.range(0);
+  const int roots = state.range(1);
+  FakeIoDelegate io_delegate;
+  AddFiles(SyntheticFiles(shape, roots), &io_delegate);
+  set<string> import_paths;
+  for (int i = 0; i < roots; i++) {
+    import_paths.insert(StringPrintf("root%d", i));
+  }
+  vector<string> names;
+  for (int i = 0; i < shape.imports; i++) {
+    names.push_back(StringPrintf("bench.dep.Dep%d", i));
+  }
+
+  AllocationCounter counter;
+  for (auto _ : state) {
+    // A fresh resolver, as its results are cached.
+    ImportResolver resolver(io_delegate, kInterfaceFile, import_paths, {});
+    for (const string& name : names) {
+      CHECK(!resolver.FindImportFile(name).empty()) << name;
+    }
+  }
+  counter.Report(state);
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_FindImportFile)
+    ->ArgNames({"imports", "import_paths"})
+    ->ArgsProduct({{10, 100}, {1, 10, 50}});
+
+void BM_LoadAndValidate(benchmark::State& state) {
+  Shape shape;
+  shape.methods = state.range(0);
+  shape.args = state.range(1);
+  shape.nesting = state.range(2);
+  shape.imports = state.range(3);
+  FakeIoDelegate io_delegate;
+  AddFiles(SyntheticFiles(shape), &io_delegate);
+  const Options options =
+      Options::From(string("aidl --lang=cpp -I . -I root0 -o out -h out ") + kInterfaceFile);
+
+  AllocationCounter counter;
+  for (auto _ : state) {
+    cpp::TypeNamespace types;
+    types.Init();
+    vector<AidlDefinedType*> defined_types;
+    vector<string> imported_files;
+    CHECK(load_and_validate_aidl(kInterfaceFile, options, io_delegate, &types, &defined_types,
+                                 &imported_files) == AidlError::OK);
+  }
+  counter.Report(state);
+}
+BENCHMARK(BM_LoadAndValidate)
+    ->ArgNames({"methods", "args", "nesting", "imports"})
+    ->Args({10, 2, 0, 0})
+    ->Args({100, 4, 0, 0})
+    ->Args({1000, 4, 0, 0})
+    ->Args({100, 4, 8, 0})
+    ->Args({100, 4, 0, 50})
+    ->Args({100, 4, 8, 50});
+
+// The shapes the generators are measured with.
+void GeneratorArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"methods", "args", "nesting", "imports"})
+      ->Args({10, 2, 0, 0})
+      ->Args({100, 4, 0, 0})
+      ->Args({1000, 4, 0, 0})
+      ->Args({100, 4, 8, 10});
+}
+
+Shape GeneratorShape(const benchmark::State& state) {
+  Shape shape;
+  shape.methods = state.range(0);
+  shape.args = state.range(1);
+  shape.nesting = state.range(2);
+  shape.imports = state.range(3);
+  return shape;
+}
+
+void BM_GenerateCpp(benchmark::State& state) {
+  LoadedInterface<cpp::TypeNamespace> loaded(GeneratorShape(state), "cpp");
+  AllocationCounter counter;
+  for (auto _ : state) {
+    CHECK(cpp::GenerateCpp("out/bench/IBench.cpp", loaded.options_, loaded.types_,
+                           *loaded.defined_types_[0], loaded.io_delegate_));
+  }
+  counter.Report(state);
+}
+BENCHMARK(BM_GenerateCpp)->Apply(GeneratorArgs);
+
+void BM_GenerateNdk(benchmark::State& state) {
+  LoadedInterface<cpp::TypeNamespace> loaded(GeneratorShape(state), "ndk");
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ndk::GenerateNdk("out/bench/IBench.cpp", loaded.options_, loaded.types_.typenames_,
+                     *loaded.defined_types_[0], loaded.io_delegate_);
+  }
+  counter.Report(state);
+}
+BENCHMARK(BM_GenerateNdk)->Apply(GeneratorArgs);
+
+void BM_GenerateJava(benchmark::State& state) {
+  LoadedInterface<java::JavaTypeNamespace> loaded(GeneratorShape(state), "java");
+  AllocationCounter counter;
+  for (auto _ : state) {
+    CHECK(java::generate_java("out/bench/IBench.java", loaded.defined_types_[0], &loaded.types_,
+                              loaded.io_delegate_, loaded.options_));
+  }
+  counter.Report(state);
+}
+BENCHMARK(BM_GenerateJava)->Apply(GeneratorArgs);
+
+// Compiles all the interfaces of a generated corpus with |lang|, from the
+// parse of the inputs to the writing of the outputs.
+void BM_CompileCorpus(benchmark::State& state, const char* lang, const char* config_text) {
+  CorpusConfig config;
+  string error;
+  CHECK(config.Parse(config_text, &error) && config.Validate(&error)) << error;
+  const Corpus corpus = GenerateCorpus(config);
+  FakeIoDelegate io_delegate;
+  AddFiles(corpus.files, &io_delegate);
+  string command = StringPrintf("aidl --lang=%s -I . -o out", lang);
+  if (string(lang) != "java") {
+    command += " -h out";
+  }
+  if (!corpus.preprocessed_file.empty()) {
+    command += " -p " + corpus.preprocessed_file;
+  }
+  const Options options = Options::From(command + " " + Join(corpus.interface_files, " "));
+  CHECK(options.Ok()) << options.GetErrorMessage();
+
+  AllocationCounter counter;
+  for (auto _ : state) {
+    CHECK_EQ(0, compile_aidl(options, io_delegate));
+  }
+  counter.Report(state);
+}
+BENCHMARK_CAPTURE(BM_CompileCorpus, outlined_onTransact, "java",
+                  "min_methods = 1200\nmax_methods = 1200\nparcelables = 20");
+BENCHMARK_CAPTURE(BM_CompileCorpus, deep_imports, "cpp",
+                  "interfaces = 4\nparcelables = 200\nimport_chain = true\npackages = 10");
+BENCHMARK_CAPTURE(BM_CompileCorpus, large_preprocessed, "java",
+                  "preprocessed_entries = 5000\nmin_methods = 50\nmax_methods = 50");
+BENCHMARK_CAPTURE(BM_CompileCorpus, wide_parcelables, "ndk",
+                  "parcelables = 10\nmin_fields = 300\nmax_fields = 300\nmax_imports = 10");
+
+void BM_CodeWriter(benchmark::State& state) {
+  const int lines = state.range(0);
+  size_t bytes = 0;
+  AllocationCounter counter;
+  for (auto _ : state) {
+    string output;
+    CodeWriterPtr writer = CodeWriter::ForString(&output);
+    for (int i = 0; i < lines; i++) {
+      if (i % 8 == 0) {
+        writer->Write("if (_aidl_ret_status != ::android::OK) {\n");
+        writer->Indent();
+      }
+      writer->Write("_aidl_ret_status = _aidl_data.writeInt32(in_arg%d);\n", i);
+      if (i % 8 == 7) {
+        writer->Dedent();
+        writer->Write("}\n");
+      }
+    }
+    CHECK(writer->Close());
+    bytes = output.size();
+  }
+  counter.Report(state);
+  SetBytesProcessed(state, bytes);
+}
+BENCHMARK(BM_CodeWriter)->ArgName("lines")->RangeMultiplier(10)->Range(100, 100000);
+
+}  // namespace
+}  // namespace aidl
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tests/corpus_generator.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+using android::base::ParseInt;
+using android::base::ParseUint;
+using android::base::Split;
+using android::base::StringAppendF;
+using android::base::StringPrintf;
+using android::base::Trim;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace aidl {
+namespace test {
+
+namespace {
+
+const char* const kScalarTypes[] = {"boolean", "byte", "char",   "int",
+                                    "long",    "float", "double", "String"};
+const char* const kArrayTypes[] = {"boolean[]", "byte[]", "int[]", "long[]", "String[]"};
+
+// The random numbers of a corpus. std::mt19937 gives the same sequence
+// everywhere, unlike the standard distributions, which aren't used for that
+// reason.
+class Random {
+ public:
+  explicit Random(uint32_t seed) : engine_(seed) {}
+
+  // A number in [min, max].
+  int Between(int min, int max) {
+    return min + static_cast<int>(engine_() % static_cast<uint32_t>(max - min + 1));
+  }
+  bool Percent(int percent) { return Between(0, 99) < percent; }
+  template <typename T, size_t N>
+  const T& Pick(const T (&values)[N]) {
+    return values[Between(0, N - 1)];
+  }
+
+ private:
+  std::mt19937 engine_;
+};
+
+struct DefinedType {
+  string package;
+  string name;
+  bool is_interface;
+
+  string CanonicalName() const { return package + "." + name; }
+  string Path() const {
+    string path = CanonicalName();
+    std::replace(path.begin(), path.end(), '.', '/');
+    return path + ".aidl";
+  }
+};
+
+// Writes the package and the imports of a file that uses |imports|.
+string FileHeader(const DefinedType& type, const vector<const DefinedType*>& imports) {
+  string header = "package " + type.package + ";\n\n";
+  set<string> names;
+  for (const DefinedType* import : imports) {
+    names.insert(import->CanonicalName());
+  }
+  for (const string& name : names) {
+    header += "import " + name + ";\n";
+  }
+  if (!names.empty()) {
+    header += "\n";
+  }
+  return header;
+}
+
+// Draws up to |max| distinct types among |candidates|, plus |required| if it
+// isn't null.
+vector<const DefinedType*> DrawImports(const vector<const DefinedType*>& candidates, int max,
+                                       const DefinedType* required, Random* random) {
+  vector<const DefinedType*> imports;
+  if (required != nullptr) {
+    imports.push_back(required);
+  }
+  const int count = candidates.empty() ? 0 : random->Between(0, max);
+  for (int i = 0; i < count; i++) {
+    const DefinedType* type = candidates[random->Between(0, candidates.size() - 1)];
+    if (std::find(imports.begin(), imports.end(), type) == imports.end()) {
+      imports.push_back(type);
+    }
+  }
+  return imports;
+}
+
+string GenerateParcelable(const DefinedType& type, const vector<const DefinedType*>& imports,
+                          const CorpusConfig& config, Random* random) {
+  string contents = FileHeader(type, imports);
+  contents += "parcelable " + type.name + " {\n";
+  // Each import is used by a field, and the chain comes first.
+  const int fields = std::max<int>(random->Between(config.min_fields, config.max_fields),
+                                   imports.size());
+  for (int i = 0; i < fields; i++) {
+    string field_type;
+    if (i < static_cast<int>(imports.size())) {
+      field_type = imports[i]->name;
+    } else if (random->Percent(25)) {
+      field_type = random->Pick(kArrayTypes);
+    } else {
+      field_type = random->Pick(kScalarTypes);
+    }
+    StringAppendF(&contents, "  %s field%d;\n", field_type.c_str(), i);
+  }
+  contents += "}\n";
+  return contents;
+}
+
+string GenerateInterface(const DefinedType& type, const vector<const DefinedType*>& imports,
+                         const CorpusConfig& config, Random* random) {
+  string contents = FileHeader(type, imports);
+  contents += "interface " + type.name + " {\n";
+  const int methods = random->Between(config.min_methods, config.max_methods);
+  // The imports are used in turn by the arguments that take a defined type.
+  size_t next_import = 0;
+  for (int m = 0; m < methods; m++) {
+    const bool oneway = random->Percent(config.oneway_percent);
+    string return_type = "void";
+    if (!oneway && random->Percent(70)) {
+      return_type = random->Percent(20) ? random->Pick(kArrayTypes) : random->Pick(kScalarTypes);
+    }
+    StringAppendF(&contents, "  /**\n   * Method %d of %s.\n   */\n  %s%s method%d(", m,
+                  type.name.c_str(), oneway ? "oneway " : "", return_type.c_str(), m);
+
+    const int args = random->Between(config.min_args, config.max_args);
+    for (int a = 0; a < args; a++) {
+      string direction = "in";
+      string arg_type;
+      const int kind = random->Between(0, 9);
+      if (kind < 3 && !imports.empty()) {
+        const DefinedType* import = imports[next_import++ % imports.size()];
+        arg_type = import->name;
+        if (!oneway && !import->is_interface) {
+          direction = random->Pick({"in", "out", "inout"});
+        }
+      } else if (kind < 5) {
+        arg_type = random->Pick(kArrayTypes);
+        if (!oneway) {
+          direction = random->Pick({"in", "out", "inout"});
+        }
+      } else {
+        arg_type = random->Pick(kScalarTypes);
+      }
+      StringAppendF(&contents, "%s%s %s arg%d", a == 0 ? "" : ", ", direction.c_str(),
+                    arg_type.c_str(), a);
+    }
+    contents += ");\n";
+  }
+  contents += "}\n";
+  return contents;
+}
+
+}  // namespace
+
+bool CorpusConfig::Set(const string& key, const string& value, string* error) {
+  if (key == "seed") {
+    if (!ParseUint(value, &seed)) {
+      *error = "invalid seed: " + value;
+      return false;
+    }
+    return true;
+  }
+  if (key == "import_chain") {
+    if (value != "true" && value != "false") {
+      *error = "import_chain must be true or false: " + value;
+      return false;
+    }
+    import_chain = value == "true";
+    return true;
+  }
+  const std::map<string, int*> ints = {
+      {"interfaces", &interfaces},
+      {"min_methods", &min_methods},
+      {"max_methods", &max_methods},
+      {"min_args", &min_args},
+      {"max_args", &max_args},
+      {"oneway_percent", &oneway_percent},
+      {"parcelables", &parcelables},
+      {"min_fields", &min_fields},
+      {"max_fields", &max_fields},
+      {"max_imports", &max_imports},
+      {"packages", &packages},
+      {"preprocessed_entries", &preprocessed_entries},
+  };
+  auto it = ints.find(key);
+  if (it == ints.end()) {
+    *error = "unknown key: " + key;
+    return false;
+  }
+  if (!ParseInt(value, it->second)) {
+    *error = "invalid " + key + ": " + value;
+    return false;
+  }
+  return true;
+}
+
+bool CorpusConfig::Parse(const string& text, string* error) {
+  int line_number = 0;
+  for (const string& raw_line : Split(text, "\n")) {
+    line_number++;
+    const string line = Trim(raw_line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    const size_t equals = line.find('=');
+    if (equals == string::npos) {
+      *error = StringPrintf("line %d: expected key = value", line_number);
+      return false;
+    }
+    if (!Set(Trim(line.substr(0, equals)), Trim(line.substr(equals + 1)), error)) {
+      *error = StringPrintf("line %d: %s", line_number, error->c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CorpusConfig::Validate(string* error) const {
+  const std::pair<const char*, int> counts[] = {
+      {"interfaces", interfaces},     {"min_methods", min_methods},
+      {"min_args", min_args},         {"parcelables", parcelables},
+      {"min_fields", min_fields},     {"max_imports", max_imports},
+      {"preprocessed_entries", preprocessed_entries},
+  };
+  for (const auto& count : counts) {
+    if (count.second < 0) {
+      *error = StringPrintf("%s must not be negative", count.first);
+      return false;
+    }
+  }
+  const std::pair<const char*, bool> ranges[] = {
+      {"methods", min_methods <= max_methods},
+      {"args", min_args <= max_args},
+      {"fields", min_fields <= max_fields},
+  };
+  for (const auto& range : ranges) {
+    if (!range.second) {
+      *error = StringPrintf("min_%s must not be greater than max_%s", range.first, range.first);
+      return false;
+    }
+  }
+  if (oneway_percent < 0 || oneway_percent > 100) {
+    *error = "oneway_percent must be between 0 and 100";
+    return false;
+  }
+  if (packages < 1) {
+    *error = "packages must be at least 1";
+    return false;
+  }
+  return true;
+}
+
+Corpus GenerateCorpus(const CorpusConfig& config) {
+  string error;
+  CHECK(config.Validate(&error)) << error;
+  Random random(config.seed);
+  Corpus corpus;
+
+  vector<DefinedType> parcelables;
+  for (int i = 0; i < config.parcelables; i++) {
+    parcelables.push_back({StringPrintf("corpus.p%d", i % config.packages),
+                           StringPrintf("Data%d", i), false});
+  }
+  vector<DefinedType> interfaces;
+  for (int i = 0; i < config.interfaces; i++) {
+    interfaces.push_back({StringPrintf("corpus.p%d", i % config.packages),
+                          StringPrintf("IService%d", i), true});
+  }
+
+  // A file only uses the types defined before it, so that there are no
+  // cycles.
+  vector<const DefinedType*> candidates;
+  for (size_t i = 0; i < parcelables.size(); i++) {
+    const DefinedType* previous =
+        config.import_chain && i > 0 ? &parcelables[i - 1] : nullptr;
+    const auto imports = DrawImports(candidates, config.max_imports, previous, &random);
+    corpus.files[parcelables[i].Path()] =
+        GenerateParcelable(parcelables[i], imports, config, &random);
+    candidates.push_back(&parcelables[i]);
+  }
+  for (size_t i = 0; i < interfaces.size(); i++) {
+    const DefinedType* last =
+        config.import_chain && !parcelables.empty() ? &parcelables.back() : nullptr;
+    const auto imports = DrawImports(candidates, config.max_imports, last, &random);
+    corpus.files[interfaces[i].Path()] = GenerateInterface(interfaces[i], imports, config, &random);
+    corpus.interface_files.push_back(interfaces[i].Path());
+    candidates.push_back(&interfaces[i]);
+  }
+
+  if (config.preprocessed_entries > 0) {
+    string contents;
+    for (int i = 0; i < config.preprocessed_entries; i++) {
+      const int package = random.Between(0, config.packages - 1);
+      if (i % 2 == 0) {
+        StringAppendF(&contents, "parcelable corpus.pre%d.Parcelable%d;\n", package, i);
+      } else {
+        StringAppendF(&contents, "interface corpus.pre%d.IInterface%d;\n", package, i);
+      }
+    }
+    corpus.preprocessed_file = "preprocessed.aidl";
+    corpus.files[corpus.preprocessed_file] = contents;
+  }
+  return corpus;
+}
+
+}  // namespace test
+}  // namespace aidl
+}  // namespace android
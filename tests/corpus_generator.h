@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace aidl {
+namespace test {
+
+// What a synthetic corpus of AIDL files looks like. The sizes that are given
+// as a range are drawn for each file or method from it, inclusive.
+struct CorpusConfig {
+  // Everything that is drawn comes from this seed. The same seed and config
+  // always give the same corpus, whatever the platform.
+  uint32_t seed = 1;
+
+  int interfaces = 1;
+  int min_methods = 10;
+  int max_methods = 10;
+  int min_args = 0;
+  int max_args = 4;
+  // Percentage of the methods that are oneway.
+  int oneway_percent = 10;
+
+  // Structured parcelables, which the interfaces and the parcelables defined
+  // after them use as types.
+  int parcelables = 0;
+  int min_fields = 1;
+  int max_fields = 8;
+  // When set, each parcelable has a field of the one before it, and the
+  // interfaces import the last one, so that the imports form a chain as deep
+  // as there are parcelables.
+  bool import_chain = false;
+  // Maximum number of other defined types that a file imports, besides the
+  // one of the chain.
+  int max_imports = 4;
+  // The defined types are spread over this many packages.
+  int packages = 1;
+
+  // Entries of a preprocessed file, half parcelables and half interfaces.
+  // No preprocessed file is generated when 0.
+  int preprocessed_entries = 0;
+
+  // Sets the field named |key| to |value|. Returns false, with an error in
+  // |*error|, if there is no such field or if the value is invalid.
+  bool Set(const std::string& key, const std::string& value, std::string* error);
+  // Sets the fields given by |text|, which has one "key = value" per line.
+  // Empty lines and lines starting with '#' are ignored.
+  bool Parse(const std::string& text, std::string* error);
+  // Returns false, with an error in |*error|, if the ranges are empty or the
+  // counts are negative.
+  bool Validate(std::string* error) const;
+};
+
+struct Corpus {
+  // The contents of each file, keyed by their path relative to the root of
+  // the corpus, which is also the import path.
+  std::map<std::string, std::string> files;
+  // The paths of the interfaces, which import all the other files.
+  std::vector<std::string> interface_files;
+  // The path of the preprocessed file, or empty when there is none.
+  std::string preprocessed_file;
+};
+
+// Generates the corpus described by |config|, which must be valid. The files
+// compile with every language.
+Corpus GenerateCorpus(const CorpusConfig& config);
+
+}  // namespace test
+}  // namespace aidl
+}  // namespace android
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+
+#include "code_writer.h"
+#include "io_delegate.h"
+#include "os.h"
+#include "tests/corpus_generator.h"
+
+using android::aidl::CodeWriterPtr;
+using android::aidl::IoDelegate;
+using android::aidl::test::Corpus;
+using android::aidl::test::CorpusConfig;
+using android::base::StartsWith;
+using std::string;
+
+namespace {
+
+const char kUsage[] =
+    "usage: aidl_corpus_generator [--config=FILE] [KEY=VALUE...] -o DIR\n"
+    "\n"
+    "Writes a synthetic corpus of AIDL files to DIR, which is also their import\n"
+    "path, and prints the paths of the interfaces, which import all the other\n"
+    "files. The corpus only depends on the seed and the config, which has one\n"
+    "KEY = VALUE per line. The KEY=VALUE arguments override the config.\n"
+    "\n"
+    "Keys:\n"
+    "  seed, interfaces, min_methods, max_methods, min_args, max_args,\n"
+    "  oneway_percent, parcelables, min_fields, max_fields, import_chain,\n"
+    "  max_imports, packages, preprocessed_entries\n"
+    "\n"
+    "Example, an interface that the Java generator outlines:\n"
+    "  aidl_corpus_generator min_methods=1200 max_methods=1200 -o corpus\n";
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  android::base::InitLogging(argv);
+  IoDelegate io_delegate;
+  CorpusConfig config;
+  string output_dir;
+  string error;
+  // The config files are applied first, whatever the order of the arguments,
+  // so that the KEY=VALUE arguments override them.
+  std::vector<string> config_files;
+  std::vector<string> overrides;
+  for (int i = 1; i < argc; i++) {
+    const string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      std::cout << kUsage;
+      return 0;
+    }
+    if (arg == "-o" && i + 1 < argc) {
+      output_dir = argv[++i];
+    } else if (StartsWith(arg, "--config=")) {
+      config_files.push_back(arg.substr(string("--config=").size()));
+    } else if (arg.find('=') != string::npos && !StartsWith(arg, "-")) {
+      overrides.push_back(arg);
+    } else {
+      std::cerr << "unknown argument: " << arg << std::endl << kUsage;
+      return 1;
+    }
+  }
+  for (const string& path : config_files) {
+    std::unique_ptr<string> contents = io_delegate.GetFileContents(path);
+    if (contents == nullptr) {
+      std::cerr << "can't read " << path << std::endl;
+      return 1;
+    }
+    if (!config.Parse(*contents, &error)) {
+      std::cerr << path << ": " << error << std::endl;
+      return 1;
+    }
+  }
+  for (const string& arg : overrides) {
+    const size_t equals = arg.find('=');
+    if (!config.Set(arg.substr(0, equals), arg.substr(equals + 1), &error)) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+  }
+  if (output_dir.empty()) {
+    std::cerr << "no output directory" << std::endl << kUsage;
+    return 1;
+  }
+  if (!config.Validate(&error)) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  if (output_dir.back() != OS_PATH_SEPARATOR) {
+    output_dir += OS_PATH_SEPARATOR;
+  }
+  const Corpus corpus = GenerateCorpus(config);
+  for (const auto& file : corpus.files) {
+    CodeWriterPtr writer = io_delegate.GetCodeWriter(output_dir + file.first);
+    if (writer == nullptr || !writer->WriteRaw(file.second) || !writer->Close()) {
+      std::cerr << "can't write " << output_dir + file.first << std::endl;
+      return 1;
+    }
+  }
+  for (const string& path : corpus.interface_files) {
+    std::cout << output_dir + path << std::endl;
+  }
+  return 0;
+}
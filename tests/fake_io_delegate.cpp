@@ -36,6 +36,7 @@ namespace test {
 // Claims to always write successfully, but can't close the file.
 class BrokenCodeWriter : public CodeWriter {
   bool Write(const char* /* format */, ...) override {  return true; }
+  bool WriteRaw(const std::string& /* data */) override { return true; }
   bool Close() override { return false; }
   ~BrokenCodeWriter() override = default;
 };  // class BrokenCodeWriter
@@ -56,6 +57,14 @@ unique_ptr<string> FakeIoDelegate::GetFileContents(
   return contents;
 }
 
+unique_ptr<FileBuffer> FakeIoDelegate::GetFileBuffer(const string& filename) const {
+  auto it = file_contents_.find(CleanPath(filename));
+  if (it == file_contents_.end()) {
+    return nullptr;
+  }
+  return FileBuffer::FromString(it->second);
+}
+
 unique_ptr<LineReader> FakeIoDelegate::GetLineReader(
     const string& file_path) const {
   unique_ptr<LineReader> ret;
@@ -70,23 +79,49 @@ bool FakeIoDelegate::FileIsReadable(const string& path) const {
   return file_contents_.find(CleanPath(path)) != file_contents_.end();
 }
 
+bool FakeIoDelegate::GetFileStamp(const string& path, FileStamp* stamp) const {
+  const string clean_path = CleanPath(path);
+  auto it = file_contents_.find(clean_path);
+  if (it == file_contents_.end()) {
+    return false;
+  }
+  stamp->mtime_ns = file_mtimes_.at(clean_path);
+  stamp->size = it->second.size();
+  return true;
+}
+
 std::unique_ptr<CodeWriter> FakeIoDelegate::GetCodeWriter(
     const std::string& file_path) const {
   if (broken_files_.count(file_path) > 0) {
     return unique_ptr<CodeWriter>(new BrokenCodeWriter);
   }
+  std::lock_guard<std::mutex> lock(mutex_);
   removed_files_.erase(file_path);
   written_file_contents_[file_path] = "";
   return CodeWriter::ForString(&written_file_contents_[file_path]);
 }
 
 void FakeIoDelegate::RemovePath(const std::string& file_path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
   removed_files_.insert(file_path);
 }
 
+bool FakeIoDelegate::RenameFile(const string& from, const string& to) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = written_file_contents_.find(from);
+  if (it == written_file_contents_.end()) {
+    return false;
+  }
+  written_file_contents_[to] = std::move(it->second);
+  written_file_contents_.erase(from);
+  removed_files_.erase(to);
+  return true;
+}
+
 void FakeIoDelegate::SetFileContents(const string& filename,
                                      const string& contents) {
   file_contents_[filename] = contents;
+  file_mtimes_[filename] = ++contents_set_count_;
 }
 
 vector<string> FakeIoDelegate::ListFiles(const string& dir) const {
@@ -100,6 +135,19 @@ vector<string> FakeIoDelegate::ListFiles(const string& dir) const {
   return files;
 }
 
+bool FakeIoDelegate::ListDirectory(const string& dir, vector<string>* names) const {
+  const string dir_name = CleanPath(dir);
+  std::set<string> entries;
+  for (auto it = file_contents_.begin(); it != file_contents_.end(); it++) {
+    if (android::base::StartsWith(it->first, dir_name)) {
+      const string rest = it->first.substr(dir_name.size());
+      entries.insert(rest.substr(0, rest.find(OS_PATH_SEPARATOR)));
+    }
+  }
+  names->insert(names->end(), entries.begin(), entries.end());
+  return true;
+}
+
 void FakeIoDelegate::AddStubParcelable(const string& canonical_name,
                                        const string& cpp_header) {
   string package, class_name, rel_path;
@@ -141,6 +189,7 @@ void FakeIoDelegate::AddBrokenFilePath(const std::string& path) {
 }
 
 bool FakeIoDelegate::GetWrittenContents(const string& path, string* content) {
+  std::lock_guard<std::mutex> lock(mutex_);
   const auto it = written_file_contents_.find(path);
   if (it == written_file_contents_.end()) {
     return false;
@@ -152,6 +201,7 @@ bool FakeIoDelegate::GetWrittenContents(const string& path, string* content) {
 }
 
 bool FakeIoDelegate::PathWasRemoved(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if (removed_files_.count(path) > 0) {
     return true;
   }
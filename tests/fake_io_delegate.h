@@ -21,6 +21,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -42,11 +43,19 @@ class FakeIoDelegate : public IoDelegate {
       const std::string& append_content_suffix = "") const override;
   std::unique_ptr<LineReader> GetLineReader(
       const std::string& file_path) const override;
+  std::unique_ptr<FileBuffer> GetFileBuffer(const std::string& filename) const override;
   bool FileIsReadable(const std::string& path) const override;
+  // The modification time of a file is the number of times the contents of
+  // any file were set when its own contents were last set.
+  bool GetFileStamp(const std::string& path, FileStamp* stamp) const override;
   std::unique_ptr<CodeWriter> GetCodeWriter(
       const std::string& file_path) const override;
   void RemovePath(const std::string& file_path) const override;
+  // Only moves what was written to |from|. The files that can be read don't
+  // change.
+  bool RenameFile(const std::string& from, const std::string& to) const override;
   std::vector<std::string> ListFiles(const std::string& dir) const override;
+  bool ListDirectory(const std::string& dir, std::vector<std::string>* names) const override;
 
   // Methods added to facilitate testing.
   void SetFileContents(const std::string& filename,
@@ -68,9 +77,13 @@ class FakeIoDelegate : public IoDelegate {
   std::string CleanPath(const std::string& path) const;
 
   std::map<std::string, std::string> file_contents_;
+  std::map<std::string, int64_t> file_mtimes_;
+  int64_t contents_set_count_ = 0;
   // Normally, writing to files leaves the IoDelegate unchanged, so
   // GetCodeWriter is a const method.  However, for tests, we break this
-  // intentionally by storing the written strings.
+  // intentionally by storing the written strings. |mutex_| guards them
+  // because the inputs may be compiled in parallel.
+  mutable std::mutex mutex_;
   mutable std::map<std::string, std::string> written_file_contents_;
 
   // We normally just write to strings in |written_file_contents_| but for
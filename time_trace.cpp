@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "time_trace.h"
+
+#include <algorithm>
+
+#include <android-base/stringprintf.h>
+
+#include "code_writer.h"
+#include "logging.h"
+
+using android::base::StringAppendF;
+using std::string;
+
+namespace android {
+namespace aidl {
+
+namespace {
+
+void AppendJsonString(const string& str, string* out) {
+  out->push_back('"');
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      StringAppendF(out, "\\u%04x", c);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+}  // namespace
+
+std::atomic<TimeTrace*> TimeTrace::current_(nullptr);
+
+TimeTrace::Scope::Scope(const char* name, const string& detail)
+    : trace_(current_.load(std::memory_order_acquire)), name_(name) {
+  if (trace_ != nullptr) {
+    detail_ = detail;
+    start_us_ = trace_->Now();
+  }
+}
+
+TimeTrace::Scope::~Scope() {
+  if (trace_ != nullptr) {
+    trace_->Add({.name = name_,
+                 .detail = std::move(detail_),
+                 .start_us = start_us_,
+                 .duration_us = trace_->Now() - start_us_,
+                 .thread = 0,
+                 .counters = std::move(counters_)});
+  }
+}
+
+void TimeTrace::Scope::Count(const char* name, int64_t value) {
+  if (trace_ == nullptr) {
+    return;
+  }
+  for (auto& counter : counters_) {
+    if (counter.first == name) {
+      counter.second += value;
+      return;
+    }
+  }
+  counters_.emplace_back(name, value);
+}
+
+TimeTrace::TimeTrace() : start_(std::chrono::steady_clock::now()) {
+  TimeTrace* expected = nullptr;
+  CHECK(current_.compare_exchange_strong(expected, this)) << "there is a time trace already";
+}
+
+TimeTrace::~TimeTrace() {
+  current_.store(nullptr, std::memory_order_release);
+}
+
+int64_t TimeTrace::Now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                               start_)
+      .count();
+}
+
+void TimeTrace::Add(Event event) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto thread = threads_.emplace(std::this_thread::get_id(), threads_.size() + 1).first;
+  event.thread = thread->second;
+  events_.push_back(std::move(event));
+}
+
+string TimeTrace::ToJson() const {
+  std::vector<const Event*> events;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Event& event : events_) {
+      events.push_back(&event);
+    }
+  }
+  // An enclosing event ends after the events in it, so it is recorded after
+  // them. It is listed before them instead, which is easier to read.
+  std::stable_sort(events.begin(), events.end(), [](const Event* a, const Event* b) {
+    return a->thread != b->thread ? a->thread < b->thread : a->start_us < b->start_us;
+  });
+
+  string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const Event* event : events) {
+    json += first ? "\n" : ",\n";
+    first = false;
+    json += "{\"name\":";
+    AppendJsonString(event->name, &json);
+    StringAppendF(&json,
+                  ",\"cat\":\"aidl\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                  "\"args\":{",
+                  event->thread, static_cast<long long>(event->start_us),
+                  static_cast<long long>(event->duration_us));
+    const char* separator = "";
+    if (!event->detail.empty()) {
+      json += "\"detail\":";
+      AppendJsonString(event->detail, &json);
+      separator = ",";
+    }
+    for (const auto& counter : event->counters) {
+      json += separator;
+      AppendJsonString(counter.first, &json);
+      StringAppendF(&json, ":%lld", static_cast<long long>(counter.second));
+      separator = ",";
+    }
+    json += "}}";
+  }
+  json += "\n]}\n";
+  return json;
+}
+
+bool TimeTrace::Write(const string& path, const IoDelegate& io_delegate) const {
+  // The events of writing the trace itself come too late to be in it.
+  const string json = ToJson();
+  CodeWriterPtr writer = io_delegate.GetCodeWriter(path);
+  if (writer == nullptr || !writer->WriteRaw(json) || !writer->Close()) {
+    LOG(ERROR) << "can't write the time trace to " << path;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace aidl
+}  // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "io_delegate.h"
+
+namespace android {
+namespace aidl {
+
+// Records how long the phases of the compiler take, for --time_trace. The
+// phases are marked with TimeTrace::Scope, and the trace is written in the
+// Chrome trace-event format, which chrome://tracing and Perfetto show as a
+// timeline. Each thread gets its own track, so the inputs compiled in
+// parallel with --jobs don't overlap, and the scopes that are nested in time
+// are shown nested.
+//
+// The scopes of all threads are recorded into the trace while it is alive.
+// Without a trace, a scope does nothing, not even reading the clock.
+class TimeTrace final {
+ public:
+  // Marks the time from its construction to its destruction as an event
+  // named |name| in the trace, if there is one. |name| must be a string
+  // literal. |detail| tells what the event is about, e.g. a file name.
+  class Scope final {
+   public:
+    explicit Scope(const char* name, const std::string& detail = "");
+    ~Scope();
+
+    // Adds |value| to the counter |name| of the event, e.g. a number of
+    // bytes. |name| must be a string literal.
+    void Count(const char* name, int64_t value);
+
+   private:
+    TimeTrace* const trace_;
+    const char* const name_;
+    std::string detail_;
+    int64_t start_us_ = 0;
+    std::vector<std::pair<const char*, int64_t>> counters_;
+
+    DISALLOW_COPY_AND_ASSIGN(Scope);
+  };
+
+  // There can be only one trace at a time.
+  TimeTrace();
+  ~TimeTrace();
+
+  // The events recorded so far, in the Chrome trace-event JSON format.
+  std::string ToJson() const;
+
+  // Writes ToJson() to |path|. Returns false on error.
+  bool Write(const std::string& path, const IoDelegate& io_delegate) const;
+
+ private:
+  struct Event {
+    const char* name;
+    std::string detail;
+    int64_t start_us;
+    int64_t duration_us;
+    int thread;
+    std::vector<std::pair<const char*, int64_t>> counters;
+  };
+
+  // Microseconds since the trace started.
+  int64_t Now() const;
+  void Add(Event event);
+
+  static std::atomic<TimeTrace*> current_;
+
+  const std::chrono::steady_clock::time_point start_;
+  mutable std::mutex mutex_;
+  std::vector<Event> events_;
+  // The threads are numbered in the order they record their first event.
+  std::map<std::thread::id, int> threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimeTrace);
+};
+
+}  // namespace aidl
+}  // namespace android
@@ -365,6 +365,20 @@ Type::Type(int kind,
 bool Type::CanWriteToParcel() const { return true; }
 
 void TypeNamespace::Init() {
+  // The built-in types never change, so they are created once and shared by
+  // all the namespaces. They are never freed.
+  static const TypeNamespace* const builtins = [] {
+    TypeNamespace* types = new TypeNamespace;
+    types->AddBuiltinTypes();
+    return types;
+  }();
+  SetBuiltinTypes(builtins);
+  void_type_ = builtins->void_type_;
+  string_type_ = builtins->string_type_;
+  ibinder_type_ = builtins->ibinder_type_;
+}
+
+void TypeNamespace::AddBuiltinTypes() {
   Add(std::make_unique<ByteType>());
   Add(std::make_unique<PrimitiveType>("int", "cstdint", "int32_t", "readInt32", "writeInt32",
                                       "readInt32Vector", "writeInt32Vector"));
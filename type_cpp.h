@@ -88,6 +88,8 @@ class Type : public ValidatableType {
 class TypeNamespace : public ::android::aidl::LanguageTypeNamespace<Type> {
  public:
   TypeNamespace() = default;
+  // Shares |typenames| instead of having types of its own.
+  explicit TypeNamespace(AidlTypenames& typenames) : LanguageTypeNamespace(typenames) {}
   virtual ~TypeNamespace() = default;
 
   void Init() override;
@@ -106,6 +108,8 @@ class TypeNamespace : public ::android::aidl::LanguageTypeNamespace<Type> {
   const Type* IBinderType() const { return ibinder_type_; }
 
  private:
+  void AddBuiltinTypes();
+
   const Type* void_type_ = nullptr;
   const Type* string_type_ = nullptr;
   const Type* ibinder_type_ = nullptr;
@@ -16,6 +16,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -23,6 +24,7 @@
 
 using std::string;
 using std::unique_ptr;
+using std::vector;
 
 namespace android {
 namespace aidl {
@@ -33,6 +35,18 @@ namespace {
 string kParcelableDotName = "Outer.Inner";
 string kParcelableColonName = "Outer::Inner";
 
+// Remembers which types from preprocessed files were created.
+class RecordingTypeNamespace : public TypeNamespace {
+ public:
+  vector<string> created_;
+
+ protected:
+  bool CreatePreprocessedType(const AidlPreprocessedType& type) override {
+    created_.push_back(type.GetCanonicalName());
+    return TypeNamespace::CreatePreprocessedType(type);
+  }
+};
+
 }  // namespace
 
 class CppTypeNamespaceTest : public ::testing::Test {
@@ -66,6 +80,36 @@ TEST_F(CppTypeNamespaceTest, SupportsNestedParcelableClass) {
   EXPECT_EQ(parcelable->GetCppName(), kParcelableColonName);
 }
 
+TEST(CppTypeNamespacePreprocessedTest, CreatesOnlyTypesLookedUp) {
+  using Kind = AidlPreprocessedType::Kind;
+  const AidlPreprocessedType foo(Kind::INTERFACE, {"a"}, "IFoo", "p.aidl", 1);
+  const AidlPreprocessedType bar(Kind::INTERFACE, {"a"}, "IBar", "p.aidl", 2);
+  const AidlPreprocessedType other_bar(Kind::INTERFACE, {"b"}, "IBar", "p.aidl", 3);
+  RecordingTypeNamespace types;
+  types.Init();
+  types.AddPreprocessedType(foo);
+  types.AddPreprocessedType(bar);
+  types.AddPreprocessedType(other_bar);
+  EXPECT_TRUE(types.created_.empty());
+
+  EXPECT_FALSE(types.HasTypeByCanonicalName("a.IBaz"));
+  EXPECT_TRUE(types.created_.empty());
+
+  const Type* type = types.FindTypeByCanonicalName("a.IFoo");
+  ASSERT_NE(type, nullptr);
+  EXPECT_EQ(type->CanonicalName(), "a.IFoo");
+  EXPECT_EQ(types.FindTypeByCanonicalName("IFoo"), type);
+  EXPECT_EQ(types.created_, vector<string>{"a.IFoo"});
+
+  // The short name finds the type added last, as if all had been added.
+  type = types.FindTypeByCanonicalName("IBar");
+  ASSERT_NE(type, nullptr);
+  EXPECT_EQ(type->CanonicalName(), "b.IBar");
+  EXPECT_EQ(types.FindTypeByCanonicalName("a.IBar")->CanonicalName(), "a.IBar");
+  EXPECT_EQ(types.FindTypeByCanonicalName("IBar"), type);
+  EXPECT_EQ(types.created_, (vector<string>{"a.IFoo", "b.IBar", "a.IBar"}));
+}
+
 }  // namespace cpp
 }  // namespace android
 }  // namespace aidl
@@ -246,6 +246,31 @@ ClassLoaderType::ClassLoaderType(const JavaTypeNamespace* types)
 // ================================================================
 
 void JavaTypeNamespace::Init() {
+  // The built-in types never change, so they are created once and shared by
+  // all the namespaces. They are never freed.
+  static const JavaTypeNamespace* const builtins = [] {
+    JavaTypeNamespace* types = new JavaTypeNamespace;
+    types->AddBuiltinTypes();
+    return types;
+  }();
+  SetBuiltinTypes(builtins);
+  m_bool_type = builtins->m_bool_type;
+  m_int_type = builtins->m_int_type;
+  m_string_type = builtins->m_string_type;
+  m_text_utils_type = builtins->m_text_utils_type;
+  m_remote_exception_type = builtins->m_remote_exception_type;
+  m_runtime_exception_type = builtins->m_runtime_exception_type;
+  m_ibinder_type = builtins->m_ibinder_type;
+  m_iinterface_type = builtins->m_iinterface_type;
+  m_binder_native_type = builtins->m_binder_native_type;
+  m_binder_proxy_type = builtins->m_binder_proxy_type;
+  m_parcel_type = builtins->m_parcel_type;
+  m_parcelable_interface_type = builtins->m_parcelable_interface_type;
+  m_context_type = builtins->m_context_type;
+  m_classloader_type = builtins->m_classloader_type;
+}
+
+void JavaTypeNamespace::AddBuiltinTypes() {
   Add(std::make_unique<BasicType>(this, "void", "XXX", "XXX", "XXX", "XXX", "XXX"));
 
   AddAndSetMember(&m_bool_type, std::make_unique<BooleanType>(this));
@@ -310,6 +335,7 @@ void JavaTypeNamespace::Init() {
 
   AddAndSetMember(&m_classloader_type, std::make_unique<class ClassLoaderType>(this));
 
+  // Like the built-in types, the literals are shared by all the namespaces.
   NULL_VALUE = new LiteralExpression("null");
   THIS_VALUE = new LiteralExpression("this");
   SUPER_VALUE = new LiteralExpression("super");
@@ -319,21 +345,37 @@ void JavaTypeNamespace::Init() {
 
 bool JavaTypeNamespace::AddParcelableType(const AidlParcelable& p,
                                           const std::string& filename) {
-  return Add(
-      std::make_unique<UserDataType>(this, p.GetPackage(), p.GetName(), false, true, filename));
+  return AddParcelableType(p.GetPackage(), p.GetName(), filename);
 }
 
 bool JavaTypeNamespace::AddBinderType(const AidlInterface& b,
                                       const std::string& filename) {
+  return AddBinderType(b.GetPackage(), b.GetName(), filename);
+}
+
+bool JavaTypeNamespace::CreatePreprocessedType(const AidlPreprocessedType& type) {
+  if (type.GetKind() == AidlPreprocessedType::Kind::INTERFACE) {
+    return AddBinderType(type.GetPackage(), type.GetName(), type.GetFilename());
+  }
+  return AddParcelableType(type.GetPackage(), type.GetName(), type.GetFilename());
+}
+
+bool JavaTypeNamespace::AddParcelableType(const std::string& package, const std::string& name,
+                                          const std::string& filename) {
+  return Add(std::make_unique<UserDataType>(this, package, name, false, true, filename));
+}
+
+bool JavaTypeNamespace::AddBinderType(const std::string& package, const std::string& name,
+                                      const std::string& filename) {
   // for interfaces, add the stub, proxy, and interface types.
-  auto stub = std::make_unique<Type>(this, b.GetPackage(), b.GetName() + ".Stub",
+  auto stub = std::make_unique<Type>(this, package, name + ".Stub",
                                      ValidatableType::KIND_GENERATED, false, filename);
-  auto proxy = std::make_unique<Type>(this, b.GetPackage(), b.GetName() + ".Stub.Proxy",
+  auto proxy = std::make_unique<Type>(this, package, name + ".Stub.Proxy",
                                       ValidatableType::KIND_GENERATED, false, filename);
-  auto defaultImpl = std::make_unique<Type>(this, b.GetPackage(), b.GetName() + ".Default",
+  auto defaultImpl = std::make_unique<Type>(this, package, name + ".Default",
                                             ValidatableType::KIND_GENERATED, false, filename);
-  auto type = std::make_unique<InterfaceType>(this, b.GetPackage(), b.GetName(), false, filename,
-                                              -1, stub.get(), proxy.get(), defaultImpl.get());
+  auto type = std::make_unique<InterfaceType>(this, package, name, false, filename, -1,
+                                              stub.get(), proxy.get(), defaultImpl.get());
 
   bool success = true;
   success &= Add(std::move(type));
@@ -285,6 +285,8 @@ class GenericListType : public Type {
 class JavaTypeNamespace : public LanguageTypeNamespace<Type> {
  public:
   JavaTypeNamespace() = default;
+  // Shares |typenames| instead of having types of its own.
+  explicit JavaTypeNamespace(AidlTypenames& typenames) : LanguageTypeNamespace(typenames) {}
   virtual ~JavaTypeNamespace() = default;
 
   void Init() override;
@@ -314,6 +316,14 @@ class JavaTypeNamespace : public LanguageTypeNamespace<Type> {
   const Type* ClassLoaderType() const { return m_classloader_type; }
 
  private:
+  // Java types only need the names, so the AidlDefinedType is not created.
+  bool CreatePreprocessedType(const AidlPreprocessedType& type) override;
+  void AddBuiltinTypes();
+  bool AddParcelableType(const std::string& package, const std::string& name,
+                         const std::string& filename);
+  bool AddBinderType(const std::string& package, const std::string& name,
+                     const std::string& filename);
+
   const Type* m_bool_type{nullptr};
   const Type* m_int_type{nullptr};
   const Type* m_string_type{nullptr};
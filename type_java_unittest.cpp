@@ -62,6 +62,45 @@ TEST_F(JavaTypeNamespaceTest, ContainerTypeCreation) {
   EXPECT_TRUE(types_.HasTypeByCanonicalName("java.util.List<a.goog.Foo>"));
 }
 
+TEST_F(JavaTypeNamespaceTest, FindsTypesByCanonicalAndShortName) {
+  unique_ptr<AidlParcelable> first(new AidlParcelable(
+      AIDL_LOCATION_HERE, new AidlQualifiedName(AIDL_LOCATION_HERE, "Foo", ""), {"a", "goog"}, ""));
+  unique_ptr<AidlParcelable> second(new AidlParcelable(
+      AIDL_LOCATION_HERE, new AidlQualifiedName(AIDL_LOCATION_HERE, "Foo", ""), {"b", "goog"}, ""));
+  EXPECT_TRUE(types_.AddParcelableType(*first.get(), __FILE__));
+  EXPECT_TRUE(types_.AddParcelableType(*second.get(), __FILE__));
+  const Type* a_foo = types_.FindTypeByCanonicalName(" a.goog.Foo ");
+  const Type* b_foo = types_.FindTypeByCanonicalName("b.goog.Foo");
+  ASSERT_NE(nullptr, a_foo);
+  ASSERT_NE(nullptr, b_foo);
+  EXPECT_EQ("a.goog.Foo", a_foo->CanonicalName());
+  EXPECT_EQ("b.goog.Foo", b_foo->CanonicalName());
+  // An ambiguous short name refers to the type added last.
+  EXPECT_EQ(b_foo, types_.FindTypeByCanonicalName("Foo"));
+  EXPECT_EQ(nullptr, types_.FindTypeByCanonicalName("c.goog.Foo"));
+}
+
+TEST_F(JavaTypeNamespaceTest, SharesBuiltinTypes) {
+  JavaTypeNamespace other;
+  other.Init();
+  EXPECT_EQ(types_.FindTypeByCanonicalName("int"), other.FindTypeByCanonicalName("int"));
+  EXPECT_EQ(types_.StringType(), other.StringType());
+  EXPECT_EQ(types_.StringType(), other.FindTypeByCanonicalName("String"));
+  // User defined types stay in the namespace they were added to.
+  unique_ptr<AidlParcelable> parcelable(new AidlParcelable(
+      AIDL_LOCATION_HERE, new AidlQualifiedName(AIDL_LOCATION_HERE, "Foo", ""), {"a", "goog"}, ""));
+  EXPECT_TRUE(types_.AddParcelableType(*parcelable.get(), __FILE__));
+  EXPECT_TRUE(types_.HasTypeByCanonicalName("a.goog.Foo"));
+  EXPECT_FALSE(other.HasTypeByCanonicalName("a.goog.Foo"));
+  // A built-in type can't be redefined, but its short name can be reused.
+  unique_ptr<AidlParcelable> string(new AidlParcelable(
+      AIDL_LOCATION_HERE, new AidlQualifiedName(AIDL_LOCATION_HERE, "String", ""), {"a", "goog"},
+      ""));
+  EXPECT_TRUE(other.AddParcelableType(*string.get(), __FILE__));
+  EXPECT_EQ("a.goog.String", other.FindTypeByCanonicalName("String")->CanonicalName());
+  EXPECT_EQ(types_.StringType(), types_.FindTypeByCanonicalName("String"));
+}
+
 }  // namespace java
 }  // namespace android
 }  // namespace aidl
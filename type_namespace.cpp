@@ -100,7 +100,8 @@ const ValidatableType* TypeNamespace::GetReturnType(const AidlTypeSpecifier& raw
   return return_type;
 }
 
-bool TypeNamespace::AddDefinedTypes(vector<AidlDefinedType*>& types, const string& filename) {
+bool TypeNamespace::AddDefinedTypes(const vector<AidlDefinedType*>& types,
+                                    const string& filename) {
   bool success = true;
   for (const auto type : types) {
     const AidlInterface* interface = type->AsInterface();
@@ -120,6 +121,14 @@ bool TypeNamespace::AddDefinedTypes(vector<AidlDefinedType*>& types, const strin
   return success;
 }
 
+bool TypeNamespace::CreatePreprocessedType(const AidlPreprocessedType& type) {
+  const AidlDefinedType& defined_type = type.GetDefinedType();
+  if (defined_type.AsInterface() != nullptr) {
+    return AddBinderType(*defined_type.AsInterface(), type.GetFilename());
+  }
+  return AddParcelableType(*defined_type.AsParcelable(), type.GetFilename());
+}
+
 const ValidatableType* TypeNamespace::GetArgType(const AidlArgument& a, int arg_index,
                                                  const AidlDefinedType& context) const {
   string error_prefix =
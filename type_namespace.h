@@ -18,6 +18,10 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <android-base/macros.h>
 #include <android-base/stringprintf.h>
@@ -25,6 +29,7 @@
 
 #include "aidl_language.h"
 #include "logging.h"
+#include "preprocessed_table.h"
 
 namespace android {
 namespace aidl {
@@ -64,9 +69,9 @@ class ValidatableType {
   virtual const ValidatableType* NullableType() const = 0;
 
   // ShortName() is the class name without a package.
-  std::string ShortName() const { return type_name_; }
+  const std::string& ShortName() const { return type_name_; }
   // CanonicalName() returns the canonical AIDL type, with packages.
-  std::string CanonicalName() const { return canonical_name_; }
+  const std::string& CanonicalName() const { return canonical_name_; }
 
   int Kind() const { return kind_; }
   std::string HumanReadableKind() const;
@@ -89,7 +94,7 @@ class TypeNamespace {
   // constructor because many of the useful methods are virtual.
   virtual void Init() = 0;
 
-  bool AddDefinedTypes(vector<AidlDefinedType*>& types, const string& filename);
+  bool AddDefinedTypes(const vector<AidlDefinedType*>& types, const string& filename);
 
   // Load this TypeNamespace with user defined types.
   virtual bool AddParcelableType(const AidlParcelable& p,
@@ -97,6 +102,13 @@ class TypeNamespace {
 
   virtual bool AddBinderType(const AidlInterface& b,
                              const std::string& filename) = 0;
+  // Make a type from a preprocessed file known to this TypeNamespace. Only its
+  // name is registered: the type is created by CreatePreprocessedType the
+  // first time it is looked up. |type| must outlive this namespace.
+  virtual void AddPreprocessedType(const AidlPreprocessedType& type) = 0;
+  // Same as AddPreprocessedType, for each type of a preprocessed file in the
+  // binary format. |table| must outlive this namespace.
+  virtual void AddPreprocessedTable(const PreprocessedTable& table) = 0;
   // Add a container type to this namespace.  Returns false only
   // on error. Silently discards requests to add non-container types.
   virtual bool MaybeAddContainerType(const AidlTypeSpecifier& aidl_type) = 0;
@@ -117,17 +129,27 @@ class TypeNamespace {
   // Returns a pointer to a type corresponding to |defined_type|.
   virtual const ValidatableType* GetDefinedType(const AidlDefinedType& defined_type) const = 0;
 
-  AidlTypenames typenames_;
+  // The AIDL types of the compilation. They belong to this namespace, unless
+  // it was created to share those that were loaded into another namespace.
+  AidlTypenames& typenames_;
 
  protected:
-  TypeNamespace() = default;
+  TypeNamespace() : typenames_(own_typenames_) {}
+  explicit TypeNamespace(AidlTypenames& typenames) : typenames_(typenames) {}
   virtual ~TypeNamespace() = default;
 
   virtual const ValidatableType* GetValidatableType(const AidlTypeSpecifier& type,
                                                     std::string* error_msg,
                                                     const AidlDefinedType& context) const = 0;
 
+  // Load this TypeNamespace with a type from a preprocessed file, once it is
+  // looked up. By default, this creates the AidlDefinedType for it and adds
+  // that.
+  virtual bool CreatePreprocessedType(const AidlPreprocessedType& type);
+
  private:
+  AidlTypenames own_typenames_;
+
   DISALLOW_COPY_AND_ASSIGN(TypeNamespace);
 };
 
@@ -135,6 +157,7 @@ template<typename T>
 class LanguageTypeNamespace : public TypeNamespace {
  public:
   LanguageTypeNamespace() = default;
+  explicit LanguageTypeNamespace(AidlTypenames& typenames) : TypeNamespace(typenames) {}
   virtual ~LanguageTypeNamespace() = default;
 
   // Get a pointer to an existing type.  Searches first by fully-qualified
@@ -155,6 +178,9 @@ class LanguageTypeNamespace : public TypeNamespace {
     return FindTypeByCanonicalName(defined_type.GetCanonicalName());
   }
 
+  void AddPreprocessedType(const AidlPreprocessedType& type) final;
+  void AddPreprocessedTable(const PreprocessedTable& table) final;
+
   bool MaybeAddContainerType(const AidlTypeSpecifier& aidl_type) override;
   // We dynamically create container types as we discover them in the parse
   // tree.  Returns false if the contained types cannot be canonicalized.
@@ -169,6 +195,10 @@ class LanguageTypeNamespace : public TypeNamespace {
     CHECK(Add(std::move(type)));
     *member = ptr_value;
   }
+  // Makes the types of |builtins| visible in this namespace, as if they had
+  // been added before any other type. |builtins| is shared by the namespaces
+  // of a language: it must not change anymore and must outlive them.
+  void SetBuiltinTypes(const LanguageTypeNamespace<T>* builtins) { builtins_ = builtins; }
 
  private:
   // Returns true iff the name can be canonicalized to a container type.
@@ -182,7 +212,41 @@ class LanguageTypeNamespace : public TypeNamespace {
   const ValidatableType* GetValidatableType(const AidlTypeSpecifier& type, std::string* error_msg,
                                             const AidlDefinedType& context) const override;
 
+  // A type, or a type from a preprocessed file that wasn't created yet, with
+  // the order in which it was added.
+  template <typename U>
+  struct Ordered {
+    const U* type;
+    size_t order;
+  };
+
+  // Returns the not yet created type from a preprocessed file which a lookup
+  // of |name| finds, or nullptr. |*order| is set to the order of that type.
+  const AidlPreprocessedType* FindPendingByCanonicalName(const std::string& name,
+                                                         size_t* order) const;
+  const AidlPreprocessedType* FindPendingByShortName(const std::string& name,
+                                                     size_t* order) const;
+  // Creates |type| as if it had been added at |order|. The lookups which find
+  // the types from preprocessed files are const, hence this is too.
+  void CreatePending(const AidlPreprocessedType* type, size_t order) const;
+
   std::vector<std::unique_ptr<const T>> types_;
+  // Indexes of |types_|. Canonical names are unique, but several types can
+  // share a short name; the most recently added one is remembered for it.
+  std::unordered_map<std::string, const T*> types_by_canonical_name_;
+  std::unordered_map<std::string, Ordered<T>> types_by_short_name_;
+  const LanguageTypeNamespace<T>* builtins_ = nullptr;
+
+  // The types from preprocessed files, see AddPreprocessedType. They are
+  // looked up as if they had been added to |types_| at their order.
+  std::unordered_map<std::string, Ordered<AidlPreprocessedType>> pending_by_canonical_name_;
+  std::unordered_map<std::string, Ordered<AidlPreprocessedType>> pending_by_short_name_;
+  std::vector<Ordered<PreprocessedTable>> pending_tables_;
+  mutable std::unordered_set<const AidlPreprocessedType*> created_;
+  size_t next_order_ = 0;
+  // The order of the type from a preprocessed file being created, if any.
+  mutable size_t creating_order_ = kNotCreating;
+  static constexpr size_t kNotCreating = static_cast<size_t>(-1);
 
   DISALLOW_COPY_AND_ASSIGN(LanguageTypeNamespace);
 };  // class LanguageTypeNamespace
@@ -191,6 +255,14 @@ template <typename T>
 bool LanguageTypeNamespace<T>::Add(std::unique_ptr<const T> type) {
   const T* existing = FindTypeByCanonicalName(type->CanonicalName());
   if (!existing) {
+    const size_t order = creating_order_ != kNotCreating ? creating_order_ : next_order_++;
+    types_by_canonical_name_.emplace(type->CanonicalName(), type.get());
+    auto it = types_by_short_name_.find(type->ShortName());
+    if (it == types_by_short_name_.end()) {
+      types_by_short_name_.emplace(type->ShortName(), Ordered<T>{type.get(), order});
+    } else if (it->second.order <= order) {
+      it->second = Ordered<T>{type.get(), order};
+    }
     types_.push_back(std::move(type));
     return true;
   }
@@ -215,6 +287,80 @@ bool LanguageTypeNamespace<T>::Add(std::unique_ptr<const T> type) {
   return true;
 }
 
+template <typename T>
+void LanguageTypeNamespace<T>::AddPreprocessedType(const AidlPreprocessedType& type) {
+  const Ordered<AidlPreprocessedType> pending{&type, next_order_++};
+  // As with Add, the first type wins a canonical name and the last a short one.
+  pending_by_canonical_name_.emplace(type.GetCanonicalName(), pending);
+  pending_by_short_name_[type.GetName()] = pending;
+}
+
+template <typename T>
+void LanguageTypeNamespace<T>::AddPreprocessedTable(const PreprocessedTable& table) {
+  pending_tables_.push_back(Ordered<PreprocessedTable>{&table, next_order_++});
+}
+
+template <typename T>
+const AidlPreprocessedType* LanguageTypeNamespace<T>::FindPendingByCanonicalName(
+    const std::string& name, size_t* order) const {
+  const AidlPreprocessedType* found = nullptr;
+  auto it = pending_by_canonical_name_.find(name);
+  if (it != pending_by_canonical_name_.end() && created_.count(it->second.type) == 0) {
+    found = it->second.type;
+    *order = it->second.order;
+  }
+  for (const auto& table : pending_tables_) {
+    if (found != nullptr && *order < table.order) {
+      break;
+    }
+    const AidlPreprocessedType* type = table.type->FindByCanonicalName(name);
+    if (type != nullptr && created_.count(type) == 0) {
+      found = type;
+      *order = table.order;
+      break;
+    }
+  }
+  return found;
+}
+
+template <typename T>
+const AidlPreprocessedType* LanguageTypeNamespace<T>::FindPendingByShortName(
+    const std::string& name, size_t* order) const {
+  // If the last type with this name was created already, it is in |types_|
+  // and none of the others would be found anyway.
+  const AidlPreprocessedType* found = nullptr;
+  auto it = pending_by_short_name_.find(name);
+  if (it != pending_by_short_name_.end() && created_.count(it->second.type) == 0) {
+    found = it->second.type;
+    *order = it->second.order;
+  }
+  for (auto table = pending_tables_.rbegin(); table != pending_tables_.rend(); ++table) {
+    if (found != nullptr && table->order < *order) {
+      break;
+    }
+    const AidlPreprocessedType* type = table->type->FindByName(name);
+    if (type != nullptr) {
+      if (created_.count(type) == 0) {
+        found = type;
+        *order = table->order;
+      }
+      break;
+    }
+  }
+  return found;
+}
+
+template <typename T>
+void LanguageTypeNamespace<T>::CreatePending(const AidlPreprocessedType* type,
+                                             size_t order) const {
+  // Marked first, so that the lookup done by Add doesn't create it again.
+  created_.insert(type);
+  const size_t outer_order = creating_order_;
+  creating_order_ = order;
+  const_cast<LanguageTypeNamespace<T>*>(this)->CreatePreprocessedType(*type);
+  creating_order_ = outer_order;
+}
+
 template <typename T>
 const T* LanguageTypeNamespace<T>::Find(const AidlTypeSpecifier& aidl_type) const {
   using std::string;
@@ -242,22 +388,45 @@ const T* LanguageTypeNamespace<T>::FindTypeByCanonicalName(
     const std::string& raw_name) const {
   using android::base::Trim;
 
-  std::string name = Trim(raw_name);
-  const T* ret = nullptr;
-  for (const auto& type : types_) {
-    // Always prefer a exact match if possible.
-    // This works for primitives and class names qualified with a package.
-    if (type->CanonicalName() == name) {
-      ret = type.get();
-      break;
+  const std::string name = Trim(raw_name);
+  // Always prefer a exact match if possible.
+  // This works for primitives and class names qualified with a package.
+  auto it = types_by_canonical_name_.find(name);
+  if (it != types_by_canonical_name_.end()) {
+    return it->second;
+  }
+  if (builtins_ != nullptr) {
+    it = builtins_->types_by_canonical_name_.find(name);
+    if (it != builtins_->types_by_canonical_name_.end()) {
+      return it->second;
     }
-    // We allow authors to drop packages when refering to a class name.
-    if (type->ShortName() == name) {
-      ret = type.get();
+  }
+  size_t order;
+  const AidlPreprocessedType* pending = FindPendingByCanonicalName(name, &order);
+  if (pending != nullptr) {
+    CreatePending(pending, order);
+    return FindTypeByCanonicalName(name);
+  }
+  // We allow authors to drop packages when refering to a class name. If the
+  // short name is ambiguous, the type added last is used. The built-in types
+  // always come first.
+  auto short_it = types_by_short_name_.find(name);
+  pending = FindPendingByShortName(name, &order);
+  if (pending != nullptr &&
+      (short_it == types_by_short_name_.end() || short_it->second.order < order)) {
+    CreatePending(pending, order);
+    return FindTypeByCanonicalName(name);
+  }
+  if (short_it != types_by_short_name_.end()) {
+    return short_it->second.type;
+  }
+  if (builtins_ != nullptr) {
+    short_it = builtins_->types_by_short_name_.find(name);
+    if (short_it != builtins_->types_by_short_name_.end()) {
+      return short_it->second.type;
     }
   }
-
-  return ret;
+  return nullptr;
 }
 
 template <typename T>